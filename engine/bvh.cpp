@@ -0,0 +1,239 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+    // squared distance from the sphere centre to the box, compared against the squared radius
+    bool touches(
+        const glm::vec3& lo,
+        const glm::vec3& hi,
+        const glm::vec4& sphere
+    ) {
+        const glm::vec3 closest = glm::clamp(glm::vec3(sphere), lo, hi);
+        const glm::vec3 d = glm::vec3(sphere) - closest;
+
+        return glm::dot(d, d) <= sphere.w * sphere.w;
+    }
+}
+
+tdl::Frustum tdl::Frustum::fromMatrix(
+    const glm::mat4& view_proj
+) {
+    const auto row = [&](const int i) {
+        return glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+    };
+
+    Frustum frustum;
+    frustum.planes = {
+        row(3) + row(0), // left
+        row(3) - row(0), // right
+        row(3) + row(1), // bottom
+        row(3) - row(1), // top
+        row(3) + row(2), // near, depth goes from -1 to 1
+        row(3) - row(2) // far
+    };
+
+    for (auto& plane : frustum.planes) plane /= glm::length(glm::vec3(plane));
+
+    return frustum;
+}
+
+bool tdl::Frustum::intersects(
+    const glm::vec4& sphere
+) const {
+    for (const auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) return false;
+    }
+
+    return true;
+}
+
+bool tdl::Frustum::intersects(
+    const glm::vec3& lo,
+    const glm::vec3& hi
+) const {
+    for (const auto& plane : planes) {
+        // corner of the box furthest along the plane normal
+        const glm::vec3 corner {
+            plane.x > 0.0f ? hi.x : lo.x,
+            plane.y > 0.0f ? hi.y : lo.y,
+            plane.z > 0.0f ? hi.z : lo.z
+        };
+
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+    }
+
+    return true;
+}
+
+void tdl::LightBVH::update(
+    const std::vector<Light>& lights,
+    const std::vector<uint64_t>& versions
+) {
+    const size_t count = std::min(lights.size(), versions.size());
+
+    bool rebuild = spheres_.size() != count;
+    if (rebuild) {
+        spheres_.assign(count, glm::vec4(0.0f));
+        versions_.assign(count, 0);
+        hit_.assign(count, 0);
+    }
+
+    bool moved = false;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (versions_[i] == versions[i]) continue;
+
+        const Light& light = lights[i];
+        const glm::vec4 sphere {light.position.x, -light.position.y, light.position.z, std::max(light.position.w, 0.0f)};
+
+        // the light moves between the tree and the global list
+        if ((sphere.w > 0.0f) != (spheres_[i].w > 0.0f)) rebuild = true;
+
+        spheres_[i] = sphere;
+        versions_[i] = versions[i];
+        moved = true;
+    }
+
+    rebuilt_ = rebuild;
+
+    if (rebuild) build();
+    else if (moved) refit();
+}
+
+void tdl::LightBVH::query(
+    const Frustum& frustum,
+    const std::vector<glm::vec4>& receivers,
+    std::vector<uint32_t>& result
+) {
+    result.assign(globals_.begin(), globals_.end());
+    if (nodes_.empty()) return;
+
+    const size_t first_hit = result.size();
+
+    for (const glm::vec4& receiver : receivers) {
+        stack_.assign(1, 0);
+
+        while (!stack_.empty()) {
+            const Node& node = nodes_[stack_.back()];
+            stack_.pop_back();
+
+            if (!touches(node.lo, node.hi, receiver) || !frustum.intersects(node.lo, node.hi)) continue;
+
+            if (node.count == 0) {
+                stack_.push_back(node.first);
+                stack_.push_back(node.first + 1);
+                continue;
+            }
+
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const uint32_t light = items_[i];
+                if (hit_[light]) continue;
+
+                const glm::vec4& sphere = spheres_[light];
+                const float reach = sphere.w + receiver.w;
+                const glm::vec3 d = glm::vec3(sphere) - glm::vec3(receiver);
+
+                if (glm::dot(d, d) > reach * reach || !frustum.intersects(sphere)) continue;
+
+                hit_[light] = 1;
+                result.push_back(light);
+            }
+        }
+    }
+
+    for (size_t i = first_hit; i < result.size(); ++i) hit_[result[i]] = 0;
+
+    // buffer order, lights that stay relevant keep their relative order between frames
+    std::ranges::sort(result);
+}
+
+void tdl::LightBVH::build() {
+    nodes_.clear();
+    items_.clear();
+    globals_.clear();
+
+    for (uint32_t i = 0; i < spheres_.size(); ++i) {
+        if (spheres_[i].w > 0.0f) items_.push_back(i);
+        else globals_.push_back(i);
+    }
+
+    if (items_.empty()) return;
+
+    nodes_.reserve(2 * (items_.size() / leaf_size + 1));
+    nodes_.emplace_back();
+
+    split(0, 0, static_cast<uint32_t>(items_.size()));
+}
+
+void tdl::LightBVH::split(
+    const uint32_t node,
+    const uint32_t begin,
+    const uint32_t end
+) {
+    glm::vec3 lo { std::numeric_limits<float>::max() };
+    glm::vec3 hi { std::numeric_limits<float>::lowest() };
+    glm::vec3 centre_lo = lo;
+    glm::vec3 centre_hi = hi;
+
+    for (uint32_t i = begin; i < end; ++i) {
+        const glm::vec4& sphere = spheres_[items_[i]];
+
+        lo = glm::min(lo, glm::vec3(sphere) - sphere.w);
+        hi = glm::max(hi, glm::vec3(sphere) + sphere.w);
+        centre_lo = glm::min(centre_lo, glm::vec3(sphere));
+        centre_hi = glm::max(centre_hi, glm::vec3(sphere));
+    }
+
+    if (end - begin <= leaf_size) {
+        nodes_[node] = {lo, begin, hi, end - begin};
+        return;
+    }
+
+    const glm::vec3 extent = centre_hi - centre_lo;
+    const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    const uint32_t mid = begin + (end - begin) / 2;
+
+    std::nth_element(
+        items_.begin() + begin,
+        items_.begin() + mid,
+        items_.begin() + end,
+        [this, axis](const uint32_t a, const uint32_t b) { return spheres_[a][axis] < spheres_[b][axis]; }
+    );
+
+    // children are stored next to each other, after their parent
+    const auto left = static_cast<uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+    nodes_.emplace_back();
+    nodes_[node] = {lo, left, hi, 0};
+
+    split(left, begin, mid);
+    split(left + 1, mid, end);
+}
+
+void tdl::LightBVH::refit() {
+    // children always come after their parent, walking backwards refits them first
+    for (auto i = static_cast<uint32_t>(nodes_.size()); i-- > 0;) {
+        Node& node = nodes_[i];
+
+        if (node.count == 0) {
+            const Node& left = nodes_[node.first];
+            const Node& right = nodes_[node.first + 1];
+
+            node.lo = glm::min(left.lo, right.lo);
+            node.hi = glm::max(left.hi, right.hi);
+            continue;
+        }
+
+        node.lo = glm::vec3(std::numeric_limits<float>::max());
+        node.hi = glm::vec3(std::numeric_limits<float>::lowest());
+
+        for (uint32_t j = node.first; j < node.first + node.count; ++j) {
+            const glm::vec4& sphere = spheres_[items_[j]];
+
+            node.lo = glm::min(node.lo, glm::vec3(sphere) - sphere.w);
+            node.hi = glm::max(node.hi, glm::vec3(sphere) + sphere.w);
+        }
+    }
+}
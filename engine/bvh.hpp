@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "lighting.hpp"
+
+namespace tdl {
+    /**
+     * @breif Planes of a view frustum, points inside are on the positive side of all six
+    */
+    struct Frustum {
+        std::array<glm::vec4, 6> planes {}; // normal (xyz) and distance (w), normalised
+
+        /**
+         * @breif Extracts the planes of a projection * view matrix
+         *
+         * Camera builds its projection with a -1 - 1 depth range (GLM_FORCE_DEPTH_ZERO_TO_ONE is only defined after
+         * glm is included), the near plane is taken for that range. For a 0 - 1 projection it lies behind the real
+         * near plane, so the frustum is a little larger but never culls anything in view.
+        */
+        static Frustum fromMatrix (
+            const glm::mat4& view_proj
+        );
+
+        /**
+         * @breif false only if the sphere (centre xyz, radius w) is completely outside
+        */
+        [[nodiscard]] bool intersects (
+            const glm::vec4& sphere
+        ) const;
+
+        /**
+         * @breif false only if the box is completely outside, boxes near the frustum corners can be reported inside
+        */
+        [[nodiscard]] bool intersects (
+            const glm::vec3& lo,
+            const glm::vec3& hi
+        ) const;
+    };
+
+    /**
+     * @breif Bounding volume hierarchy over the influence spheres of the lights
+     *
+     * Finds the lights that can light a visible object without testing every light against every object. The tree is
+     * built once and refit when lights move, it is only built again when lights are added or removed or a light gains
+     * or loses its radius. Lights without a radius (ambient, spot) are kept outside the tree and are always relevant.
+    */
+    class LightBVH {
+        public:
+            static constexpr uint32_t leaf_size = 4; // max lights per leaf
+
+            /**
+             * @breif Refits the tree to the lights that changed, builds it if the set of lights changed
+             *
+             * @param lights lights in light buffer order, positions are mirrored on the y axis like in the shader
+             * @param versions version of every light, only lights with a new version are refit
+            */
+            void update (
+                const std::vector<Light>& lights,
+                const std::vector<uint64_t>& versions
+            );
+
+            /**
+             * @breif Finds the lights whose influence sphere touches the frustum and at least one of the receivers
+             *
+             * @param frustum view frustum of the camera
+             * @param receivers bounding spheres (centre xyz, radius w) of the visible objects
+             * @param result filled with the indices of the relevant lights in ascending order, global lights included
+            */
+            void query (
+                const Frustum& frustum,
+                const std::vector<glm::vec4>& receivers,
+                std::vector<uint32_t>& result
+            );
+
+            [[nodiscard]] uint32_t nodes() const { return static_cast<uint32_t>(nodes_.size()); }
+            [[nodiscard]] bool rebuilt() const { return rebuilt_; } // true if the last update built the tree again
+
+        private:
+            /**
+             * @breif Leaves hold count lights starting at first in items_, inner nodes (count 0) have their children at
+             * first and first + 1
+            */
+            struct Node {
+                glm::vec3 lo {0.0f};
+                uint32_t first = 0;
+                glm::vec3 hi {0.0f};
+                uint32_t count = 0;
+            };
+
+            void build();
+
+            /**
+             * @breif Makes node the parent of the lights in items_[begin, end), splits them at the median of the longest axis
+            */
+            void split (
+                uint32_t node,
+                uint32_t begin,
+                uint32_t end
+            );
+
+            void refit();
+
+            std::vector<Node> nodes_;
+            std::vector<uint32_t> items_; // lights with a radius, in leaf order
+            std::vector<uint32_t> globals_; // lights without a radius
+
+            std::vector<glm::vec4> spheres_; // world space influence sphere of every light
+            std::vector<uint64_t> versions_; // version every sphere was computed from
+            std::vector<uint8_t> hit_; // lights found by the running query
+            std::vector<uint32_t> stack_; // nodes left to visit, kept between queries to reuse the allocation
+
+            bool rebuilt_ = false;
+    };
+};
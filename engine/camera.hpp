@@ -81,6 +81,9 @@ namespace tdl {
             */
             [[nodiscard]] glm::mat4 getProjectionMatrix(); // getter not const as changes has_changed_
 
+            [[nodiscard]] float getNearPlane() const { return details_.near_; }
+            [[nodiscard]] float getFarPlane() const { return details_.far_; }
+
             /**
              * @breif bool operator to check if the projection matrix has change d since it was last retrived.
             */
@@ -0,0 +1,132 @@
+#include "clusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void tdl::LightClusters::build(
+    const std::vector<Light>& lights,
+    const glm::mat4& view,
+    const glm::mat4& proj,
+    const float near,
+    const float far,
+    const glm::vec2& screen,
+    JobSystem& jobs
+) {
+    const auto start = std::chrono::steady_clock::now();
+
+    info_.depth = {near, far, static_cast<float>(depth_slices) / std::log(far / near), 0.0f};
+    info_.screen = {screen.x, screen.y, 0.0f, 0.0f};
+
+    indices_.clear();
+    bounds_.clear();
+    clustered_ = 0;
+    overflow_ = 0;
+
+    const auto light_count = static_cast<uint32_t>(std::min<size_t>(lights.size(), max_lights));
+
+    for (uint32_t i = 0; i < light_count; ++i) {
+        const Light& light = lights[i];
+        const float radius = light.position.w;
+
+        // no falloff radius, every fragment has to see this light
+        if (radius <= 0.0f) {
+            indices_.push_back(i);
+            continue;
+        }
+
+        // the fragment shader mirrors light positions on the y axis
+        const glm::vec4 centre = view * glm::vec4(light.position.x, -light.position.y, light.position.z, 1.0f);
+        const float depth = -centre.z;
+
+        if (depth + radius < near || depth - radius > far) continue; // entirely in front of or behind the frustum
+
+        Bounds bounds {
+            i,
+            0, tiles_x - 1,
+            0, tiles_y - 1,
+            slice(std::max(depth - radius, near)), slice(std::min(depth + radius, far))
+        };
+
+        // screen rect of the bounding box, spheres crossing the near plane can cover the whole screen
+        if (depth - radius > near) {
+            glm::vec2 lo { 1.0f };
+            glm::vec2 hi { -1.0f };
+
+            for (int corner = 0; corner < 8; ++corner) {
+                const glm::vec4 point {
+                    centre.x + ((corner & 1) ? radius : -radius),
+                    centre.y + ((corner & 2) ? radius : -radius),
+                    centre.z + ((corner & 4) ? radius : -radius),
+                    1.0f
+                };
+
+                const glm::vec4 clip = proj * point;
+                const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+
+                lo = glm::min(lo, ndc);
+                hi = glm::max(hi, ndc);
+            }
+
+            if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f) continue; // outside the screen
+
+            const auto tile = [](const float ndc, const uint32_t tiles) {
+                const float t = std::clamp((ndc * 0.5f + 0.5f) * static_cast<float>(tiles), 0.0f, static_cast<float>(tiles - 1));
+                return static_cast<uint32_t>(t);
+            };
+
+            bounds.x0 = tile(lo.x, tiles_x);
+            bounds.x1 = tile(hi.x, tiles_x);
+            bounds.y0 = tile(lo.y, tiles_y);
+            bounds.y1 = tile(hi.y, tiles_y);
+        }
+
+        bounds_.push_back(bounds);
+    }
+
+    const auto global_count = static_cast<uint32_t>(indices_.size());
+    info_.grid = {tiles_x, tiles_y, depth_slices, global_count};
+    clustered_ = static_cast<uint32_t>(bounds_.size());
+
+    // every slice only writes to its own clusters
+    jobs.parallelFor(depth_slices, 1, [this](const size_t begin, const size_t end) {
+        for (auto z = static_cast<uint32_t>(begin); z < end; ++z) {
+            const uint32_t first = z * tiles_x * tiles_y;
+
+            for (uint32_t c = first; c < first + tiles_x * tiles_y; ++c) lists_[c].clear();
+
+            for (const Bounds& b : bounds_) {
+                if (z < b.z0 || z > b.z1) continue;
+
+                for (uint32_t y = b.y0; y <= b.y1; ++y) {
+                    for (uint32_t x = b.x0; x <= b.x1; ++x) {
+                        lists_[first + y * tiles_x + x].push_back(b.light);
+                    }
+                }
+            }
+        }
+    });
+
+    // flatten into one index list after the global lights
+    max_per_cluster_ = 0;
+
+    for (uint32_t c = 0; c < count; ++c) {
+        const auto& list = lists_[c];
+        const auto offset = static_cast<uint32_t>(indices_.size());
+        const auto fits = static_cast<uint32_t>(std::min<size_t>(list.size(), max_indices - std::min<size_t>(offset, max_indices)));
+
+        indices_.insert(indices_.end(), list.begin(), list.begin() + fits);
+        grid_[c] = {offset, fits};
+
+        overflow_ += static_cast<uint32_t>(list.size()) - fits;
+        max_per_cluster_ = std::max(max_per_cluster_, fits);
+    }
+
+    build_time_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+}
+
+uint32_t tdl::LightClusters::slice(
+    const float depth
+) const {
+    const float s = std::log(depth / info_.depth.x) * info_.depth.z;
+    return static_cast<uint32_t>(std::clamp(s, 0.0f, static_cast<float>(depth_slices - 1)));
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "jobs.hpp"
+#include "lighting.hpp"
+
+namespace tdl {
+    /**
+     * @breif Header of the cluster grid storage buffer, tells the fragment shader how to find its cluster
+    */
+    struct ClusterInfo {
+        glm::uvec4 grid {0}; // tiles x, tiles y, depth slices, number of global lights
+        glm::vec4 depth {0.0f}; // near plane, far plane, slices / log(far / near), 0
+        glm::vec4 screen {0.0f}; // framebuffer width, height, 0, 0
+    };
+
+    /**
+     * @breif Assigns lights to view space froxel clusters on the CPU
+     *
+     * The view frustum is split into tiles_x * tiles_y screen tiles and depth_slices exponentially spaced depth slices.
+     * Every light with a finite influence radius is added to all clusters its bounding sphere could touch, every
+     * fragment then only has to shade the lights in its own cluster. Lights without a radius (ambient, directional)
+     * are global and listed at the start of the index list.
+     *
+     * The result is laid out exactly like the storage buffers read by the fragment shader.
+    */
+    class LightClusters {
+        public:
+            static constexpr uint32_t tiles_x = 16;
+            static constexpr uint32_t tiles_y = 9;
+            static constexpr uint32_t depth_slices = 24;
+            static constexpr uint32_t count = tiles_x * tiles_y * depth_slices;
+
+            static constexpr uint32_t max_indices = count * 64; // capacity of the light index buffer
+
+            /**
+             * @breif Rebuilds the clusters for the given lights and camera
+             *
+             * @param lights lights in the order they are stored in the light buffer, only the first max_lights are used
+             * @param view view matrix of the camera
+             * @param proj projection matrix of the camera
+             * @param near distance to the near plane
+             * @param far distance to the far plane
+             * @param screen size of the framebuffer in pixels
+             * @param jobs job system used to fill the depth slices in parallel
+            */
+            void build (
+                const std::vector<Light>& lights,
+                const glm::mat4& view,
+                const glm::mat4& proj,
+                float near,
+                float far,
+                const glm::vec2& screen,
+                JobSystem& jobs
+            );
+
+            [[nodiscard]] const ClusterInfo& info() const { return info_; }
+
+            /**
+             * @breif offset into indices() and number of lights of every cluster, indexed x + y * tiles_x + slice * tiles_x * tiles_y
+            */
+            [[nodiscard]] const std::vector<glm::uvec2>& grid() const { return grid_; }
+            [[nodiscard]] const std::vector<uint32_t>& indices() const { return indices_; }
+
+            [[nodiscard]] uint32_t clusteredLights() const { return clustered_; } // lights that touch the frustum
+            [[nodiscard]] uint32_t maxPerCluster() const { return max_per_cluster_; }
+            [[nodiscard]] uint32_t overflow() const { return overflow_; } // indices dropped because the buffer was full
+            [[nodiscard]] std::chrono::nanoseconds buildTime() const { return build_time_; }
+
+        private:
+            /**
+             * @breif Range of clusters touched by one light
+            */
+            struct Bounds {
+                uint32_t light;
+                uint32_t x0, x1;
+                uint32_t y0, y1;
+                uint32_t z0, z1;
+            };
+
+            /**
+             * @breif Gets the depth slice the given view space distance falls into
+            */
+            [[nodiscard]] uint32_t slice (
+                float depth
+            ) const;
+
+            ClusterInfo info_ {};
+            std::vector<glm::uvec2> grid_ = std::vector<glm::uvec2>(count);
+            std::vector<uint32_t> indices_;
+
+            // kept between builds to reuse the allocations
+            std::vector<Bounds> bounds_;
+            std::vector<std::vector<uint32_t>> lists_ = std::vector<std::vector<uint32_t>>(count);
+
+            uint32_t clustered_ = 0;
+            uint32_t max_per_cluster_ = 0;
+            uint32_t overflow_ = 0;
+            std::chrono::nanoseconds build_time_ {0};
+    };
+};
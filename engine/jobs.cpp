@@ -0,0 +1,253 @@
+#include "jobs.hpp"
+
+#include <algorithm>
+
+namespace {
+    // pool and worker index of the calling thread, used to push jobs onto the worker's own queue
+    thread_local const tdl::JobSystem* current_system = nullptr;
+    thread_local int current_index = -1;
+
+    int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+}
+
+tdl::JobSystem::JobSystem(
+    unsigned int workers
+) {
+    if (workers == 0) {
+        // leave one hardware thread for the thread that owns the pool
+        const unsigned int hardware = std::thread::hardware_concurrency();
+        workers = hardware > 1 ? hardware - 1 : 1;
+    }
+
+    stats_start_ns_ = nowNs();
+
+    workers_.reserve(workers);
+    for (unsigned int i = 0; i < workers; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+
+    // threads are only started once every worker exists as they steal from each other
+    for (unsigned int i = 0; i < workers; ++i) {
+        workers_[i]->thread = std::thread(&tdl::JobSystem::workerLoop, this, i);
+    }
+}
+
+tdl::JobHandle tdl::JobSystem::submit(
+    std::function<void()> task,
+    const JobHandle& parent
+) {
+    auto job = std::make_shared<Job>();
+    job->task = std::move(task);
+    job->parent = parent;
+
+    // parent can not finish before this job has
+    if (parent != nullptr) parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+
+    int index = currentWorker();
+    if (index < 0) index = static_cast<int>(next_.fetch_add(1, std::memory_order_relaxed) % workers_.size());
+
+    {
+        std::lock_guard lock (workers_[index]->mutex);
+        workers_[index]->queue.push_back(job);
+    }
+
+    pending_.fetch_add(1, std::memory_order_release);
+
+    // locking the sleep mutex makes sure a worker that is about to sleep sees the new job
+    { std::lock_guard lock (sleep_mutex_); }
+    sleep_cv_.notify_one();
+
+    return job;
+}
+
+void tdl::JobSystem::wait(
+    const JobHandle& job
+) {
+    const int index = currentWorker();
+
+    // help out instead of blocking, this also stops workers waiting on their own children from deadlocking
+    while (job->unfinished.load(std::memory_order_acquire) > 0) {
+        if (const JobHandle next = findJob(index)) {
+            run(next);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    if (job->error) std::rethrow_exception(job->error);
+}
+
+void tdl::JobSystem::parallelFor(
+    const size_t count,
+    size_t grain,
+    const std::function<void(size_t, size_t)>& body
+) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+
+    // not worth going through the queues for a single chunk
+    if (count <= grain) {
+        body(0, count);
+        return;
+    }
+
+    // root is never queued, it only exists so all chunks can be waited on at once
+    const auto root = std::make_shared<Job>();
+
+    for (size_t begin = 0; begin < count; begin += grain) {
+        const size_t end = std::min(begin + grain, count);
+        submit([&body, begin, end] { body(begin, end); }, root);
+    }
+
+    finish(root); // root has no task of its own
+    wait(root);
+}
+
+std::vector<tdl::WorkerStats> tdl::JobSystem::stats() const {
+    const auto elapsed = static_cast<double>(std::max<int64_t>(nowNs() - stats_start_ns_.load(), 1));
+
+    std::vector<WorkerStats> result;
+    result.reserve(workers_.size());
+
+    for (const auto& worker : workers_) {
+        const int64_t busy = worker->busy_ns.load(std::memory_order_relaxed);
+
+        result.push_back({
+            worker->jobs.load(std::memory_order_relaxed),
+            worker->steals.load(std::memory_order_relaxed),
+            std::chrono::nanoseconds(busy),
+            static_cast<double>(busy) / elapsed
+        });
+    }
+
+    return result;
+}
+
+void tdl::JobSystem::resetStats() {
+    for (const auto& worker : workers_) {
+        worker->jobs = 0;
+        worker->steals = 0;
+        worker->busy_ns = 0;
+    }
+
+    stats_start_ns_ = nowNs();
+}
+
+tdl::JobSystem::~JobSystem() {
+    {
+        std::lock_guard lock (sleep_mutex_);
+        stop_ = true;
+    }
+    sleep_cv_.notify_all();
+
+    for (const auto& worker : workers_) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+void tdl::JobSystem::workerLoop(
+    const unsigned int index
+) {
+    current_system = this;
+    current_index = static_cast<int>(index);
+
+    while (!stop_.load(std::memory_order_acquire)) {
+        if (const JobHandle job = findJob(static_cast<int>(index))) {
+            // only measured here, jobs run while waiting inside another job are part of that job's time
+            const int64_t start = nowNs();
+            run(job);
+
+            workers_[index]->busy_ns.fetch_add(nowNs() - start, std::memory_order_relaxed);
+            continue;
+        }
+
+        // nothing to do, sleep until a job is submitted
+        std::unique_lock lock (sleep_mutex_);
+        sleep_cv_.wait(lock, [this] {
+            return stop_.load(std::memory_order_acquire) || pending_.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
+
+tdl::JobHandle tdl::JobSystem::findJob(
+    const int index
+) {
+    // newest job from the own queue first, it is the most likely to still be in cache
+    if (index >= 0) {
+        Worker& self = *workers_[index];
+        std::lock_guard lock (self.mutex);
+
+        if (!self.queue.empty()) {
+            JobHandle job = std::move(self.queue.back());
+            self.queue.pop_back();
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    // steal the oldest job from any other worker
+    const size_t count = workers_.size();
+    const size_t start = index >= 0 ? static_cast<size_t>(index) + 1 : 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const size_t victim = (start + i) % count;
+        if (static_cast<int>(victim) == index) continue;
+
+        Worker& other = *workers_[victim];
+        std::lock_guard lock (other.mutex);
+
+        if (!other.queue.empty()) {
+            JobHandle job = std::move(other.queue.front());
+            other.queue.pop_front();
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+
+            if (index >= 0) workers_[index]->steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+void tdl::JobSystem::run(
+    const JobHandle& job
+) {
+    try {
+        if (job->task) job->task();
+    } catch (...) {
+        std::lock_guard lock (error_mutex_);
+        if (!job->error) job->error = std::current_exception();
+    }
+
+    if (const int index = currentWorker(); index >= 0) {
+        workers_[index]->jobs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    finish(job);
+}
+
+void tdl::JobSystem::finish(
+    const JobHandle& job
+) {
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    job->task = nullptr; // release anything captured by the task
+
+    if (job->parent != nullptr) {
+        // pass errors up so waiting on the parent reports them
+        if (job->error) {
+            std::lock_guard lock (error_mutex_);
+            if (!job->parent->error) job->parent->error = job->error;
+        }
+
+        finish(job->parent);
+    }
+}
+
+int tdl::JobSystem::currentWorker() const {
+    return current_system == this ? current_index : -1;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tdl {
+    /**
+     * @breif A unit of work that can be run by any worker of a JobSystem
+     *
+     * A job is only finished once its own task and all of its children have finished, this is what allows a parent
+     * to be used to wait for a whole group of jobs.
+    */
+    struct Job {
+        std::function<void()> task;
+        std::shared_ptr<Job> parent;
+        std::atomic<int> unfinished { 1 }; // own task + children that are still running
+        std::exception_ptr error; // first exception thrown by the task or one of its children
+    };
+    using JobHandle = std::shared_ptr<Job>;
+
+    /**
+     * @breif Utilization counters of a single worker thread
+    */
+    struct WorkerStats {
+        uint64_t jobs = 0; // jobs run
+        uint64_t steals = 0; // jobs taken from another worker's queue
+        std::chrono::nanoseconds busy {0}; // time spent running jobs
+        double utilization = 0.0; // busy time / time since the counters were reset
+    };
+
+    /**
+     * @breif Work-stealing task scheduler
+     *
+     * Every worker owns a deque, jobs submitted from a worker are pushed onto its own deque and popped from the back
+     * (most recent first) while idle workers steal from the front of other deques (oldest first). Jobs submitted from
+     * outside the pool are spread over the workers round robin. Threads waiting for a job help run queued jobs instead
+     * of blocking.
+    */
+    class JobSystem {
+        public:
+            /**
+             * @breif Starts the worker threads
+             *
+             * @param workers number of worker threads, 0 uses one less than the number of hardware threads
+            */
+            explicit JobSystem (
+                unsigned int workers = 0
+            );
+
+            JobSystem(const JobSystem&) = delete;
+            JobSystem& operator=(const JobSystem&) = delete;
+
+            /**
+             * @breif Queues a task to be run by the pool
+             *
+             * @param task function to run
+             * @param parent job that will not finish before this one has, can be nullptr
+             * @return JobHandle that can be passed to wait() or used as the parent of other jobs
+            */
+            JobHandle submit (
+                std::function<void()> task,
+                const JobHandle& parent = nullptr
+            );
+
+            /**
+             * @breif Blocks until the job and all of its children have finished, running queued jobs in the meantime
+             *
+             * Rethrows the first exception thrown by the job or any of its children.
+             *
+             * @param job job to wait for
+            */
+            void wait (
+                const JobHandle& job
+            );
+
+            /**
+             * @breif Splits [0, count) into chunks of at most grain elements and runs body on every chunk in parallel
+             *
+             * Returns once every chunk has been processed.
+             *
+             * @param count number of elements
+             * @param grain max number of elements per job
+             * @param body called with the [begin, end) range of each chunk
+            */
+            void parallelFor (
+                size_t count,
+                size_t grain,
+                const std::function<void(size_t, size_t)>& body
+            );
+
+            /**
+             * @breif Gets the utilization counters of every worker
+             *
+             * @return std::vector<WorkerStats> one entry per worker
+            */
+            [[nodiscard]] std::vector<WorkerStats> stats() const;
+
+            /**
+             * @breif Sets all worker counters back to zero
+            */
+            void resetStats();
+
+            [[nodiscard]] unsigned int workerCount() const { return static_cast<unsigned int>(workers_.size()); }
+
+            ~JobSystem();
+
+        private:
+            struct Worker {
+                std::deque<JobHandle> queue;
+                std::mutex mutex;
+                std::thread thread;
+
+                std::atomic<uint64_t> jobs { 0 };
+                std::atomic<uint64_t> steals { 0 };
+                std::atomic<int64_t> busy_ns { 0 };
+            };
+
+            /**
+             * @breif Loop run by each worker thread
+             *
+             * @param index index of the worker in workers_
+            */
+            void workerLoop (
+                unsigned int index
+            );
+
+            /**
+             * @breif Takes a job from the given worker's queue or steals one from any other worker
+             *
+             * @param index index of the worker looking for work, -1 for threads outside the pool
+             * @return JobHandle or nullptr if every queue is empty
+            */
+            JobHandle findJob (
+                int index
+            );
+
+            /**
+             * @breif Runs the job and marks it as finished
+             *
+             * @param job job to run
+            */
+            void run (
+                const JobHandle& job
+            );
+
+            /**
+             * @breif Marks one unit of the job as finished, finishing its parent if it was the last one
+             *
+             * @param job job to finish
+            */
+            void finish (
+                const JobHandle& job
+            );
+
+            /**
+             * @breif Index of the calling thread in workers_, -1 if it does not belong to this pool
+            */
+            [[nodiscard]] int currentWorker() const;
+
+            std::vector<std::unique_ptr<Worker>> workers_;
+
+            std::atomic<size_t> pending_ { 0 }; // queued jobs that have not been picked up yet
+            std::atomic<unsigned int> next_ { 0 }; // round robin index for jobs submitted from outside the pool
+            std::atomic<bool> stop_ { false };
+
+            std::mutex sleep_mutex_;
+            std::condition_variable sleep_cv_;
+
+            std::mutex error_mutex_;
+
+            std::atomic<int64_t> stats_start_ns_ { 0 };
+    };
+};
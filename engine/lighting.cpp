@@ -1,5 +1,8 @@
 #include "lighting.hpp"
 
+#include "clusters.hpp"
+#include "vulkan/shadows.hpp"
+
 tdl::AmbientLight::AmbientLight(
     const glm::vec4& color,
     const float intensity,
@@ -17,7 +20,7 @@ void tdl::LightHelper::render(
     command_buffer.bindDescriptorSets(
         vk::PipelineBindPoint::eGraphics,
         pipeline_layout,
-        2,
+        3,
         1,
         &descriptor_sets[cframe],
         0,
@@ -27,70 +30,129 @@ void tdl::LightHelper::render(
 
 void tdl::LightHelper::createDescriptorSets(
     std::vector<vk::DescriptorSet>& descriptor_sets,
-    const std::vector<MemoryBuffer*>& ubos,
+    const std::vector<LightBuffers>& buffers,
     const unsigned int max_f_frames,
-    const vk::DescriptorPool descriptor_pool,
+    DescriptorAllocator& descriptors,
     const vk::Device device,
-    const vk::DescriptorSetLayout ubo_layout
+    const vk::DescriptorSetLayout lights_layout,
+    const vk::ImageView shadow_atlas,
+    const vk::Sampler shadow_sampler
 ) {
-    std::vector<vk::DescriptorSetLayout> layouts (max_f_frames, ubo_layout);
-
-    const vk::DescriptorSetAllocateInfo alloc_info {
-        descriptor_pool,
-        static_cast<uint32_t>(max_f_frames),
-        layouts.data()
-    };
-
-    descriptor_sets.resize(max_f_frames);
-
-    if (
-        device.allocateDescriptorSets(
-            &alloc_info,
-            descriptor_sets.data()
-        ) != vk::Result::eSuccess
-    ) throw std::runtime_error("ERR 14 ");
+    descriptor_sets = descriptors.allocate(lights_layout, max_f_frames);
 
     for (int i = 0; i < max_f_frames; ++i) {
-        const vk::DescriptorBufferInfo buffer_info {
-            ubos[i]->getBuffer(),
-            0,
-            sizeof(LightObject)
+        const vk::DescriptorBufferInfo buffer_infos[] {
+            {
+                buffers[i].lights->getBuffer(),
+                0,
+                VK_WHOLE_SIZE
+            },
+            {
+                buffers[i].grid->getBuffer(),
+                0,
+                VK_WHOLE_SIZE
+            },
+            {
+                buffers[i].indices->getBuffer(),
+                0,
+                VK_WHOLE_SIZE
+            }
         };
 
+        // bindings 5, 6 and 7 are consecutive so one write covers all three
         const vk::WriteDescriptorSet descriptor_write {
             descriptor_sets[i],
             5,
             0,
-            1,
-            vk::DescriptorType::eUniformBuffer,
+            static_cast<uint32_t>(std::size(buffer_infos)),
+            vk::DescriptorType::eStorageBuffer,
             nullptr,
-            &buffer_info,
+            buffer_infos,
             nullptr
         };
 
-        device.updateDescriptorSets(1, &descriptor_write, 0, nullptr);
+        const vk::DescriptorImageInfo atlas_info {
+            shadow_sampler,
+            shadow_atlas,
+            vk::ImageLayout::eShaderReadOnlyOptimal
+        };
+
+        const vk::DescriptorBufferInfo tiles_info {
+            buffers[i].shadows->getBuffer(),
+            0,
+            VK_WHOLE_SIZE
+        };
+
+        const vk::WriteDescriptorSet descriptor_writes[] {
+            descriptor_write,
+            {
+                descriptor_sets[i],
+                8,
+                0,
+                1,
+                vk::DescriptorType::eCombinedImageSampler,
+                &atlas_info,
+                nullptr,
+                nullptr
+            },
+            {
+                descriptor_sets[i],
+                9,
+                0,
+                1,
+                vk::DescriptorType::eStorageBuffer,
+                nullptr,
+                &tiles_info,
+                nullptr
+            }
+        };
+
+        device.updateDescriptorSets(static_cast<uint32_t>(std::size(descriptor_writes)), descriptor_writes, 0, nullptr);
     }
 }
 
-void tdl::LightHelper::initUBOs(
-    std::vector<MemoryBuffer*>& ubos,
+void tdl::LightHelper::initBuffers(
+    std::vector<LightBuffers>& buffers,
     const unsigned int max_f_frames,
     const vk::Device device,
     const vk::Queue graphics_queue,
     const vk::CommandPool command_pool,
     const vk::PhysicalDevice physical_device
 ) {
-    ubos.resize(max_f_frames);
-
-    for (unsigned int i = 0; i < max_f_frames; ++i) {
-        ubos[i] = new MemoryBuffer (
-            sizeof(LightObject),
-            vk::BufferUsageFlagBits::eUniformBuffer,
+    const auto create = [&](const vk::DeviceSize size) {
+        auto* buffer = new MemoryBuffer (
+            size,
+            vk::BufferUsageFlagBits::eStorageBuffer,
             vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
             device,
             graphics_queue,
             command_pool,
             physical_device
         );
+
+        buffer->map(); // rewritten every frame
+        return buffer;
+    };
+
+    buffers.resize(max_f_frames);
+
+    for (unsigned int i = 0; i < max_f_frames; ++i) {
+        buffers[i].lights = create(sizeof(Light) * max_lights);
+        buffers[i].grid = create(sizeof(ClusterInfo) + sizeof(glm::uvec2) * LightClusters::count);
+        buffers[i].indices = create(sizeof(uint32_t) * LightClusters::max_indices);
+        buffers[i].shadows = create(sizeof(ShadowTile) * ShadowAtlas::tile_count);
+    }
+}
+
+void tdl::LightHelper::destroyBuffers(
+    std::vector<LightBuffers>& buffers
+) {
+    for (const auto& frame : buffers) {
+        delete frame.lights;
+        delete frame.grid;
+        delete frame.indices;
+        delete frame.shadows;
     }
+
+    buffers.clear();
 }
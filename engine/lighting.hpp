@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 
 #include "vulkan/buffers.hpp"
@@ -12,18 +14,18 @@
 #include <vector>
 
 namespace tdl {
-    enum class LightingModels : int {
-        LAMBERT = 0,
-        BLINNPHONG = 1,
-        PHONG = 2
-    };
-
     enum class LightType : int {
         AMBIENT = 0,
         POINT = 1,
         DIRECTIONAL = 2
     };
 
+    /**
+     * @breif Light as it is stored in the light storage buffer
+     *
+     * position.w holds the influence radius, 0 for lights that reach every fragment (ambient, directional).
+     * direction.w holds the first shadow atlas tile of the light plus one, 0 if it casts no shadow.
+    */
     struct alignas(16) Light {
         glm::vec4 position;
         glm::vec4 direction;
@@ -31,9 +33,16 @@ namespace tdl {
         glm::vec4 data;
     };
 
-    struct LightObject {
-        alignas(16) Light lights[16];
-        alignas(2) int num_lights = 0;
+    inline constexpr uint32_t max_lights = 4096; // capacity of the light storage buffer
+
+    /**
+     * @breif Storage buffers read by the fragment shader for one frame in flight
+    */
+    struct LightBuffers {
+        MemoryBuffer* lights = nullptr; // Light[max_lights], binding 5
+        MemoryBuffer* grid = nullptr; // ClusterInfo + uvec2 per cluster, binding 6
+        MemoryBuffer* indices = nullptr; // light indices of all clusters, binding 7
+        MemoryBuffer* shadows = nullptr; // ShadowTile of every atlas tile, binding 9 (the atlas itself is binding 8)
     };
 
     class LightHelper {
@@ -45,8 +54,11 @@ namespace tdl {
                 unsigned long cframe
             );
 
-            static void initUBOs (
-                std::vector<MemoryBuffer*>& ubos,
+            /**
+             * @breif Allocates and maps the light, cluster grid and light index buffers of every frame in flight
+            */
+            static void initBuffers (
+                std::vector<LightBuffers>& buffers,
                 unsigned int max_f_frames,
                 vk::Device device,
                 vk::Queue graphics_queue,
@@ -56,11 +68,17 @@ namespace tdl {
 
             static void createDescriptorSets (
                 std::vector<vk::DescriptorSet>& descriptor_sets,
-                const std::vector<MemoryBuffer*>& ubos,
+                const std::vector<LightBuffers>& buffers,
                 unsigned int max_f_frames,
-                vk::DescriptorPool descriptor_pool,
+                DescriptorAllocator& descriptors,
                 vk::Device device,
-                vk::DescriptorSetLayout ubo_layout
+                vk::DescriptorSetLayout lights_layout,
+                vk::ImageView shadow_atlas,
+                vk::Sampler shadow_sampler
+            );
+
+            static void destroyBuffers (
+                std::vector<LightBuffers>& buffers
             );
     };
 
@@ -110,14 +128,36 @@ namespace tdl {
             ) {
                 position_ += glm::vec4(direction, 0);
                 light_model_->translate(direction);
+                ++version_;
             }
 
             virtual void exportGPU() = 0;
 
+            /**
+             * @breif Refreshes ubo_data_ if the light changed since the last export
+             *
+             * @return bool true if ubo_data_ was rewritten
+            */
+            bool exportIfChanged() {
+                if (exported_version_ == version_) return false;
+
+                exportGPU();
+                exported_version_ = version_;
+                return true;
+            }
+
+            /**
+             * @breif Distance after which the light no longer contributes to the scene
+             *
+             * Used to assign the light to clusters, 0 means that the light reaches every fragment.
+            */
+            [[nodiscard]] virtual float influenceRadius() const { return 0.0f; }
+
             virtual ~LightInterface() = default;
 
             Light ubo_data_ {};
-            bool has_changed_ = true;
+            uint64_t version_ = 1; // incremented every time the light changes
+            uint64_t exported_version_ = 0; // version ubo_data_ was last exported at
             glm::vec4 color_ {0.0f};
             glm::vec4 direction_ {0.0f};
             float fov_ = 75.0f;
@@ -138,15 +178,15 @@ namespace tdl {
 
             void setColor (
                 const glm::vec4& color
-            ) override { color_ = color; has_changed_ = true; }
+            ) override { color_ = color; ++version_; }
 
             void setIntensity (
                 const float intensity
-            ) override { intensity_ = intensity; has_changed_ = true; }
+            ) override { intensity_ = intensity; ++version_; }
 
             void setModel (
                 const LightingModels model
-            ) override { model_ = model; has_changed_ = true; }
+            ) override { model_ = model; ++version_; }
 
             void exportGPU() override {
                 ubo_data_.color = color_;
@@ -175,23 +215,53 @@ namespace tdl {
 
             void setColor (
                 const glm::vec4& color
-            ) override { color_ = color; has_changed_ = true; }
+            ) override { color_ = color; ++version_; }
 
             void setIntensity (
                 const float intensity
-            ) override { intensity_ = intensity; has_changed_ = true; }
+            ) override { intensity_ = intensity; ++version_; }
 
             void setModel (
                 const LightingModels model
-            ) override { model_ = model; has_changed_ = true; }
+            ) override { model_ = model; ++version_; }
 
             void exportGPU() override {
                 ubo_data_.color = color_;
                 ubo_data_.position = position_;
+                ubo_data_.position.w = influenceRadius();
                 ubo_data_.data.y = intensity_;
                 ubo_data_.data.z = static_cast<float>(model_);
                 ubo_data_.data.w = 1; // point
             }
+
+            /**
+             * @breif Sets the attenuation radius, the light fades out towards it and does not reach past it
+             *
+             * @param radius distance in world units, 0 derives it from the intensity again (see influenceRadius())
+            */
+            void setRadius (
+                const float radius
+            ) { radius_ = std::max(radius, 0.0f); ++version_; }
+
+            /**
+             * @breif Attenuation radius set with setRadius(), 0 if it is derived from the intensity
+            */
+            [[nodiscard]] float getRadius() const { return radius_; }
+
+            /**
+             * @breif The radius set with setRadius(), or the distance at which intensity / distance^2 drops below cutoff
+            */
+            [[nodiscard]] float influenceRadius() const override {
+                if (radius_ > 0.0f) return radius_;
+
+                const float brightest = std::max({color_.r, color_.g, color_.b});
+                return std::sqrt(std::max(intensity_ * brightest, 0.0f) / cutoff);
+            }
+
+            static constexpr float cutoff = 0.01f; // contribution that is treated as no light
+
+        private:
+            float radius_ = 0.0f;
     };
 
     class DirectionalLight final : public LightInterface {
@@ -218,19 +288,20 @@ namespace tdl {
 
             void setColor (
                 const glm::vec4& color
-            ) override { color_ = color; has_changed_ = true; }
+            ) override { color_ = color; ++version_; }
 
             void setIntensity (
                 const float intensity
-            ) override { intensity_ = intensity; has_changed_ = true; }
+            ) override { intensity_ = intensity; ++version_; }
 
             void setModel (
                 const LightingModels model
-            ) override { model_ = model; has_changed_ = true; }
+            ) override { model_ = model; ++version_; }
 
             void exportGPU() override {
                 ubo_data_.color = color_;
                 ubo_data_.position = position_;
+                ubo_data_.position.w = 0.0f; // no influence radius, reaches every fragment in its cone
                 ubo_data_.direction = direction_;
                 ubo_data_.data.x = fov_;
                 ubo_data_.data.y = intensity_;
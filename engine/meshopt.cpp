@@ -0,0 +1,615 @@
+#include "meshopt.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+    // hashes and compares the raw bytes, vertices from the same OBJ face corners are bitwise identical
+    template <typename T>
+    struct BytesHash {
+        size_t operator()(const T& value) const {
+            uint32_t words[sizeof(T) / sizeof(uint32_t)];
+            std::memcpy(words, &value, sizeof(words));
+
+            size_t hash = 14695981039346656037ull; // FNV-1a over 32 bit words
+            for (const uint32_t word : words) {
+                hash ^= word;
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    template <typename T>
+    struct BytesEqual {
+        bool operator()(const T& a, const T& b) const {
+            return std::memcmp(&a, &b, sizeof(T)) == 0;
+        }
+    };
+
+    // sum of squared distances to a set of planes, upper triangle of a symmetric 4x4 matrix
+    struct Quadric {
+        double xx = 0.0, xy = 0.0, xz = 0.0, xw = 0.0;
+        double yy = 0.0, yz = 0.0, yw = 0.0;
+        double zz = 0.0, zw = 0.0;
+        double ww = 0.0;
+
+        static Quadric plane(
+            const glm::vec3& normal,
+            const double distance
+        ) {
+            const double x = normal.x, y = normal.y, z = normal.z, w = distance;
+            return {x * x, x * y, x * z, x * w, y * y, y * z, y * w, z * z, z * w, w * w};
+        }
+
+        Quadric& operator+=(const Quadric& other) {
+            xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+            yy += other.yy; yz += other.yz; yw += other.yw;
+            zz += other.zz; zw += other.zw;
+            ww += other.ww;
+            return *this;
+        }
+
+        [[nodiscard]] double error(const glm::vec3& point) const {
+            const double x = point.x, y = point.y, z = point.z;
+            return xx * x * x + yy * y * y + zz * z * z + ww
+                + 2.0 * (xy * x * y + xz * x * z + yz * y * z + xw * x + yw * y + zw * z);
+        }
+    };
+
+    // triangles that use each vertex, adjacency[offsets[v], offsets[v + 1])
+    void buildAdjacency(
+        const std::vector<uint32_t>& indices,
+        const uint32_t vertex_count,
+        std::vector<uint32_t>& offsets,
+        std::vector<uint32_t>& adjacency
+    ) {
+        offsets.assign(vertex_count + 1, 0);
+        for (const uint32_t index : indices) ++offsets[index + 1];
+        for (uint32_t v = 0; v < vertex_count; ++v) offsets[v + 1] += offsets[v];
+
+        adjacency.resize(indices.size());
+        std::vector<uint32_t> fill (offsets.begin(), offsets.end() - 1);
+        for (uint32_t i = 0; i < indices.size(); ++i) adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    float cacheRatio(
+        const uint32_t misses,
+        const size_t count
+    ) {
+        return count == 0 ? 0.0f : static_cast<float>(misses) / static_cast<float>(count);
+    }
+}
+
+tdl::MeshStats tdl::MeshOptimizer::optimize(
+    const std::vector<Vertex>& soup,
+    std::vector<Vertex>& vertices,
+    std::vector<uint32_t>& indices
+) {
+    index(soup, vertices, indices);
+
+    const auto vertex_count = static_cast<uint32_t>(vertices.size());
+    const size_t triangles = indices.size() / 3;
+
+    MeshStats stats {};
+    stats.vertices = vertex_count;
+    stats.triangles = static_cast<uint32_t>(triangles);
+
+    const uint32_t misses_before = cacheMisses(indices, vertex_count);
+    stats.acmr_before = cacheRatio(misses_before, triangles);
+    stats.atvr_before = cacheRatio(misses_before, vertex_count);
+
+    const std::vector<uint32_t> clusters = tipsify(indices, vertex_count);
+    orderClusters(indices, clusters, vertices);
+    reorderVertices(vertices, indices);
+
+    const uint32_t misses_after = cacheMisses(indices, vertex_count);
+    stats.acmr_after = cacheRatio(misses_after, triangles);
+    stats.atvr_after = cacheRatio(misses_after, vertex_count);
+    stats.clusters = static_cast<uint32_t>(clusters.size());
+
+    return stats;
+}
+
+void tdl::MeshOptimizer::index(
+    const std::vector<Vertex>& soup,
+    std::vector<Vertex>& vertices,
+    std::vector<uint32_t>& indices
+) {
+    vertices.clear();
+    indices.clear();
+    const size_t count = soup.size() - soup.size() % 3; // a trailing incomplete triangle is never drawn
+    indices.reserve(count);
+
+    std::unordered_map<Vertex, uint32_t, BytesHash<Vertex>, BytesEqual<Vertex>> unique;
+    unique.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const auto [it, inserted] = unique.try_emplace(soup[i], static_cast<uint32_t>(vertices.size()));
+        if (inserted) vertices.push_back(soup[i]);
+        indices.push_back(it->second);
+    }
+}
+
+std::vector<uint32_t> tdl::MeshOptimizer::tipsify(
+    std::vector<uint32_t>& indices,
+    const uint32_t vertex_count
+) {
+    const auto triangle_count = static_cast<uint32_t>(indices.size() / 3);
+    std::vector<uint32_t> clusters;
+    if (triangle_count == 0) return clusters;
+
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> adjacency;
+    buildAdjacency(indices, vertex_count, offsets, adjacency);
+
+    std::vector<uint32_t> live (vertex_count); // triangles not emitted yet per vertex
+    for (uint32_t v = 0; v < vertex_count; ++v) live[v] = offsets[v + 1] - offsets[v];
+
+    std::vector<uint32_t> cached (vertex_count, 0); // time the vertex entered the cache
+    std::vector<uint8_t> emitted (triangle_count, 0);
+    std::vector<uint32_t> dead_end; // recently used vertices, candidates once the fan runs out
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    uint32_t time = cache_size + 1;
+    uint32_t cursor = 0; // scan position for vertices with live triangles
+
+    // next vertex with live triangles, from the dead end stack first, then in input order
+    const auto skipDeadEnd = [&]() -> int64_t {
+        while (!dead_end.empty()) {
+            const uint32_t vertex = dead_end.back();
+            dead_end.pop_back();
+            if (live[vertex] > 0) return vertex;
+        }
+
+        for (; cursor < vertex_count; ++cursor) {
+            if (live[cursor] > 0) return cursor;
+        }
+
+        return -1;
+    };
+
+    int64_t fan = skipDeadEnd();
+    clusters.push_back(0);
+
+    while (fan >= 0) {
+        candidates.clear();
+
+        // emit every remaining triangle around the fanning vertex
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+            const uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+            emitted[t] = 1;
+
+            for (uint32_t k = 0; k < 3; ++k) {
+                const uint32_t vertex = indices[t * 3 + k];
+                output.push_back(vertex);
+                dead_end.push_back(vertex);
+                candidates.push_back(vertex);
+                --live[vertex];
+
+                if (time - cached[vertex] > cache_size) cached[vertex] = time++;
+            }
+        }
+
+        // prefer the candidate that stays in the cache longest while all its triangles are emitted
+        int64_t next = -1;
+        int64_t best = -1;
+        for (const uint32_t vertex : candidates) {
+            if (live[vertex] == 0) continue;
+
+            int64_t priority = 0;
+            if (time - cached[vertex] + 2 * live[vertex] <= cache_size) priority = time - cached[vertex];
+
+            if (priority > best) {
+                best = priority;
+                next = vertex;
+            }
+        }
+
+        if (next < 0) {
+            next = skipDeadEnd();
+            // the cache no longer holds the fan, this is where the overdraw pass may reorder
+            if (next >= 0) clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+        }
+
+        fan = next;
+    }
+
+    indices = std::move(output);
+    return clusters;
+}
+
+void tdl::MeshOptimizer::orderClusters(
+    std::vector<uint32_t>& indices,
+    const std::vector<uint32_t>& clusters,
+    const std::vector<Vertex>& vertices
+) {
+    if (clusters.size() < 2) return;
+
+    const auto triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+    // area weighted centre of the whole mesh
+    glm::vec3 mesh_centre {0.0f};
+    float mesh_area = 0.0f;
+
+    std::vector<glm::vec3> centres (clusters.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> normals (clusters.size(), glm::vec3(0.0f)); // sum of area weighted face normals
+    std::vector<float> areas (clusters.size(), 0.0f);
+
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+        for (uint32_t t = clusters[c]; t < end; ++t) {
+            const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+            const float area = glm::length(normal);
+            const glm::vec3 centre = (p0 + p1 + p2) / 3.0f;
+
+            centres[c] += centre * area;
+            normals[c] += normal;
+            areas[c] += area;
+        }
+
+        mesh_centre += centres[c];
+        mesh_area += areas[c];
+    }
+
+    if (mesh_area <= 0.0f) return;
+    mesh_centre /= mesh_area;
+
+    // clusters that face away from the centre are likely to occlude the others, so they are drawn first
+    std::vector<float> scores (clusters.size(), 0.0f);
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        if (areas[c] <= 0.0f) continue;
+
+        const glm::vec3 centre = centres[c] / areas[c];
+        const float length = glm::length(normals[c]);
+        if (length > 0.0f) scores[c] = glm::dot(centre - mesh_centre, normals[c] / length);
+    }
+
+    std::vector<uint32_t> order (clusters.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](const uint32_t a, const uint32_t b) {
+        return scores[a] > scores[b];
+    });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+
+    for (const uint32_t c : order) {
+        const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+        sorted.insert(sorted.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+    }
+
+    indices = std::move(sorted);
+}
+
+void tdl::MeshOptimizer::reorderVertices(
+    std::vector<Vertex>& vertices,
+    std::vector<uint32_t>& indices
+) {
+    static constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> remap (vertices.size(), unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(reordered); // vertices no triangle uses are dropped
+}
+
+std::vector<tdl::MeshLod> tdl::MeshOptimizer::buildLods(
+    const std::vector<Vertex>& vertices,
+    std::vector<uint32_t>& indices
+) {
+    const auto vertex_count = static_cast<uint32_t>(vertices.size());
+
+    std::vector<MeshLod> lods;
+    lods.push_back({
+        0,
+        static_cast<uint32_t>(indices.size()),
+        0.0f,
+        cacheRatio(cacheMisses(indices, vertex_count), indices.size() / 3)
+    });
+
+    std::vector<uint32_t> level = indices;
+    float error = 0.0f;
+
+    while (lods.size() < max_lods && level.size() / 3 >= min_lod_triangles) {
+        float step = 0.0f;
+        std::vector<uint32_t> simplified = simplify(vertices, level, level.size() / 6 * 3, step);
+
+        // less than 10% smaller, the seams and borders are all that is left
+        if (simplified.empty() || simplified.size() * 10 > level.size() * 9) break;
+
+        // the quadrics only know the triangles of the previous level, the distance from level 0 adds up
+        error += step;
+
+        const std::vector<uint32_t> clusters = tipsify(simplified, vertex_count);
+        orderClusters(simplified, clusters, vertices);
+
+        lods.push_back({
+            static_cast<uint32_t>(indices.size()),
+            static_cast<uint32_t>(simplified.size()),
+            error,
+            cacheRatio(cacheMisses(simplified, vertex_count), simplified.size() / 3)
+        });
+
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        level = std::move(simplified);
+    }
+
+    return lods;
+}
+
+std::vector<uint32_t> tdl::MeshOptimizer::simplify(
+    const std::vector<Vertex>& vertices,
+    const std::vector<uint32_t>& indices,
+    const size_t target_index_count,
+    float& error
+) {
+    const auto vertex_count = static_cast<uint32_t>(vertices.size());
+    std::vector<uint32_t> result = indices;
+
+    std::vector<uint8_t> locked (vertex_count, 0);
+
+    // several vertices at one position are a seam, moving one of them would tear the surface open
+    std::unordered_map<glm::vec3, uint32_t, BytesHash<glm::vec3>, BytesEqual<glm::vec3>> positions;
+    for (const uint32_t index : result) {
+        const auto [it, inserted] = positions.try_emplace(vertices[index].pos, index);
+        if (!inserted && it->second != index) locked[index] = locked[it->second] = 1;
+    }
+
+    // edges that are not shared by exactly two triangles are on a border
+    std::unordered_map<uint64_t, uint32_t> edges;
+    for (size_t i = 0; i < result.size(); ++i) {
+        const uint32_t a = result[i];
+        const uint32_t b = result[i - i % 3 + (i + 1) % 3];
+        ++edges[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)];
+    }
+    for (const auto& [edge, count] : edges) {
+        if (count == 2) continue;
+        locked[edge >> 32] = 1;
+        locked[edge & 0xffffffff] = 1;
+    }
+
+    std::vector<Quadric> quadrics (vertex_count);
+    for (size_t t = 0; t < result.size(); t += 3) {
+        const glm::vec3& p0 = vertices[result[t + 0]].pos;
+        const glm::vec3 normal = glm::cross(vertices[result[t + 1]].pos - p0, vertices[result[t + 2]].pos - p0);
+        const float length = glm::length(normal);
+        if (length <= 0.0f) continue;
+
+        const Quadric plane = Quadric::plane(normal / length, -glm::dot(normal / length, p0));
+        for (uint32_t k = 0; k < 3; ++k) quadrics[result[t + k]] += plane;
+    }
+
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        double cost;
+    };
+
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint8_t> touched;
+    std::vector<uint32_t> remap;
+    double max_cost = 0.0;
+
+    // every pass collapses the cheapest edges whose one rings do not overlap, so their costs stay valid
+    while (result.size() > target_index_count) {
+        buildAdjacency(result, vertex_count, offsets, adjacency);
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); ++i) {
+            const uint32_t a = result[i];
+            const uint32_t b = result[i - i % 3 + (i + 1) % 3];
+            if (a > b) continue; // shared edges appear once in each direction
+
+            Collapse best {0, 0, std::numeric_limits<double>::max()};
+            if (!locked[a]) {
+                Quadric quadric = quadrics[a];
+                quadric += quadrics[b];
+                best = {a, b, quadric.error(vertices[b].pos)};
+            }
+            if (!locked[b]) {
+                Quadric quadric = quadrics[b];
+                quadric += quadrics[a];
+                const double cost = quadric.error(vertices[a].pos);
+                if (cost < best.cost) best = {b, a, cost};
+            }
+
+            if (best.cost < std::numeric_limits<double>::max()) collapses.push_back(best);
+        }
+
+        if (collapses.empty()) break;
+        std::ranges::sort(collapses, {}, &Collapse::cost);
+
+        touched.assign(vertex_count, 0);
+        remap.resize(vertex_count);
+        std::iota(remap.begin(), remap.end(), 0u);
+
+        const size_t goal = (result.size() - target_index_count) / 3;
+        size_t removed = 0;
+
+        for (const Collapse& collapse : collapses) {
+            if (removed >= goal) break;
+            if (touched[collapse.from] || touched[collapse.to]) continue;
+
+            const glm::vec3& target = vertices[collapse.to].pos;
+
+            // moving the vertex must not turn any of the remaining triangles around
+            bool flips = false;
+            size_t degenerate = 0;
+
+            for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; ++a) {
+                const uint32_t* const tri = &result[adjacency[a] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+                    ++degenerate;
+                    continue;
+                }
+
+                glm::vec3 p[3] = { vertices[tri[0]].pos, vertices[tri[1]].pos, vertices[tri[2]].pos };
+                const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for (uint32_t k = 0; k < 3; ++k) {
+                    if (tri[k] == collapse.from) p[k] = target;
+                }
+                const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+
+            if (flips) continue;
+
+            for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; ++a) {
+                for (uint32_t k = 0; k < 3; ++k) touched[result[adjacency[a] * 3 + k]] = 1;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            max_cost = std::max(max_cost, collapse.cost);
+            removed += degenerate;
+        }
+
+        if (removed == 0) break;
+
+        // triangles that lost an edge are dropped
+        size_t write = 0;
+        for (size_t t = 0; t < result.size(); t += 3) {
+            const uint32_t a = remap[result[t + 0]];
+            const uint32_t b = remap[result[t + 1]];
+            const uint32_t c = remap[result[t + 2]];
+            if (a == b || b == c || a == c) continue;
+
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    error = static_cast<float>(std::sqrt(std::max(max_cost, 0.0)));
+    return result;
+}
+
+std::vector<tdl::Meshlet> tdl::MeshOptimizer::buildMeshlets(
+    const std::vector<Vertex>& vertices,
+    const std::vector<uint32_t>& indices,
+    const uint32_t index_count
+) {
+    static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> owner (vertices.size(), none); // last meshlet that used the vertex
+    uint32_t unique = 0;
+
+    for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+        auto current = static_cast<uint32_t>(meshlets.size()) - 1; // none before the first meshlet
+
+        uint32_t added = 0;
+        for (uint32_t k = 0; k < 3; ++k) {
+            if (owner[indices[i + k]] != current) ++added;
+        }
+
+        if (
+            meshlets.empty() ||
+            unique + added > max_meshlet_vertices ||
+            meshlets.back().index_count / 3 == max_meshlet_triangles
+        ) {
+            meshlets.push_back({});
+            meshlets.back().first_index = i;
+            unique = 0;
+            ++current;
+        }
+
+        for (uint32_t k = 0; k < 3; ++k) {
+            if (owner[indices[i + k]] == current) continue;
+            owner[indices[i + k]] = current;
+            ++unique;
+        }
+
+        meshlets.back().index_count += 3;
+    }
+
+    std::vector<glm::vec3> normals;
+
+    for (Meshlet& meshlet : meshlets) {
+        const uint32_t end = meshlet.first_index + meshlet.index_count;
+
+        glm::vec3 min { std::numeric_limits<float>::max() };
+        glm::vec3 max { std::numeric_limits<float>::lowest() };
+        for (uint32_t i = meshlet.first_index; i < end; ++i) {
+            min = glm::min(min, vertices[indices[i]].pos);
+            max = glm::max(max, vertices[indices[i]].pos);
+        }
+
+        const glm::vec3 centre = (min + max) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t i = meshlet.first_index; i < end; ++i) {
+            radius = std::max(radius, glm::length(vertices[indices[i]].pos - centre));
+        }
+        meshlet.sphere = glm::vec4(centre, radius);
+
+        // the cone holds every face normal, it is useless once they spread over a hemisphere
+        normals.clear();
+        glm::vec3 axis {0.0f};
+        for (uint32_t i = meshlet.first_index; i < end; i += 3) {
+            const glm::vec3& p0 = vertices[indices[i]].pos;
+            const glm::vec3 normal = glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+            const float length = glm::length(normal);
+            if (length <= 0.0f) continue;
+
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+
+        const float axis_length = glm::length(axis);
+        if (normals.empty() || axis_length <= 0.0f) continue;
+        axis /= axis_length;
+
+        float min_dot = 1.0f;
+        for (const glm::vec3& normal : normals) min_dot = std::min(min_dot, glm::dot(axis, normal));
+
+        // sine of the cone's half angle, cull.comp culls when the view direction is inside the mirrored cone
+        if (min_dot > 0.0f) meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - min_dot * min_dot));
+    }
+
+    return meshlets;
+}
+
+uint32_t tdl::MeshOptimizer::cacheMisses(
+    const std::vector<uint32_t>& indices,
+    const uint32_t vertex_count
+) {
+    // a vertex is still in the FIFO if fewer than cache_size other vertices entered after it
+    std::vector<uint32_t> cached (vertex_count, 0);
+    uint32_t time = cache_size + 1;
+    uint32_t misses = 0;
+
+    for (const uint32_t index : indices) {
+        if (time - cached[index] > cache_size) {
+            cached[index] = time++;
+            ++misses;
+        }
+    }
+
+    return misses;
+}
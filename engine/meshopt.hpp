@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "objects.hpp"
+
+namespace tdl {
+    /**
+     * @breif Static methods that turn the triangle soup of an OBJ file into an indexed mesh that renders fast
+     *
+     * optimize() runs every step in order: identical vertices are merged into an index buffer, triangles are reordered
+     * for the post transform vertex cache (Tipsify, Sander et al. 2007), the resulting clusters are sorted so outward
+     * facing ones are drawn first to reduce overdraw, and the vertices are renumbered in the order they are first used
+     * so the vertex fetch reads memory sequentially.
+    */
+    class MeshOptimizer final {
+        public:
+            static constexpr uint32_t cache_size = 16; // FIFO cache size assumed for Tipsify and the statistics
+            static constexpr uint32_t max_lods = 5; // level 0 included
+            static constexpr uint32_t min_lod_triangles = 32; // no level is built from fewer triangles than this
+            static constexpr uint32_t max_meshlet_vertices = 64;
+            static constexpr uint32_t max_meshlet_triangles = 124;
+
+            /**
+             * @breif Indexes and optimizes a triangle list
+             *
+             * @param soup three vertices per triangle, in file order
+             * @param vertices filled with the unique vertices in fetch order
+             * @param indices filled with three indices per triangle
+             * @return MeshStats cache statistics before (indexed, file order) and after the optimization
+            */
+            static MeshStats optimize (
+                const std::vector<Vertex>& soup,
+                std::vector<Vertex>& vertices,
+                std::vector<uint32_t>& indices
+            );
+
+            /**
+             * @breif Merges bitwise identical vertices
+            */
+            static void index (
+                const std::vector<Vertex>& soup,
+                std::vector<Vertex>& vertices,
+                std::vector<uint32_t>& indices
+            );
+
+            /**
+             * @breif Reorders the triangles for a FIFO vertex cache of cache_size entries
+             *
+             * @param indices three indices per triangle, reordered in place
+             * @param vertex_count number of vertices the indices point into
+             * @return std::vector<uint32_t> first triangle of every cluster, a cluster starts wherever Tipsify had to
+             * jump to a vertex that was not in the cache
+            */
+            static std::vector<uint32_t> tipsify (
+                std::vector<uint32_t>& indices,
+                uint32_t vertex_count
+            );
+
+            /**
+             * @breif Sorts the clusters so the ones facing away from the centre of the mesh are drawn first
+             *
+             * Triangles inside a cluster keep their order, so the vertex cache efficiency is mostly kept.
+            */
+            static void orderClusters (
+                std::vector<uint32_t>& indices,
+                const std::vector<uint32_t>& clusters,
+                const std::vector<Vertex>& vertices
+            );
+
+            /**
+             * @breif Renumbers the vertices in the order the indices first reference them
+            */
+            static void reorderVertices (
+                std::vector<Vertex>& vertices,
+                std::vector<uint32_t>& indices
+            );
+
+            /**
+             * @breif Builds coarser levels of detail from the optimized triangles with simplify()
+             *
+             * Every level halves the triangles of the previous one and is reordered for the vertex cache again. The
+             * levels share the vertices, their indices are appended to indices. Building stops early once locked seams
+             * and borders keep a level from getting noticeably smaller.
+             *
+             * Every level is simplified from the one before it, so the error of a level is the sum of the errors of
+             * the steps that led to it, a bound on its distance from level 0.
+             *
+             * @param vertices vertices of the mesh
+             * @param indices triangles of level 0, the other levels are appended
+             * @return std::vector<MeshLod> every level, level 0 first
+            */
+            static std::vector<MeshLod> buildLods (
+                const std::vector<Vertex>& vertices,
+                std::vector<uint32_t>& indices
+            );
+
+            /**
+             * @breif Quadric error metric edge collapse (Garland and Heckbert 1997)
+             *
+             * Vertices collapse onto one of their neighbours, so no new vertices are made and the attributes stay
+             * valid. Vertices on UV or normal seams (several vertices at one position) and on open borders are never
+             * moved, which keeps seams closed and the outline of every usemtl slice intact.
+             *
+             * @param vertices vertices the indices point into
+             * @param indices triangles to simplify
+             * @param target_index_count indices to stop at, the result can be larger if not enough edges can collapse
+             * @param error set to the largest distance between a moved vertex and the planes of the triangles in
+             * indices
+             * @return std::vector<uint32_t> indices of the simplified triangles
+            */
+            static std::vector<uint32_t> simplify (
+                const std::vector<Vertex>& vertices,
+                const std::vector<uint32_t>& indices,
+                size_t target_index_count,
+                float& error
+            );
+
+            /**
+             * @breif Splits triangles into meshlets and computes their bounding spheres and normal cones
+             *
+             * Triangles are taken in order, so the meshlets of Tipsify ordered indices are compact patches. A meshlet
+             * ends once the next triangle would take it over max_meshlet_vertices or max_meshlet_triangles, the limits
+             * mesh shaders are usually written for.
+             *
+             * @param vertices vertices the indices point into
+             * @param indices index buffer of the mesh
+             * @param index_count indices from the start of the buffer to split, level 0 only
+             * @return std::vector<Meshlet> meshlets covering [0, index_count)
+            */
+            static std::vector<Meshlet> buildMeshlets (
+                const std::vector<Vertex>& vertices,
+                const std::vector<uint32_t>& indices,
+                uint32_t index_count
+            );
+
+            /**
+             * @breif Vertex shader invocations of a FIFO cache of cache_size entries
+            */
+            static uint32_t cacheMisses (
+                const std::vector<uint32_t>& indices,
+                uint32_t vertex_count
+            );
+    };
+};
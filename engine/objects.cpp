@@ -1,4 +1,5 @@
 #include "objects.hpp"
+#include "meshopt.hpp"
 
 #define STB_IMAGE_STATIC
 #define STB_IMAGE_IMPLEMENTATION
@@ -6,9 +7,62 @@
 
 #include <opencv2/imgproc.hpp>
 
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <limits>
 #include <sstream>
 #include <fstream>
 
+namespace {
+    // maps the unit sphere onto the [-1, 1] square, decoded by octDecode() in shader.vert
+    glm::vec2 octEncode(
+        const glm::vec3& normal
+    ) {
+        const float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (sum == 0.0f) return {0.0f, 0.0f}; // no normal, decodes to +z
+
+        glm::vec2 encoded = glm::vec2(normal) / sum;
+
+        // the lower hemisphere is folded over the diagonals
+        if (normal.z < 0.0f) {
+            encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * glm::vec2(
+                encoded.x >= 0.0f ? 1.0f : -1.0f,
+                encoded.y >= 0.0f ? 1.0f : -1.0f
+            );
+        }
+
+        return encoded;
+    }
+
+    int16_t toSnorm16(
+        const float value
+    ) {
+        return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    uint16_t toUnorm16(
+        const float value
+    ) {
+        return static_cast<uint16_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    std::array<uint16_t, 4> quantize(
+        const glm::vec3& position,
+        const glm::vec3& min,
+        const glm::vec3& extent
+    ) {
+        // flat axes have no extent, every vertex sits at the minimum
+        const glm::vec3 t = glm::vec3(
+            extent.x > 0.0f ? (position.x - min.x) / extent.x : 0.0f,
+            extent.y > 0.0f ? (position.y - min.y) / extent.y : 0.0f,
+            extent.z > 0.0f ? (position.z - min.z) / extent.z : 0.0f
+        );
+
+        return {toUnorm16(t.x), toUnorm16(t.y), toUnorm16(t.z), 0};
+    }
+}
+
 vk::VertexInputBindingDescription tdl::Vertex::getBindingDescription() {
     return {
         0,
@@ -43,6 +97,50 @@ std::array<vk::VertexInputAttributeDescription, 3> tdl::Vertex::getAttributeDesc
     };
 }
 
+tdl::CompressedVertex::CompressedVertex(
+    const Vertex& vertex,
+    const glm::vec3& min,
+    const glm::vec3& extent
+) : pos { quantize(vertex.pos, min, extent) } {
+    const glm::vec2 oct = octEncode(vertex.color); // color holds the normal
+    normal = {toSnorm16(oct.x), toSnorm16(oct.y)};
+    uv = {glm::packHalf1x16(vertex.uv.x), glm::packHalf1x16(vertex.uv.y)};
+}
+
+vk::VertexInputBindingDescription tdl::CompressedVertex::getBindingDescription() {
+    return {
+        0,
+        sizeof(CompressedVertex),
+        vk::VertexInputRate::eVertex
+    };
+}
+
+std::array<vk::VertexInputAttributeDescription, 3> tdl::CompressedVertex::getAttributeDescriptions() {
+    return {
+        // quantized position at location 0, read as vec3 in 0 - 1
+        vk::VertexInputAttributeDescription {
+            0,
+            0,
+            vk::Format::eR16G16B16A16Unorm,
+            offsetof(CompressedVertex, pos)
+        },
+        // octahedral normal at location 1, read as vec2 in -1 - 1
+        vk::VertexInputAttributeDescription {
+            1,
+            0,
+            vk::Format::eR16G16Snorm,
+            offsetof(CompressedVertex, normal)
+        },
+        // uv coords at location 2, converted to float by the vertex fetch
+        vk::VertexInputAttributeDescription {
+            2,
+            0,
+            vk::Format::eR16G16Sfloat,
+            offsetof(CompressedVertex, uv)
+        }
+    };
+}
+
 std::vector<std::string> tdl::OBJLoader::split(
     const std::string& str,
     const char delimiter
@@ -493,50 +591,169 @@ std::string tdl::OBJLoader::getMTLPath(
 }
 
 
+tdl::Mesh::Mesh(
+    const std::vector<Vertex>& vertices
+) {
+    stats_ = MeshOptimizer::optimize(vertices, vertices_, indices_);
+    lods_ = MeshOptimizer::buildLods(vertices_, indices_);
+    meshlets_ = MeshOptimizer::buildMeshlets(vertices_, indices_, lods_[0].index_count);
+}
+
+uint32_t tdl::Mesh::selectLod(
+    const float pixels_per_unit,
+    const float threshold,
+    const uint32_t current
+) const {
+    // errors grow with every level, so the first one over the threshold ends the search
+    uint32_t desired = 0;
+    for (uint32_t lod = 1; lod < lods_.size() && lods_[lod].error * pixels_per_unit <= threshold; ++lod) {
+        desired = lod;
+    }
+
+    if (desired <= current) return desired; // finer levels are switched to right away
+
+    uint32_t coarser = current;
+    for (uint32_t lod = coarser + 1; lod <= desired; ++lod) {
+        if (lods_[lod].error * pixels_per_unit <= threshold * (1.0f - lod_hysteresis)) coarser = lod;
+    }
+
+    return coarser;
+}
+
 void tdl::Mesh::initBuffer(
     const vk::Device device,
     const vk::Queue graphics_queue,
     const vk::CommandPool command_pool,
-    const vk::PhysicalDevice p_device
+    const vk::PhysicalDevice p_device,
+    UploadQueue& uploads
 ) {
     if (buffer_ != nullptr) return; // do not re-initialse buffer
 
-    // create new buffer on the heap
-    buffer_ = new MemoryBuffer {
-        vertices_.size() * sizeof(vertices_.at(0)),
-        vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
-        vk::MemoryPropertyFlagBits::eDeviceLocal,
-        device,
-        graphics_queue,
-        command_pool,
-        p_device
-    };
+    // copies data into a new device local vertex or index buffer through a staging buffer
+    const auto upload = [&](
+        const void* const data,
+        const vk::DeviceSize size,
+        const vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eVertexBuffer
+    ) {
+        // create new buffer on the heap
+        auto* const buffer = new MemoryBuffer {
+            size,
+            vk::BufferUsageFlagBits::eTransferDst | usage,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            device,
+            graphics_queue,
+            command_pool,
+            p_device
+        };
+
+        // a staging buffer improves performance, the upload queue frees it once the copy is done
+        auto* const staging = new MemoryBuffer {
+            size,
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            device,
+            graphics_queue,
+            command_pool,
+            p_device
+        };
+
+        staging->set(data, size); // write to staging buffer
+        uploads.loadBuffer(staging, buffer->getBuffer(), size); // copy staging buffer into main buffer
 
-    // a staging buffer improves performance
-    const MemoryBuffer copy_buffer {
-        vertices_.size() * sizeof(vertices_.at(0)),
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-        device,
-        graphics_queue,
-        command_pool,
-        p_device
+        return buffer;
     };
 
-    // write to staging buffer
-    copy_buffer.set(vertices_.data(), vertices_.size() * sizeof(vertices_.at(0)));
-    // copy staging buffer into main buffer
-    buffer_->copy(copy_buffer, vertices_.size() * sizeof(vertices_.at(0)));
+    index_buffer_ = upload(
+        indices_.data(),
+        indices_.size() * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer
+    );
+
+    if (cullable()) {
+        meshlet_buffer_ = upload(
+            meshlets_.data(),
+            meshlets_.size() * sizeof(Meshlet),
+            vk::BufferUsageFlagBits::eStorageBuffer
+        );
+    }
+
+    if (!compressed_) {
+        buffer_ = upload(vertices_.data(), vertexBytes());
+
+        // separate position stream for the depth pre-pass, it only fetches what it needs
+        std::vector<glm::vec3> positions;
+        positions.reserve(vertices_.size());
+        for (const auto& vertex : vertices_) positions.push_back(vertex.pos);
+
+        position_buffer_ = upload(positions.data(), positionBytes());
+        return;
+    }
+
+    // positions are stored relative to the bounding box of the mesh
+    glm::vec3 min { std::numeric_limits<float>::max() };
+    glm::vec3 max { std::numeric_limits<float>::lowest() };
+
+    for (const auto& vertex : vertices_) {
+        min = glm::min(min, vertex.pos);
+        max = glm::max(max, vertex.pos);
+    }
+
+    if (vertices_.empty()) min = max = glm::vec3(0.0f);
+
+    const glm::vec3 extent = max - min;
+    decode_ = {glm::vec4(min, 0.0f), glm::vec4(extent, 0.0f)};
+
+    std::vector<CompressedVertex> compressed;
+    std::vector<std::array<uint16_t, 4>> positions;
+    compressed.reserve(vertices_.size());
+    positions.reserve(vertices_.size());
+
+    for (const auto& vertex : vertices_) {
+        compressed.emplace_back(vertex, min, extent);
+        positions.push_back(compressed.back().pos); // same bits as the full vertex, the pre-pass depth has to match
+    }
+
+    buffer_ = upload(compressed.data(), vertexBytes());
+    position_buffer_ = upload(positions.data(), positionBytes());
 }
 
 void tdl::Mesh::render(
-    const vk::CommandBuffer command_buffer
+    const vk::CommandBuffer command_buffer,
+    const uint32_t lod,
+    const bool bind
+) const {
+    if (bind) {
+        const vk::Buffer buffers[] = { buffer_->getBuffer() }; // buffer containing triangles
+        static constexpr vk::DeviceSize offsets[] = { 0 };
+        command_buffer.bindVertexBuffers(0, 1, buffers, offsets); // bind buffer to command buffer
+        command_buffer.bindIndexBuffer(index_buffer_->getBuffer(), 0, vk::IndexType::eUint32);
+    }
+
+    // draw all the triangles of the level
+    command_buffer.drawIndexed(lods_[lod].index_count, 1, lods_[lod].first_index, 0, 0);
+}
+
+void tdl::Mesh::renderPositions(
+    const vk::CommandBuffer command_buffer,
+    const uint32_t lod
+) const {
+    const vk::Buffer buffers[] = { position_buffer_->getBuffer() };
+    static constexpr vk::DeviceSize offsets[] = { 0 };
+    command_buffer.bindVertexBuffers(0, 1, buffers, offsets);
+    command_buffer.bindIndexBuffer(index_buffer_->getBuffer(), 0, vk::IndexType::eUint32);
+    command_buffer.drawIndexed(lods_[lod].index_count, 1, lods_[lod].first_index, 0, 0);
+}
+
+void tdl::Mesh::renderIndirect(
+    const vk::CommandBuffer command_buffer,
+    const IndirectDraw& draw,
+    const bool positions
 ) const {
-    const vk::Buffer buffers[] = { buffer_->getBuffer() }; // buffer containing triangles
+    const vk::Buffer buffers[] = { positions ? position_buffer_->getBuffer() : buffer_->getBuffer() };
     static constexpr vk::DeviceSize offsets[] = { 0 };
-    command_buffer.bindVertexBuffers(0, 1, buffers, offsets); // bind buffer to command buffer
-    // draw all the vertices in the buffer
-    command_buffer.draw(static_cast<uint32_t>(vertices_.size()), 1, 0, 0);
+    command_buffer.bindVertexBuffers(0, 1, buffers, offsets);
+    command_buffer.bindIndexBuffer(draw.indices ? draw.indices : index_buffer_->getBuffer(), 0, vk::IndexType::eUint32);
+    command_buffer.drawIndexedIndirect(draw.command, draw.offset, 1, sizeof(vk::DrawIndexedIndirectCommand));
 }
 
 void tdl::Texture::load(
@@ -544,68 +761,89 @@ void tdl::Texture::load(
     const vk::Queue graphics_queue,
     const vk::CommandPool command_pool,
     const vk::PhysicalDevice p_device,
-    const vk::DescriptorSetLayout layout,
-    const vk::DescriptorPool descriptor_pool,
-    const vk::Sampler sampler
+    TextureTable& textures,
+    DeletionQueue& deletions,
+    UploadQueue& uploads,
+    const vk::Sampler sampler,
+    const unsigned int frames
 ) {
+    if (loaded_) return; // already has its slot in the table
+
+    image_.setDeletionQueue(&deletions);
+    image_.setUploadQueue(&uploads);
+
     sampler_ = sampler;
     device_ = device;
     graphics_queue_ = graphics_queue;
     command_pool_ = command_pool;
     p_device_ = p_device;
-    layout_ = layout;
-    descriptor_pool_ = descriptor_pool;
 
     // select how to load data into the vk::Image
 
     if (is_color_) {
         loadColor();
-        return;
-    }
-
-    if (type_ == tdl::File::Image) {
+    } else if (type_ == tdl::File::Image) {
         loadImage();
     } else if (type_ == tdl::File::Video) {
         loadVideo();
     } else {
         throw std::runtime_error("ERR 061: Unkown texture type. Texture::load(...)");
     }
+
+    // video frames are copied into the images of the frames in flight, the slots stay valid for the whole video
+    index_ = textures.add(image_.image_view_, sampler_);
+
+    if (type_ != tdl::File::Video || is_color_) return;
+
+    // the other frames in flight start with the first frame too, their slots follow index_
+    for (unsigned int i = 1; i < frames; ++i) {
+        Image& image = *frame_images_.emplace_back(std::make_unique<Image>());
+
+        image.setDevice(device_);
+        image.setDeletionQueue(&deletions);
+        image.setUploadQueue(&uploads);
+        image.loadImage(
+            frame_data_.data,
+            width_,
+            plane_height_,
+            device_,
+            command_pool_,
+            graphics_queue_,
+            p_device_,
+            vk::Format::eR8Unorm
+        );
+
+        // no setSampler, the sampler is owned (and destroyed) by image_
+        textures.add(image.image_view_, sampler_);
+    }
+
+    uploaded_frames_.assign(frames, frame_number_);
 }
 
-void tdl::Texture::setNextImage() {
+void tdl::Texture::setNextImage(
+    UploadQueue& uploads,
+    const size_t frame
+) {
+    Image& image = frame == 0 ? image_ : *frame_images_[frame - 1];
+    vk::DeviceSize bytes;
+
     // use mutex to tell the animation thread that the image is being loaded and can not be
     frame_mutex_.lock();
-    image_.buffer_->set(frame_data_.data, width_ * height_ * 4);
-    frame_mutex_.unlock();
 
-    Image::setImageLayout(
-        image_.image_,
-        vk::ImageLayout::eUndefined,
-        vk::ImageLayout::eTransferDstOptimal,
-        device_,
-        command_pool_,
-        graphics_queue_
-    );
+    if (uploaded_frames_[frame] == frame_number_) { // video has not moved on since this frame in flight was drawn
+        frame_mutex_.unlock();
+        return;
+    }
 
-    // update image with new frame data
-    image_.buffer_->asImage(image_.image_, width_, height_);
+    // the staging buffer belongs to the frame in flight, its last copy finished before the frame's fence
+    bytes = frame_data_.total() * frame_data_.elemSize();
+    image.buffer_->set(frame_data_.data, bytes);
+    uploaded_frames_[frame] = frame_number_;
 
-    Image::setImageLayout(
-        image_.image_,
-        vk::ImageLayout::eTransferDstOptimal,
-        vk::ImageLayout::eShaderReadOnlyOptimal,
-        device_,
-        command_pool_,
-        graphics_queue_
-    );
-}
+    frame_mutex_.unlock();
 
-void tdl::Texture::render(
-    const vk::CommandBuffer command_buffer,
-    const vk::PipelineLayout pipeline_layout
-) const {
-    // binds image to command buffer
-    image_.render(command_buffer, pipeline_layout);
+    // update image with new frame data, submitted with the frame instead of waiting for the queue
+    uploads.copyToImage(frame, image.buffer_->getBuffer(), image.image_, width_, plane_height_, bytes);
 }
 
 void tdl::Texture::loadNextFrame() {
@@ -629,13 +867,24 @@ void tdl::Texture::loadNextFrame() {
 
     video_->retrieve(frame_); // grab next frame
 
-    // mutex to tell main thread that the frame is being converted
+    // mutex to tell main thread that the frame is being swapped in
     frame_mutex_.lock();
+    storeFrame();
+    ++frame_number_;
+    frame_mutex_.unlock();
+}
 
-    // convert from BGR to RGBA format
-    cv::cvtColor(frame_, frame_data_, cv::COLOR_BGR2RGBA);
+void tdl::Texture::storeFrame() {
+    // luma only (grey video), the Y plane is the frame and U and V stay neutral
+    if (frame_.channels() == 1) {
+        frame_data_.create(static_cast<int>(plane_height_), static_cast<int>(width_), CV_8UC1);
+        frame_.copyTo(frame_data_.rowRange(0, static_cast<int>(height_)));
+        frame_data_.rowRange(static_cast<int>(height_), static_cast<int>(plane_height_)).setTo(128);
+        return;
+    }
 
-    frame_mutex_.unlock();
+    // pack BGR into planar YUV, 1.5 bytes per pixel to upload instead of 4 and no RGBA expansion
+    cv::cvtColor(frame_, frame_data_, frame_.channels() == 4 ? cv::COLOR_BGRA2YUV_I420 : cv::COLOR_BGR2YUV_I420);
 }
 
 void tdl::Texture::loadImage() {
@@ -668,13 +917,6 @@ void tdl::Texture::loadImage() {
 
     image_.setSampler(sampler_);
 
-    image_.createDescriptor(
-        layout_,
-        descriptor_pool_
-    );
-
-    image_.updateDescriptor();
-
     loaded_ = true; // stop this code being excecuted again
 }
 
@@ -687,13 +929,10 @@ void tdl::Texture::loadVideo() {
     // retrive required parameters from video
     width_ = static_cast<uint32_t>(video_->get(cv::CAP_PROP_FRAME_WIDTH));
     height_ = static_cast<uint32_t>(video_->get(cv::CAP_PROP_FRAME_HEIGHT));
+    plane_height_ = height_ * 3 / 2; // full size Y plane + quarter size U and V planes
     fps_ = static_cast<float>(video_->get(cv::CAP_PROP_FPS));
 
     image_.setDevice(device_);
-    image_.createDescriptor(
-        layout_,
-        descriptor_pool_
-    );
 
     *video_ >> frame_; // load first frame
 
@@ -701,21 +940,21 @@ void tdl::Texture::loadVideo() {
         throw std::runtime_error("ERR 062: Could not load first frame of video texture! Texture::loadVideo(...)");
     }
 
-    // convert image format from BGR to RGBA
-    cv::cvtColor(frame_, frame_data_, cv::COLOR_BGR2RGBA);
+    storeFrame(); // frame is stored as YUV planes
 
+    // the planes are stacked vertically in a single channel image
     image_.loadImage(
         frame_data_.data,
         width_,
-        height_,
+        plane_height_,
         device_,
         command_pool_,
         graphics_queue_,
-        p_device_
+        p_device_,
+        vk::Format::eR8Unorm
     );
 
     image_.setSampler(sampler_);
-    image_.updateDescriptor();
 
     loaded_ = true; // stop this code from bering run again
 }
@@ -724,10 +963,6 @@ void tdl::Texture::loadColor() {
     if (loaded_) return; // stop this code from being run multiple times
 
     image_.setDevice(device_);
-    image_.createDescriptor(
-        layout_,
-        descriptor_pool_
-    );
 
     // set texture as a 1x1 pixel of a single color
     image_.loadImage(
@@ -741,7 +976,6 @@ void tdl::Texture::loadColor() {
     );
 
     image_.setSampler(sampler_);
-    image_.updateDescriptor();
 
     loaded_ = true; // stop this code from being run again
 }
@@ -750,36 +984,25 @@ void tdl::Model::rotate(
     const glm::vec3& angles,
     const glm::vec3& centre
 ) {
-    // rotate model around a given centre by translating it and then rotating it
-
-    ubo_data_.rotation = glm::translate(ubo_data_.rotation, centre);
-    ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.x, {1, 0, 0});
-    ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.y, {0, 1, 0});
-    ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.z, {0, 0, 1});
-    ubo_data_.rotation = glm::translate(ubo_data_.rotation, -centre);
-
-    has_changed_ = true; // tell ThreeDL that the matrix has changed since it was last retrived
+    transform_.rotate(angles, centre); // marks the model and all of its children as changed
 }
 
 void tdl::Model::rotate(
     const glm::vec3& angles
 ) {
-    // rotate model around a given centre by translating it and then rotating it
-
-    ubo_data_.rotation = glm::translate(ubo_data_.rotation, centre_);
-    ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.x, {1, 0, 0});
-    ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.y, {0, 1, 0});
-    ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.z, {0, 0, 1});
-    ubo_data_.rotation = glm::translate(ubo_data_.rotation, -centre_);
-
-    has_changed_ = true; // tell ThreeDL that the matrix has changed since it was last retrived
+    transform_.rotate(angles, centre_);
 }
 
 void tdl::Model::translate(
     const glm::vec3& val
 ) {
-    has_changed_ = true;
-    ubo_data_.translation = glm::translate(ubo_data_.translation, val);
+    transform_.translate(val);
+}
+
+void tdl::Model::setParent(
+    const shared_model<Model>& parent
+) {
+    transform_.setParent(parent.ptr_ != nullptr ? &parent->transform_ : nullptr);
 }
 
 tdl::shared_model<tdl::Model> tdl::Model::operator[] (
@@ -807,9 +1030,12 @@ std::vector<std::string> tdl::Model::getKeys() const {
     return { keys.begin(), keys.end() };
 }
 
-void tdl::Model::imageTick() {
+void tdl::Model::imageTick(
+    UploadQueue& uploads,
+    const size_t frame
+) {
     for (const auto &obj: objects_ | std::views::values) {
-        obj->imageTick(); // load all texture frames as images
+        obj->imageTick(uploads, frame); // load all texture frames as images
     }
 }
 
@@ -824,8 +1050,10 @@ void tdl::Model::loadTexture(
     const vk::Queue graphics_queue,
     const vk::CommandPool command_pool,
     const vk::PhysicalDevice p_device,
-    const vk::DescriptorSetLayout layout,
-    const vk::DescriptorPool descriptor_pool
+    TextureTable& textures,
+    DeletionQueue& deletions,
+    UploadQueue& uploads,
+    const unsigned int frames
 ) const {
     for (const auto &obj: objects_ | std::views::values) {
         obj->loadTexture(
@@ -833,8 +1061,10 @@ void tdl::Model::loadTexture(
             graphics_queue,
             command_pool,
             p_device,
-            layout,
-            descriptor_pool
+            textures,
+            deletions,
+            uploads,
+            frames
         );
     }
 }
@@ -843,14 +1073,16 @@ void tdl::Model::loadMesh(
     const vk::Device device,
     const vk::Queue graphics_queue,
     const vk::CommandPool command_pool,
-    const vk::PhysicalDevice p_device
+    const vk::PhysicalDevice p_device,
+    UploadQueue& uploads
 ) {
     for (const auto &obj: objects_ | std::views::values) {
         obj->loadMesh(
             device,
             graphics_queue,
             command_pool,
-            p_device
+            p_device,
+            uploads
         );
     }
 }
@@ -860,20 +1092,10 @@ void tdl::Model::render(
     const vk::PipelineLayout pipeline_layout,
     const unsigned long cframe
 ) {
-    // bind model UBO
-    command_buffer.bindDescriptorSets(
-            vk::PipelineBindPoint::eGraphics,
-            pipeline_layout,
-            3,
-            1,
-            &descriptor_sets_[cframe],
-            0,
-            nullptr
-    );
-
     // bind all object UBOs
     for (const auto &obj: objects_ | std::views::values) {
-        obj->render(command_buffer, pipeline_layout, cframe);
+        obj->bindUBO(command_buffer, pipeline_layout, cframe);
+        obj->render(command_buffer, pipeline_layout, cframe, true);
     }
 }
 
@@ -884,20 +1106,6 @@ void tdl::Model::initUBOs(
     const vk::CommandPool command_pool,
     const vk::PhysicalDevice physical_device
 ) {
-    // allocate space for the model UBO
-    ubos_.resize(max_f_frames);
-    for (unsigned int i = 0; i < max_f_frames; ++i) {
-        ubos_[i] = new MemoryBuffer (
-            sizeof(ModelObject),
-            vk::BufferUsageFlagBits::eUniformBuffer,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-            device,
-            graphics_queue,
-            command_pool,
-            physical_device
-        );
-    }
-
     // allocate space for object UBOs
     for (const auto &obj: objects_ | std::views::values) {
         obj->initUBOs(
@@ -912,57 +1120,18 @@ void tdl::Model::initUBOs(
 
 void tdl::Model::createDescriptorSets(
     const unsigned int max_f_frames,
-    const vk::DescriptorPool descriptor_pool,
+    DescriptorAllocator& descriptors,
     const vk::Device device,
-    const vk::DescriptorSetLayout model_layout,
     const vk::DescriptorSetLayout object_layout
 ) {
     for (const auto &obj: objects_ | std::views::values) {
         obj->createDescriptorSets(
             max_f_frames,
-            descriptor_pool,
+            descriptors,
             device,
             object_layout
         );
     }
-
-    std::vector<vk::DescriptorSetLayout> layouts (max_f_frames, model_layout);
-
-    const vk::DescriptorSetAllocateInfo alloc_info {
-        descriptor_pool,
-        static_cast<uint32_t>(max_f_frames),
-        layouts.data()
-    };
-
-    descriptor_sets_.resize(max_f_frames);
-
-    if (
-        device.allocateDescriptorSets(
-            &alloc_info,
-            descriptor_sets_.data()
-        ) != vk::Result::eSuccess
-    ) throw std::runtime_error("ERR 14 ");
-
-    for (int i = 0; i < max_f_frames; ++i) {
-        const vk::DescriptorBufferInfo buffer_info {
-            ubos_[i]->getBuffer(),
-            0,
-            sizeof(ModelObject) // UBO contains a ModelObject
-        };
-
-        const vk::WriteDescriptorSet descriptor_write {
-            descriptor_sets_[i],
-            2,
-            0,
-            1,
-            vk::DescriptorType::eUniformBuffer, // descriptor contains a uniform buffer
-            nullptr,
-            &buffer_info,
-            nullptr
-        };
-
-        device.updateDescriptorSets(1, &descriptor_write, 0, nullptr);
-    }
 }
 
 void tdl::Model::caluclateCentre() {
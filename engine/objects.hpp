@@ -10,13 +10,23 @@
 #include<opencv4/opencv2/core/mat.hpp>
 #include <opencv2/core/ocl.hpp>
 
+#include <algorithm>
+#include <bit>
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <chrono>
 #include <ranges>
 
 #include "types.hpp"
+#include "transform.hpp"
 #include "vulkan/buffers.hpp"
+#include "vulkan/pipelines.hpp"
+#include "vulkan/textures.hpp"
+#include "vulkan/deletion.hpp"
+#include "vulkan/descriptors.hpp"
+#include "vulkan/uploads.hpp"
 
 namespace tdl {
     /**
@@ -55,25 +65,59 @@ namespace tdl {
     };
 
     /**
-     * @breif Describes the UBO that each object is given.
+     * @breif: Contains data needed for shader stages.
+     *
+     * Contains matracies for projection, camera, and rotation. Needed to render objects.
     */
-    struct ModelObject {
-        glm::mat4 translation = glm::mat4(1);
-        glm::mat4 rotation = glm::mat4(1);
+    struct UniformBufferObject {
+        glm::mat4 proj;
+        glm::mat4 camera;
+        glm::mat4 rotation;
+        glm::vec4 data = {1.0f, 0.0f, 0.0f, 0.0f};
     };
 
+    /**
+     * @breif One entry of the MaterialTable, laid out like Material in material.glsl
+    */
     struct MaterialObject {
-        glm::vec4 ambient_color;
-        glm::vec4 specular_color;
-        glm::vec4 specular_exponent;
-        glm::vec4 other_data;
+        glm::vec4 ambient_color {0.0f};
+        glm::vec4 specular_color {0.0f};
+        glm::vec4 specular_exponent {0.0f}; // exponent (x), 1 if unlit (y)
+        glm::vec4 other_data {0.0f}; // 1 for video textures (x)
+        uint32_t texture_slot = 0; // in the TextureTable
+        uint32_t padding[3] {};
+    };
+
+    /**
+     * @breif Turns the quantized positions of a compressed mesh back into model space, position = min + q * extent
+    */
+    struct MeshObject {
+        glm::vec4 position_min {0.0f};
+        glm::vec4 position_extent {1.0f};
     };
 
+    /**
+     * @breif Describes the UBO that each object is given.
+     *
+     * mvp is computed once per object per frame on the CPU so the vertex shader only does a single matrix multiply.
+     * The material is not part of it, the objects index the MaterialTable instead.
+    */
     struct ObjectObject {
-        glm::mat4 translation = glm::mat4(1);
-        glm::mat4 rotation = glm::mat4(1);
+        glm::mat4 mvp = glm::mat4(1); // projection * view * model
+        glm::mat4 model = glm::mat4(1); // world matrix of the object
 
-        MaterialObject mat {};
+        MeshObject mesh {};
+    };
+
+    /**
+     * @breif Entry of the per frame transform buffer, laid out like Transform in object.glsl
+     *
+     * Objects that change nearly every frame are written here instead of to their UBO, the vertex shader applies the
+     * view and projection itself. Draws find their entry through DrawConstants::transform.
+    */
+    struct ObjectTransform {
+        glm::mat4 model = glm::mat4(1);
+        MeshObject mesh {};
     };
 
     class Model;
@@ -198,6 +242,29 @@ namespace tdl {
             static std::array<vk::VertexInputAttributeDescription, 3> getAttributeDescriptions();
     };
 
+    /**
+     * @brief Half the size of a Vertex, used by meshes with compression enabled (see Mesh::setCompressed()).
+     *
+     * The position is quantized to 16 bits per axis relative to the bounding box of the mesh (MeshObject holds the
+     * box), the normal is octahedral encoded into two snorm16 values and the uv is stored as two half floats.
+    */
+    class CompressedVertex final {
+        public:
+            CompressedVertex (
+                const Vertex& vertex,
+                const glm::vec3& min,
+                const glm::vec3& extent
+            );
+
+            std::array<uint16_t, 4> pos; // unorm16, w is padding
+            std::array<int16_t, 2> normal; // snorm16 octahedral
+            std::array<uint16_t, 2> uv; // half floats
+
+            static vk::VertexInputBindingDescription getBindingDescription();
+            static std::array<vk::VertexInputAttributeDescription, 3> getAttributeDescriptions();
+    };
+    static_assert(sizeof(CompressedVertex) == sizeof(Vertex) / 2);
+
     class ObjectInterface;
     /**
      * @brief Static methods used to load an OBJ file.
@@ -276,6 +343,62 @@ namespace tdl {
             );
     };
 
+    /**
+     * @breif Post transform vertex cache efficiency of a mesh before and after MeshOptimizer, simulated for a FIFO cache
+     *
+     * ACMR is vertex shader invocations per triangle (0.5 - 3, lower is better), ATVR is invocations per unique vertex
+     * (1 is ideal).
+    */
+    struct MeshStats {
+        uint32_t vertices = 0; // unique vertices after indexing
+        uint32_t triangles = 0;
+        uint32_t clusters = 0; // groups of triangles reordered for overdraw
+        float acmr_before = 0.0f; // indexed, in file order
+        float atvr_before = 0.0f;
+        float acmr_after = 0.0f;
+        float atvr_after = 0.0f;
+    };
+
+    /**
+     * @breif Range of the index buffer that draws one level of detail of a mesh
+    */
+    struct MeshLod {
+        uint32_t first_index = 0;
+        uint32_t index_count = 0;
+        float error = 0.0f; // how far the simplified surface can be from the full mesh, in model space
+        float acmr = 0.0f;
+    };
+
+    /**
+     * @breif Cluster of neighbouring triangles that is culled as a whole, laid out like Meshlet in cull.comp
+    */
+    struct Meshlet {
+        glm::vec4 sphere {0.0f}; // bounding sphere in model space, centre (xyz) and radius (w)
+        glm::vec4 cone {0.0f, 0.0f, 0.0f, 2.0f}; // normal cone axis (xyz) and cutoff (w), a cutoff > 1 never culls
+        uint32_t first_index = 0; // into the index buffer of the mesh
+        uint32_t index_count = 0;
+        uint32_t padding[2] {};
+    };
+
+    /**
+     * @breif Draw whose VkDrawIndexedIndirectCommand was written by a culling pass on the GPU
+    */
+    struct IndirectDraw {
+        vk::Buffer indices; // index buffer to draw from, null for the index buffer of the mesh
+        vk::Buffer command; // null if the object is not culled on the GPU
+        vk::DeviceSize offset = 0; // of the command in bytes
+    };
+
+    /**
+     * @breif Push constants of every draw, laid out like the Draw block in material.glsl
+    */
+    struct DrawConstants {
+        static constexpr uint32_t static_transform = UINT32_MAX; // the matrices are read from the object UBO
+
+        uint32_t material = 0; // index of the object's material in the MaterialTable, which holds its texture slot
+        uint32_t transform = static_transform; // entry of the object in the frame's transform buffer
+    };
+
     /**
      * @brief Stores vertex information about a mesh
      *
@@ -286,41 +409,161 @@ namespace tdl {
             /**
              * @breif sets the vertex data that the mesh stores and renders
              *
-             * @param vertices vertex data (std::vector<tdl::Vertex>)
+             * The triangle list is indexed and optimized for the vertex cache and overdraw by MeshOptimizer, so
+             * vertices_ only holds the unique vertices afterwards. The levels of detail and the meshlets of level 0
+             * are built from it as well.
+             *
+             * @param vertices vertex data (std::vector<tdl::Vertex>), three vertices per triangle
             */
             explicit Mesh (
                 const std::vector<Vertex>& vertices
-            ) : vertices_ { vertices } {}
+            );
 
             /**
-             * @breif creates the vk::Buffer for the model and copies the vertex data into it
+             * @breif creates the vk::Buffer for the model and records the copy of the vertex data into it
              *
              * @param device currently selected GPU (logical)
              * @param graphics_queue vk::Queue
              * @param command_pool command pool used to allocate command buffers
              * @param p_device currently selected GPU (physical)
+             * @param uploads queue the copies are recorded into, the buffers can be used after UploadQueue::flush()
             */
             void initBuffer (
                 vk::Device device,
                 vk::Queue graphics_queue,
                 vk::CommandPool command_pool,
-                vk::PhysicalDevice p_device
+                vk::PhysicalDevice p_device,
+                UploadQueue& uploads
             );
 
             /**
              * @breif tells the command buffer to bind the vertex data (render the vertices)
              *
              * @param command_buffer vk::CommandBuffer used to render the mesh
+             * @param lod level of detail to draw, 0 is the full mesh
+             * @param bind false if the vertex and index buffers of this mesh are still bound
             */
             void render (
-                vk::CommandBuffer command_buffer
+                vk::CommandBuffer command_buffer,
+                uint32_t lod = 0,
+                bool bind = true
+            ) const;
+
+            /**
+             * @breif binds only the vertex positions, used by the depth pre-pass
+             *
+             * @param command_buffer vk::CommandBuffer used to render the mesh
+             * @param lod level of detail to draw, has to match the one of the main pass for the depth to be equal
+            */
+            void renderPositions (
+                vk::CommandBuffer command_buffer,
+                uint32_t lod = 0
             ) const;
 
+            /**
+             * @breif Picks the coarsest level of detail whose error covers at most threshold pixels on screen
+             *
+             * A coarser level is only switched to once its error is lod_hysteresis below the threshold, so objects
+             * near the switching distance do not pop back and forth between two levels.
+             *
+             * @param pixels_per_unit pixels a model space distance of 1 covers at the object's distance
+             * @param threshold largest error in pixels
+             * @param current level drawn last frame
+             * @return uint32_t level to draw
+            */
+            [[nodiscard]] uint32_t selectLod (
+                float pixels_per_unit,
+                float threshold,
+                uint32_t current
+            ) const;
+
+            [[nodiscard]] uint32_t lodCount() const { return static_cast<uint32_t>(lods_.size()); }
+            [[nodiscard]] const MeshLod& getLod(const uint32_t lod) const { return lods_[lod]; }
+
+            /**
+             * @breif Draws the triangles a culling pass on the GPU picked
+             *
+             * @param command_buffer vk::CommandBuffer used to render the mesh
+             * @param draw command written by MeshletCuller or OcclusionCuller
+             * @param positions true to bind the position stream for the depth pre-pass
+            */
+            void renderIndirect (
+                vk::CommandBuffer command_buffer,
+                const IndirectDraw& draw,
+                bool positions
+            ) const;
+
+            /**
+             * @breif Large meshes are culled per meshlet, for small ones culling the whole object is enough
+            */
+            [[nodiscard]] bool cullable() const { return meshlets_.size() >= min_meshlets; }
+            [[nodiscard]] uint32_t meshletCount() const { return static_cast<uint32_t>(meshlets_.size()); }
+            [[nodiscard]] vk::Buffer meshletBuffer() const { return meshlet_buffer_->getBuffer(); }
+            [[nodiscard]] vk::Buffer indexBuffer() const { return index_buffer_->getBuffer(); }
+
+            /**
+             * @breif Stores the vertices as CompressedVertex, has to be set before the buffer is created
+             *
+             * @param compressed true to halve the size of the vertex data at the cost of 16 bit positions
+            */
+            void setCompressed (
+                const bool compressed
+            ) { compressed_ = compressed; }
+
+            [[nodiscard]] bool compressed() const { return compressed_; }
+
+            /**
+             * @breif Dequantization of the positions, identity for uncompressed meshes
+            */
+            [[nodiscard]] const MeshObject& decode() const { return decode_; }
+
+            /**
+             * @breif Vertex cache statistics from the optimization done when the mesh was created
+            */
+            [[nodiscard]] const MeshStats& getStats() const { return stats_; }
+
+            [[nodiscard]] uint32_t triangles(const uint32_t lod = 0) const { return lods_[lod].index_count / 3; }
+
+            /**
+             * @breif Size of the index data read by render() and renderPositions() for a level of detail
+            */
+            [[nodiscard]] vk::DeviceSize indexBytes(const uint32_t lod = 0) const {
+                return lods_[lod].index_count * sizeof(uint32_t);
+            }
+
+            /**
+             * @breif Size of the vertex data read by render()
+            */
+            [[nodiscard]] vk::DeviceSize vertexBytes() const {
+                return vertices_.size() * (compressed_ ? sizeof(CompressedVertex) : sizeof(Vertex));
+            }
+
+            /**
+             * @breif Size of the position stream read by renderPositions()
+            */
+            [[nodiscard]] vk::DeviceSize positionBytes() const {
+                return vertices_.size() * (compressed_ ? sizeof(std::array<uint16_t, 4>) : sizeof(glm::vec3));
+            }
+
             ~Mesh() = default;
 
-            std::vector<Vertex> vertices_;
+            static constexpr float lod_hysteresis = 0.25f;
+            static constexpr uint32_t min_meshlets = 16;
+
+            std::vector<Vertex> vertices_; // unique vertices in the order the indices first use them
         private:
+            std::vector<uint32_t> indices_; // every level of detail, level 0 first
+            std::vector<MeshLod> lods_;
+            std::vector<Meshlet> meshlets_; // of level 0
+            MeshStats stats_ {};
+
             MemoryBuffer* buffer_ = nullptr;
+            MemoryBuffer* position_buffer_ = nullptr; // positions only, in the same format as the full vertices
+            MemoryBuffer* index_buffer_ = nullptr; // shared by both vertex streams, read by the culling pass as well
+            MemoryBuffer* meshlet_buffer_ = nullptr; // only for cullable() meshes
+
+            bool compressed_ = false;
+            MeshObject decode_ {};
 
             std::string path_;
             bool loaded_ = false;
@@ -334,6 +577,9 @@ namespace tdl {
      *
      * Can hold a static image or a video in which case a single frame is loaded to the shader. Frame rate of video is
      * independent of the frame rate of the engine.
+     *
+     * A video has one image per frame in flight in consecutive slots of the TextureTable, so a new frame is copied
+     * into the image of the frame being recorded while the other frames in flight still read theirs.
     */
     class Texture final {
         public:
@@ -376,32 +622,45 @@ namespace tdl {
              * @param graphics_queue vk::Queue
              * @param command_pool command pool used to allocate command buffers
              * @param p_device currently used GPU (physical)
-             * @param layout layout of the image
-             * @param descriptor_pool descriptor pool used to allocate descriptor sets
+             * @param textures table the texture is added to once it is loaded
+             * @param deletions queue the images go to if they are loaded again
+             * @param uploads queue the copies are recorded into, the texture can be sampled after UploadQueue::flush()
+             * @param sampler sampler the texture is read with
+             * @param frames frames in flight, number of images of a video
             */
             void load (
                 vk::Device device,
                 vk::Queue graphics_queue,
                 vk::CommandPool command_pool,
                 vk::PhysicalDevice p_device,
-                vk::DescriptorSetLayout layout,
-                vk::DescriptorPool descriptor_pool,
-                vk::Sampler sampler
+                TextureTable& textures,
+                DeletionQueue& deletions,
+                UploadQueue& uploads,
+                vk::Sampler sampler,
+                unsigned int frames
             );
 
             /**
-             * @breif binds the texture (vk::Image) to the command buffer for rendering
+             * @breif Slot of the texture in the TextureTable, valid once the texture is loaded
              *
-             * @param command_buffer command buffer to bind texture to
-             * @param pipeline_layout vk::PipelineLayout
+             * The first of the frames in flight for a video, the shaders add the frame (see textureSlot in texture.glsl).
             */
-            void render (
-                vk::CommandBuffer command_buffer,
-                vk::PipelineLayout pipeline_layout
-            ) const;
+            [[nodiscard]] uint32_t index() const { return index_; }
 
             void loadNextFrame(); // queries opencv capture
-            void setNextImage(); // creates vulkan image from latest frame
+
+            /**
+             * @breif Records the copy of the latest frame into the image of a frame in flight
+             *
+             * Nothing is recorded if the image already holds the latest frame.
+             *
+             * @param uploads streaming uploads the copy is recorded into
+             * @param frame frame in flight being recorded, its fence has to be waited on
+            */
+            void setNextImage (
+                UploadQueue& uploads,
+                size_t frame
+            );
 
             ~Texture() = default;
 
@@ -410,6 +669,15 @@ namespace tdl {
             void loadVideo(); // loads video from file (opencv library)
             void loadColor(); // sets image to a single pixel of required colour
 
+            /**
+             * @breif Stores the latest decoded frame in frame_data_ as planar I420 (YUV 4:2:0)
+             *
+             * The FFMPEG backend of OpenCV only hands out decoded frames as BGR (CAP_PROP_FORMAT -1 gives the
+             * compressed packets, not the planes), so BGR frames are packed into I420 and luma only frames get neutral
+             * U and V planes. Conversion to RGB happens in the fragment shader.
+            */
+            void storeFrame();
+
             File type_;
 
             std::unique_ptr<cv::VideoCapture> video_;
@@ -424,19 +692,22 @@ namespace tdl {
 
             uint32_t width_ = 0;
             uint32_t height_ = 0;
+            uint32_t plane_height_ = 0; // height of the Y, U and V planes stacked into one image
             float fps_ = 0.0f;
 
             vk::Device device_;
             vk::Queue graphics_queue_;
             vk::CommandPool command_pool_;
             vk::PhysicalDevice p_device_;
-            vk::DescriptorSetLayout layout_;
-            vk::DescriptorPool descriptor_pool_;
             vk::Sampler sampler_;
+            uint32_t index_ = 0;
 
             std::chrono::high_resolution_clock::time_point time_ = std::chrono::high_resolution_clock::now();
 
-            Image image_;
+            Image image_; // frame in flight 0 of a video
+            std::vector<std::unique_ptr<Image>> frame_images_; // frames in flight 1 and up of a video
+            uint64_t frame_number_ = 0; // decoded frames, guarded by frame_mutex_
+            std::vector<uint64_t> uploaded_frames_; // frame_number_ held by the image of each frame in flight
     };
     using TexPtr = std::shared_ptr<Texture>;
 
@@ -447,6 +718,8 @@ namespace tdl {
         friend class Model;
         friend class Vlkn;
         friend class OBJLoader;
+        friend class ThreeDL;
+        friend class ShadowAtlas;
 
         public:
             explicit ObjectInterface (
@@ -474,18 +747,34 @@ namespace tdl {
                 vk::Queue graphics_queue,
                 vk::CommandPool command_pool,
                 vk::PhysicalDevice p_device,
-                const vk::DescriptorSetLayout& layout,
-                const vk::DescriptorPool& descriptor_pool
-            ) const = 0;
+                TextureTable& textures,
+                DeletionQueue& deletions,
+                UploadQueue& uploads,
+                unsigned int frames
+            ) = 0;
 
             virtual void loadMesh (
                 vk::Device device,
                 vk::Queue graphics_queue,
                 vk::CommandPool command_pool,
-                vk::PhysicalDevice p_device
+                vk::PhysicalDevice p_device,
+                UploadQueue& uploads
             )  = 0;
 
             virtual void render (
+                vk::CommandBuffer command_buffer,
+                vk::PipelineLayout pipeline_layout,
+                unsigned long cframe,
+                bool bind_mesh
+            ) const = 0;
+
+            /**
+             * @breif Binds the object UBO of the frame to set 2
+             *
+             * Draws reading the transform buffer skip it, but the set is used by the shaders so any object's UBO has to
+             * be bound before them.
+            */
+            virtual void bindUBO (
                 vk::CommandBuffer command_buffer,
                 vk::PipelineLayout pipeline_layout,
                 unsigned long cframe
@@ -501,22 +790,93 @@ namespace tdl {
 
             virtual void createDescriptorSets (
                 unsigned int max_f_frames,
-                vk::DescriptorPool descriptor_pool,
+                DescriptorAllocator& descriptors,
                 vk::Device device,
                 vk::DescriptorSetLayout ubo_layout
             ) = 0;
 
             virtual void caluclateCentre() = 0;
-            virtual void imageTick() = 0;
+
+            /**
+             * @breif Bounding sphere of the object in world space
+             *
+             * @param model world matrix of the object
+             * @return glm::vec4 centre (xyz) and radius (w)
+            */
+            [[nodiscard]] glm::vec4 boundingSphere (
+                const glm::mat4& model
+            ) const {
+                return {glm::vec3(model * glm::vec4(centre_, 1.0f)), radius_ * maxScale(model)};
+            }
+
+            /**
+             * @breif Largest scale along any axis of a world matrix
+            */
+            [[nodiscard]] static float maxScale (
+                const glm::mat4& model
+            ) {
+                return std::max({
+                    glm::length(glm::vec3(model[0])),
+                    glm::length(glm::vec3(model[1])),
+                    glm::length(glm::vec3(model[2]))
+                });
+            }
+
+            /**
+             * @breif True if the object changed in dynamic_frames of the last 8 rendered frames
+             *
+             * Such objects are drawn from the frame's transform buffer, rewriting their UBO every frame would cost a
+             * matrix multiply on the CPU for a product the vertex shader can form itself.
+            */
+            [[nodiscard]] bool changesOften() const { return std::popcount(change_history_) >= dynamic_frames; }
+
+            static constexpr int dynamic_frames = 4;
+
+            virtual void imageTick (
+                UploadQueue& uploads,
+                size_t frame
+            ) = 0;
             virtual void frameTick() = 0;
             virtual void setNoLight() = 0;
 
+            /**
+             * @breif Shader permutation the object is drawn with
+            */
+            [[nodiscard]] virtual PipelineKey pipelineKey() const = 0;
+
+            /**
+             * @breif Binds the position stream of the mesh for the depth pre-pass, see bindUBO()
+             *
+             * @param view true to draw the triangles render() draws (lod_ and the culled meshlets) for the depth
+             * pre-pass, false to draw the full mesh for the shadow atlas
+            */
+            virtual void renderDepth (
+                vk::CommandBuffer command_buffer,
+                vk::PipelineLayout pipeline_layout,
+                unsigned long cframe,
+                bool view
+            ) const = 0;
+
             std::vector<MemoryBuffer*> ubos_;
-            ObjectObject ubo_data_ {};
-            bool has_changed_ = true;
+            ObjectObject ubo_data_ {}; // only the mesh is used, matrices are computed from transform_
+            MaterialObject mat_ {};
+            uint64_t version_ = 1; // incremented every time mat_ changes
+            uint32_t material_ = 0; // index of mat_ in the MaterialTable, looked up by the renderer
+            uint64_t material_version_ = 0; // version_ material_ was looked up at
+            std::vector<uint64_t> frame_versions_; // version last uploaded to each frame's UBO
+            uint64_t seen_version_ = 0; // snapshot version of the last rendered frame
+            uint8_t change_history_ = 0; // one bit per rendered frame, set if the object changed, newest in the lowest bit
+            // DrawConstants::transform of the frame being recorded, static_transform unless the object changes often
+            uint32_t transform_slot_ = DrawConstants::static_transform;
+            Transform transform_; // local transform, relative to the model that renders the object
+            LightingModels lighting_model_ = LightingModels::PER_LIGHT;
             TexPtr tex_;
             MeshPtr mesh_;
             glm::vec3 centre_ {};
+            float radius_ = 0.0f; // distance from centre_ to the furthest vertex
+            uint32_t lod_ = 0; // level of detail of the mesh drawn by render(), picked by the renderer every frame
+            // output of the culling passes for the phase being recorded, render() draws lod_ if there is no command
+            IndirectDraw culled_ {};
             vk::Sampler sampler_;
     };
     using ObjectPtr = std::shared_ptr<ObjectInterface>;
@@ -554,9 +914,12 @@ namespace tdl {
                     tex_ = std::make_shared<Texture>(Material::lTorRGBA(material_.diffuse));
                 }
 
-                ubo_data_.mat.ambient_color = glm::vec4(material.ambient, 0);
-                ubo_data_.mat.specular_color = glm::vec4(material.specular, 0);
-                ubo_data_.mat.specular_exponent = glm::vec4(material.specular_exponent, material_.light_, 0, 0);
+                mat_.ambient_color = glm::vec4(material.ambient, 0);
+                mat_.specular_color = glm::vec4(material.specular, 0);
+                mat_.specular_exponent = glm::vec4(material.specular_exponent, material_.light_, 0, 0);
+
+                // video textures are uploaded as YUV planes and converted to RGB by the shader
+                if constexpr (tex_type == File::Video) mat_.other_data.x = 1;
             }
 
             /**
@@ -569,13 +932,7 @@ namespace tdl {
                 const glm::vec3& angles,
                 const glm::vec3& centre
             ) override {
-                ubo_data_.rotation = glm::translate(ubo_data_.rotation, centre);
-                ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.x, {1, 0, 0});
-                ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.y, {0, 1, 0});
-                ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.z, {0, 0, 1});
-                ubo_data_.rotation = glm::translate(ubo_data_.rotation, -centre);
-
-                has_changed_ = true;
+                transform_.rotate(angles, centre);
             }
 
 
@@ -587,13 +944,7 @@ namespace tdl {
             void rotate (
                 const glm::vec3& angles
             ) override {
-                ubo_data_.rotation = glm::translate(ubo_data_.rotation, centre_);
-                ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.x, {1, 0, 0});
-                ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.y, {0, 1, 0});
-                ubo_data_.rotation = glm::rotate(ubo_data_.rotation, angles.z, {0, 0, 1});
-                ubo_data_.rotation = glm::translate(ubo_data_.rotation, -centre_);
-
-                has_changed_ = true;
+                transform_.rotate(angles, centre_);
             }
 
             /**
@@ -604,14 +955,23 @@ namespace tdl {
             void translate (
                 const glm::vec3& val
             ) override {
-                ubo_data_.translation = glm::translate(ubo_data_.translation, val);
-                has_changed_ = true;
+                transform_.translate(val);
             }
 
             void setNoLight() override {
                 material_.light_ = 1;
-                ubo_data_.mat.specular_exponent.y = 1;
-                has_changed_ = true;
+                mat_.specular_exponent.y = 1;
+                ++version_;
+            }
+
+            [[nodiscard]] PipelineKey pipelineKey() const override {
+                return {
+                    material_.light_ == 0,
+                    lighting_model_,
+                    tex_type == File::Video,
+                    false,
+                    mesh_->compressed()
+                };
             }
 
             ~Object() override {
@@ -628,26 +988,36 @@ namespace tdl {
              * @param graphics_queue vk::Queue
              * @param command_pool command pool used to allocate command buffers
              * @param p_device GPU currently being used (physical)
-             * @param layout layout of bindings
-             * @param descriptor_pool pool used to allocate descriptor sets
+             * @param textures table the texture is added to
+             * @param deletions queue the replaced images go to
+             * @param uploads queue the copies are recorded into
+             * @param frames frames in flight
             */
             void loadTexture (
                 const vk::Device device,
                 const vk::Queue graphics_queue,
                 const vk::CommandPool command_pool,
                 const vk::PhysicalDevice p_device,
-                const vk::DescriptorSetLayout& layout,
-                const vk::DescriptorPool& descriptor_pool
-            ) const override {
+                TextureTable& textures,
+                DeletionQueue& deletions,
+                UploadQueue& uploads,
+                const unsigned int frames
+            ) override {
                 tex_->load(
                     device,
                     graphics_queue,
                     command_pool,
                     p_device,
-                    layout,
-                    descriptor_pool,
-                    sampler_
+                    textures,
+                    deletions,
+                    uploads,
+                    sampler_,
+                    frames
                 );
+
+                // the texture slot is part of the material, objects with the same texture share a material entry
+                mat_.texture_slot = tex_->index();
+                ++version_;
             }
 
             /**
@@ -657,26 +1027,75 @@ namespace tdl {
              * @param graphics_queue vk::Queue
              * @param command_pool command pool used to allocate command buffers
              * @param p_device GPU currently being used (physical)
+             * @param uploads queue the copies are recorded into
             */
             void loadMesh (
                 const vk::Device device,
                 const vk::Queue graphics_queue,
                 const vk::CommandPool command_pool,
-                const vk::PhysicalDevice p_device
+                const vk::PhysicalDevice p_device,
+                UploadQueue& uploads
             ) override {
-                mesh_->initBuffer(device, graphics_queue, command_pool, p_device);
+                mesh_->initBuffer(device, graphics_queue, command_pool, p_device, uploads);
+                ubo_data_.mesh = mesh_->decode();
                 caluclateCentre();
             }
 
 
             /**
-             * @breif Binds the texture and vertex buffers to the given command buffer
+             * @breif Binds the vertex buffers to the given command buffer and draws the object
+             *
+             * The renderer pushes the DrawConstants of the object and binds its UBO (bindUBO()) before, draws are sorted
+             * so consecutive ones share the material and the mesh.
              *
              * @param command_buffer command buffer to bind to
              * @param pipeline_layout layout of bindings
              * @param cframe current frame number
+             * @param bind_mesh false if the last draw bound the vertex and index buffers of the same mesh
              */
             void render (
+                const vk::CommandBuffer command_buffer,
+                const vk::PipelineLayout pipeline_layout,
+                const unsigned long cframe,
+                const bool bind_mesh
+            ) const override {
+                if (culled_.command) {
+                    mesh_->renderIndirect(command_buffer, culled_, false);
+                } else {
+                    mesh_->render(command_buffer, lod_, bind_mesh);
+                }
+            }
+
+            /**
+             * @breif Binds the vertex positions to the given command buffer, no texture is needed
+             *
+             * @param command_buffer command buffer to bind to
+             * @param pipeline_layout layout of bindings
+             * @param cframe current frame number
+             */
+            void renderDepth (
+                const vk::CommandBuffer command_buffer,
+                const vk::PipelineLayout pipeline_layout,
+                const unsigned long cframe,
+                const bool view
+            ) const override {
+                if (!view) {
+                    mesh_->renderPositions(command_buffer);
+                } else if (culled_.command) {
+                    mesh_->renderIndirect(command_buffer, culled_, true);
+                } else {
+                    mesh_->renderPositions(command_buffer, lod_);
+                }
+            }
+
+            /**
+             * @breif Binds the UBO of the frame to set 2 of the given layout
+             *
+             * @param command_buffer command buffer to bind to
+             * @param pipeline_layout layout of bindings
+             * @param cframe current frame number
+             */
+            void bindUBO (
                 const vk::CommandBuffer command_buffer,
                 const vk::PipelineLayout pipeline_layout,
                 const unsigned long cframe
@@ -690,9 +1109,6 @@ namespace tdl {
                     0,
                     nullptr
                 );
-
-                tex_->render(command_buffer, pipeline_layout);
-                mesh_->render(command_buffer);
             }
 
             /**
@@ -711,6 +1127,7 @@ namespace tdl {
                 const vk::CommandPool command_pool,
                 const vk::PhysicalDevice physical_device
             ) override {
+                frame_versions_.assign(max_f_frames, 0);
                 ubos_.resize(max_f_frames);
                 for (unsigned int i = 0; i < max_f_frames; ++i) {
                     ubos_[i] = new MemoryBuffer (
@@ -722,6 +1139,8 @@ namespace tdl {
                         command_pool,
                         physical_device
                     );
+
+                    ubos_[i]->map(); // written every frame the object or camera moves, so keep it mapped
                 }
             }
 
@@ -729,32 +1148,17 @@ namespace tdl {
              * @breif Creates descriptor sets for all UBO buffers
              *
              * @param max_f_frames max number of pre rendered frames
-             * @param descriptor_pool pool used to allocate descriptor sets
+             * @param descriptors allocator the sets are taken from
              * @param device current GPU (logical)
              * @param ubo_layout layout of UBO
              */
             void createDescriptorSets(
                 const unsigned int max_f_frames,
-                const vk::DescriptorPool descriptor_pool,
+                DescriptorAllocator& descriptors,
                 const vk::Device device,
                 const vk::DescriptorSetLayout ubo_layout
             ) override {
-                std::vector<vk::DescriptorSetLayout> layouts (max_f_frames, ubo_layout);
-
-                const vk::DescriptorSetAllocateInfo alloc_info {
-                    descriptor_pool,
-                    static_cast<uint32_t>(max_f_frames),
-                    layouts.data()
-                };
-
-                descriptor_sets_.resize(max_f_frames);
-
-                if (
-                    device.allocateDescriptorSets(
-                        &alloc_info,
-                        descriptor_sets_.data()
-                    ) != vk::Result::eSuccess
-                ) throw std::runtime_error("ERR 14 ");
+                descriptor_sets_ = descriptors.allocate(ubo_layout, max_f_frames);
 
                 for (int i = 0; i < max_f_frames; ++i) {
                     const vk::DescriptorBufferInfo buffer_info {
@@ -781,12 +1185,16 @@ namespace tdl {
             /**
              * @breif Calculates centre of the mesh
              *
-             * Method sets the internal value of centre_ by taking the average position of all the x, y and z values.
+             * Method sets the internal value of centre_ by taking the average position of all the x, y and z values,
+             * radius_ is set to the distance of the furthest vertex from it.
             */
             void caluclateCentre() override {
                 centre_ = glm::vec3(0.0f);
                 for (const auto& vert : mesh_->vertices_) centre_ += vert.pos;
                 centre_ /= mesh_->vertices_.size();
+
+                radius_ = 0.0f;
+                for (const auto& vert : mesh_->vertices_) radius_ = std::max(radius_, glm::length(vert.pos - centre_));
             }
 
             /**
@@ -795,8 +1203,11 @@ namespace tdl {
              * This method only performs an operation if the texture stores a video. If enabled when this method is
              * called the OpenCV VideoCapture loads the next frame and converts it to the RGBA format.
             */
-            void imageTick() override {
-                if constexpr (tex_type == tdl::File::Video) tex_->setNextImage();
+            void imageTick (
+                UploadQueue& uploads,
+                const size_t frame
+            ) override {
+                if constexpr (tex_type == tdl::File::Video) tex_->setNextImage(uploads, frame);
             }
 
             /**
@@ -921,6 +1332,25 @@ namespace tdl {
                 const glm::vec3& val
             );
 
+            /**
+             * @breif Attaches the model to a parent model, the model then moves along with its parent
+             *
+             * The model keeps its own rotation and translation which are now relative to the parent. Passing nullptr
+             * detaches the model again.
+             *
+             * @param parent model to attach to
+            */
+            void setParent (
+                const shared_model<Model>& parent
+            );
+
+            /**
+             * @breif Gets the world matrix of the model (all parent transforms applied)
+             *
+             * @return glm::mat4 cached world matrix
+            */
+            [[nodiscard]] glm::mat4 getWorldMatrix() const { return transform_.world(); }
+
             [[nodiscard]] glm::vec3 getCentre() const { return centre_; }
 
             /**
@@ -944,19 +1374,64 @@ namespace tdl {
                 }
             }
 
-            ~Model() {
-                for (const auto& memory : ubos_) {
-                    delete memory;
+            /**
+             * @breif Shades every object with the given lighting model instead of the model of each light
+             *
+             * Selects the shader permutation the objects are drawn with, so it has to be set before ThreeDL::start().
+             *
+             * @param model lighting model to use, PER_LIGHT to use the model each light was given
+            */
+            void setLightingModel (
+                const LightingModels model
+            ) {
+                for (const auto& object : objects_ | std::ranges::views::values) {
+                    object->lighting_model_ = model;
+                }
+            }
+
+            /**
+             * @breif Stores the vertices of every object as CompressedVertex, halving their size
+             *
+             * Positions are quantized to 16 bits over the bounding box of each mesh, so very large meshes lose some
+             * precision. The buffers are created by ThreeDL::start(), so it has to be called before that.
+             *
+             * @param compressed true to compress the vertices
+            */
+            void setCompressedVertices (
+                const bool compressed
+            ) {
+                for (const auto& object : objects_ | std::ranges::views::values) {
+                    object->mesh_->setCompressed(compressed);
                 }
             }
+
+            /**
+             * @breif Vertex cache statistics of every object's mesh, see MeshStats
+             *
+             * @return std::vector<std::pair<std::string, MeshStats>> object name and the stats of its mesh
+            */
+            [[nodiscard]] std::vector<std::pair<std::string, MeshStats>> getMeshStats() const {
+                std::vector<std::pair<std::string, MeshStats>> stats;
+                stats.reserve(objects_.size());
+
+                for (const auto& [name, object] : objects_) stats.emplace_back(name, object->mesh_->getStats());
+                return stats;
+            }
+
         private:
             /**
              * @breif Calls imageTick() of all child objects
              *
              * Tells child objects to load current cv::VideoCapture frame into a vk::Image so the model can be textured
              * with the new frame (only for video textures)
+             *
+             * @param uploads streaming uploads the copies are recorded into
+             * @param frame frame in flight being recorded
             */
-            void imageTick();
+            void imageTick (
+                UploadQueue& uploads,
+                size_t frame
+            );
 
             /**
              * @breif Calls frameTick() of all child objects
@@ -973,16 +1448,20 @@ namespace tdl {
              * @param graphics_queue vk::Queue
              * @param command_pool command pool used to allocate command buffers
              * @param p_device GPU currently in use (physical)
-             * @param layout layout of bindings
-             * @param descriptor_pool pool used to allocate descriptor sets
+             * @param textures table the textures are added to
+             * @param deletions queue the replaced images go to
+             * @param uploads queue the copies are recorded into
+             * @param frames frames in flight
             */
             void loadTexture (
                 vk::Device device,
                 vk::Queue graphics_queue,
                 vk::CommandPool command_pool,
                 vk::PhysicalDevice p_device,
-                vk::DescriptorSetLayout layout,
-                vk::DescriptorPool descriptor_pool
+                TextureTable& textures,
+                DeletionQueue& deletions,
+                UploadQueue& uploads,
+                unsigned int frames
             ) const;
 
             /**
@@ -992,16 +1471,18 @@ namespace tdl {
              * @param graphics_queue vk::Queue
              * @param command_pool pool used to allocate command buffers
              * @param p_device GPU currently in use (physical)
+             * @param uploads queue the copies are recorded into
             */
             void loadMesh (
                 vk::Device device,
                 vk::Queue graphics_queue,
                 vk::CommandPool command_pool,
-                vk::PhysicalDevice p_device
+                vk::PhysicalDevice p_device,
+                UploadQueue& uploads
             );
 
             /**
-             * @breif Tells all children objects to bind their models and textures to the given command buffer
+             * @breif Tells all children objects to bind their UBOs and textures to the given command buffer
              *
              * @param command_buffer command buffer used to bind models and textures
              * @param pipeline_layout layout of bindings in pipeline
@@ -1014,7 +1495,7 @@ namespace tdl {
             );
 
             /**
-             * @breif Allocates memory buffers which store UBO data
+             * @breif Tells all children objects to allocate the memory buffers which store their UBO data
              *
              * @param max_f_frames number of pre-rendered frames
              * @param device GPU currently in use (logical)
@@ -1031,19 +1512,17 @@ namespace tdl {
             );
 
             /**
-             * @breif Creates required number of descriptor sets for UBOs, models and textures
+             * @breif Creates required number of descriptor sets for the object UBOs
              *
              * @param max_f_frames max number of pre-rendered frames
-             * @param descriptor_pool pool used to allocate descriptor sets
+             * @param descriptors allocator the sets are taken from
              * @param device GPU currently in use (logical)
-             * @param model_layout layout of model UBO
              * @param object_layout layout of object UBO
             */
             void createDescriptorSets (
                 unsigned int max_f_frames,
-                vk::DescriptorPool descriptor_pool,
+                DescriptorAllocator& descriptors,
                 vk::Device device,
-                vk::DescriptorSetLayout model_layout,
                 vk::DescriptorSetLayout object_layout
             );
 
@@ -1065,10 +1544,7 @@ namespace tdl {
 
             glm::vec3 centre_;
 
-            ModelObject ubo_data_ {};
-            std::vector<MemoryBuffer*> ubos_;
-            std::vector<vk::DescriptorSet> descriptor_sets_;
-            bool has_changed_ = true;
+            Transform transform_; // node in the scene graph, transforms of objects_ are relative to it
     };
 
     /**
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+    #include <xmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+#endif
+
+namespace tdl::simd {
+    /**
+     * @breif Multiplies two column major 4x4 matrices: out = a * b
+     *
+     * Uses AVX (two columns per iteration), SSE or NEON depending on what the compiler targets and falls back to plain
+     * scalar code otherwise. out must not alias a or b.
+     *
+     * @param a 16 floats of the left matrix
+     * @param b 16 floats of the right matrix
+     * @param out 16 floats the result is written to, may point into mapped GPU memory
+    */
+    inline void mul (
+        const float* const a,
+        const float* const b,
+        float* const out
+    ) {
+        // every column of the result is a linear combination of the columns of a weighted by a column of b
+#if defined(__AVX__)
+        const __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+        const __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+        const __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+        const __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+
+        for (int col = 0; col < 16; col += 8) {
+            const __m256 bc = _mm256_loadu_ps(b + col); // two columns of b, one per 128 bit lane
+
+            __m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(bc, 0x00));
+    #if defined(__FMA__)
+            r = _mm256_fmadd_ps(a1, _mm256_permute_ps(bc, 0x55), r);
+            r = _mm256_fmadd_ps(a2, _mm256_permute_ps(bc, 0xAA), r);
+            r = _mm256_fmadd_ps(a3, _mm256_permute_ps(bc, 0xFF), r);
+    #else
+            r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_permute_ps(bc, 0x55)));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_permute_ps(bc, 0xAA)));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_permute_ps(bc, 0xFF)));
+    #endif
+            _mm256_storeu_ps(out + col, r);
+        }
+#elif defined(__SSE__) || defined(_M_X64)
+        const __m128 a0 = _mm_loadu_ps(a);
+        const __m128 a1 = _mm_loadu_ps(a + 4);
+        const __m128 a2 = _mm_loadu_ps(a + 8);
+        const __m128 a3 = _mm_loadu_ps(a + 12);
+
+        for (int col = 0; col < 16; col += 4) {
+            const __m128 bc = _mm_loadu_ps(b + col);
+
+            __m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(0, 0, 0, 0)));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(1, 1, 1, 1))));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(2, 2, 2, 2))));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(3, 3, 3, 3))));
+
+            _mm_storeu_ps(out + col, r);
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        const float32x4_t a0 = vld1q_f32(a);
+        const float32x4_t a1 = vld1q_f32(a + 4);
+        const float32x4_t a2 = vld1q_f32(a + 8);
+        const float32x4_t a3 = vld1q_f32(a + 12);
+
+        for (int col = 0; col < 16; col += 4) {
+            const float32x4_t bc = vld1q_f32(b + col);
+
+            float32x4_t r = vmulq_laneq_f32(a0, bc, 0);
+            r = vfmaq_laneq_f32(r, a1, bc, 1);
+            r = vfmaq_laneq_f32(r, a2, bc, 2);
+            r = vfmaq_laneq_f32(r, a3, bc, 3);
+
+            vst1q_f32(out + col, r);
+        }
+#else
+        for (int col = 0; col < 4; ++col) {
+            for (int row = 0; row < 4; ++row) {
+                out[col * 4 + row] =
+                    a[row] * b[col * 4] +
+                    a[4 + row] * b[col * 4 + 1] +
+                    a[8 + row] * b[col * 4 + 2] +
+                    a[12 + row] * b[col * 4 + 3];
+            }
+        }
+#endif
+    }
+
+    /**
+     * @breif Writes a * b into out
+     *
+     * @param a left matrix
+     * @param b right matrix
+     * @param out result, must not be a or b
+    */
+    inline void mul (
+        const glm::mat4& a,
+        const glm::mat4& b,
+        glm::mat4& out
+    ) {
+        mul(&a[0][0], &b[0][0], &out[0][0]);
+    }
+
+    /**
+     * @breif Returns a * b
+    */
+    inline glm::mat4 mul (
+        const glm::mat4& a,
+        const glm::mat4& b
+    ) {
+        glm::mat4 out;
+        mul(a, b, out);
+        return out;
+    }
+};
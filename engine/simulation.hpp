@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "objects.hpp"
+#include "lighting.hpp"
+
+namespace tdl {
+    /**
+     * @breif Lock-free single producer / single consumer triple buffer
+     *
+     * The producer always owns the back slot and the consumer always owns the front slot, the third slot is swapped
+     * between them through a single atomic. Neither side ever waits for the other: the producer can overwrite a
+     * snapshot that was never consumed and the consumer keeps reading its front slot until a newer one is published.
+     *
+     * @tparam T type stored in each slot
+    */
+    template <typename T>
+    class TripleBuffer {
+        public:
+            /**
+             * @breif Slot the producer is allowed to write into
+             *
+             * @return T& back slot
+            */
+            T& back() { return slots_[back_]; }
+
+            /**
+             * @breif Hands the back slot over to the consumer and takes ownership of the spare slot
+            */
+            void publish() {
+                back_ = state_.exchange(back_ | dirty_bit, std::memory_order_acq_rel) & index_mask;
+            }
+
+            /**
+             * @breif Checks if a slot has been published since the consumer last called consume()
+             *
+             * Only the consumer clears this so the result stays valid until consume() is called.
+            */
+            [[nodiscard]] bool pending() const {
+                return (state_.load(std::memory_order_acquire) & dirty_bit) != 0;
+            }
+
+            /**
+             * @breif Swaps the latest published slot into the front slot
+             *
+             * @return true if a new slot was published since the last call
+            */
+            bool consume() {
+                if (!pending()) return false;
+
+                front_ = state_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+                return true;
+            }
+
+            /**
+             * @breif Slot the consumer is allowed to read from
+             *
+             * @return const T& front slot
+            */
+            [[nodiscard]] const T& front() const { return slots_[front_]; }
+
+        private:
+            static constexpr uint8_t index_mask = 0b011;
+            static constexpr uint8_t dirty_bit = 0b100;
+
+            std::array<T, 3> slots_ {};
+
+            uint8_t back_ = 0;
+            uint8_t front_ = 1;
+            std::atomic<uint8_t> state_ { 2 }; // index of the spare slot + dirty bit
+    };
+
+    /**
+     * @breif Immutable copy of every transform in the scene produced by one simulation tick
+     *
+     * The objects of all models are flattened into a single array in render order (models first, then the models of
+     * lights) and store their world matrix, the renderer combines it with the view projection matrix. Each entry
+     * carries the version it had when the snapshot was taken so the renderer only uploads entries that changed, the
+     * same goes for the lights.
+    */
+    struct TransformSnapshot {
+        UniformBufferObject camera {
+            glm::mat4(1.0f),
+            glm::mat4(1.0f),
+            glm::mat4(1.0f)
+        };
+
+        std::vector<ObjectObject> objects;
+        std::vector<uint64_t> object_versions;
+        std::vector<MaterialObject> materials; // of every object, the renderer looks up their MaterialTable index
+        std::vector<uint64_t> material_versions; // ObjectInterface::version_, changes only with the material
+
+        float near_plane = 0.01f; // clip planes of the camera, used to build the light clusters
+        float far_plane = 10000.0f;
+
+        std::vector<Light> lights;
+        std::vector<uint64_t> light_versions; // lets the renderer rewrite only the lights that changed
+
+        std::chrono::steady_clock::time_point time {};
+        // first key press handled by the latest tick that saw one, kept by the ticks after it
+        std::chrono::steady_clock::time_point input {};
+        uint64_t sequence = 0; // 0 until the first tick has been published
+
+        /**
+         * @breif Linear blend between two matrices
+         *
+         * Used to interpolate between two simulation ticks, the ticks are close enough together that blending the
+         * rotation matrices component wise is not noticeable.
+        */
+        static glm::mat4 blend (
+            const glm::mat4& from,
+            const glm::mat4& to,
+            const float alpha
+        ) { return from + (to - from) * alpha; }
+    };
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace tdl {
+    /**
+     * @breif Counters describing the cost of the last simulation tick and the last rendered frame
+     *
+     * Retrived through ThreeDL::getStats(), can be used to measure how the engine scales with the size of the scene.
+    */
+    struct FrameStats {
+        // simulation tick
+        uint64_t transforms_updated = 0; // world matrices recomputed
+        uint64_t objects_captured = 0; // object world matrices copied into the snapshot
+        std::chrono::nanoseconds transform_time {0}; // time spent on both of the above
+        double transforms_per_second = 0.0; // (transforms_updated + objects_captured) / transform_time
+
+        // rendered frame
+        uint64_t objects_uploaded = 0; // object UBOs rewritten
+        std::chrono::nanoseconds upload_time {0};
+        double uploads_per_second = 0.0; // objects_uploaded / upload_time
+        // objects that changed in most of the last frames, copied into the transform buffer instead of their UBO.
+        // Animate every object of a large scene each frame and compare upload_time with the same scene kept still
+        uint64_t dynamic_objects = 0;
+        uint64_t transform_bytes = 0; // written to the transform buffer
+        // video frames copied by the upload queue, submitted with the frame instead of stalling the graphics queue
+        uint64_t streamed_uploads = 0;
+        uint64_t streamed_bytes = 0;
+        uint64_t loaded_bytes = 0; // meshes and textures uploaded in one batch by the upload queue
+
+        // shadow atlas tiles rendered again because their light or a caster in range changed, 0 for a static scene
+        uint64_t shadow_tiles_rendered = 0;
+        uint64_t shadow_casters_drawn = 0;
+
+        // draws of the rendered frame
+        uint64_t draws = 0;
+        uint64_t prepass_draws = 0; // depth only draws, 0 without RendererInfo::depth_prepass_
+        uint64_t pipelines = 0; // shader permutations in use
+        uint64_t pipeline_binds = 0; // pipeline switches per frame, one per permutation as draws are sorted
+        uint64_t descriptor_binds = 0; // sets bound by the main passes, textures are bound once and not per draw
+        uint64_t descriptor_sets = 0; // allocated from the DescriptorAllocator, grows with the scene
+        uint64_t descriptor_pools = 0; // pools the allocator chained so far
+        uint64_t deletions_pending = 0; // replaced resources waiting for the frames in flight, none after a few frames
+        uint64_t deletions_released = 0; // destroyed by the DeletionQueue so far
+        uint64_t graph_passes = 0; // passes added to the RenderGraph of the frame
+        uint64_t graph_passes_culled = 0; // dropped because nothing read what they wrote
+        uint64_t graph_barriers = 0; // pipelineBarrier calls the graph recorded, one per pass at most
+        uint64_t transient_bytes = 0; // images created by the graph
+        uint64_t transient_heap_bytes = 0; // memory they are placed in, less than transient_bytes when they alias
+        uint64_t material_changes = 0; // draws are sorted by material inside every pipeline
+        uint64_t dynamic_draws = 0; // draws that read the transform buffer and bind no object UBO
+        uint64_t mesh_binds = 0; // vertex and index buffer binds, draws of the same mesh in a row bind them once
+        uint64_t materials = 0; // distinct materials in the MaterialTable
+        uint64_t vertex_bytes = 0; // vertex data read by the draws, halved by Model::setCompressedVertices()
+        uint64_t index_bytes = 0;
+        uint64_t triangles = 0; // triangles of the main pass
+        uint64_t lod_draws = 0; // draws of a simplified level of detail
+        uint64_t lod_triangles_saved = 0; // triangles the full meshes would have added
+
+        // only with RendererInfo::meshlet_culling_
+        uint64_t meshlet_draws = 0; // objects drawn from the culled index buffers
+        uint64_t meshlets_tested = 0;
+        // triangles left after culling, from the last frame that used the same frame in flight slot
+        uint64_t meshlet_triangles_drawn = 0;
+
+        // only with RendererInfo::occlusion_culling_, from the last frame that used the same frame in flight slot.
+        // Objects culled per meshlet are not counted, their meshlets are tested against the same pyramid
+        uint64_t occlusion_tested = 0; // objects tested against the frustum and the HiZ pyramid
+        uint64_t occlusion_culled = 0; // drawn in neither phase
+        uint64_t occlusion_redrawn = 0; // hidden last frame and drawn by the second phase
+        double occlusion_culled_fraction = 0.0; // occlusion_culled / occlusion_tested
+        // vertex shader invocations per triangle of the main pass, simulated for the post transform cache when the
+        // meshes were optimized. Compare with gpu_time against MeshStats::acmr_before to see what the reordering saves
+        double acmr = 0.0;
+
+        // GPU time between the start and the end of the frame's command buffer, from the last frame that used the same
+        // frame in flight slot. Compare RenderMode::FORWARD and RenderMode::DEFERRED with it as the light count grows,
+        // 0 if the device has no timestamps
+        std::chrono::nanoseconds gpu_time {0};
+
+        // key press to the presentKHR of the first frame drawn from the tick that handled it. The press is timed when
+        // GLFW reports it, the time the display takes after presentKHR is not included. Compare
+        // RendererInfo::frames_in_flight_ and present_mode_ with it, 0 until a key was pressed
+        std::chrono::nanoseconds input_latency {0};
+        std::chrono::nanoseconds input_latency_average {0};
+        uint64_t inputs_measured = 0;
+
+        // only with RendererInfo::count_fragments_, from the last frame that used the same frame in flight slot
+        uint64_t fragments_shaded = 0; // fragment shader invocations
+        double overdraw = 0.0; // fragments_shaded / pixels, 1 means every pixel was shaded once
+
+        // light clusters of the rendered frame
+        uint64_t lights = 0; // lights in the scene
+        uint64_t lights_packed = 0; // lights that can reach a visible object, the only ones in the light buffer
+        uint64_t light_bvh_nodes = 0;
+        uint64_t lights_uploaded = 0; // lights rewritten because they changed, 0 for a static lighting rig
+        uint64_t light_bytes_uploaded = 0;
+        uint64_t lights_clustered = 0; // lights with a radius that touch the view frustum
+        uint64_t cluster_indices = 0; // entries in the light index buffer
+        uint64_t max_lights_per_cluster = 0;
+        uint64_t cluster_overflow = 0; // light indices dropped because the index buffer was full
+        std::chrono::nanoseconds cluster_time {0}; // time spent assigning lights to clusters
+    };
+
+    /**
+     * @breif Items processed per second, 0 if no time was measured
+    */
+    inline double perSecond (
+        const uint64_t items,
+        const std::chrono::nanoseconds time
+    ) {
+        if (time.count() <= 0) return 0.0;
+        return static_cast<double>(items) / std::chrono::duration<double>(time).count();
+    }
+};
@@ -1,38 +1,160 @@
 #include "threedl.hpp"
 
+#include <algorithm>
 #include <thread>
 
 #include "objects.hpp"
+#include "simd.hpp"
 
 void tdl::ThreeDL::internalAnimation(
     const std::function<void()>& animation
 ) {
-    while (!glfwWindowShouldClose(info_.window_)) {
-        glfwPollEvents(); // Log all events, eg. key presses
+    const float delta = std::chrono::duration<float, std::chrono::milliseconds::period>(tick_).count();
+    const auto tick = std::chrono::duration_cast<std::chrono::steady_clock::duration>(tick_);
 
-        // get the current time to calculate a time delta
-        const auto time = std::chrono::high_resolution_clock::now();
-        const float delta = std::chrono::duration<float, std::chrono::milliseconds::period>(time - time_).count();
+    auto next = std::chrono::steady_clock::now() + tick;
 
-        if (delta < 1) continue; // this function runs at at most every millisecond
-
-        time_ = std::chrono::high_resolution_clock::now(); // update time this was last called
+    while (!glfwWindowShouldClose(info_.window_)) {
+        glfwPollEvents(); // Log all events, eg. key presses
 
-        for (const auto& obj : models_) {
-            obj->frameTick(); // load next frame for video textures
-        }
+        // load next frame for video textures, every model decodes its own videos
+        jobs_.parallelFor(models_.size(), 1, [this](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) models_[i]->frameTick();
+        });
 
         animation(); // call user defined animation function
 
         // control code only called if a camera controller was passed to setCamera()
         if (controlled_) {
-            ubo_mutex_.lock();
             controller_->tick(keys_, delta);
-            ubo_mutex_.unlock();
         }
+
+        publishSnapshot(); // hand the new state over to the renderer
+
+        // sleep instead of spinning until the next tick is due
+        std::this_thread::sleep_until(next);
+        next += tick;
+
+        // do not try to catch up after a long stall (eg. window being dragged), just continue from now
+        const auto now = std::chrono::steady_clock::now();
+        if (now > next + tick * 4) next = now + tick;
     }
 }
 
+void tdl::ThreeDL::publishSnapshot() {
+    TransformSnapshot& snapshot = snapshots_.back();
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // world matrices of every dirty model, level by level across the job system
+    const size_t updated = TransformArena::get().update(jobs_);
+
+    // same order as the renderer: all models first, then the models of the lights
+    std::vector<const Model*>& models = capture_models_;
+    models.clear();
+
+    for (const auto& model : models_) models.push_back(model.ptr_.get());
+    for (const auto& light : lights_) models.push_back(light->light_model_.ptr_.get());
+
+    // first flattened object of every model, so models can be captured independently
+    std::vector<size_t>& offsets = capture_offsets_;
+    offsets.resize(models.size());
+
+    size_t object_count = 0;
+    for (size_t i = 0; i < models.size(); ++i) {
+        offsets[i] = object_count;
+        object_count += models[i]->objects_.size();
+    }
+
+    // resize() keeps the capacity so no allocations happen after the first few ticks
+    snapshot.objects.resize(object_count);
+    snapshot.object_versions.resize(object_count);
+    snapshot.materials.resize(object_count);
+    snapshot.material_versions.resize(object_count);
+    snapshot.lights.resize(lights_.size());
+    snapshot.light_versions.resize(lights_.size());
+
+    jobs_.parallelFor(models.size(), 16, [&](const size_t begin, const size_t end) {
+        for (size_t model_idx = begin; model_idx < end; ++model_idx) {
+            const Model& model = *models[model_idx];
+
+            // already up to date after the arena update, this only reads the cached matrix
+            const glm::mat4 world = model.transform_.world();
+            const uint64_t model_version = model.transform_.version();
+
+            size_t object_idx = offsets[model_idx];
+
+            for (const auto& obj : model.objects_ | std::views::values) {
+                ObjectObject& data = snapshot.objects[object_idx];
+
+                data.mesh = obj->ubo_data_.mesh;
+                snapshot.materials[object_idx] = obj->mat_;
+                snapshot.material_versions[object_idx] = obj->version_;
+                simd::mul(world, obj->transform_.world(), data.model); // objects are roots so their world is local
+
+                // every counter only ever increases so the sum changes whenever the material or any transform does
+                snapshot.object_versions[object_idx] = obj->version_ + obj->transform_.version() + model_version;
+
+                ++object_idx;
+            }
+        }
+    });
+
+    const auto transform_time = std::chrono::steady_clock::now() - start;
+
+    // lights that did not change keep the data of their last export
+    for (size_t i = 0; i < lights_.size(); ++i) {
+        lights_[i]->exportIfChanged();
+        snapshot.lights[i] = lights_[i]->ubo_data_;
+        snapshot.light_versions[i] = lights_[i]->version_;
+    }
+
+    if (controlled_) {
+        snapshot.camera.proj = controller_->getProjectionMatrix();
+        snapshot.camera.camera = controller_->getCameraMatrix(); // camera translation
+        snapshot.camera.rotation = controller_->getRotationMatrix(); // camera rotation
+        snapshot.near_plane = controller_->getNearPlane();
+        snapshot.far_plane = controller_->getFarPlane();
+    } else {
+        snapshot.camera.proj = camera_->getProjectionMatrix();
+        snapshot.near_plane = camera_->getNearPlane();
+        snapshot.far_plane = camera_->getFarPlane();
+    }
+
+    // the key presses of this tick, the renderer measures from them to the first frame presented with them
+    if (input_ != std::chrono::steady_clock::time_point {}) {
+        last_input_ = input_;
+        input_ = {};
+    }
+    snapshot.input = last_input_;
+
+    snapshot.time = std::chrono::steady_clock::now();
+    snapshot.sequence = ++sequence_;
+
+    snapshots_.publish();
+
+    std::lock_guard lock (stats_mutex_);
+    stats_.transforms_updated = updated;
+    stats_.objects_captured = object_count;
+    stats_.transform_time = std::chrono::duration_cast<std::chrono::nanoseconds>(transform_time);
+    stats_.transforms_per_second = perSecond(updated + object_count, stats_.transform_time);
+}
+
+tdl::FrameStats tdl::ThreeDL::getStats() const {
+    std::lock_guard lock (stats_mutex_);
+    return stats_;
+}
+
+void tdl::ThreeDL::setTickRate(
+    const double hz
+) {
+    if (hz <= 0) {
+        throw std::invalid_argument("ERR 066: Tick rate has to be > 0. ThreeDL::setTickRate(...)");
+    }
+
+    tick_ = std::chrono::duration<double>(1.0 / hz);
+}
+
 void tdl::ThreeDL::openWindow() {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // no opengl
@@ -56,7 +178,7 @@ void tdl::ThreeDL::openWindow() {
 void tdl::ThreeDL::start(
     const std::function<void()>& animation
 ) {
-    app_ = std::make_unique<Vlkn>(&info_); // create vulkan helper
+    app_ = std::make_unique<Vlkn>(&info_, &jobs_); // create vulkan helper
 
     openWindow();
 
@@ -74,34 +196,48 @@ void tdl::ThreeDL::start(
     }
 
     for (const auto& light : lights_) {
-        light->exportGPU();
+        light->exportIfChanged();
         app_->add(light);
     }
 
     app_->init(); // initialse the vulkan helper
 
-    time_ = std::chrono::high_resolution_clock::now(); // set start time
+    // the renderer needs a complete snapshot before the first frame
+    publishSnapshot();
+    snapshots_.consume();
+
     // start thread that calls the animation function independetly of the loop below
     std::jthread user_thread (&tdl::ThreeDL::internalAnimation, this, animation);
 
     showWindow(); // now that everything has loaded the window can be shown
 
     while (!glfwWindowShouldClose(info_.window_)) {
-        if (controlled_) {
-            // stop animation thread making any modifications
-            ubo_mutex_.lock();
+        // pick up the latest snapshot without waiting for the simulation
+        if (snapshots_.pending()) {
+            if (interpolate_) previous_ = snapshots_.front();
+            snapshots_.consume();
+        }
+
+        const TransformSnapshot& latest = snapshots_.front();
 
-            ubo_.proj = controller_->getProjectionMatrix();
-            ubo_.camera = controller_->getCameraMatrix(); // camera translation
-            ubo_.rotation = controller_->getRotationMatrix(); // camera rotation
+        if (interpolate_) {
+            // draw one tick behind so there are always two ticks to blend between
+            const auto since = std::chrono::steady_clock::now() - latest.time;
+            const float alpha = std::clamp(static_cast<float>(since / tick_), 0.0f, 1.0f);
 
-            // allow modifications from a different thread
-            ubo_mutex_.unlock();
+            app_->newFrame(latest, &previous_, alpha);
         } else {
-            ubo_.proj = camera_->getProjectionMatrix();
+            app_->newFrame(latest, nullptr, 1.0f);
         }
 
-        app_->newFrame(ubo_); // draw render & the frame to the screen
+        FrameStats frame = app_->getStats(); // render counters, the simulation counters are kept
+
+        std::lock_guard lock (stats_mutex_);
+        frame.transforms_updated = stats_.transforms_updated;
+        frame.objects_captured = stats_.objects_captured;
+        frame.transform_time = stats_.transform_time;
+        frame.transforms_per_second = stats_.transforms_per_second;
+        stats_ = frame;
     }
 
     user_thread.request_stop();
@@ -121,6 +257,11 @@ void tdl::ThreeDL::onKey(
         glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
 
+    // GLFW does not time its events, the earliest is when glfwPollEvents() hands them over
+    if (action == GLFW_PRESS && instance->input_ == std::chrono::steady_clock::time_point {}) {
+        instance->input_ = std::chrono::steady_clock::now();
+    }
+
     // create a key map
     instance->keys_[key] = action != GLFW_RELEASE;
 }
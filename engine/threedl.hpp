@@ -4,10 +4,13 @@
 #include <memory>
 #include <unordered_map>
 #include <chrono>
-#include <mutex>
 #include <functional>
+#include <mutex>
 
 #include "camera.hpp"
+#include "jobs.hpp"
+#include "simulation.hpp"
+#include "stats.hpp"
 #include "vulkan/vulkan-utils.hpp"
 
 namespace tdl {
@@ -28,6 +31,18 @@ namespace tdl {
         public:
             ThreeDL() = default;
 
+            /**
+             * @breif Creates the engine with the given renderer settings
+             *
+             * Used to pick the render path, eg. info.render_mode_ = RenderMode::DEFERRED for scenes with many lights.
+             * The window is created from the size and title in info when start() is called.
+             *
+             * @param info renderer settings
+            */
+            explicit ThreeDL (
+                const RendererInfo& info
+            ) : info_ { info } {}
+
             /**
             * @breif Adds the given model to the render queue
             *
@@ -88,6 +103,49 @@ namespace tdl {
             );
             void start() { start([]{}); } // allow user to not pass an animation function
 
+            /**
+             * @breif Sets how many times per second the animation function and camera controller are ticked
+             *
+             * The simulation runs at a fixed rate independent of the frame rate, the renderer always draws the latest
+             * state published by the simulation.
+             *
+             * @param hz ticks per second
+            */
+            void setTickRate (
+                double hz
+            );
+
+            /**
+             * @breif Enables or disables interpolation between the two latest simulation ticks
+             *
+             * When enabled the renderer draws one tick behind and blends transforms so movement looks smooth at frame
+             * rates higher than the tick rate.
+             *
+             * @param enabled true to interpolate
+            */
+            void setInterpolation (
+                const bool enabled
+            ) { interpolate_ = enabled; }
+
+            /**
+             * @breif Gets the job system used by the engine
+             *
+             * Can be used to load models or run any other work on the engine's worker threads, eg.
+             * app.jobs().submit([&]{ model = tdl::make_model(path); });
+             *
+             * @return JobSystem&
+            */
+            JobSystem& jobs() { return jobs_; }
+
+            /**
+             * @breif Gets the counters of the last simulation tick and the last rendered frame
+             *
+             * Safe to call from the animation function while the engine is running.
+             *
+             * @return FrameStats copy of the counters
+            */
+            [[nodiscard]] FrameStats getStats() const;
+
             ~ThreeDL() {
                 glfwDestroyWindow(info_.window_);
                 glfwTerminate();
@@ -126,9 +184,10 @@ namespace tdl {
             );
 
             /**
-            * @breif Run repeatedly by the engine inside a seperate frame
+            * @breif Fixed timestep simulation loop run by the engine inside a seperate thread
             *
-            * Calls the user defined animation function inside
+            * Calls the user defined animation function once per tick, publishes a snapshot of the scene and then
+            * sleeps until the next tick is due.
             *
             * @param animation user defined animation function to call
             */
@@ -136,6 +195,13 @@ namespace tdl {
                 const std::function<void()>& animation
             );
 
+            /**
+             * @breif Copies every transform and light into the back slot of snapshots_ and publishes it
+             *
+             * Only called by the simulation thread (and once before it is started).
+            */
+            void publishSnapshot();
+
             /**
              * @breif Opens GLFW window based on params in info_
             */
@@ -149,6 +215,8 @@ namespace tdl {
 
             RendererInfo info_;
 
+            JobSystem jobs_; // declared before app_ so the workers outlive the renderer
+
             std::unique_ptr<Vlkn> app_ = nullptr;
 
             std::vector<shared_model<Model>> models_;
@@ -156,18 +224,26 @@ namespace tdl {
 
             std::unordered_map<int, bool> keys_;
 
-            std::mutex ubo_mutex_;
+            // first key press since the last snapshot and the last one a snapshot carried, only used by the simulation thread
+            std::chrono::steady_clock::time_point input_ {};
+            std::chrono::steady_clock::time_point last_input_ {};
 
             std::shared_ptr<tdl::CameraController> controller_ = nullptr;
             std::shared_ptr<tdl::Camera> camera_ = nullptr;
             bool controlled_ = false;
 
-            std::chrono::high_resolution_clock::time_point time_ = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> tick_ { 1.0 / 120.0 }; // time between simulation ticks
+            bool interpolate_ = true;
+
+            TripleBuffer<TransformSnapshot> snapshots_; // simulation -> renderer
+            TransformSnapshot previous_; // snapshot before the front one, owned by the render thread
+            uint64_t sequence_ = 0;
+
+            // reused by publishSnapshot() to avoid allocating every tick
+            std::vector<const Model*> capture_models_;
+            std::vector<size_t> capture_offsets_;
 
-            UniformBufferObject ubo_ = {
-                glm::mat4(1.0f),
-                glm::mat4(1.0f),
-                glm::mat4(1.0f)
-            };
+            mutable std::mutex stats_mutex_;
+            FrameStats stats_ {};
     };
 }
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "transform.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "simd.hpp"
+
+tdl::TransformArena& tdl::TransformArena::get() {
+    static TransformArena arena;
+    return arena;
+}
+
+size_t tdl::TransformArena::update(
+    JobSystem& jobs
+) {
+    std::lock_guard lock (mutex_); // no slots can be handed out while the blocks are walked
+
+    for (auto& level : levels_) level.clear();
+
+    // bucket dirty nodes by depth, a parent is always on a lower level than its children
+    const uint32_t count = count_.load(std::memory_order_acquire);
+    size_t total = 0;
+
+    for (uint32_t id = 0; id < count; ++id) {
+        Block& b = block(id);
+        const uint32_t slot = id % block_size;
+
+        if (!b.alive[slot] || !b.dirty[slot]) continue;
+
+        const uint32_t level = b.depth[slot];
+        if (level >= levels_.size()) levels_.resize(level + 1);
+
+        levels_[level].push_back(id);
+        ++total;
+    }
+
+    for (const auto& level : levels_) {
+        jobs.parallelFor(level.size(), 256, [this, &level](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) compose(level[i]);
+        });
+    }
+
+    return total;
+}
+
+uint32_t tdl::TransformArena::create() {
+    std::lock_guard lock (mutex_);
+
+    uint32_t id;
+    if (!free_.empty()) {
+        id = free_.back();
+        free_.pop_back();
+    } else {
+        id = count_.load(std::memory_order_relaxed);
+
+        if (id / block_size >= max_blocks) {
+            throw std::runtime_error("ERR 068: Too many transforms. TransformArena::create(...)");
+        }
+
+        if (blocks_[id / block_size] == nullptr) blocks_[id / block_size] = std::make_unique<Block>();
+    }
+
+    translation(id) = glm::mat4(1.0f);
+    rotation(id) = glm::mat4(1.0f);
+    world(id) = glm::mat4(1.0f);
+    parent(id) = none;
+    depth(id) = 0;
+    version(id) = 1;
+    dirty(id) = 1;
+    children(id).clear();
+    block(id).alive[id % block_size] = 1;
+
+    // published after the slot is initialised so update() never sees a half written node
+    if (id == count_.load(std::memory_order_relaxed)) count_.store(id + 1, std::memory_order_release);
+
+    return id;
+}
+
+void tdl::TransformArena::release(
+    const uint32_t id
+) {
+    std::lock_guard lock (mutex_);
+
+    block(id).alive[id % block_size] = 0;
+    free_.push_back(id);
+}
+
+void tdl::TransformArena::compose(
+    const uint32_t id
+) {
+    Block& b = block(id);
+    const uint32_t slot = id % block_size;
+
+    const uint32_t p = b.parent[slot];
+
+    if (p == none) {
+        simd::mul(b.translation[slot], b.rotation[slot], b.world[slot]);
+    } else {
+        const glm::mat4 local = simd::mul(b.translation[slot], b.rotation[slot]);
+        simd::mul(world(p), local, b.world[slot]);
+    }
+
+    b.dirty[slot] = 0;
+}
+
+void tdl::TransformArena::markDirty(
+    const uint32_t id
+) {
+    ++version(id);
+
+    // descendants of a dirty node are always dirty themselves so the walk can stop here
+    if (dirty(id)) return;
+    dirty(id) = 1;
+
+    for (const uint32_t child : children(id)) markDirty(child);
+}
+
+void tdl::TransformArena::updateDepth(
+    const uint32_t id
+) {
+    const uint32_t p = parent(id);
+    depth(id) = p == none ? 0 : depth(p) + 1;
+
+    for (const uint32_t child : children(id)) updateDepth(child);
+}
+
+tdl::Transform::Transform() : id_ { TransformArena::get().create() } {}
+
+tdl::Transform::Transform(
+    const Transform& other
+) : id_ { TransformArena::get().create() } {
+    TransformArena& arena = TransformArena::get();
+
+    arena.translation(id_) = arena.translation(other.id_);
+    arena.rotation(id_) = arena.rotation(other.id_);
+}
+
+tdl::Transform& tdl::Transform::operator=(
+    const Transform& other
+) {
+    if (this == &other) return *this;
+
+    TransformArena& arena = TransformArena::get();
+
+    // links stay untouched, only the local transform is taken over
+    arena.translation(id_) = arena.translation(other.id_);
+    arena.rotation(id_) = arena.rotation(other.id_);
+    arena.markDirty(id_);
+
+    return *this;
+}
+
+void tdl::Transform::setParent(
+    const Transform* const parent
+) {
+    TransformArena& arena = TransformArena::get();
+
+    const uint32_t new_parent = parent != nullptr ? parent->id_ : TransformArena::none;
+    const uint32_t old_parent = arena.parent(id_);
+
+    if (new_parent == old_parent) return;
+
+    // walk up from the new parent to make sure this node is not one of its ancestors
+    for (uint32_t current = new_parent; current != TransformArena::none; current = arena.parent(current)) {
+        if (current == id_) {
+            throw std::runtime_error("ERR 067: Transform can not be parented to itself or a child. Transform::setParent(...)");
+        }
+    }
+
+    if (old_parent != TransformArena::none) std::erase(arena.children(old_parent), id_);
+
+    arena.parent(id_) = new_parent;
+    if (new_parent != TransformArena::none) arena.children(new_parent).push_back(id_);
+
+    arena.updateDepth(id_);
+    arena.markDirty(id_);
+}
+
+void tdl::Transform::rotate(
+    const glm::vec3& angles,
+    const glm::vec3& centre
+) {
+    TransformArena& arena = TransformArena::get();
+    glm::mat4& rotation = arena.rotation(id_);
+
+    // rotate around a given centre by translating it and then rotating it
+    rotation = glm::translate(rotation, centre);
+    rotation = glm::rotate(rotation, angles.x, {1, 0, 0});
+    rotation = glm::rotate(rotation, angles.y, {0, 1, 0});
+    rotation = glm::rotate(rotation, angles.z, {0, 0, 1});
+    rotation = glm::translate(rotation, -centre);
+
+    arena.markDirty(id_);
+}
+
+void tdl::Transform::translate(
+    const glm::vec3& val
+) {
+    TransformArena& arena = TransformArena::get();
+
+    // only the last column changes, no need for a full matrix multiply
+    glm::mat4& translation = arena.translation(id_);
+    translation[3] += translation[0] * val.x + translation[1] * val.y + translation[2] * val.z;
+
+    arena.markDirty(id_);
+}
+
+glm::mat4 tdl::Transform::getTranslation() const {
+    return TransformArena::get().translation(id_);
+}
+
+glm::mat4 tdl::Transform::getRotation() const {
+    return TransformArena::get().rotation(id_);
+}
+
+glm::mat4 tdl::Transform::local() const {
+    TransformArena& arena = TransformArena::get();
+    return simd::mul(arena.translation(id_), arena.rotation(id_));
+}
+
+glm::mat4 tdl::Transform::world() const {
+    TransformArena& arena = TransformArena::get();
+
+    if (arena.dirty(id_)) {
+        // ancestors of a clean node are always clean, so find the highest dirty one and compose down from there
+        std::vector<uint32_t> chain;
+        for (uint32_t current = id_; current != TransformArena::none && arena.dirty(current); current = arena.parent(current)) {
+            chain.push_back(current);
+        }
+
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) arena.compose(*it);
+    }
+
+    return arena.world(id_);
+}
+
+uint64_t tdl::Transform::version() const {
+    return TransformArena::get().version(id_);
+}
+
+tdl::Transform::~Transform() {
+    TransformArena& arena = TransformArena::get();
+
+    if (const uint32_t p = arena.parent(id_); p != TransformArena::none) std::erase(arena.children(p), id_);
+
+    // children become roots and keep their local transform
+    for (const uint32_t child : arena.children(id_)) {
+        arena.parent(child) = TransformArena::none;
+        arena.updateDepth(child);
+        arena.markDirty(child);
+    }
+
+    arena.children(id_).clear();
+    arena.release(id_);
+}
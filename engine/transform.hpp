@@ -0,0 +1,206 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "jobs.hpp"
+
+namespace tdl {
+    /**
+     * @breif Structure of arrays storage for every Transform node
+     *
+     * Nodes are stored in fixed size blocks so their data never moves, a block stores each field of its nodes in a
+     * separate array which keeps the world matrix update streaming through memory. Blocks are only ever added, slots of
+     * destroyed nodes are reused.
+     *
+     * Creating and destroying unlinked nodes is thread safe (eg. loading a model inside a job), everything else
+     * (changing, linking, reading and updating nodes) has to happen on one thread at a time, in ThreeDL this is the
+     * simulation thread.
+    */
+    class TransformArena {
+        friend class Transform;
+
+        public:
+            static constexpr uint32_t none = UINT32_MAX; // parent index of root nodes
+
+            /**
+             * @breif Arena shared by every Transform
+            */
+            static TransformArena& get();
+
+            /**
+             * @breif Recomputes the world matrix of every dirty node
+             *
+             * Dirty nodes are grouped by their depth in the hierarchy, all nodes of one depth only depend on the level
+             * above them so every level is spread over the job system.
+             *
+             * @param jobs job system used to update the nodes of a level in parallel
+             * @return size_t number of world matrices that were recomputed
+            */
+            size_t update (
+                JobSystem& jobs
+            );
+
+            TransformArena(const TransformArena&) = delete;
+            TransformArena& operator=(const TransformArena&) = delete;
+
+        private:
+            static constexpr uint32_t block_size = 1024;
+            static constexpr uint32_t max_blocks = 1024; // fixed so blocks can be looked up without locking
+
+            struct Block {
+                std::array<glm::mat4, block_size> translation;
+                std::array<glm::mat4, block_size> rotation;
+                std::array<glm::mat4, block_size> world;
+                std::array<uint32_t, block_size> parent;
+                std::array<uint32_t, block_size> depth;
+                std::array<uint64_t, block_size> version;
+                std::array<uint8_t, block_size> dirty;
+                std::array<uint8_t, block_size> alive;
+                std::array<std::vector<uint32_t>, block_size> children;
+            };
+
+            TransformArena() = default;
+
+            /**
+             * @breif Takes a free slot and initialises it as a root node with an identity transform
+             *
+             * @return uint32_t index of the node
+            */
+            uint32_t create();
+
+            /**
+             * @breif Returns the slot to the arena, links to the node have to be removed first
+            */
+            void release (
+                uint32_t id
+            );
+
+            Block& block(const uint32_t id) { return *blocks_[id / block_size]; }
+
+            glm::mat4& translation(const uint32_t id) { return block(id).translation[id % block_size]; }
+            glm::mat4& rotation(const uint32_t id) { return block(id).rotation[id % block_size]; }
+            glm::mat4& world(const uint32_t id) { return block(id).world[id % block_size]; }
+            uint32_t& parent(const uint32_t id) { return block(id).parent[id % block_size]; }
+            uint32_t& depth(const uint32_t id) { return block(id).depth[id % block_size]; }
+            uint64_t& version(const uint32_t id) { return block(id).version[id % block_size]; }
+            uint8_t& dirty(const uint32_t id) { return block(id).dirty[id % block_size]; }
+            std::vector<uint32_t>& children(const uint32_t id) { return block(id).children[id % block_size]; }
+
+            /**
+             * @breif Composes parent world * translation * rotation of a single node
+             *
+             * The parent has to be up to date already.
+            */
+            void compose (
+                uint32_t id
+            );
+
+            /**
+             * @breif Marks the node and its descendants as dirty and increments their versions
+            */
+            void markDirty (
+                uint32_t id
+            );
+
+            /**
+             * @breif Sets the depth of every descendant of the node after it was moved in the hierarchy
+            */
+            void updateDepth (
+                uint32_t id
+            );
+
+            std::array<std::unique_ptr<Block>, max_blocks> blocks_;
+            std::atomic<uint32_t> count_ { 0 }; // slots handed out so far (live + free)
+            std::vector<uint32_t> free_;
+            std::mutex mutex_; // guards create() and release()
+
+            std::vector<std::vector<uint32_t>> levels_; // dirty nodes per depth, kept to reuse the allocations
+    };
+
+    /**
+     * @breif Node of the scene graph, stores a local transform and caches the world transform
+     *
+     * The local transform is translation * rotation (same order the shaders used to apply them). Changing a node marks
+     * it and all of its descendants dirty, the world matrix of a dirty node is recomputed by TransformArena::update()
+     * or the next time it is read. Every change also increments the version of the node and its descendants so users
+     * of the world matrix can tell when it has to be read again.
+     *
+     * The data itself lives in the TransformArena, a Transform is only a handle to its slot. Copying a node only copies
+     * the local transform, the copy is a root without children.
+    */
+    class Transform {
+        public:
+            Transform();
+
+            Transform (
+                const Transform& other
+            );
+
+            Transform& operator= (
+                const Transform& other
+            );
+
+            /**
+             * @breif Attaches the node to a new parent, nullptr makes it a root
+             *
+             * The local transform is kept, so the node moves along with its new parent. Trying to attach a node to
+             * itself or to one of its descendants results in a std::runtime_error.
+             *
+             * @param parent new parent node
+            */
+            void setParent (
+                const Transform* parent
+            );
+
+            /**
+             * @breif Rotates the node around a given point (in local space)
+             *
+             * @param angles XYZ euler angles to rotate by
+             * @param centre centre of rotation
+            */
+            void rotate (
+                const glm::vec3& angles,
+                const glm::vec3& centre
+            );
+
+            /**
+             * @breif Translates the node by the given amount of units in the XYZ directions
+             *
+             * @param val XYZ values of translation
+            */
+            void translate (
+                const glm::vec3& val
+            );
+
+            [[nodiscard]] glm::mat4 getTranslation() const;
+            [[nodiscard]] glm::mat4 getRotation() const;
+            [[nodiscard]] glm::mat4 local() const;
+
+            /**
+             * @breif Gets the world matrix (parent world * local), recomputing it only if the node is dirty
+             *
+             * @return glm::mat4 world matrix
+            */
+            [[nodiscard]] glm::mat4 world() const;
+
+            /**
+             * @breif Version of the world matrix, changes whenever the node or one of its ancestors changes
+            */
+            [[nodiscard]] uint64_t version() const;
+
+            [[nodiscard]] uint32_t id() const { return id_; }
+
+            ~Transform();
+
+        private:
+            uint32_t id_;
+    };
+};
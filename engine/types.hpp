@@ -15,4 +15,11 @@ namespace tdl {
         Video,
         Image
     };
+
+    enum class LightingModels : int {
+        LAMBERT = 0,
+        BLINNPHONG = 1,
+        PHONG = 2,
+        PER_LIGHT = 3 // only for materials, every light is shaded with its own model
+    };
 };
\ No newline at end of file
@@ -1,4 +1,63 @@
 #include "buffers.hpp"
+#include "deletion.hpp"
+#include "uploads.hpp"
+
+#include <utility>
+
+namespace {
+    /**
+     * @breif Stages and accesses of an image in a layout, the writes for a source layout and every access for a target
+    */
+    std::pair<vk::PipelineStageFlags, vk::AccessFlags> layoutAccess(
+        const vk::ImageLayout layout
+    ) {
+        switch (layout) {
+            case vk::ImageLayout::eUndefined:
+            case vk::ImageLayout::ePreinitialized:
+                return {vk::PipelineStageFlagBits::eTopOfPipe, {}};
+            case vk::ImageLayout::eTransferDstOptimal:
+                return {vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite};
+            case vk::ImageLayout::eTransferSrcOptimal:
+                return {vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead};
+            case vk::ImageLayout::eShaderReadOnlyOptimal:
+                return {
+                    vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+                    vk::AccessFlagBits::eShaderRead
+                };
+            case vk::ImageLayout::eGeneral:
+                return {
+                    vk::PipelineStageFlagBits::eComputeShader,
+                    vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite
+                };
+            case vk::ImageLayout::eColorAttachmentOptimal:
+                return {
+                    vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                    vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite
+                };
+            case vk::ImageLayout::eDepthStencilAttachmentOptimal:
+                return {
+                    vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+                    vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite
+                };
+            case vk::ImageLayout::eDepthStencilReadOnlyOptimal:
+                return {
+                    vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eFragmentShader,
+                    vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eShaderRead
+                };
+            case vk::ImageLayout::ePresentSrcKHR:
+                return {vk::PipelineStageFlagBits::eBottomOfPipe, {}};
+            default:
+                throw std::invalid_argument("ERR 003: Unsupported layout transition! tdl::Image::setImageLayout(...)\n");
+        }
+    }
+
+    bool isDepthLayout(
+        const vk::ImageLayout layout
+    ) {
+        return layout == vk::ImageLayout::eDepthStencilAttachmentOptimal ||
+            layout == vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+    }
+}
 
 vk::CommandBuffer tdl::CommandBuffer::begin(
     const vk::Device device,
@@ -90,9 +149,6 @@ void tdl::Image::setImageLayout(
 ) {
     const vk::CommandBuffer command_buffer = CommandBuffer::begin(device, command_pool);
 
-    vk::PipelineStageFlags src;
-    vk::PipelineStageFlags dst;
-
     vk::ImageMemoryBarrier barrier {
             {},
             {},
@@ -102,7 +158,7 @@ void tdl::Image::setImageLayout(
             vk::QueueFamilyIgnored,
             image,
             vk::ImageSubresourceRange {
-                vk::ImageAspectFlagBits::eColor,
+                isDepthLayout(old_layout) || isDepthLayout(new_layout) ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor,
                 0,
                 1,
                 0,
@@ -110,28 +166,12 @@ void tdl::Image::setImageLayout(
             }
     };
 
-    // auto detect pipeline flags & access masks
-    if (
-        old_layout == vk::ImageLayout::eUndefined &&
-        new_layout == vk::ImageLayout::eTransferDstOptimal
-    ) {
-        barrier.srcAccessMask = {};
-        barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-
-        src = vk::PipelineStageFlagBits::eTopOfPipe;
-        dst = vk::PipelineStageFlagBits::eTransfer;
-    } else if (
-        old_layout == vk::ImageLayout::eTransferDstOptimal &&
-        new_layout == vk::ImageLayout::eShaderReadOnlyOptimal
-    ) {
-        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    // auto detect pipeline flags & access masks, the old layout says what has to be finished, the new one what waits
+    const auto [src, src_access] = layoutAccess(old_layout);
+    const auto [dst, dst_access] = layoutAccess(new_layout);
 
-        src = vk::PipelineStageFlagBits::eTransfer;
-        dst = vk::PipelineStageFlagBits::eFragmentShader;
-    } else {
-        throw std::invalid_argument("ERR 003: Unsupported layout transition! tdl::Image::setImageLayout(...)\n");
-    }
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
 
     // change image layout
     command_buffer.pipelineBarrier(
@@ -156,15 +196,32 @@ void tdl::Image::loadImage(
     const vk::Device device,
     const vk::CommandPool command_pool,
     const vk::Queue graphics_queue,
-    const vk::PhysicalDevice p_device
+    const vk::PhysicalDevice p_device,
+    const vk::Format format
 ) {
     device_ = device;
     physical_device_ = p_device;
+    format_ = format;
+
+    // release the image incase it has already been allocated to avoid memory leaks, frames in flight may still read it
+    if (deletions_ != nullptr) {
+        deletions_->push(buffer_);
+        deletions_->push(image_view_);
+        deletions_->push(image_);
+        deletions_->push(image_memory_);
+    } else {
+        delete buffer_;
+        device_.destroyImageView(image_view_);
+        device_.destroyImage(image_);
+        device_.freeMemory(image_memory_);
+    }
 
-    device_.destroyImage(image_); // destroy image incase it has already been allocated to avoid memory leaks
+    buffer_ = nullptr;
+    image_view_ = nullptr;
+    image_ = nullptr;
+    image_memory_ = nullptr;
 
-    // * 4 as there are 4 bytes per pixel (RGBA)
-    const vk::DeviceSize image_size = width * height * 4;
+    const vk::DeviceSize image_size = width * height * texelSize(format_);
 
     // buffer to hold image data
     buffer_ = new MemoryBuffer {
@@ -181,7 +238,7 @@ void tdl::Image::loadImage(
     const vk::ImageCreateInfo image_info {
         {},
         vk::ImageType::e2D,
-        vk::Format::eR8G8B8A8Srgb,
+        format_,
         vk::Extent3D {
             static_cast<uint32_t>(width),
             static_cast<uint32_t>(height),
@@ -211,7 +268,7 @@ void tdl::Image::loadImage(
     const vk::MemoryRequirements mem_reqs = device.getImageMemoryRequirements(image_);
 
     const vk::MemoryAllocateInfo alloc_info {
-        image_size,
+        mem_reqs.size,
         tdl::MemoryBuffer::findMemoryType(
             p_device,
             mem_reqs.memoryTypeBits,
@@ -229,31 +286,36 @@ void tdl::Image::loadImage(
     image_memory_ = device.allocateMemory(alloc_info);
     device.bindImageMemory(image_, image_memory_, 0);
 
-    setImageLayout(
-        image_,
-        vk::ImageLayout::eUndefined,
-        vk::ImageLayout::eTransferDstOptimal,
-        device,
-        command_pool,
-        graphics_queue
-    );
+    if (uploads_ != nullptr) {
+        // copied with the rest of the scene, buffer_ lives as long as the image
+        uploads_->loadImage(buffer_->getBuffer(), image_, width, height, image_size);
+    } else {
+        setImageLayout(
+            image_,
+            vk::ImageLayout::eUndefined,
+            vk::ImageLayout::eTransferDstOptimal,
+            device,
+            command_pool,
+            graphics_queue
+        );
 
-    buffer_->asImage(image_, width, height); // save contents of memory buffer as a vk::Image
+        buffer_->asImage(image_, width, height); // save contents of memory buffer as a vk::Image
 
-    setImageLayout(
-        image_,
-        vk::ImageLayout::eTransferDstOptimal,
-        vk::ImageLayout::eShaderReadOnlyOptimal,
-        device,
-        command_pool,
-        graphics_queue
-    );
+        setImageLayout(
+            image_,
+            vk::ImageLayout::eTransferDstOptimal,
+            vk::ImageLayout::eShaderReadOnlyOptimal,
+            device,
+            command_pool,
+            graphics_queue
+        );
+    }
 
     const vk::ImageViewCreateInfo view_info {
             {},
             image_,
             vk::ImageViewType::e2D,
-            vk::Format::eR8G8B8A8Srgb,
+            format_,
             {},
             vk::ImageSubresourceRange {
                 vk::ImageAspectFlagBits::eColor,
@@ -274,6 +336,20 @@ void tdl::Image::loadImage(
     }
 }
 
+vk::DeviceSize tdl::Image::texelSize(
+    const vk::Format format
+) {
+    switch (format) {
+        case vk::Format::eR8G8B8A8Srgb:
+        case vk::Format::eR8G8B8A8Unorm:
+            return 4; // RGBA
+        case vk::Format::eR8Unorm:
+            return 1; // single plane of a YUV frame
+        default:
+            throw std::invalid_argument("ERR 065: Unsupported image format! tdl::Image::texelSize(...)\n");
+    }
+}
+
 void tdl::Image::recreateImageView(
     const vk::Device device
 ) {
@@ -283,7 +359,7 @@ void tdl::Image::recreateImageView(
         {},
         image_,
         vk::ImageViewType::e2D,
-        vk::Format::eR8G8B8A8Srgb,
+        format_,
         {},
         vk::ImageSubresourceRange {
             vk::ImageAspectFlagBits::eColor,
@@ -304,72 +380,6 @@ void tdl::Image::recreateImageView(
     }
 }
 
-void tdl::Image::createDescriptor(
-    const vk::DescriptorSetLayout layout,
-    const vk::DescriptorPool descriptor_pool
-) {
-    const vk::DescriptorSetAllocateInfo alloc_info {
-        descriptor_pool,
-        1,
-        &layout
-    };
-
-    try {
-        descriptor_set_ = device_.allocateDescriptorSets(alloc_info)[0];
-    } catch (const vk::SystemError& e) {
-        throw std::runtime_error(
-            "ERR 009: Failed to allocate descriptor set! tdl::Image::createDescriptor(...)"
-            + std::string(e.what())
-        );
-    }
-}
-
-void tdl::Image::updateDescriptor() const {
-    const vk::DescriptorImageInfo image_info {
-        sampler_,
-        image_view_,
-        vk::ImageLayout::eShaderReadOnlyOptimal
-    };
-
-   const vk::WriteDescriptorSet descriptor_write {
-        descriptor_set_,
-        0,
-        0,
-        1,
-        vk::DescriptorType::eCombinedImageSampler,
-        &image_info,
-        nullptr,
-        nullptr
-    };
-
-    try {
-        device_.updateDescriptorSets(
-            1, &descriptor_write,
-            0, nullptr
-        );
-    } catch (const vk::SystemError& e) {
-        throw std::runtime_error(
-            "ERR 010: Failed to update descriptor set! tdl::Image::updateDescriptor(...)"
-            + std::string(e.what())
-        );
-    }
-}
-
-void tdl::Image::render(
-    const vk::CommandBuffer command_buffer,
-    const vk::PipelineLayout pipeline_layout
-) const {
-    command_buffer.bindDescriptorSets(
-        vk::PipelineBindPoint::eGraphics,
-        pipeline_layout,
-        1,
-        1,
-        &descriptor_set_,
-        0,
-        nullptr
-    );
-}
-
 void tdl::Image::setDevice(
     const vk::Device device
 ) { device_ = device; }
@@ -394,6 +404,11 @@ void tdl::MemoryBuffer::set(
     const void* const data,
     const vk::DeviceSize buffer_size
 ) const {
+    if (mapped_ != nullptr) {
+        memcpy(mapped_, data, buffer_size);
+        return;
+    }
+
     try {
         void* mapped = device_.mapMemory(memory_, 0, buffer_size);
         memcpy(mapped, data, buffer_size);
@@ -406,6 +421,21 @@ void tdl::MemoryBuffer::set(
     }
 }
 
+void* tdl::MemoryBuffer::map() {
+    if (mapped_ != nullptr) return mapped_;
+
+    try {
+        mapped_ = device_.mapMemory(memory_, 0, VK_WHOLE_SIZE);
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 069: Failed to persistently map buffer. tdl::MemoryBuffer::map(...)\n"
+            + err.code().message()
+        );
+    }
+
+    return mapped_;
+}
+
 void tdl::MemoryBuffer::copy(
     const MemoryBuffer& source,
     const vk::DeviceSize size
@@ -10,10 +10,17 @@
 #include <vulkan/vulkan.hpp>
 
 namespace tdl {
+    class DeletionQueue;
+    class UploadQueue;
+
     /**
      * @breif Helper functions to create a vk::CommandBuffer.
      *
      * CommandBuffer provides static methods to create and end a command buffer.
+     *
+     * end() submits to the graphics queue and waits for it to go idle, so it is only used while the renderer is set up
+     * (and while the swapchain is recreated, when the device is idle anyway). The meshes and textures of the scene and
+     * the video frames go through the UploadQueue instead.
     */
     class CommandBuffer {
         public:
@@ -64,6 +71,21 @@ namespace tdl {
                 vk::DeviceSize buffer_size
             ) const;
 
+            /**
+             * @breif Maps the whole buffer and keeps it mapped until the buffer is destroyed
+             *
+             * Only valid for host visible memory. Once mapped set() copies straight into the mapping and data() can be
+             * used to write into the buffer without any extra copies.
+             *
+             * @return void* pointer to the start of the buffer
+            */
+            void* map();
+
+            /**
+             * @breif Pointer to the persistently mapped memory, nullptr if map() has not been called
+            */
+            [[nodiscard]] void* data() const { return mapped_; }
+
             void copy (
                 const MemoryBuffer& source,
                 vk::DeviceSize size
@@ -100,6 +122,8 @@ namespace tdl {
             }
 
             ~MemoryBuffer() {
+                if (mapped_ != nullptr) device_.unmapMemory(memory_);
+
                 device_.destroyBuffer(buffer_);
                 device_.freeMemory(memory_);
             }
@@ -111,6 +135,7 @@ namespace tdl {
             vk::CommandPool command_pool_;
             vk::Buffer buffer_;
             vk::DeviceMemory memory_;
+            void* mapped_ = nullptr;
 
             void createBuffer (
                 vk::DeviceSize size,
@@ -122,8 +147,8 @@ namespace tdl {
     /**
      * @breif Helper class for vulkan image allocation
      *
-     * Loads a unsigned char* into an image and creates an image view for it. Helper methods can be subsequently used
-     * to create a sampler and bind them to a given command buffer.
+     * Loads a unsigned char* into an image and creates an image view for it. The view is read by the shaders through
+     * the TextureTable, the image does not own a descriptor set.
     */
     class Image {
         public:
@@ -156,25 +181,26 @@ namespace tdl {
                 vk::Device device,
                 vk::CommandPool command_pool,
                 vk::Queue graphics_queue,
-                vk::PhysicalDevice p_device
+                vk::PhysicalDevice p_device,
+                vk::Format format = vk::Format::eR8G8B8A8Srgb
             );
 
-            void createDescriptor (
-                vk::DescriptorSetLayout layout,
-                vk::DescriptorPool descriptor_pool
+            /**
+             * @breif Number of bytes a single texel of the given format takes up
+             *
+             * Only the formats used by the engine are supported (RGBA8 and single channel R8 planes).
+             *
+             * @param format format of the image
+             * @return size of one texel in bytes
+            */
+            static vk::DeviceSize texelSize (
+                vk::Format format
             );
 
             void recreateImageView (
                 vk::Device device
             );
 
-            void updateDescriptor() const;
-
-            void render (
-                vk::CommandBuffer command_buffer,
-                vk::PipelineLayout pipeline_layout
-            ) const;
-
             void setSampler(
                 const vk::Sampler sampler
             ) { sampler_ = sampler; };
@@ -183,6 +209,24 @@ namespace tdl {
                 vk::Device device
             );
 
+            /**
+             * @breif Queue the resources of a loaded image go to when loadImage() replaces them
+             *
+             * Without one they are destroyed straight away, which is only safe if no frame in flight samples the image.
+            */
+            void setDeletionQueue (
+                DeletionQueue* const deletions
+            ) { deletions_ = deletions; }
+
+            /**
+             * @breif Queue loadImage() records its copy into, the image can only be sampled after UploadQueue::flush()
+             *
+             * Without one loadImage() copies on the graphics queue and waits for it.
+            */
+            void setUploadQueue (
+                UploadQueue* const uploads
+            ) { uploads_ = uploads; }
+
             ~Image();
 
             MemoryBuffer* buffer_ = nullptr;
@@ -194,6 +238,8 @@ namespace tdl {
             vk::PhysicalDevice physical_device_;
             vk::DeviceMemory image_memory_;
             vk::Sampler sampler_;
-            vk::DescriptorSet descriptor_set_;
+            DeletionQueue* deletions_ = nullptr;
+            UploadQueue* uploads_ = nullptr;
+            vk::Format format_ = vk::Format::eR8G8B8A8Srgb;
     };
 };
\ No newline at end of file
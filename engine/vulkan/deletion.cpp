@@ -0,0 +1,79 @@
+#include "deletion.hpp"
+
+void tdl::DeletionQueue::init(
+    const vk::Device device
+) {
+    device_ = device;
+}
+
+void tdl::DeletionQueue::push(
+    MemoryBuffer* const buffer
+) {
+    if (buffer == nullptr) return;
+    push([buffer] { delete buffer; });
+}
+
+void tdl::DeletionQueue::push(
+    const vk::Image image
+) {
+    if (!image) return;
+    push([device = device_, image] { device.destroyImage(image); });
+}
+
+void tdl::DeletionQueue::push(
+    const vk::ImageView view
+) {
+    if (!view) return;
+    push([device = device_, view] { device.destroyImageView(view); });
+}
+
+void tdl::DeletionQueue::push(
+    const vk::DeviceMemory memory
+) {
+    if (!memory) return;
+    push([device = device_, memory] { device.freeMemory(memory); });
+}
+
+void tdl::DeletionQueue::push(
+    const vk::Framebuffer framebuffer
+) {
+    if (!framebuffer) return;
+    push([device = device_, framebuffer] { device.destroyFramebuffer(framebuffer); });
+}
+
+void tdl::DeletionQueue::push(
+    const vk::DescriptorPool pool
+) {
+    if (!pool) return;
+    push([device = device_, pool] { device.destroyDescriptorPool(pool); });
+}
+
+uint64_t tdl::DeletionQueue::submit() {
+    return ++submitted_;
+}
+
+void tdl::DeletionQueue::collect(
+    const uint64_t completed
+) {
+    while (!entries_.empty() && entries_.front().frame <= completed) {
+        entries_.front().release();
+        entries_.pop_front();
+        ++released_;
+    }
+}
+
+void tdl::DeletionQueue::flush() {
+    collect(UINT64_MAX);
+}
+
+void tdl::DeletionQueue::push(
+    std::function<void()> release
+) {
+    // the frame being recorded may already use the resource, it is the next one submitted
+    entries_.push_back({submitted_ + 1, std::move(release)});
+}
+
+void tdl::DeletionQueue::destroy() {
+    flush();
+    device_ = nullptr;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include <vulkan/vulkan.hpp>
+
+#include "buffers.hpp"
+
+namespace tdl {
+    /**
+     * @breif Destroys resources once the GPU is done with every frame that could have used them
+     *
+     * Works like a timeline semaphore on top of the frame fences (Vulkan 1.0 has no timeline semaphores): every frame
+     * submitted to the graphics queue gets the next value of a counter, and once a frame's fence was waited on, that
+     * value and every value before it are done since the queue finishes its submissions in order. A resource pushed
+     * while a frame is recorded is tagged with the value of that frame and released by the first collect() that
+     * reaches it, so it can be replaced without waitIdle.
+     *
+     * Not thread safe, resources are pushed from the render thread.
+    */
+    class DeletionQueue {
+        public:
+            void init (
+                vk::Device device
+            );
+
+            void push (
+                MemoryBuffer* buffer // deleted, the queue takes ownership
+            );
+
+            void push (
+                vk::Image image
+            );
+
+            void push (
+                vk::ImageView view
+            );
+
+            void push (
+                vk::DeviceMemory memory
+            );
+
+            void push (
+                vk::Framebuffer framebuffer
+            );
+
+            // the sets allocated from it are freed with it
+            void push (
+                vk::DescriptorPool pool
+            );
+
+            /**
+             * @breif Moves the timeline to the frame being submitted
+             *
+             * @return uint64_t value the frame's fence stands for, collect() is called with it once it was waited on
+            */
+            uint64_t submit();
+
+            /**
+             * @breif Releases everything tagged with a frame up to completed
+             *
+             * @param completed value returned by submit() for a frame whose fence was waited on
+            */
+            void collect (
+                uint64_t completed
+            );
+
+            void flush(); // releases everything, the device has to be idle
+
+            [[nodiscard]] uint64_t pending() const { return entries_.size(); }
+            [[nodiscard]] uint64_t released() const { return released_; } // since the queue was created
+
+            void destroy();
+
+        private:
+            struct Entry {
+                uint64_t frame; // last frame that could have used the resource
+                std::function<void()> release;
+            };
+
+            void push (
+                std::function<void()> release
+            );
+
+            vk::Device device_;
+
+            std::deque<Entry> entries_; // frames only go up, the oldest entries are at the front
+            uint64_t submitted_ = 0; // value of the last frame submitted
+            uint64_t released_ = 0;
+    };
+};
@@ -0,0 +1,161 @@
+#include "descriptors.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+void tdl::DescriptorAllocator::init(
+    const vk::Device device,
+    const unsigned int frames
+) {
+    device_ = device;
+    frames_.resize(frames);
+}
+
+vk::DescriptorSet tdl::DescriptorAllocator::allocate(
+    const vk::DescriptorSetLayout layout
+) {
+    ++sets_;
+    return allocate(persistent_, layout);
+}
+
+std::vector<vk::DescriptorSet> tdl::DescriptorAllocator::allocate(
+    const vk::DescriptorSetLayout layout,
+    const uint32_t count
+) {
+    // one at a time, the sets do not have to come from the same pool
+    std::vector<vk::DescriptorSet> sets (count);
+    for (auto& set : sets) set = allocate(layout);
+
+    return sets;
+}
+
+vk::DescriptorSet tdl::DescriptorAllocator::allocateTransient(
+    const vk::DescriptorSetLayout layout,
+    const size_t frame
+) {
+    ++transient_sets_;
+    return allocate(frames_[frame], layout);
+}
+
+void tdl::DescriptorAllocator::beginFrame(
+    const size_t frame
+) {
+    Chain& chain = frames_[frame];
+    transient_sets_ = 0;
+
+    // the pools are kept, a frame needs about as many sets as the last time it was recorded
+    for (Pool& pool : chain.pools) {
+        if (pool.used == 0) continue;
+
+        device_.resetDescriptorPool(pool.pool);
+        pool.used = 0;
+    }
+
+    chain.current = 0;
+}
+
+vk::DescriptorSet tdl::DescriptorAllocator::allocate(
+    Chain& chain,
+    const vk::DescriptorSetLayout layout
+) {
+    vk::DescriptorSet set;
+
+    while (true) {
+        if (chain.current == chain.pools.size()) {
+            const uint32_t capacity = chain.pools.empty()
+                ? initial_pool_sets
+                : std::min(chain.pools.back().capacity * 2, max_pool_sets);
+
+            chain.pools.push_back(createPool(capacity));
+        }
+
+        Pool& pool = chain.pools[chain.current];
+
+        if (pool.used < pool.capacity) {
+            const vk::DescriptorSetAllocateInfo alloc_info {
+                pool.pool,
+                1,
+                &layout
+            };
+
+            const vk::Result result = device_.allocateDescriptorSets(&alloc_info, &set);
+
+            if (result == vk::Result::eSuccess) {
+                ++pool.used;
+                return set;
+            }
+
+            // a pool that cannot hold a single set will not fit the next one either
+            if (pool.used == 0) {
+                throw std::runtime_error(
+                    "ERR 099: Failed to allocate descriptor set from an empty pool (" + vk::to_string(result)
+                    + "). DescriptorAllocator::allocate(...)"
+                );
+            }
+        }
+
+        // full, or out of descriptors of one type (VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL)
+        ++chain.current;
+    }
+}
+
+tdl::DescriptorAllocator::Pool tdl::DescriptorAllocator::createPool(
+    const uint32_t capacity
+) {
+    const vk::DescriptorPoolSize pool_sizes[] {
+        {
+            vk::DescriptorType::eUniformBuffer,
+            capacity * uniform_buffers_per_set
+        },
+        {
+            vk::DescriptorType::eStorageBuffer,
+            capacity * storage_buffers_per_set
+        },
+        {
+            vk::DescriptorType::eCombinedImageSampler,
+            capacity * samplers_per_set
+        },
+        {
+            vk::DescriptorType::eInputAttachment,
+            capacity * input_attachments_per_set
+        }
+    };
+
+    Pool pool;
+    pool.capacity = capacity;
+
+    try {
+        pool.pool = device_.createDescriptorPool({
+            {},
+            capacity,
+            static_cast<uint32_t>(std::size(pool_sizes)),
+            pool_sizes
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 098: Failed to create descriptor pool. DescriptorAllocator::createPool(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    ++pools_;
+    return pool;
+}
+
+void tdl::DescriptorAllocator::destroy() {
+    if (!device_) return;
+
+    for (const Pool& pool : persistent_.pools) device_.destroyDescriptorPool(pool.pool);
+    for (const Chain& chain : frames_) {
+        for (const Pool& pool : chain.pools) device_.destroyDescriptorPool(pool.pool);
+    }
+
+    persistent_ = {};
+    frames_.clear();
+    sets_ = 0;
+    transient_sets_ = 0;
+    pools_ = 0;
+
+    device_ = nullptr;
+}
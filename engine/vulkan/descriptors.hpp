@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace tdl {
+    /**
+     * @breif Hands out descriptor sets from a chain of pools that grows when the last one is full
+     *
+     * Every pool holds max_sets sets and enough descriptors of each type for that many sets of the renderer's layouts,
+     * so counting sets is enough to know when a pool is full; the next pool is twice as large, up to max_pool_sets. Sets
+     * with more descriptors than the per set counts below (the TextureTable) need their own pool.
+     *
+     * Persistent sets live as long as the allocator. Transient sets come from pools owned by a frame in flight and are
+     * recycled by beginFrame() once the frame's fence was waited on, so they only have to be written again and never
+     * freed. The OcclusionCuller and the G-buffer inputs take their sets from them, so they are never rewritten while
+     * an earlier frame reads them.
+    */
+    class DescriptorAllocator {
+        public:
+            static constexpr uint32_t initial_pool_sets = 64;
+            static constexpr uint32_t max_pool_sets = 4096;
+
+            // descriptors of each type a single set may use
+            static constexpr uint32_t uniform_buffers_per_set = 2;
+            static constexpr uint32_t storage_buffers_per_set = 5;
+            static constexpr uint32_t samplers_per_set = 2;
+            static constexpr uint32_t input_attachments_per_set = 4; // the G-buffer
+
+            /**
+             * @breif Sets up the allocator, the first pool is only created by the first allocation
+             *
+             * @param device current GPU (logical)
+             * @param frames frames in flight, each has its own pools for transient sets
+            */
+            void init (
+                vk::Device device,
+                unsigned int frames
+            );
+
+            /**
+             * @breif Allocates a set that lives as long as the allocator
+             *
+             * @param layout layout of the set
+             * @return vk::DescriptorSet the new set, nothing is written to it
+            */
+            vk::DescriptorSet allocate (
+                vk::DescriptorSetLayout layout
+            );
+
+            /**
+             * @breif Allocates one set per frame in flight with the same layout
+             *
+             * @param layout layout of the sets
+             * @param count number of sets
+             * @return std::vector<vk::DescriptorSet> the new sets, nothing is written to them
+            */
+            std::vector<vk::DescriptorSet> allocate (
+                vk::DescriptorSetLayout layout,
+                uint32_t count
+            );
+
+            /**
+             * @breif Allocates a set that is only valid until beginFrame() is called for the same frame again
+             *
+             * @param layout layout of the set
+             * @param frame frame in flight the set is used by
+             * @return vk::DescriptorSet the new set, nothing is written to it
+            */
+            vk::DescriptorSet allocateTransient (
+                vk::DescriptorSetLayout layout,
+                size_t frame
+            );
+
+            /**
+             * @breif Recycles the transient sets of a frame, its fence has to be waited on before
+             *
+             * @param frame frame in flight about to be recorded
+            */
+            void beginFrame (
+                size_t frame
+            );
+
+            [[nodiscard]] uint64_t sets() const { return sets_; } // persistent sets allocated
+            [[nodiscard]] uint64_t transientSets() const { return transient_sets_; } // by the last frame that began
+            [[nodiscard]] uint64_t pools() const { return pools_; } // persistent and transient
+
+            void destroy();
+
+        private:
+            struct Pool {
+                vk::DescriptorPool pool;
+                uint32_t capacity = 0; // max sets
+                uint32_t used = 0;
+            };
+
+            // pools filled one after the other, full ones are kept until they are reset or destroyed
+            struct Chain {
+                std::vector<Pool> pools;
+                size_t current = 0;
+            };
+
+            vk::DescriptorSet allocate (
+                Chain& chain,
+                vk::DescriptorSetLayout layout
+            );
+
+            Pool createPool (
+                uint32_t capacity
+            );
+
+            vk::Device device_;
+
+            Chain persistent_;
+            std::vector<Chain> frames_; // transient pools of every frame in flight
+
+            uint64_t sets_ = 0;
+            uint64_t transient_sets_ = 0;
+            uint64_t pools_ = 0;
+    };
+};
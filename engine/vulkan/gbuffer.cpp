@@ -0,0 +1,270 @@
+#include "gbuffer.hpp"
+
+#include <stdexcept>
+
+void tdl::GBuffer::create(
+    const vk::Device device,
+    const vk::Extent2D extent,
+    const vk::RenderPass render_pass,
+    const vk::DescriptorSetLayout ubo_layout,
+    const vk::DescriptorSetLayout object_layout,
+    const vk::DescriptorSetLayout lights_layout,
+    const std::vector<char>& vert,
+    const std::vector<char>& frag
+) {
+    device_ = device;
+    extent_ = extent;
+    render_pass_ = render_pass;
+
+    createLayout();
+    createPipeline(ubo_layout, object_layout, lights_layout, vert, frag);
+}
+
+void tdl::GBuffer::writeInputs(
+    const vk::DescriptorSet set,
+    const std::array<vk::ImageView, count>& views
+) const {
+    std::array<vk::DescriptorImageInfo, count> image_infos;
+    std::array<vk::WriteDescriptorSet, count> writes;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        image_infos[i] = {
+            nullptr,
+            views[i],
+            vk::ImageLayout::eShaderReadOnlyOptimal
+        };
+
+        writes[i] = {
+            set,
+            i,
+            0,
+            1,
+            vk::DescriptorType::eInputAttachment,
+            &image_infos[i],
+            nullptr,
+            nullptr
+        };
+    }
+
+    device_.updateDescriptorSets(count, writes.data(), 0, nullptr);
+}
+
+void tdl::GBuffer::draw(
+    const vk::CommandBuffer command_buffer,
+    const vk::DescriptorSet ubo_set,
+    const vk::DescriptorSet inputs_set,
+    const vk::DescriptorSet lights_set
+) const {
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline_);
+
+    // set 1 differs from the object pipelines, so every set has to be bound again for this layout
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout_, 0, 1, &ubo_set, 0, nullptr);
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout_, 1, 1, &inputs_set, 0, nullptr);
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout_, 3, 1, &lights_set, 0, nullptr);
+
+    command_buffer.draw(3, 1, 0, 0); // fullscreen triangle
+}
+
+void tdl::GBuffer::destroy() {
+    if (!device_) return;
+
+    device_.destroyPipeline(pipeline_);
+    device_.destroyPipelineLayout(pipeline_layout_);
+    device_.destroyDescriptorSetLayout(layout_);
+
+    pipeline_ = nullptr;
+    pipeline_layout_ = nullptr;
+    layout_ = nullptr;
+}
+
+void tdl::GBuffer::createLayout() {
+    std::array<vk::DescriptorSetLayoutBinding, count> bindings;
+    for (uint32_t i = 0; i < count; ++i) {
+        bindings[i] = {
+            i,
+            vk::DescriptorType::eInputAttachment,
+            1,
+            vk::ShaderStageFlagBits::eFragment,
+            nullptr
+        };
+    }
+
+    try {
+        layout_ = device_.createDescriptorSetLayout({
+            {},
+            count,
+            bindings.data()
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 079: Failed to create G-buffer descriptor set layout. GBuffer::createLayout(...)\n"
+            + std::string(err.what())
+        );
+    }
+}
+
+void tdl::GBuffer::createPipeline(
+    const vk::DescriptorSetLayout ubo_layout,
+    const vk::DescriptorSetLayout object_layout,
+    const vk::DescriptorSetLayout lights_layout,
+    const std::vector<char>& vert,
+    const std::vector<char>& frag
+) {
+    // set 2 (object UBO) is never bound, it only keeps the lights at set 3 like in the object pipelines
+    const vk::DescriptorSetLayout set_layouts[] = { ubo_layout, layout_, object_layout, lights_layout };
+
+    vk::ShaderModule vert_module;
+    vk::ShaderModule frag_module;
+
+    try {
+        pipeline_layout_ = device_.createPipelineLayout({
+            {},
+            static_cast<uint32_t>(std::size(set_layouts)),
+            set_layouts
+        });
+
+        vert_module = device_.createShaderModule({
+            {},
+            vert.size(),
+            reinterpret_cast<const uint32_t*>(vert.data())
+        });
+
+        frag_module = device_.createShaderModule({
+            {},
+            frag.size(),
+            reinterpret_cast<const uint32_t*>(frag.data())
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 080: Failed to create lighting pipeline layout. GBuffer::createPipeline(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    const vk::PipelineShaderStageCreateInfo stages[] = {
+        {
+            {},
+            vk::ShaderStageFlagBits::eVertex,
+            vert_module,
+            "main"
+        },
+        {
+            {},
+            vk::ShaderStageFlagBits::eFragment,
+            frag_module,
+            "main"
+        }
+    };
+
+    // the triangle is generated from gl_VertexIndex
+    static constexpr vk::PipelineVertexInputStateCreateInfo vertex_info {};
+
+    static constexpr vk::PipelineInputAssemblyStateCreateInfo assembly {
+        {},
+        vk::PrimitiveTopology::eTriangleList,
+        VK_FALSE
+    };
+
+    const vk::Viewport viewport {
+        0.0f, 0.0f,
+        static_cast<float>(extent_.width),
+        static_cast<float>(extent_.height),
+        0.0f, 1.0f
+    };
+
+    const vk::Rect2D scissor = {
+        {0, 0},
+        extent_
+    };
+
+    const vk::PipelineViewportStateCreateInfo viewport_info {
+        {},
+        1,
+        &viewport,
+        1,
+        &scissor
+    };
+
+    static constexpr vk::PipelineRasterizationStateCreateInfo rasterizer {
+        {},
+        VK_FALSE,
+        VK_FALSE,
+        vk::PolygonMode::eFill,
+        vk::CullModeFlagBits::eNone,
+        vk::FrontFace::eClockwise,
+        VK_FALSE,
+        0.0f,
+        0.0f,
+        0.0f,
+        1.0f
+    };
+
+    static constexpr vk::PipelineMultisampleStateCreateInfo multisampling {
+        {},
+        vk::SampleCountFlagBits::e1,
+        VK_FALSE,
+        1.0f,
+        nullptr,
+        VK_FALSE,
+        VK_FALSE
+    };
+
+    static constexpr vk::PipelineColorBlendAttachmentState blending_attach {
+        VK_FALSE,
+        vk::BlendFactor::eOne,
+        vk::BlendFactor::eZero,
+        vk::BlendOp::eAdd,
+        vk::BlendFactor::eOne,
+        vk::BlendFactor::eZero,
+        vk::BlendOp::eAdd,
+        vk::ColorComponentFlags(
+            vk::ColorComponentFlagBits::eR |
+            vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB |
+            vk::ColorComponentFlagBits::eA
+        )
+    };
+
+    static constexpr vk::PipelineColorBlendStateCreateInfo blending {
+        {},
+        VK_FALSE,
+        vk::LogicOp::eCopy,
+        1,
+        &blending_attach,
+        {0.0f, 0.0f, 0.0f, 0.0f}
+    };
+
+    const vk::GraphicsPipelineCreateInfo info {
+        {},
+        2,
+        stages,
+        &vertex_info,
+        &assembly,
+        nullptr,
+        &viewport_info,
+        &rasterizer,
+        &multisampling,
+        nullptr, // the lighting subpass has no depth attachment
+        &blending,
+        nullptr,
+        pipeline_layout_,
+        render_pass_,
+        1,
+        nullptr,
+        -1
+    };
+
+    try {
+        pipeline_ = device_.createGraphicsPipeline(nullptr, info).value;
+    } catch (const vk::SystemError& err) {
+        device_.destroyShaderModule(vert_module);
+        device_.destroyShaderModule(frag_module);
+        throw std::runtime_error(
+            "ERR 081: Failed to create lighting pipeline. GBuffer::createPipeline(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    device_.destroyShaderModule(vert_module);
+    device_.destroyShaderModule(frag_module);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace tdl {
+    /**
+     * @breif Attachments and lighting pipeline of the deferred render path
+     *
+     * Objects are drawn into the G-buffer in the first subpass of the render pass, the second subpass reads it back as
+     * input attachments and shades every pixel once with the clustered lights. Both subpasses share one render pass so
+     * tile based GPUs can keep the G-buffer in tile memory.
+     *
+     * The attachments are created by the RenderGraph of the frame with the usage below, which places them with the
+     * other images that only live for the frame (in lazily allocated memory when the device has it). Their views are
+     * written into a transient set of the frame by writeInputs().
+    */
+    class GBuffer {
+        public:
+            // albedo, normal + specular exponent, specular colour + lighting model, world position + view depth
+            static constexpr std::array<vk::Format, 4> formats {
+                vk::Format::eR8G8B8A8Unorm,
+                vk::Format::eR16G16B16A16Sfloat,
+                vk::Format::eR8G8B8A8Unorm,
+                vk::Format::eR32G32B32A32Sfloat
+            };
+
+            static constexpr uint32_t count = formats.size();
+
+            // never leave the render pass, so they do not have to be backed by real memory on tile based GPUs
+            static constexpr vk::ImageUsageFlags usage =
+                vk::ImageUsageFlagBits::eColorAttachment |
+                vk::ImageUsageFlagBits::eInputAttachment |
+                vk::ImageUsageFlagBits::eTransientAttachment;
+
+            /**
+             * @breif Creates the layout of the input attachments and the lighting pipeline
+             *
+             * Depends on the render pass and the size of the swapchain, has to be destroyed and created again when they
+             * change.
+             *
+             * @param device current GPU (logical)
+             * @param extent size of the framebuffer
+             * @param render_pass deferred render pass, the lighting pipeline is used in subpass 1
+             * @param ubo_layout layout of set 0 (camera UBO)
+             * @param object_layout layout of set 2, unused by the lighting pass but needed to keep the set numbers
+             * @param lights_layout layout of set 3 (lights, clusters and shadows)
+             * @param vert SPIR-V of the fullscreen vertex shader
+             * @param frag SPIR-V of the lighting fragment shader
+            */
+            void create (
+                vk::Device device,
+                vk::Extent2D extent,
+                vk::RenderPass render_pass,
+                vk::DescriptorSetLayout ubo_layout,
+                vk::DescriptorSetLayout object_layout,
+                vk::DescriptorSetLayout lights_layout,
+                const std::vector<char>& vert,
+                const std::vector<char>& frag
+            );
+
+            /**
+             * @breif Points a set with layout() at the attachments the frame draws into
+             *
+             * @param set set 1 of the lighting pass, not used by a frame in flight
+             * @param views views of the attachments, in the order of formats
+            */
+            void writeInputs (
+                vk::DescriptorSet set,
+                const std::array<vk::ImageView, count>& views
+            ) const;
+
+            /**
+             * @breif Records the lighting subpass, has to be called after nextSubpass()
+             *
+             * @param command_buffer command buffer of the frame
+             * @param ubo_set set 0 of the frame
+             * @param inputs_set set 1 of the frame, written by writeInputs()
+             * @param lights_set set 3 of the frame
+            */
+            void draw (
+                vk::CommandBuffer command_buffer,
+                vk::DescriptorSet ubo_set,
+                vk::DescriptorSet inputs_set,
+                vk::DescriptorSet lights_set
+            ) const;
+
+            [[nodiscard]] vk::DescriptorSetLayout layout() const { return layout_; }
+
+            void destroy();
+
+        private:
+            void createLayout();
+            void createPipeline(
+                vk::DescriptorSetLayout ubo_layout,
+                vk::DescriptorSetLayout object_layout,
+                vk::DescriptorSetLayout lights_layout,
+                const std::vector<char>& vert,
+                const std::vector<char>& frag
+            );
+
+            vk::Device device_;
+            vk::Extent2D extent_;
+            vk::RenderPass render_pass_;
+
+            vk::DescriptorSetLayout layout_; // set 1 of the lighting pass, one input attachment per G-buffer image
+
+            vk::PipelineLayout pipeline_layout_;
+            vk::Pipeline pipeline_;
+    };
+};
@@ -0,0 +1,589 @@
+#include "graph.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "buffers.hpp"
+#include "deletion.hpp"
+
+namespace {
+    // source access masks only need the writes, reads do not have to be made visible
+    constexpr vk::AccessFlags write_bits =
+        vk::AccessFlagBits::eShaderWrite |
+        vk::AccessFlagBits::eColorAttachmentWrite |
+        vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+        vk::AccessFlagBits::eTransferWrite |
+        vk::AccessFlagBits::eHostWrite |
+        vk::AccessFlagBits::eMemoryWrite;
+
+    vk::DeviceSize alignUp(
+        const vk::DeviceSize value,
+        const vk::DeviceSize alignment
+    ) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+tdl::RenderGraph::Access tdl::RenderGraph::access(
+    const Usage usage
+) {
+    switch (usage) {
+        case Usage::None:
+            return {{}, {}, vk::ImageLayout::eUndefined};
+        case Usage::TransferWrite:
+            return {vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eTransferDstOptimal};
+        case Usage::ComputeRead:
+            return {vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eGeneral};
+        case Usage::ComputeWrite:
+            // the culling shaders append with atomics, so their writes also read
+            return {
+                vk::PipelineStageFlagBits::eComputeShader,
+                vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                vk::ImageLayout::eGeneral
+            };
+        case Usage::ComputeSample:
+            return {vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal};
+        case Usage::DrawIndirect:
+            return {
+                vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+                vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead,
+                vk::ImageLayout::eUndefined
+            };
+        case Usage::ColorAttachment:
+            return {
+                vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+                vk::ImageLayout::eColorAttachmentOptimal
+            };
+        case Usage::DepthAttachment:
+            return {
+                vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+                vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                vk::ImageLayout::eDepthStencilAttachmentOptimal
+            };
+        case Usage::FragmentSample:
+            return {vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal};
+    }
+
+    throw std::invalid_argument("ERR 102: Unknown usage. RenderGraph::access(...)");
+}
+
+void tdl::RenderGraph::init(
+    const vk::Device device,
+    const vk::PhysicalDevice physical_device,
+    DeletionQueue& deletions
+) {
+    device_ = device;
+    physical_device_ = physical_device;
+    deletions_ = &deletions;
+}
+
+void tdl::RenderGraph::reset() {
+    passes_.clear();
+    resources_.clear();
+}
+
+tdl::RenderGraph::Resource tdl::RenderGraph::importBuffer(
+    std::string name,
+    const Usage before
+) {
+    ResourceData& resource = resources_.emplace_back();
+    resource.name = std::move(name);
+    resource.buffer = true;
+    resource.before = before;
+
+    return static_cast<Resource>(resources_.size() - 1);
+}
+
+tdl::RenderGraph::Resource tdl::RenderGraph::importImage(
+    std::string name,
+    const vk::Image image,
+    const vk::ImageAspectFlags aspect,
+    const uint32_t levels,
+    const vk::ImageLayout layout,
+    const Usage before
+) {
+    ResourceData& resource = resources_.emplace_back();
+    resource.name = std::move(name);
+    resource.image = image;
+    resource.aspect = aspect;
+    resource.levels = levels;
+    resource.layout = layout;
+    resource.before = before;
+
+    return static_cast<Resource>(resources_.size() - 1);
+}
+
+tdl::RenderGraph::Resource tdl::RenderGraph::createImage(
+    std::string name,
+    const ImageDesc& desc
+) {
+    ResourceData& resource = resources_.emplace_back();
+    resource.name = std::move(name);
+    resource.created = true;
+    resource.desc = desc;
+    resource.aspect = desc.aspect;
+    resource.levels = desc.levels;
+
+    return static_cast<Resource>(resources_.size() - 1);
+}
+
+tdl::RenderGraph::Pass tdl::RenderGraph::addPass(
+    std::string name,
+    Record record
+) {
+    PassData& pass = passes_.emplace_back();
+    pass.name = std::move(name);
+    pass.record = std::move(record);
+
+    return static_cast<Pass>(passes_.size() - 1);
+}
+
+void tdl::RenderGraph::read(
+    const Pass pass,
+    const Resource resource,
+    const Usage usage,
+    const vk::ImageLayout layout
+) {
+    Access use_access = access(usage);
+    if (layout != vk::ImageLayout::eUndefined) use_access.layout = layout;
+
+    passes_[pass].uses.push_back({resource, use_access, true, false, false, vk::ImageLayout::eUndefined});
+}
+
+void tdl::RenderGraph::write(
+    const Pass pass,
+    const Resource resource,
+    const Usage usage,
+    const vk::ImageLayout layout
+) {
+    Access use_access = access(usage);
+    if (layout != vk::ImageLayout::eUndefined) use_access.layout = layout;
+
+    passes_[pass].uses.push_back({resource, use_access, false, true, false, vk::ImageLayout::eUndefined});
+}
+
+void tdl::RenderGraph::attachment(
+    const Pass pass,
+    const Resource resource,
+    const vk::ImageLayout initial,
+    const vk::ImageLayout final
+) {
+    const bool depth = static_cast<bool>(resources_[resource].aspect & vk::ImageAspectFlagBits::eDepth);
+
+    Access use_access = access(depth ? Usage::DepthAttachment : Usage::ColorAttachment);
+    use_access.layout = initial;
+
+    const bool loaded = initial != vk::ImageLayout::eUndefined;
+    passes_[pass].uses.push_back({resource, use_access, loaded, true, true, final});
+}
+
+void tdl::RenderGraph::output(
+    const Resource resource
+) {
+    resources_[resource].output = true;
+}
+
+void tdl::RenderGraph::compile() {
+    cull();
+
+    // first and last pass of the images created by the graph
+    for (uint32_t p = 0; p < passes_.size(); ++p) {
+        if (!passes_[p].live) continue;
+
+        for (const Use& use : passes_[p].uses) {
+            ResourceData& resource = resources_[use.resource];
+            if (!resource.created) continue;
+
+            resource.first = std::min(resource.first, p);
+            resource.last = std::max(resource.last, p);
+        }
+    }
+
+    place();
+
+    std::vector<State> states (resources_.size());
+    for (size_t i = 0; i < resources_.size(); ++i) {
+        const ResourceData& resource = resources_[i];
+        const Access before = access(resource.before);
+
+        states[i].layout = resource.layout;
+        states[i].read_stages = before.stage;
+        if (before.access & write_bits) {
+            states[i].write_stages = before.stage;
+            states[i].write_access = before.access & write_bits;
+        }
+    }
+
+    barriers_ = 0;
+
+    for (uint32_t p = 0; p < passes_.size(); ++p) {
+        PassData& pass = passes_[p];
+        pass.src_stages = {};
+        pass.dst_stages = {};
+        pass.memory = vk::MemoryBarrier {};
+        pass.images.clear();
+
+        if (!pass.live) continue;
+
+        for (const Use& use : pass.uses) {
+            const ResourceData& resource = resources_[use.resource];
+            State& state = states[use.resource];
+
+            // the memory of an image created by the graph may have held another image earlier in the frame
+            if (resource.created && resource.first == p && state.used_stages == vk::PipelineStageFlags {}) {
+                const Transient& transient = transients_[resource.transient];
+
+                for (size_t i = 0; i < resources_.size(); ++i) {
+                    const ResourceData& other = resources_[i];
+                    if (!other.created || other.transient < 0 || other.last >= p) continue;
+
+                    const Transient& placed = transients_[other.transient];
+                    const bool overlaps =
+                        placed.offset < transient.offset + transient.requirements.size &&
+                        transient.offset < placed.offset + placed.requirements.size;
+                    if (!overlaps) continue;
+
+                    state.write_stages |= states[i].used_stages;
+                    state.write_access |= states[i].used_writes;
+                }
+            }
+
+            barrier(pass, resource, state, use);
+        }
+
+        if (pass.src_stages) ++barriers_;
+    }
+}
+
+void tdl::RenderGraph::execute(
+    const vk::CommandBuffer command_buffer
+) const {
+    for (const PassData& pass : passes_) {
+        if (!pass.live) continue;
+
+        if (pass.src_stages) {
+            const bool memory = pass.memory.srcAccessMask || pass.memory.dstAccessMask;
+
+            command_buffer.pipelineBarrier(
+                pass.src_stages,
+                pass.dst_stages,
+                {},
+                memory ? 1 : 0, &pass.memory,
+                0, nullptr,
+                static_cast<uint32_t>(pass.images.size()), pass.images.data()
+            );
+        }
+
+        pass.record(command_buffer);
+    }
+}
+
+vk::Image tdl::RenderGraph::image(
+    const Resource resource
+) const {
+    return resources_[resource].image;
+}
+
+vk::ImageView tdl::RenderGraph::view(
+    const Resource resource
+) const {
+    const int32_t transient = resources_[resource].transient;
+    return transient < 0 ? nullptr : transients_[transient].view;
+}
+
+void tdl::RenderGraph::cull() {
+    // walked backwards, a resource is needed while a pass that is kept reads what the passes before it wrote
+    std::vector<bool> needed (resources_.size());
+    for (size_t i = 0; i < resources_.size(); ++i) needed[i] = resources_[i].output;
+
+    culled_ = 0;
+
+    for (size_t p = passes_.size(); p-- > 0;) {
+        PassData& pass = passes_[p];
+
+        pass.live = pass.uses.empty(); // nothing declared, recorded for its side effects
+        for (const Use& use : pass.uses) {
+            if (use.write && needed[use.resource]) pass.live = true;
+        }
+
+        if (!pass.live) {
+            ++culled_;
+            continue;
+        }
+
+        for (const Use& use : pass.uses) {
+            if (use.write && !use.read) needed[use.resource] = false;
+        }
+        for (const Use& use : pass.uses) {
+            if (use.read) needed[use.resource] = true;
+        }
+    }
+}
+
+void tdl::RenderGraph::place() {
+    std::vector<Transient> wanted;
+    for (const ResourceData& resource : resources_) {
+        if (!resource.created || resource.first == UINT32_MAX) continue;
+        wanted.push_back({resource.name, resource.desc, resource.first, resource.last});
+    }
+
+    const bool same = std::ranges::equal(wanted, transients_, [](const Transient& a, const Transient& b) {
+        return a.name == b.name && a.desc == b.desc && a.first == b.first && a.last == b.last;
+    });
+
+    // the images of the last frame still fit, they are bound to their memory for good
+    if (!same) {
+        releaseTransients();
+        transients_ = std::move(wanted);
+
+        uint32_t memory_types = ~0u;
+        bool lazy = true; // only attachments that never leave their render pass
+
+        try {
+            for (Transient& transient : transients_) {
+                transient.image = device_.createImage({
+                    {},
+                    vk::ImageType::e2D,
+                    transient.desc.format,
+                    {transient.desc.extent.width, transient.desc.extent.height, 1},
+                    transient.desc.levels,
+                    1,
+                    vk::SampleCountFlagBits::e1,
+                    vk::ImageTiling::eOptimal,
+                    transient.desc.usage,
+                    vk::SharingMode::eExclusive,
+                    0,
+                    nullptr,
+                    vk::ImageLayout::eUndefined
+                });
+
+                transient.requirements = device_.getImageMemoryRequirements(transient.image);
+                memory_types &= transient.requirements.memoryTypeBits;
+                lazy = lazy && static_cast<bool>(transient.desc.usage & vk::ImageUsageFlagBits::eTransientAttachment);
+            }
+        } catch (const vk::SystemError& err) {
+            throw std::runtime_error(
+                "ERR 103: Failed to create render graph image. RenderGraph::place(...)\n"
+                + std::string(err.what())
+            );
+        }
+
+        if (!transients_.empty() && memory_types == 0) {
+            throw std::runtime_error("ERR 104: No memory type fits every render graph image. RenderGraph::place(...)");
+        }
+
+        // largest first, every image goes to the lowest offset that no image alive at the same time uses
+        std::vector<size_t> order (transients_.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, std::greater {}, [&](const size_t i) { return transients_[i].requirements.size; });
+
+        std::vector<size_t> placed;
+        vk::DeviceSize heap_size = 0;
+        transient_bytes_ = 0;
+
+        for (const size_t i : order) {
+            Transient& transient = transients_[i];
+            const vk::DeviceSize size = transient.requirements.size;
+            vk::DeviceSize offset = 0;
+
+            for (bool moved = true; moved;) {
+                moved = false;
+
+                for (const size_t j : placed) {
+                    const Transient& other = transients_[j];
+                    const bool alive = transient.first <= other.last && other.first <= transient.last;
+                    const bool overlaps = offset < other.offset + other.requirements.size && other.offset < offset + size;
+
+                    if (alive && overlaps) {
+                        offset = alignUp(other.offset + other.requirements.size, transient.requirements.alignment);
+                        moved = true;
+                    }
+                }
+            }
+
+            transient.offset = offset;
+            placed.push_back(i);
+
+            heap_size = std::max(heap_size, offset + size);
+            transient_bytes_ += size;
+        }
+
+        heap_bytes_ = heap_size;
+
+        if (heap_size > 0) {
+            uint32_t memory_type;
+            try {
+                // tile based GPUs keep such attachments in tile memory, desktop GPUs have no lazily allocated memory
+                if (!lazy) throw std::runtime_error("not transient");
+                memory_type = MemoryBuffer::findMemoryType(
+                    physical_device_,
+                    memory_types,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated
+                );
+            } catch (const std::runtime_error&) {
+                memory_type = MemoryBuffer::findMemoryType(physical_device_, memory_types, vk::MemoryPropertyFlagBits::eDeviceLocal);
+            }
+
+            try {
+                heap_ = device_.allocateMemory({heap_size, memory_type});
+
+                for (Transient& transient : transients_) {
+                    device_.bindImageMemory(transient.image, heap_, transient.offset);
+
+                    transient.view = device_.createImageView({
+                        {},
+                        transient.image,
+                        vk::ImageViewType::e2D,
+                        transient.desc.format,
+                        {},
+                        {
+                            transient.desc.aspect,
+                            0,
+                            transient.desc.levels,
+                            0,
+                            1
+                        }
+                    });
+                }
+            } catch (const vk::SystemError& err) {
+                throw std::runtime_error(
+                    "ERR 105: Failed to allocate render graph memory. RenderGraph::place(...)\n"
+                    + std::string(err.what())
+                );
+            }
+        }
+    }
+
+    // both lists are in the order the resources were created in
+    int32_t index = 0;
+    for (ResourceData& resource : resources_) {
+        if (!resource.created || resource.first == UINT32_MAX) continue;
+
+        resource.transient = index;
+        resource.image = transients_[index].image;
+        ++index;
+    }
+}
+
+void tdl::RenderGraph::barrier(
+    PassData& pass,
+    const ResourceData& resource,
+    State& state,
+    const Use& use
+) {
+    const Access& use_access = use.access;
+
+    state.used_stages |= use_access.stage;
+    if (use.write) state.used_writes |= use_access.access & write_bits;
+
+    if (use.attachment) {
+        // the render pass synchronises the attachment, only a load in another layout needs a barrier in front of it
+        if (use_access.layout != vk::ImageLayout::eUndefined && use_access.layout != state.layout) {
+            pass.src_stages |= state.write_stages | state.read_stages;
+            if (!pass.src_stages) pass.src_stages = vk::PipelineStageFlagBits::eTopOfPipe;
+            pass.dst_stages |= use_access.stage;
+
+            pass.images.push_back({
+                state.write_access,
+                use_access.access,
+                state.layout,
+                use_access.layout,
+                vk::QueueFamilyIgnored,
+                vk::QueueFamilyIgnored,
+                resource.image,
+                {resource.aspect, 0, resource.levels, 0, 1}
+            });
+        }
+
+        // the memory held another image of the frame, its writes have to finish before the render pass overwrites it
+        else if (state.write_stages) {
+            pass.src_stages |= state.write_stages;
+            pass.dst_stages |= use_access.stage;
+            pass.memory.srcAccessMask |= state.write_access;
+            pass.memory.dstAccessMask |= use_access.access;
+        }
+
+        state.layout = use.final_layout;
+        state.write_stages = {};
+        state.write_access = {};
+        state.read_stages = {};
+        state.visible_stages = {};
+        return;
+    }
+
+    const bool transition =
+        !resource.buffer &&
+        use_access.layout != vk::ImageLayout::eUndefined &&
+        use_access.layout != state.layout;
+
+    // write after write and write after read, or read after a write that is not visible to the stage yet
+    vk::PipelineStageFlags src;
+    if (use.write || transition) src |= state.write_stages | state.read_stages;
+    if (use.read && state.write_stages && (use_access.stage & ~state.visible_stages)) src |= state.write_stages;
+
+    if (src || transition) {
+        pass.src_stages |= src ? src : vk::PipelineStageFlags {vk::PipelineStageFlagBits::eTopOfPipe};
+        pass.dst_stages |= use_access.stage;
+
+        if (transition) {
+            pass.images.push_back({
+                state.write_access,
+                use_access.access,
+                state.layout,
+                use_access.layout,
+                vk::QueueFamilyIgnored,
+                vk::QueueFamilyIgnored,
+                resource.image,
+                {resource.aspect, 0, resource.levels, 0, 1}
+            });
+        } else {
+            pass.memory.srcAccessMask |= state.write_access;
+            pass.memory.dstAccessMask |= use_access.access;
+        }
+    }
+
+    if (use.write || transition) {
+        // the layout transition counts as a write the later passes have to wait for
+        state.write_stages = use_access.stage;
+        state.write_access = use.write ? use_access.access & write_bits : vk::AccessFlags {};
+        state.read_stages = use.read ? use_access.stage : vk::PipelineStageFlags {};
+        state.visible_stages = use.write ? vk::PipelineStageFlags {} : use_access.stage;
+        if (transition) state.layout = use_access.layout;
+    } else {
+        state.read_stages |= use_access.stage;
+        if (src) state.visible_stages |= use_access.stage;
+    }
+}
+
+void tdl::RenderGraph::releaseTransients() {
+    for (const Transient& transient : transients_) {
+        deletions_->push(transient.view);
+        deletions_->push(transient.image);
+    }
+    deletions_->push(heap_);
+
+    transients_.clear();
+    heap_ = nullptr;
+    transient_bytes_ = 0;
+    heap_bytes_ = 0;
+}
+
+void tdl::RenderGraph::destroy() {
+    if (!device_) return;
+
+    // the device is idle, nothing has to wait for the frames in flight
+    for (const Transient& transient : transients_) {
+        device_.destroyImageView(transient.view);
+        device_.destroyImage(transient.image);
+    }
+    device_.freeMemory(heap_);
+
+    transients_.clear();
+    heap_ = nullptr;
+    passes_.clear();
+    resources_.clear();
+
+    device_ = nullptr;
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace tdl {
+    class DeletionQueue;
+
+    /**
+     * @breif How a pass uses a resource, decides the stages, access masks and layout of the barriers around it
+    */
+    enum class Usage : uint8_t {
+        None, // not used, nothing has to be waited for
+        TransferWrite,
+        ComputeRead, // storage buffer or storage image
+        ComputeWrite,
+        ComputeSample, // sampled by a compute shader
+        DrawIndirect, // indirect commands and the index buffers the culling passes write
+        ColorAttachment,
+        DepthAttachment,
+        FragmentSample
+    };
+
+    /**
+     * @breif Records the passes of a frame in order with the barriers between them worked out from what they use
+     *
+     * Every pass declares the resources it reads and writes. compile() drops the passes nothing reads from (nothing
+     * that leads to a resource marked with output()), merges the barriers each pass needs into one pipelineBarrier
+     * in front of it and moves images into the layout the pass asks for. The barriers inside a pass (between the
+     * levels of the HiZ pyramid, between a fill and the dispatch reading it) stay with the code recording the pass.
+     *
+     * Render pass attachments are only tracked by their layout: the render pass moves them from its initial to its
+     * final layout and its subpass dependencies synchronise them, so no barrier is recorded for them.
+     *
+     * Images created with createImage() only live for the frame. They are placed in one block of device memory, images
+     * whose first and last pass do not overlap share memory. The images and the memory are kept as long as the next
+     * frames create the same images in the same passes, so a steady frame allocates nothing. When every one of them is a
+     * transient attachment (the G-buffer) the block is lazily allocated memory where the GPU has it.
+     *
+     * Passes are recorded in the order they were added, the graph only drops passes and never moves them.
+    */
+    class RenderGraph {
+        public:
+            using Resource = uint32_t;
+            using Pass = uint32_t;
+            using Record = std::function<void(vk::CommandBuffer)>;
+
+            /**
+             * @breif Image created by the graph
+            */
+            struct ImageDesc {
+                vk::Format format = vk::Format::eUndefined;
+                vk::Extent2D extent;
+                vk::ImageUsageFlags usage;
+                vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+                uint32_t levels = 1;
+
+                bool operator==(const ImageDesc&) const = default;
+            };
+
+            /**
+             * @breif Stages, access mask and layout of a Usage
+            */
+            struct Access {
+                vk::PipelineStageFlags stage;
+                vk::AccessFlags access;
+                vk::ImageLayout layout;
+            };
+
+            [[nodiscard]] static Access access (
+                Usage usage
+            );
+
+            /**
+             * @param device current GPU (logical)
+             * @param physical_device current GPU (physical)
+             * @param deletions queue the images of the graph go to when different ones are needed
+            */
+            void init (
+                vk::Device device,
+                vk::PhysicalDevice physical_device,
+                DeletionQueue& deletions
+            );
+
+            /**
+             * @breif Removes every pass and resource, the images created by the graph are kept for the next compile()
+            */
+            void reset();
+
+            /**
+             * @breif Adds buffers the graph does not own, they are synchronised with memory barriers
+             *
+             * @param name name of the buffers
+             * @param before how the submissions before this frame last used them
+             * @return Resource handle used by the passes
+            */
+            Resource importBuffer (
+                std::string name,
+                Usage before = Usage::None
+            );
+
+            /**
+             * @breif Adds an image the graph does not own
+             *
+             * @param name name of the image
+             * @param image the image
+             * @param aspect aspects of the barriers
+             * @param levels mip levels of the barriers
+             * @param layout layout the image is in when the frame starts
+             * @param before how the submissions before this frame last used it
+             * @return Resource handle used by the passes
+            */
+            Resource importImage (
+                std::string name,
+                vk::Image image,
+                vk::ImageAspectFlags aspect,
+                uint32_t levels,
+                vk::ImageLayout layout,
+                Usage before = Usage::None
+            );
+
+            /**
+             * @breif Adds an image owned by the graph, its contents are undefined when the first pass uses it
+             *
+             * @param name name of the image, an image with the same name and desc is taken from the last frame
+             * @param desc format, size and usage of the image
+             * @return Resource handle used by the passes
+            */
+            Resource createImage (
+                std::string name,
+                const ImageDesc& desc
+            );
+
+            /**
+             * @breif Adds a pass after the ones added before
+             *
+             * @param name name of the pass
+             * @param record records the pass, only called by execute() if the pass was not culled
+             * @return Pass handle used to declare what the pass uses
+            */
+            Pass addPass (
+                std::string name,
+                Record record
+            );
+
+            /**
+             * @param layout layout the image has to be in, the layout of the usage if eUndefined
+            */
+            void read (
+                Pass pass,
+                Resource resource,
+                Usage usage,
+                vk::ImageLayout layout = vk::ImageLayout::eUndefined
+            );
+
+            /**
+             * @param layout layout the image has to be in, the layout of the usage if eUndefined
+            */
+            void write (
+                Pass pass,
+                Resource resource,
+                Usage usage,
+                vk::ImageLayout layout = vk::ImageLayout::eUndefined
+            );
+
+            /**
+             * @breif Declares an attachment of the render pass recorded by the pass
+             *
+             * The contents are loaded (read and written) unless initial is eUndefined.
+             *
+             * @param initial initialLayout of the attachment
+             * @param final finalLayout of the attachment
+            */
+            void attachment (
+                Pass pass,
+                Resource resource,
+                vk::ImageLayout initial,
+                vk::ImageLayout final
+            );
+
+            /**
+             * @breif Marks a resource whose contents are needed after the frame (the swapchain image)
+            */
+            void output (
+                Resource resource
+            );
+
+            /**
+             * @breif Culls the passes, works out the barriers and places the images created by the graph
+            */
+            void compile();
+
+            /**
+             * @breif Records the passes that were not culled with the barriers in front of them
+             *
+             * @param command_buffer command buffer of the frame, outside of a render pass
+            */
+            void execute (
+                vk::CommandBuffer command_buffer
+            ) const;
+
+            [[nodiscard]] vk::Image image(Resource resource) const;
+            [[nodiscard]] vk::ImageView view(Resource resource) const; // only for images created by the graph
+
+            [[nodiscard]] uint64_t passes() const { return passes_.size(); }
+            [[nodiscard]] uint64_t culled() const { return culled_; } // passes compile() dropped
+            [[nodiscard]] uint64_t barriers() const { return barriers_; } // pipelineBarrier calls recorded
+            [[nodiscard]] uint64_t transientBytes() const { return transient_bytes_; } // size of the created images
+            [[nodiscard]] uint64_t heapBytes() const { return heap_bytes_; } // memory they are placed in
+
+            void destroy();
+
+        private:
+            struct Use {
+                Resource resource;
+                Access access;
+                bool read;
+                bool write;
+                bool attachment; // synchronised by a render pass, access.layout is the initial layout
+                vk::ImageLayout final_layout;
+            };
+
+            struct PassData {
+                std::string name;
+                Record record;
+                std::vector<Use> uses;
+                bool live = false;
+
+                // the barrier recorded in front of the pass
+                vk::PipelineStageFlags src_stages;
+                vk::PipelineStageFlags dst_stages;
+                vk::MemoryBarrier memory;
+                std::vector<vk::ImageMemoryBarrier> images;
+            };
+
+            struct ResourceData {
+                std::string name;
+                bool buffer = false;
+                bool output = false;
+                vk::Image image;
+                vk::ImageAspectFlags aspect;
+                uint32_t levels = 1;
+                vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+                Usage before = Usage::None;
+
+                // only for images created by the graph
+                bool created = false;
+                ImageDesc desc;
+                int32_t transient = -1; // index into transients_, -1 if culled with every pass using it
+                uint32_t first = UINT32_MAX; // first and last pass that is not culled
+                uint32_t last = 0;
+            };
+
+            /**
+             * @breif Image created by the graph, placed at offset in heap_
+            */
+            struct Transient {
+                std::string name;
+                ImageDesc desc;
+                uint32_t first = 0;
+                uint32_t last = 0;
+                vk::Image image;
+                vk::ImageView view;
+                vk::MemoryRequirements requirements;
+                vk::DeviceSize offset = 0;
+            };
+
+            /**
+             * @breif What happened to a resource up to the pass being compiled
+            */
+            struct State {
+                vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+                vk::PipelineStageFlags write_stages; // last write nothing has waited for yet
+                vk::AccessFlags write_access;
+                vk::PipelineStageFlags read_stages; // reads since the last write
+                vk::PipelineStageFlags visible_stages; // the last write is visible to these
+
+                // every access of the frame, also the ones a render pass synchronised, for the next image in its memory
+                vk::PipelineStageFlags used_stages;
+                vk::AccessFlags used_writes;
+            };
+
+            void cull();
+            void place(); // creates the images of the graph if they differ from the last frame
+            void barrier (
+                PassData& pass,
+                const ResourceData& resource,
+                State& state,
+                const Use& use
+            );
+
+            void releaseTransients(); // hands the images and the heap to the deletion queue
+
+            vk::Device device_;
+            vk::PhysicalDevice physical_device_;
+            DeletionQueue* deletions_ = nullptr;
+
+            std::vector<PassData> passes_;
+            std::vector<ResourceData> resources_;
+
+            std::vector<Transient> transients_; // kept across frames
+            vk::DeviceMemory heap_;
+
+            uint64_t culled_ = 0;
+            uint64_t barriers_ = 0;
+            uint64_t transient_bytes_ = 0;
+            uint64_t heap_bytes_ = 0;
+    };
+};
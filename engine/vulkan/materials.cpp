@@ -0,0 +1,74 @@
+#include "materials.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(tdl::MaterialObject) % 16 == 0, "materials are laid out like the std430 Material array of material.glsl");
+
+void tdl::MaterialTable::init(
+    const vk::Device device,
+    const vk::PhysicalDevice physical_device,
+    const vk::Queue graphics_queue,
+    const vk::CommandPool command_pool,
+    DeletionQueue& deletions
+) {
+    device_ = device;
+    physical_device_ = physical_device;
+    graphics_queue_ = graphics_queue;
+    command_pool_ = command_pool;
+    deletions_ = &deletions;
+
+    reserve(initial_capacity);
+}
+
+uint32_t tdl::MaterialTable::add(
+    const MaterialObject& material
+) {
+    Key key;
+    std::memcpy(key.data(), &material, sizeof(MaterialObject));
+
+    const auto [it, added] = indices_.try_emplace(key, count_);
+    if (!added) return it->second;
+
+    if (count_ == capacity_) reserve(capacity_ * 2);
+
+    static_cast<MaterialObject*>(buffer_->data())[count_] = material;
+
+    return count_++;
+}
+
+void tdl::MaterialTable::reserve(
+    const uint32_t capacity
+) {
+    auto* const buffer = new MemoryBuffer {
+        capacity * sizeof(MaterialObject),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        device_,
+        graphics_queue_,
+        command_pool_,
+        physical_device_
+    };
+
+    auto* const materials = static_cast<MaterialObject*>(buffer->map());
+    std::fill_n(materials, capacity, MaterialObject {});
+
+    // the frames in flight still read the old buffer, only happens when a lot of new materials show up at once
+    if (buffer_ != nullptr) {
+        std::copy_n(static_cast<const MaterialObject*>(buffer_->data()), count_, materials);
+        deletions_->push(buffer_);
+    }
+
+    buffer_ = buffer;
+    capacity_ = capacity;
+    ++generation_;
+}
+
+void tdl::MaterialTable::destroy() {
+    delete buffer_;
+
+    buffer_ = nullptr;
+    capacity_ = 0;
+    count_ = 0;
+    indices_.clear();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+
+#include <vulkan/vulkan.hpp>
+
+#include "buffers.hpp"
+#include "deletion.hpp"
+#include "../objects.hpp"
+
+namespace tdl {
+    /**
+     * @breif Every distinct material of the scene in one storage buffer, objects only keep their index into it
+     *
+     * Objects that share a material share its entry, so the table holds one copy per material instead of one per
+     * object and frame in flight. Entries are never changed or removed, an object whose material changes is given the
+     * index of another entry. New entries are written past the ones the frames in flight read, so they are copied into
+     * the buffer straight away. A grown buffer replaces the old one for the frame being recorded, the old one goes to
+     * the DeletionQueue until the other frames in flight are done with it.
+    */
+    class MaterialTable {
+        public:
+            static constexpr uint32_t initial_capacity = 64;
+
+            /**
+             * @breif Creates the buffer with room for initial_capacity materials
+             *
+             * @param device current GPU (logical)
+             * @param physical_device current GPU (physical)
+             * @param graphics_queue queue the buffer is created with
+             * @param command_pool pool used by the buffer
+             * @param deletions queue the buffer goes to when it is grown
+            */
+            void init (
+                vk::Device device,
+                vk::PhysicalDevice physical_device,
+                vk::Queue graphics_queue,
+                vk::CommandPool command_pool,
+                DeletionQueue& deletions
+            );
+
+            /**
+             * @breif Index of the material, it is added to the table if no object used it before
+             *
+             * @param material material of an object, MaterialObject::texture_slot included
+             * @return uint32_t index of the material, DrawConstants::material of the objects using it
+            */
+            uint32_t add (
+                const MaterialObject& material
+            );
+
+            [[nodiscard]] vk::Buffer buffer() const { return buffer_->getBuffer(); }
+            [[nodiscard]] vk::DeviceSize bytes() const { return capacity_ * sizeof(MaterialObject); }
+            [[nodiscard]] uint32_t count() const { return count_; }
+
+            // incremented when the buffer is created again, the descriptor sets reading it have to be written again
+            [[nodiscard]] uint64_t generation() const { return generation_; }
+
+            void destroy();
+
+        private:
+            using Key = std::array<uint32_t, sizeof(MaterialObject) / sizeof(uint32_t)>; // bits of a MaterialObject
+
+            void reserve(uint32_t capacity);
+
+            vk::Device device_;
+            vk::PhysicalDevice physical_device_;
+            vk::Queue graphics_queue_;
+            vk::CommandPool command_pool_;
+            DeletionQueue* deletions_ = nullptr;
+
+            MemoryBuffer* buffer_ = nullptr; // host visible and persistently mapped
+            uint32_t capacity_ = 0;
+            uint32_t count_ = 0;
+            uint64_t generation_ = 0;
+
+            std::map<Key, uint32_t> indices_;
+    };
+};
@@ -0,0 +1,362 @@
+#include "meshlets.hpp"
+
+#include <ranges>
+#include <stdexcept>
+
+static_assert(sizeof(tdl::MeshletCuller::Constants) <= 128, "push constants are only guaranteed to hold 128 bytes");
+
+void tdl::MeshletCuller::init(
+    const vk::Device device,
+    const vk::PhysicalDevice physical_device,
+    const vk::Queue graphics_queue,
+    const vk::CommandPool command_pool,
+    const std::vector<char>& comp,
+    const unsigned int max_f_frames,
+    const vk::ImageView pyramid,
+    const vk::Sampler sampler
+) {
+    device_ = device;
+    physical_device_ = physical_device;
+    graphics_queue_ = graphics_queue;
+    command_pool_ = command_pool;
+    max_f_frames_ = max_f_frames;
+    pyramid_ = pyramid;
+    pyramid_sampler_ = sampler;
+
+    createPipeline(comp);
+}
+
+void tdl::MeshletCuller::setPyramid(
+    const vk::ImageView pyramid,
+    const vk::Sampler sampler
+) {
+    pyramid_ = pyramid;
+    pyramid_sampler_ = sampler;
+
+    const vk::DescriptorImageInfo image_info {
+        pyramid_sampler_,
+        pyramid_,
+        vk::ImageLayout::eGeneral
+    };
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    for (const auto& slot : targets_ | std::views::values) {
+        for (const vk::DescriptorSet set : slot.sets) {
+            writes.emplace_back(set, 5, 0, 1, vk::DescriptorType::eCombinedImageSampler, &image_info, nullptr, nullptr);
+        }
+    }
+
+    device_.updateDescriptorSets(writes, nullptr);
+}
+
+void tdl::MeshletCuller::begin(
+    const unsigned long cframe
+) {
+    cframe_ = cframe;
+    queue_.clear();
+    meshlets_ = 0;
+    triangles_drawn_ = 0;
+}
+
+tdl::MeshletCuller::Output tdl::MeshletCuller::add(
+    const ObjectInterface* const object,
+    const Mesh& mesh,
+    const Constants& constants
+) {
+    const bool inserted = !targets_.contains(object);
+    Target& slot = target(object, mesh);
+
+    // the fence of this frame in flight has been waited on, so the last commands written into the slot are final
+    if (slot.written[cframe_]) {
+        for (uint32_t phase = 0; phase < 2; ++phase) {
+            const MemoryBuffer* const command = slot.commands[cframe_ * 2 + phase];
+            triangles_drawn_ += static_cast<const vk::DrawIndexedIndirectCommand*>(command->data())->indexCount / 3;
+        }
+    }
+    slot.written[cframe_] = true;
+
+    Job job {};
+    Output output {};
+    for (uint32_t phase = 0; phase < 2; ++phase) {
+        const uint32_t i = cframe_ * 2 + phase;
+        job.sets[phase] = slot.sets[i];
+        job.commands[phase] = slot.commands[i]->getBuffer();
+        output[phase] = {slot.indices[i]->getBuffer(), slot.commands[i]->getBuffer(), 0};
+    }
+    job.visibility = slot.visibility->getBuffer();
+    job.clear = inserted;
+    job.constants = constants;
+
+    queue_.push_back(job);
+    meshlets_ += constants.meshlet_count;
+
+    return output;
+}
+
+void tdl::MeshletCuller::record(
+    const vk::CommandBuffer command_buffer,
+    const uint32_t phase
+) {
+    if (queue_.empty()) return;
+
+    // the shader only appends, every command starts out empty. Both phases are reset before the first one, so the
+    // triangles read back stay right in frames without a second phase
+    static constexpr vk::DrawIndexedIndirectCommand empty {0, 1, 0, 0, 0};
+    if (phase == 0) {
+        for (Job& job : queue_) {
+            for (const vk::Buffer command : job.commands) {
+                command_buffer.updateBuffer(command, 0, sizeof(empty), &empty);
+            }
+
+            // new meshlets were not visible last frame, the second phase tests them against the pyramid
+            if (job.clear) {
+                command_buffer.fillBuffer(job.visibility, 0, VK_WHOLE_SIZE, 0);
+                job.clear = false;
+            }
+        }
+    }
+
+    // also orders the visibility the last frame wrote before this frame reads it
+    const vk::MemoryBarrier reset {
+        vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite
+    };
+
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        {},
+        reset,
+        nullptr,
+        nullptr
+    );
+
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_);
+
+    for (Job& job : queue_) {
+        job.constants.phase = phase;
+
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout_, 0, 1, &job.sets[phase], 0, nullptr);
+        command_buffer.pushConstants(
+            pipeline_layout_,
+            vk::ShaderStageFlagBits::eCompute,
+            0,
+            sizeof(Constants),
+            &job.constants
+        );
+        command_buffer.dispatch((job.constants.meshlet_count + group_size - 1) / group_size, 1, 1);
+    }
+}
+
+void tdl::MeshletCuller::destroy() {
+    if (!device_) return;
+
+    for (auto& slot : targets_ | std::views::values) {
+        for (uint32_t i = 0; i < slot.sets.size(); ++i) {
+            delete slot.indices[i];
+            delete slot.commands[i];
+        }
+        delete slot.visibility;
+        device_.destroyDescriptorPool(slot.pool);
+    }
+    targets_.clear();
+    queue_.clear();
+
+    device_.destroyPipeline(pipeline_);
+    device_.destroyPipelineLayout(pipeline_layout_);
+    device_.destroyDescriptorSetLayout(layout_);
+
+    pipeline_ = nullptr;
+    pipeline_layout_ = nullptr;
+    layout_ = nullptr;
+}
+
+tdl::MeshletCuller::Target& tdl::MeshletCuller::target(
+    const ObjectInterface* const object,
+    const Mesh& mesh
+) {
+    const auto [it, inserted] = targets_.try_emplace(object);
+    Target& slot = it->second;
+    if (!inserted) return slot;
+
+    const vk::DeviceSize index_bytes = mesh.indexBytes();
+    const uint32_t set_count = 2 * max_f_frames_; // one per phase
+
+    const vk::DescriptorPoolSize pool_sizes[] = {
+        {vk::DescriptorType::eStorageBuffer, 5 * set_count},
+        {vk::DescriptorType::eCombinedImageSampler, set_count}
+    };
+
+    try {
+        slot.pool = device_.createDescriptorPool({
+            {},
+            set_count,
+            2,
+            pool_sizes
+        });
+
+        const std::vector<vk::DescriptorSetLayout> layouts (set_count, layout_);
+        slot.sets = device_.allocateDescriptorSets({
+            slot.pool,
+            set_count,
+            layouts.data()
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 083: Failed to create meshlet culling descriptor sets. MeshletCuller::target(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    slot.written.assign(max_f_frames_, false);
+
+    slot.visibility = new MemoryBuffer {
+        mesh.meshletCount() * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        device_,
+        graphics_queue_,
+        command_pool_,
+        physical_device_
+    };
+
+    const vk::DescriptorImageInfo image_info {
+        pyramid_sampler_,
+        pyramid_,
+        vk::ImageLayout::eGeneral
+    };
+
+    for (uint32_t i = 0; i < set_count; ++i) {
+        slot.indices.push_back(new MemoryBuffer {
+            index_bytes,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndexBuffer,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            device_,
+            graphics_queue_,
+            command_pool_,
+            physical_device_
+        });
+
+        slot.commands.push_back(new MemoryBuffer {
+            sizeof(vk::DrawIndexedIndirectCommand),
+            vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            device_,
+            graphics_queue_,
+            command_pool_,
+            physical_device_
+        });
+        slot.commands.back()->map();
+
+        const vk::DescriptorBufferInfo buffer_infos[] = {
+            {mesh.meshletBuffer(), 0, mesh.meshletCount() * sizeof(Meshlet)},
+            {mesh.indexBuffer(), 0, index_bytes}, // level 0 is at the start of the index buffer
+            {slot.indices[i]->getBuffer(), 0, index_bytes},
+            {slot.commands[i]->getBuffer(), 0, sizeof(vk::DrawIndexedIndirectCommand)},
+            {slot.visibility->getBuffer(), 0, mesh.meshletCount() * sizeof(uint32_t)}
+        };
+
+        std::array<vk::WriteDescriptorSet, 6> writes;
+        for (uint32_t b = 0; b < 5; ++b) {
+            writes[b] = {
+                slot.sets[i],
+                b,
+                0,
+                1,
+                vk::DescriptorType::eStorageBuffer,
+                nullptr,
+                &buffer_infos[b],
+                nullptr
+            };
+        }
+        writes[5] = {
+            slot.sets[i],
+            5,
+            0,
+            1,
+            vk::DescriptorType::eCombinedImageSampler,
+            &image_info,
+            nullptr,
+            nullptr
+        };
+
+        device_.updateDescriptorSets(writes, nullptr);
+    }
+
+    return slot;
+}
+
+void tdl::MeshletCuller::createPipeline(
+    const std::vector<char>& comp
+) {
+    std::array<vk::DescriptorSetLayoutBinding, 6> bindings;
+    for (uint32_t i = 0; i < bindings.size(); ++i) {
+        bindings[i] = {
+            i,
+            i == 5 ? vk::DescriptorType::eCombinedImageSampler : vk::DescriptorType::eStorageBuffer,
+            1,
+            vk::ShaderStageFlagBits::eCompute,
+            nullptr
+        };
+    }
+
+    const vk::PushConstantRange push_constants {
+        vk::ShaderStageFlagBits::eCompute,
+        0,
+        sizeof(Constants)
+    };
+
+    vk::ShaderModule module;
+
+    try {
+        layout_ = device_.createDescriptorSetLayout({
+            {},
+            static_cast<uint32_t>(bindings.size()),
+            bindings.data()
+        });
+
+        pipeline_layout_ = device_.createPipelineLayout({
+            {},
+            1,
+            &layout_,
+            1,
+            &push_constants
+        });
+
+        module = device_.createShaderModule({
+            {},
+            comp.size(),
+            reinterpret_cast<const uint32_t*>(comp.data())
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 084: Failed to create meshlet culling pipeline layout. MeshletCuller::createPipeline(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    const vk::ComputePipelineCreateInfo info {
+        {},
+        {
+            {},
+            vk::ShaderStageFlagBits::eCompute,
+            module,
+            "main"
+        },
+        pipeline_layout_
+    };
+
+    try {
+        pipeline_ = device_.createComputePipeline(nullptr, info).value;
+    } catch (const vk::SystemError& err) {
+        device_.destroyShaderModule(module);
+        throw std::runtime_error(
+            "ERR 085: Failed to create meshlet culling pipeline. MeshletCuller::createPipeline(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    device_.destroyShaderModule(module);
+}
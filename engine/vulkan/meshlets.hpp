@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include "buffers.hpp"
+#include "occlusion.hpp"
+#include "../objects.hpp"
+
+namespace tdl {
+    /**
+     * @breif Compute pass that culls the meshlets of large meshes before they are drawn
+     *
+     * One invocation of cull.comp tests one meshlet against the frustum and, if enabled, its normal cone against the
+     * camera. Visible meshlets append their triangles to an index buffer of the object and count them in an indirect
+     * draw command, so a single scanned mesh that covers the whole scene only draws what is in view. Every object gets
+     * its own output buffers per frame in flight, they are created the first time the object is culled.
+     *
+     * With CullFlags::occlusion the meshlets are culled in the two phases described in OcclusionCuller, every object
+     * then keeps the visibility of its meshlets and gets a second set of output buffers for the second phase.
+    */
+    class MeshletCuller {
+        public:
+            static constexpr uint32_t group_size = 64; // local_size_x of cull.comp
+
+            /**
+             * @breif Push constants of cull.comp, everything in the model space of the object
+            */
+            struct Constants {
+                glm::mat4 to_clip {1.0f}; // model view projection of the object
+                glm::vec4 camera {0.0f}; // camera position
+                glm::vec4 pyramid {0.0f}; // HiZ::size()
+                uint32_t meshlet_count = 0;
+                uint32_t phase = 0; // set by record()
+                uint32_t flags = 0; // CullFlags
+                uint32_t padding = 0;
+            };
+
+            /**
+             * @breif Draws of the object in phase 0 and 1, see Mesh::renderIndirect()
+            */
+            using Output = std::array<IndirectDraw, 2>;
+
+            /**
+             * @breif Creates the compute pipeline
+             *
+             * @param device current GPU (logical)
+             * @param physical_device current GPU (physical)
+             * @param graphics_queue queue the output buffers are created with, it has to support compute as well
+             * @param command_pool pool used by the output buffers
+             * @param comp SPIR-V of the culling shader
+             * @param max_f_frames max number of pre rendered frames
+             * @param pyramid HiZ::view(), only read with CullFlags::occlusion
+             * @param sampler HiZ::sampler()
+            */
+            void init (
+                vk::Device device,
+                vk::PhysicalDevice physical_device,
+                vk::Queue graphics_queue,
+                vk::CommandPool command_pool,
+                const std::vector<char>& comp,
+                unsigned int max_f_frames,
+                vk::ImageView pyramid,
+                vk::Sampler sampler
+            );
+
+            /**
+             * @breif Points every descriptor set at a new pyramid, has to be called when the HiZ is created again
+            */
+            void setPyramid (
+                vk::ImageView pyramid,
+                vk::Sampler sampler
+            );
+
+            /**
+             * @breif Starts a frame, drops the objects queued for the last one
+            */
+            void begin (
+                unsigned long cframe
+            );
+
+            /**
+             * @breif Queues the culling of an object for record()
+             *
+             * @param object identifies the output buffers, only compared
+             * @param mesh mesh of the object, has to be Mesh::cullable()
+             * @param constants transform, camera and flags in the model space of the object, phase is set by record()
+             * @return Output buffers the object has to draw from this frame
+            */
+            Output add (
+                const ObjectInterface* object,
+                const Mesh& mesh,
+                const Constants& constants
+            );
+
+            /**
+             * @breif Records the culling of every queued object, has to be outside of a render pass
+             *
+             * The output has to be made visible to the index fetch and the indirect draws by the caller (the render
+             * graph of the frame, Usage::DrawIndirect). Phase 1 is only recorded with CullFlags::occlusion, after
+             * HiZ::build().
+             *
+             * @param command_buffer command buffer of the frame
+             * @param phase 0 before the pyramid is built, 1 after
+            */
+            void record (
+                vk::CommandBuffer command_buffer,
+                uint32_t phase
+            );
+
+            [[nodiscard]] uint32_t objects() const { return static_cast<uint32_t>(queue_.size()); }
+            [[nodiscard]] uint64_t meshlets() const { return meshlets_; }
+
+            /**
+             * @breif Triangles the queued objects drew the last time this frame in flight slot was used
+            */
+            [[nodiscard]] uint64_t trianglesDrawn() const { return triangles_drawn_; }
+
+            void destroy();
+
+        private:
+            /**
+             * @breif Output buffers and descriptor sets of one object, two per frame in flight (one per phase)
+            */
+            struct Target {
+                vk::DescriptorPool pool;
+                std::vector<vk::DescriptorSet> sets;
+                std::vector<MemoryBuffer*> indices;
+                std::vector<MemoryBuffer*> commands; // host visible so the visible triangles can be counted
+                MemoryBuffer* visibility = nullptr; // one uint per meshlet, shared by the frames in flight
+                std::vector<uint8_t> written; // the slot holds the result of an earlier frame
+            };
+
+            struct Job {
+                std::array<vk::DescriptorSet, 2> sets;
+                std::array<vk::Buffer, 2> commands;
+                vk::Buffer visibility; // cleared before the first dispatch if the target is new
+                bool clear;
+                Constants constants;
+            };
+
+            Target& target (
+                const ObjectInterface* object,
+                const Mesh& mesh
+            );
+
+            void createPipeline(const std::vector<char>& comp);
+
+            vk::Device device_;
+            vk::PhysicalDevice physical_device_;
+            vk::Queue graphics_queue_;
+            vk::CommandPool command_pool_;
+            unsigned int max_f_frames_ = 0;
+            vk::ImageView pyramid_;
+            vk::Sampler pyramid_sampler_;
+
+            vk::DescriptorSetLayout layout_;
+            vk::PipelineLayout pipeline_layout_;
+            vk::Pipeline pipeline_;
+
+            std::unordered_map<const ObjectInterface*, Target> targets_;
+            std::vector<Job> queue_;
+
+            unsigned long cframe_ = 0;
+            uint64_t meshlets_ = 0;
+            uint64_t triangles_drawn_ = 0;
+    };
+};
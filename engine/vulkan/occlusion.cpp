@@ -0,0 +1,692 @@
+#include "occlusion.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+static_assert(sizeof(tdl::OcclusionCuller::Constants) <= 128, "push constants are only guaranteed to hold 128 bytes");
+
+void tdl::HiZ::create(
+    const vk::Device device,
+    const vk::PhysicalDevice physical_device,
+    const vk::Queue graphics_queue,
+    const vk::CommandPool command_pool,
+    const vk::Extent2D extent,
+    const vk::ImageView depth,
+    const std::vector<char>& comp
+) {
+    device_ = device;
+    physical_device_ = physical_device;
+    graphics_queue_ = graphics_queue;
+    command_pool_ = command_pool;
+    extent_ = extent;
+    levels_ = std::bit_width(std::max(extent.width, extent.height));
+
+    createImage();
+    createDescriptors(depth);
+    createPipeline(comp);
+}
+
+void tdl::HiZ::build(
+    const vk::CommandBuffer command_buffer
+) const {
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_);
+
+    for (uint32_t level = 0; level < levels_; ++level) {
+        const vk::Extent2D source = level == 0 ? extent_ : levelExtent(level - 1);
+        const vk::Extent2D target = levelExtent(level);
+
+        const Reduce reduce {
+            {static_cast<int>(source.width), static_cast<int>(source.height)},
+            {static_cast<int>(target.width), static_cast<int>(target.height)},
+            level == 0 ? 1u : 0u
+        };
+
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout_, 0, 1, &sets_[level], 0, nullptr);
+        command_buffer.pushConstants(pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Reduce), &reduce);
+        command_buffer.dispatch(
+            (target.width + group_size - 1) / group_size,
+            (target.height + group_size - 1) / group_size,
+            1
+        );
+
+        // the next level reads this one, the culling shaders after the last level wait through the render graph
+        if (level + 1 == levels_) break;
+
+        const vk::ImageMemoryBarrier barrier {
+            vk::AccessFlagBits::eShaderWrite,
+            vk::AccessFlagBits::eShaderRead,
+            vk::ImageLayout::eGeneral,
+            vk::ImageLayout::eGeneral,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            image_,
+            {
+                vk::ImageAspectFlagBits::eColor,
+                level,
+                1,
+                0,
+                1
+            }
+        };
+
+        command_buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eComputeShader,
+            {},
+            nullptr,
+            nullptr,
+            barrier
+        );
+    }
+}
+
+void tdl::HiZ::destroy() {
+    if (!device_) return;
+
+    device_.destroyPipeline(pipeline_);
+    device_.destroyPipelineLayout(pipeline_layout_);
+    device_.destroyDescriptorPool(pool_);
+    device_.destroyDescriptorSetLayout(layout_);
+    device_.destroySampler(sampler_);
+
+    for (const vk::ImageView view : level_views_) device_.destroyImageView(view);
+    device_.destroyImageView(view_);
+    device_.destroyImage(image_);
+    device_.freeMemory(memory_);
+
+    level_views_.clear();
+    sets_.clear();
+    pipeline_ = nullptr;
+    pipeline_layout_ = nullptr;
+    pool_ = nullptr;
+    layout_ = nullptr;
+    sampler_ = nullptr;
+    view_ = nullptr;
+    image_ = nullptr;
+    memory_ = nullptr;
+}
+
+vk::Extent2D tdl::HiZ::levelExtent(
+    const uint32_t level
+) const {
+    return {std::max(extent_.width >> level, 1u), std::max(extent_.height >> level, 1u)};
+}
+
+void tdl::HiZ::createImage() {
+    const vk::ImageCreateInfo info {
+        {},
+        vk::ImageType::e2D,
+        vk::Format::eR32Sfloat,
+        {extent_.width, extent_.height, 1},
+        levels_,
+        1,
+        vk::SampleCountFlagBits::e1,
+        vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+        vk::SharingMode::eExclusive,
+        0, nullptr,
+        vk::ImageLayout::eUndefined
+    };
+
+    try {
+        image_ = device_.createImage(info);
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 086: Failed to create HiZ pyramid. HiZ::createImage(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    const vk::MemoryRequirements reqs = device_.getImageMemoryRequirements(image_);
+
+    try {
+        memory_ = device_.allocateMemory({
+            reqs.size,
+            MemoryBuffer::findMemoryType(
+                physical_device_,
+                reqs.memoryTypeBits,
+                vk::MemoryPropertyFlagBits::eDeviceLocal
+            )
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 087: Failed to allocate memory for HiZ pyramid. HiZ::createImage(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    device_.bindImageMemory(image_, memory_, 0);
+
+    try {
+        view_ = device_.createImageView({
+            {},
+            image_,
+            vk::ImageViewType::e2D,
+            vk::Format::eR32Sfloat,
+            {},
+            {
+                vk::ImageAspectFlagBits::eColor,
+                0,
+                levels_,
+                0,
+                1
+            }
+        });
+
+        for (uint32_t level = 0; level < levels_; ++level) {
+            level_views_.push_back(device_.createImageView({
+                {},
+                image_,
+                vk::ImageViewType::e2D,
+                vk::Format::eR32Sfloat,
+                {},
+                {
+                    vk::ImageAspectFlagBits::eColor,
+                    level,
+                    1,
+                    0,
+                    1
+                }
+            }));
+        }
+
+        // texelFetch() is all the shaders use, the sampler only has to allow every level
+        sampler_ = device_.createSampler({
+            {},
+            vk::Filter::eNearest,
+            vk::Filter::eNearest,
+            vk::SamplerMipmapMode::eNearest,
+            vk::SamplerAddressMode::eClampToEdge,
+            vk::SamplerAddressMode::eClampToEdge,
+            vk::SamplerAddressMode::eClampToEdge,
+            0.0f,
+            VK_FALSE,
+            1.0f,
+            VK_FALSE,
+            vk::CompareOp::eAlways,
+            0.0f,
+            static_cast<float>(levels_),
+            vk::BorderColor::eFloatOpaqueWhite,
+            VK_FALSE
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 088: Failed to create HiZ pyramid views. HiZ::createImage(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    // the pyramid never leaves the general layout, it is written and read by compute shaders only
+    const vk::CommandBuffer command_buffer = CommandBuffer::begin(device_, command_pool_);
+
+    const vk::ImageMemoryBarrier barrier {
+        {},
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+        vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eGeneral,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        image_,
+        {
+            vk::ImageAspectFlagBits::eColor,
+            0,
+            levels_,
+            0,
+            1
+        }
+    };
+
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eComputeShader,
+        {},
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+    );
+
+    CommandBuffer::end(device_, command_buffer, command_pool_, graphics_queue_);
+}
+
+void tdl::HiZ::createDescriptors(
+    const vk::ImageView depth
+) {
+    static constexpr std::array<vk::DescriptorSetLayoutBinding, 2> bindings {{
+        {0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute, nullptr},
+        {1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute, nullptr}
+    }};
+
+    const vk::DescriptorPoolSize pool_sizes[] = {
+        {vk::DescriptorType::eCombinedImageSampler, levels_},
+        {vk::DescriptorType::eStorageImage, levels_}
+    };
+
+    try {
+        layout_ = device_.createDescriptorSetLayout({
+            {},
+            static_cast<uint32_t>(bindings.size()),
+            bindings.data()
+        });
+
+        pool_ = device_.createDescriptorPool({
+            {},
+            levels_,
+            2,
+            pool_sizes
+        });
+
+        const std::vector<vk::DescriptorSetLayout> layouts (levels_, layout_);
+        sets_ = device_.allocateDescriptorSets({
+            pool_,
+            levels_,
+            layouts.data()
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 089: Failed to create HiZ descriptor sets. HiZ::createDescriptors(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    for (uint32_t level = 0; level < levels_; ++level) {
+        const vk::DescriptorImageInfo source = level == 0
+            ? vk::DescriptorImageInfo {sampler_, depth, vk::ImageLayout::eDepthStencilReadOnlyOptimal}
+            : vk::DescriptorImageInfo {sampler_, level_views_[level - 1], vk::ImageLayout::eGeneral};
+
+        const vk::DescriptorImageInfo target {
+            nullptr,
+            level_views_[level],
+            vk::ImageLayout::eGeneral
+        };
+
+        const std::array<vk::WriteDescriptorSet, 2> writes {{
+            {sets_[level], 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &source, nullptr, nullptr},
+            {sets_[level], 1, 0, 1, vk::DescriptorType::eStorageImage, &target, nullptr, nullptr}
+        }};
+
+        device_.updateDescriptorSets(writes, nullptr);
+    }
+}
+
+void tdl::HiZ::createPipeline(
+    const std::vector<char>& comp
+) {
+    const vk::PushConstantRange push_constants {
+        vk::ShaderStageFlagBits::eCompute,
+        0,
+        sizeof(Reduce)
+    };
+
+    vk::ShaderModule module;
+
+    try {
+        pipeline_layout_ = device_.createPipelineLayout({
+            {},
+            1,
+            &layout_,
+            1,
+            &push_constants
+        });
+
+        module = device_.createShaderModule({
+            {},
+            comp.size(),
+            reinterpret_cast<const uint32_t*>(comp.data())
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 090: Failed to create HiZ pipeline layout. HiZ::createPipeline(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    const vk::ComputePipelineCreateInfo info {
+        {},
+        {
+            {},
+            vk::ShaderStageFlagBits::eCompute,
+            module,
+            "main"
+        },
+        pipeline_layout_
+    };
+
+    try {
+        pipeline_ = device_.createComputePipeline(nullptr, info).value;
+    } catch (const vk::SystemError& err) {
+        device_.destroyShaderModule(module);
+        throw std::runtime_error(
+            "ERR 091: Failed to create HiZ pipeline. HiZ::createPipeline(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    device_.destroyShaderModule(module);
+}
+
+void tdl::OcclusionCuller::init(
+    const vk::Device device,
+    const vk::PhysicalDevice physical_device,
+    const vk::Queue graphics_queue,
+    const vk::CommandPool command_pool,
+    DescriptorAllocator& descriptors,
+    const std::vector<char>& comp,
+    const unsigned int max_f_frames,
+    const vk::ImageView pyramid,
+    const vk::Sampler sampler
+) {
+    device_ = device;
+    physical_device_ = physical_device;
+    graphics_queue_ = graphics_queue;
+    command_pool_ = command_pool;
+    descriptors_ = &descriptors;
+    max_f_frames_ = max_f_frames;
+    pyramid_ = pyramid;
+    pyramid_sampler_ = sampler;
+
+    counts_.assign(max_f_frames_, 0);
+
+    createPipeline(comp);
+}
+
+void tdl::OcclusionCuller::setPyramid(
+    const vk::ImageView pyramid,
+    const vk::Sampler sampler
+) {
+    pyramid_ = pyramid;
+    pyramid_sampler_ = sampler;
+}
+
+void tdl::OcclusionCuller::begin(
+    const unsigned long cframe,
+    const uint32_t object_count
+) {
+    cframe_ = cframe;
+
+    // the fence of this frame in flight has been waited on, so the commands written into the slot are final
+    tested_ = 0;
+    culled_ = 0;
+    redrawn_ = 0;
+
+    const uint32_t count = counts_[cframe_];
+    if (count > 0) {
+        const auto* const bounds = static_cast<const Bounds*>(bounds_[cframe_]->data());
+        const auto* const commands = static_cast<const vk::DrawIndexedIndirectCommand*>(commands_[cframe_]->data());
+
+        for (uint32_t i = 0; i < count; ++i) {
+            if (bounds[i].index_count == 0) continue;
+
+            ++tested_;
+            if (commands[i].instanceCount == 0 && commands[count + i].instanceCount == 0) ++culled_;
+            if (commands[count + i].instanceCount > 0) ++redrawn_;
+        }
+    }
+
+    counts_[cframe_] = object_count;
+    if (object_count == 0) return;
+
+    if (object_count > capacity_) {
+        device_.waitIdle(); // the other frames in flight still use the old buffers
+        reserve(std::max(object_count, 2 * capacity_));
+    }
+
+    // objects that are not added keep an empty draw
+    std::memset(bounds_[cframe_]->data(), 0, object_count * sizeof(Bounds));
+
+    // the set of the last frame in this slot was recycled with the slot's transient pools
+    set_ = descriptors_->allocateTransient(layout_, cframe_);
+    writeDescriptors();
+}
+
+std::array<tdl::IndirectDraw, 2> tdl::OcclusionCuller::add(
+    const uint32_t object,
+    const glm::vec4& sphere,
+    const MeshLod& lod
+) {
+    static_cast<Bounds*>(bounds_[cframe_]->data())[object] = {sphere, lod.first_index, lod.index_count};
+
+    const vk::Buffer commands = commands_[cframe_]->getBuffer();
+    const vk::DeviceSize stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+    return {{
+        {nullptr, commands, object * stride},
+        {nullptr, commands, (counts_[cframe_] + object) * stride}
+    }};
+}
+
+void tdl::OcclusionCuller::record(
+    const vk::CommandBuffer command_buffer,
+    const uint32_t phase,
+    Constants constants
+) {
+    const uint32_t count = counts_[cframe_];
+    if (count == 0) return;
+
+    if (phase == 0) {
+        // the commands read back stay right in frames without a second phase
+        const vk::DeviceSize bytes = count * sizeof(vk::DrawIndexedIndirectCommand);
+        command_buffer.fillBuffer(commands_[cframe_]->getBuffer(), bytes, bytes, 0);
+
+        // objects added to the scene were not visible last frame, the second phase tests them against the pyramid
+        if (clear_) {
+            command_buffer.fillBuffer(visibility_->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+            clear_ = false;
+        }
+    }
+
+    // also orders the visibility the last frame wrote before this frame reads it
+    const vk::MemoryBarrier ready {
+        vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite
+    };
+
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        {},
+        ready,
+        nullptr,
+        nullptr
+    );
+
+    constants.object_count = count;
+    constants.phase = phase;
+
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_);
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout_, 0, 1, &set_, 0, nullptr);
+    command_buffer.pushConstants(pipeline_layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Constants), &constants);
+    command_buffer.dispatch((count + group_size - 1) / group_size, 1, 1);
+}
+
+void tdl::OcclusionCuller::destroy() {
+    if (!device_) return;
+
+    for (uint32_t i = 0; i < bounds_.size(); ++i) {
+        delete bounds_[i];
+        delete commands_[i];
+    }
+    delete visibility_;
+
+    bounds_.clear();
+    commands_.clear();
+    visibility_ = nullptr;
+    capacity_ = 0;
+
+    device_.destroyPipeline(pipeline_);
+    device_.destroyPipelineLayout(pipeline_layout_);
+    device_.destroyDescriptorSetLayout(layout_);
+
+    pipeline_ = nullptr;
+    pipeline_layout_ = nullptr;
+    set_ = nullptr;
+    layout_ = nullptr;
+}
+
+void tdl::OcclusionCuller::reserve(
+    const uint32_t capacity
+) {
+    for (uint32_t i = 0; i < bounds_.size(); ++i) {
+        delete bounds_[i];
+        delete commands_[i];
+    }
+    delete visibility_;
+
+    bounds_.clear();
+    commands_.clear();
+    capacity_ = capacity;
+
+    for (uint32_t i = 0; i < max_f_frames_; ++i) {
+        bounds_.push_back(new MemoryBuffer {
+            capacity_ * sizeof(Bounds),
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            device_,
+            graphics_queue_,
+            command_pool_,
+            physical_device_
+        });
+        bounds_.back()->map();
+
+        commands_.push_back(new MemoryBuffer {
+            2 * capacity_ * sizeof(vk::DrawIndexedIndirectCommand),
+            vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            device_,
+            graphics_queue_,
+            command_pool_,
+            physical_device_
+        });
+        commands_.back()->map();
+    }
+
+    visibility_ = new MemoryBuffer {
+        capacity_ * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        device_,
+        graphics_queue_,
+        command_pool_,
+        physical_device_
+    };
+    clear_ = true;
+
+    // nothing recorded with the old buffers can be read back
+    counts_.assign(max_f_frames_, 0);
+}
+
+void tdl::OcclusionCuller::writeDescriptors() {
+    const vk::DescriptorImageInfo image_info {
+        pyramid_sampler_,
+        pyramid_,
+        vk::ImageLayout::eGeneral
+    };
+
+    const vk::DescriptorBufferInfo buffer_infos[] = {
+        {bounds_[cframe_]->getBuffer(), 0, VK_WHOLE_SIZE},
+        {commands_[cframe_]->getBuffer(), 0, VK_WHOLE_SIZE},
+        {visibility_->getBuffer(), 0, VK_WHOLE_SIZE}
+    };
+
+    std::array<vk::WriteDescriptorSet, 4> writes;
+    for (uint32_t b = 0; b < 3; ++b) {
+        writes[b] = {
+            set_,
+            b,
+            0,
+            1,
+            vk::DescriptorType::eStorageBuffer,
+            nullptr,
+            &buffer_infos[b],
+            nullptr
+        };
+    }
+    writes[3] = {
+        set_,
+        3,
+        0,
+        1,
+        vk::DescriptorType::eCombinedImageSampler,
+        &image_info,
+        nullptr,
+        nullptr
+    };
+
+    device_.updateDescriptorSets(writes, nullptr);
+}
+
+void tdl::OcclusionCuller::createPipeline(
+    const std::vector<char>& comp
+) {
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+    for (uint32_t i = 0; i < bindings.size(); ++i) {
+        bindings[i] = {
+            i,
+            i == 3 ? vk::DescriptorType::eCombinedImageSampler : vk::DescriptorType::eStorageBuffer,
+            1,
+            vk::ShaderStageFlagBits::eCompute,
+            nullptr
+        };
+    }
+
+    const vk::PushConstantRange push_constants {
+        vk::ShaderStageFlagBits::eCompute,
+        0,
+        sizeof(Constants)
+    };
+
+    vk::ShaderModule module;
+
+    try {
+        layout_ = device_.createDescriptorSetLayout({
+            {},
+            static_cast<uint32_t>(bindings.size()),
+            bindings.data()
+        });
+
+        pipeline_layout_ = device_.createPipelineLayout({
+            {},
+            1,
+            &layout_,
+            1,
+            &push_constants
+        });
+
+        module = device_.createShaderModule({
+            {},
+            comp.size(),
+            reinterpret_cast<const uint32_t*>(comp.data())
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 092: Failed to create occlusion culling pipeline layout. OcclusionCuller::createPipeline(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    const vk::ComputePipelineCreateInfo info {
+        {},
+        {
+            {},
+            vk::ShaderStageFlagBits::eCompute,
+            module,
+            "main"
+        },
+        pipeline_layout_
+    };
+
+    try {
+        pipeline_ = device_.createComputePipeline(nullptr, info).value;
+    } catch (const vk::SystemError& err) {
+        device_.destroyShaderModule(module);
+        throw std::runtime_error(
+            "ERR 093: Failed to create occlusion culling pipeline. OcclusionCuller::createPipeline(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    device_.destroyShaderModule(module);
+}
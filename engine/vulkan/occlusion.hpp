@@ -0,0 +1,271 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include "buffers.hpp"
+#include "descriptors.hpp"
+#include "../objects.hpp"
+
+namespace tdl {
+    /**
+     * @breif Bits of the flags push constant of the culling shaders, the same as in hiz.glsl
+    */
+    struct CullFlags {
+        static constexpr uint32_t frustum = 1; // off when the lens distortion is on
+        static constexpr uint32_t cones = 2; // only used by cull.comp
+        static constexpr uint32_t occlusion = 4; // test against the HiZ pyramid in two phases
+    };
+
+    /**
+     * @breif Hierarchical depth pyramid the culling shaders test bounding spheres against
+     *
+     * Level 0 is a copy of the depth buffer, every further level keeps the furthest depth of the texels it covers, so a
+     * sphere whose nearest depth is behind the 2x2 texels covering its screen rectangle is hidden. The pyramid is built
+     * by hiz.comp from the depth the first culling phase drew, and stays in the general layout. Depends on the size of
+     * the swapchain, has to be destroyed and created again when it changes.
+    */
+    class HiZ {
+        public:
+            static constexpr uint32_t group_size = 8; // local_size_x and local_size_y of hiz.comp
+
+            /**
+             * @breif Creates the pyramid, its views and the downsampling pipeline
+             *
+             * @param device current GPU (logical)
+             * @param physical_device current GPU (physical)
+             * @param graphics_queue queue used to move the pyramid to the general layout
+             * @param command_pool pool used to move the pyramid to the general layout
+             * @param extent size of the depth buffer
+             * @param depth view of the depth buffer, has to be created with vk::ImageUsageFlagBits::eSampled
+             * @param comp SPIR-V of the downsampling shader
+            */
+            void create (
+                vk::Device device,
+                vk::PhysicalDevice physical_device,
+                vk::Queue graphics_queue,
+                vk::CommandPool command_pool,
+                vk::Extent2D extent,
+                vk::ImageView depth,
+                const std::vector<char>& comp
+            );
+
+            /**
+             * @breif Records the downsampling, has to be outside of a render pass
+             *
+             * The depth buffer has to be in vk::ImageLayout::eDepthStencilReadOnlyOptimal and its writes visible to
+             * the compute shader. Only the barriers between the levels are recorded, the caller orders the build after
+             * the last reads of the pyramid and before the next ones (the render graph of the frame).
+            */
+            void build (
+                vk::CommandBuffer command_buffer
+            ) const;
+
+            [[nodiscard]] vk::Image image() const { return image_; }
+            [[nodiscard]] vk::ImageView view() const { return view_; } // every level
+            [[nodiscard]] uint32_t levels() const { return levels_; }
+            [[nodiscard]] vk::Sampler sampler() const { return sampler_; }
+
+            /**
+             * @breif Size of level 0 (xy) and number of levels (z), the pyramid_size push constant of the culling shaders
+            */
+            [[nodiscard]] glm::vec4 size() const {
+                return {static_cast<float>(extent_.width), static_cast<float>(extent_.height), static_cast<float>(levels_), 0.0f};
+            }
+
+            void destroy();
+
+        private:
+            /**
+             * @breif Push constants of hiz.comp
+            */
+            struct Reduce {
+                glm::ivec2 source_size;
+                glm::ivec2 target_size;
+                uint32_t copy; // 1 for level 0
+            };
+
+            void createImage();
+            void createDescriptors(vk::ImageView depth);
+            void createPipeline(const std::vector<char>& comp);
+
+            [[nodiscard]] vk::Extent2D levelExtent(uint32_t level) const;
+
+            vk::Device device_;
+            vk::PhysicalDevice physical_device_;
+            vk::Queue graphics_queue_;
+            vk::CommandPool command_pool_;
+            vk::Extent2D extent_;
+            uint32_t levels_ = 0;
+
+            vk::Image image_;
+            vk::DeviceMemory memory_;
+            vk::ImageView view_;
+            std::vector<vk::ImageView> level_views_; // one per level, written by one dispatch and read by the next
+            vk::Sampler sampler_;
+
+            vk::DescriptorSetLayout layout_;
+            vk::DescriptorPool pool_;
+            std::vector<vk::DescriptorSet> sets_; // one per level
+
+            vk::PipelineLayout pipeline_layout_;
+            vk::Pipeline pipeline_;
+    };
+
+    /**
+     * @breif Compute pass that culls whole objects against the frustum and the HiZ pyramid in two phases
+     *
+     * Phase 0 draws the objects that were visible at the end of the last frame and are still in view, the HiZ pyramid
+     * is built from that depth. Phase 1 tests every object in view against the pyramid, draws the visible ones phase 0
+     * missed and keeps the result for the next frame. Objects that were hidden last frame and show up now are drawn
+     * late instead of not at all, so the culling never leaves holes in the frame.
+     *
+     * Every object writes one VkDrawIndexedIndirectCommand per phase, indexed by its place in the TransformSnapshot.
+     * Objects culled per meshlet by MeshletCuller are not added, their meshlets are tested on their own.
+    */
+    class OcclusionCuller {
+        public:
+            static constexpr uint32_t group_size = 64; // local_size_x of occlusion.comp
+
+            /**
+             * @breif Push constants of occlusion.comp
+            */
+            struct Constants {
+                glm::mat4 view_proj {1.0f};
+                glm::vec4 pyramid {0.0f}; // HiZ::size()
+                uint32_t object_count = 0;
+                uint32_t phase = 0;
+                uint32_t flags = 0; // CullFlags::frustum and CullFlags::occlusion
+                uint32_t padding = 0;
+            };
+
+            /**
+             * @breif World space bounds and level of detail of one object, laid out like Bounds in occlusion.comp
+            */
+            struct Bounds {
+                glm::vec4 sphere {0.0f};
+                uint32_t first_index = 0;
+                uint32_t index_count = 0; // 0 for objects that were not added
+                uint32_t padding[2] {};
+            };
+
+            /**
+             * @breif Creates the compute pipeline
+             *
+             * @param device current GPU (logical)
+             * @param physical_device current GPU (physical)
+             * @param graphics_queue queue the buffers are created with, it has to support compute as well
+             * @param command_pool pool used by the buffers
+             * @param descriptors allocator of the transient set every frame binds
+             * @param comp SPIR-V of the culling shader
+             * @param max_f_frames max number of pre rendered frames
+             * @param pyramid HiZ::view()
+             * @param sampler HiZ::sampler()
+            */
+            void init (
+                vk::Device device,
+                vk::PhysicalDevice physical_device,
+                vk::Queue graphics_queue,
+                vk::CommandPool command_pool,
+                DescriptorAllocator& descriptors,
+                const std::vector<char>& comp,
+                unsigned int max_f_frames,
+                vk::ImageView pyramid,
+                vk::Sampler sampler
+            );
+
+            /**
+             * @breif Points the sets of the next frames at a new pyramid, has to be called when the HiZ is created again
+            */
+            void setPyramid (
+                vk::ImageView pyramid,
+                vk::Sampler sampler
+            );
+
+            /**
+             * @breif Starts a frame and counts what the last frame in the same frame in flight slot culled
+             *
+             * The buffers only grow when objects are added to the scene, which waits for the GPU once. The descriptor set
+             * is a transient set of the slot, so DescriptorAllocator::beginFrame() has to be called first.
+             *
+             * @param cframe frame in flight slot, its fence has to be waited on
+             * @param object_count objects in the TransformSnapshot
+            */
+            void begin (
+                unsigned long cframe,
+                uint32_t object_count
+            );
+
+            /**
+             * @breif Adds an object to the culling of this frame
+             *
+             * @param object place of the object in the TransformSnapshot, it has to stay the same between frames
+             * @param sphere world space bounding sphere
+             * @param lod level of detail the object draws this frame
+             * @return std::array<IndirectDraw, 2> draws of the object in phase 0 and 1
+            */
+            std::array<IndirectDraw, 2> add (
+                uint32_t object,
+                const glm::vec4& sphere,
+                const MeshLod& lod
+            );
+
+            /**
+             * @breif Records the culling of one phase, has to be outside of a render pass
+             *
+             * The commands have to be made visible to the indirect draws by the caller (the render graph of the frame).
+             *
+             * @param command_buffer command buffer of the frame
+             * @param phase 0 before the pyramid is built, 1 after HiZ::build()
+             * @param constants view projection, pyramid and flags of the frame
+            */
+            void record (
+                vk::CommandBuffer command_buffer,
+                uint32_t phase,
+                Constants constants
+            );
+
+            // from the last frame that used the same frame in flight slot
+            [[nodiscard]] uint64_t tested() const { return tested_; }
+            [[nodiscard]] uint64_t culled() const { return culled_; } // drawn in neither phase
+            [[nodiscard]] uint64_t redrawn() const { return redrawn_; } // drawn by phase 1
+
+            void destroy();
+
+        private:
+            void reserve(uint32_t capacity);
+            void writeDescriptors();
+            void createPipeline(const std::vector<char>& comp);
+
+            vk::Device device_;
+            vk::PhysicalDevice physical_device_;
+            vk::Queue graphics_queue_;
+            vk::CommandPool command_pool_;
+            unsigned int max_f_frames_ = 0;
+            vk::ImageView pyramid_;
+            vk::Sampler pyramid_sampler_;
+
+            DescriptorAllocator* descriptors_ = nullptr;
+            vk::DescriptorSetLayout layout_;
+            vk::DescriptorSet set_; // transient, written by every frame for its own buffers
+            vk::PipelineLayout pipeline_layout_;
+            vk::Pipeline pipeline_;
+
+            uint32_t capacity_ = 0; // objects the buffers have room for
+            std::vector<MemoryBuffer*> bounds_; // host visible, one per frame in flight
+            std::vector<MemoryBuffer*> commands_; // host visible so the culled objects can be counted
+            MemoryBuffer* visibility_ = nullptr; // one uint per object, shared by the frames in flight
+            bool clear_ = false; // visibility_ is new and has to be cleared before it is read
+            std::vector<uint32_t> counts_; // objects recorded by each frame in flight slot
+
+            unsigned long cframe_ = 0;
+            uint64_t tested_ = 0;
+            uint64_t culled_ = 0;
+            uint64_t redrawn_ = 0;
+    };
+};
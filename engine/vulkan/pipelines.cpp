@@ -0,0 +1,343 @@
+#include "pipelines.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+
+#include "../objects.hpp"
+
+void tdl::PipelineVariants::init(
+    const vk::Device device,
+    const vk::PipelineLayout layout,
+    const vk::RenderPass render_pass,
+    const vk::Extent2D extent,
+    const std::vector<char>& vert,
+    const std::vector<char>& frag,
+    const std::vector<char>& depth,
+    const bool count_fragments,
+    const uint32_t color_attachments,
+    const uint32_t texture_count
+) {
+    device_ = device;
+    layout_ = layout;
+    render_pass_ = render_pass;
+    extent_ = extent;
+    count_fragments_ = count_fragments;
+    color_attachments_ = color_attachments;
+    texture_count_ = texture_count;
+
+    vert_ = createModule(vert);
+    frag_ = createModule(frag);
+    depth_vert_ = createModule(depth);
+
+    try {
+        cache_ = device_.createPipelineCache({});
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 070: Failed to create pipeline cache. PipelineVariants::init(...)\n"
+            + std::string(err.what())
+        );
+    }
+}
+
+vk::Pipeline tdl::PipelineVariants::get(
+    const PipelineKey& key
+) {
+    vk::Pipeline& pipeline = pipelines_[key.id()];
+    if (!pipeline) pipeline = create(key, false);
+
+    return pipeline;
+}
+
+vk::Pipeline tdl::PipelineVariants::depth(
+    const bool compressed
+) {
+    vk::Pipeline& pipeline = depth_[compressed];
+
+    if (!pipeline) {
+        PipelineKey key;
+        key.compressed = compressed;
+
+        pipeline = create(key, true);
+    }
+
+    return pipeline;
+}
+
+uint32_t tdl::PipelineVariants::created() const {
+    uint32_t count = 0;
+    for (const auto& pipeline : pipelines_) count += pipeline ? 1 : 0;
+    for (const auto& pipeline : depth_) count += pipeline ? 1 : 0;
+
+    return count;
+}
+
+void tdl::PipelineVariants::destroy() {
+    if (!device_) return;
+
+    for (auto& pipeline : pipelines_) {
+        device_.destroyPipeline(pipeline);
+        pipeline = nullptr;
+    }
+
+    for (auto& pipeline : depth_) {
+        device_.destroyPipeline(pipeline);
+        pipeline = nullptr;
+    }
+
+    device_.destroyPipelineCache(cache_);
+    device_.destroyShaderModule(vert_);
+    device_.destroyShaderModule(frag_);
+    device_.destroyShaderModule(depth_vert_);
+
+    cache_ = nullptr;
+    vert_ = nullptr;
+    frag_ = nullptr;
+    depth_vert_ = nullptr;
+}
+
+vk::ShaderModule tdl::PipelineVariants::createModule(
+    const std::vector<char>& code
+) const {
+    try {
+        return device_.createShaderModule({
+            {},
+            code.size(),
+            reinterpret_cast<const uint32_t*>(code.data())
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 056: Failed to create shader module. PipelineVariants::createModule(...)\n"
+            + std::string(err.what())
+        );
+    }
+}
+
+vk::Pipeline tdl::PipelineVariants::create(
+    const PipelineKey& key,
+    const bool prepass
+) const {
+    // layout matches the specialization constants declared in the shaders, every stage ignores the ones it does not use
+    struct Constants {
+        VkBool32 lit;
+        int32_t model;
+        VkBool32 video;
+        VkBool32 count_fragments;
+        VkBool32 compressed;
+        uint32_t texture_count;
+    };
+
+    const Constants constants {
+        key.lit ? VK_TRUE : VK_FALSE,
+        static_cast<int32_t>(key.model),
+        key.video ? VK_TRUE : VK_FALSE,
+        count_fragments_ ? VK_TRUE : VK_FALSE,
+        key.compressed ? VK_TRUE : VK_FALSE,
+        texture_count_
+    };
+
+    static constexpr vk::SpecializationMapEntry entries[] = {
+        {0, offsetof(Constants, lit), sizeof(VkBool32)},
+        {1, offsetof(Constants, model), sizeof(int32_t)},
+        {2, offsetof(Constants, video), sizeof(VkBool32)},
+        {3, offsetof(Constants, count_fragments), sizeof(VkBool32)},
+        {4, offsetof(Constants, compressed), sizeof(VkBool32)},
+        {5, offsetof(Constants, texture_count), sizeof(uint32_t)}
+    };
+
+    const vk::SpecializationInfo specialization {
+        static_cast<uint32_t>(std::size(entries)),
+        entries,
+        sizeof(constants),
+        &constants
+    };
+
+    const vk::PipelineShaderStageCreateInfo stages[] = {
+        {
+            {},
+            vk::ShaderStageFlagBits::eVertex,
+            vert_,
+            "main",
+            &specialization
+        },
+        {
+            {},
+            vk::ShaderStageFlagBits::eFragment,
+            frag_,
+            "main",
+            &specialization
+        }
+    };
+
+    const vk::PipelineShaderStageCreateInfo depth_stage {
+        {},
+        vk::ShaderStageFlagBits::eVertex,
+        depth_vert_,
+        "main",
+        &specialization
+    };
+
+    const vk::VertexInputBindingDescription binding = key.compressed
+        ? CompressedVertex::getBindingDescription()
+        : Vertex::getBindingDescription();
+    const std::array<vk::VertexInputAttributeDescription, 3> attributes = key.compressed
+        ? CompressedVertex::getAttributeDescriptions()
+        : Vertex::getAttributeDescriptions();
+
+    // the pre-pass reads the tightly packed position stream of the meshes, same format as the full vertices
+    const vk::VertexInputBindingDescription position_binding {
+        0,
+        key.compressed ? static_cast<uint32_t>(sizeof(std::array<uint16_t, 4>)) : static_cast<uint32_t>(sizeof(glm::vec3)),
+        vk::VertexInputRate::eVertex
+    };
+
+    const vk::VertexInputAttributeDescription position_attribute {
+        0,
+        0,
+        key.compressed ? vk::Format::eR16G16B16A16Unorm : vk::Format::eR32G32B32Sfloat,
+        0
+    };
+
+    const vk::PipelineVertexInputStateCreateInfo vertex_info {
+        {},
+        1,
+        prepass ? &position_binding : &binding,
+        prepass ? 1 : static_cast<uint32_t>(attributes.size()),
+        prepass ? &position_attribute : attributes.data()
+    };
+
+    static constexpr vk::PipelineInputAssemblyStateCreateInfo assembly {
+        {},
+        vk::PrimitiveTopology::eTriangleList,
+        VK_FALSE
+    };
+
+    const vk::Viewport viewport {
+        0.0f, 0.0f,
+        static_cast<float>(extent_.width),
+        static_cast<float>(extent_.height),
+        0.0f, 1.0f
+    };
+
+    const vk::Rect2D scissor = {
+        {0, 0},
+        extent_
+    };
+
+    vk::PipelineViewportStateCreateInfo viewport_info {
+        {},
+        1,
+        &viewport,
+        1,
+        &scissor
+    };
+
+    static constexpr vk::PipelineRasterizationStateCreateInfo rasterizer {
+        {},
+        VK_FALSE,
+        VK_FALSE,
+        vk::PolygonMode::eFill,
+        vk::CullModeFlagBits::eNone,
+        vk::FrontFace::eClockwise,
+        VK_FALSE,
+        0.0f,
+        0.0f,
+        0.0f,
+        1.0f
+    };
+
+    static constexpr vk::PipelineMultisampleStateCreateInfo multisampling {
+        {},
+        vk::SampleCountFlagBits::e1,
+        VK_FALSE,
+        1.0f,
+        nullptr,
+        VK_FALSE,
+        VK_FALSE
+    };
+
+    static constexpr vk::PipelineColorBlendAttachmentState blending_attach {
+        VK_FALSE,
+        vk::BlendFactor::eOne,
+        vk::BlendFactor::eZero,
+        vk::BlendOp::eAdd,
+        vk::BlendFactor::eOne,
+        vk::BlendFactor::eZero,
+        vk::BlendOp::eAdd,
+        vk::ColorComponentFlags(
+            vk::ColorComponentFlagBits::eR |
+            vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB |
+            vk::ColorComponentFlagBits::eA
+        )
+    };
+
+    // the pre-pass leaves the colour untouched
+    const vk::PipelineColorBlendAttachmentState depth_only_attach {
+        VK_FALSE,
+        vk::BlendFactor::eOne,
+        vk::BlendFactor::eZero,
+        vk::BlendOp::eAdd,
+        vk::BlendFactor::eOne,
+        vk::BlendFactor::eZero,
+        vk::BlendOp::eAdd,
+        {}
+    };
+
+    // every colour attachment of the subpass (one per G-buffer image in the deferred path) uses the same state
+    const std::vector<vk::PipelineColorBlendAttachmentState> blend_attachments (
+        color_attachments_,
+        prepass ? depth_only_attach : blending_attach
+    );
+
+    const vk::PipelineColorBlendStateCreateInfo blending {
+        {},
+        VK_FALSE,
+        vk::LogicOp::eCopy,
+        static_cast<uint32_t>(blend_attachments.size()),
+        blend_attachments.data(),
+        {0.0f, 0.0f, 0.0f, 0.0f}
+    };
+
+    // after the pre-pass only the closest surface of every pixel is shaded, the depth is already final
+    const vk::PipelineDepthStencilStateCreateInfo depth_stencil {
+        {},
+        VK_TRUE,
+        key.after_prepass ? VK_FALSE : VK_TRUE,
+        key.after_prepass ? vk::CompareOp::eEqual : vk::CompareOp::eLess,
+        VK_FALSE,
+        VK_FALSE,
+        {},
+        {},
+        0.0f,
+        1.0f
+    };
+
+    const vk::GraphicsPipelineCreateInfo info {
+        {},
+        prepass ? 1u : 2u,
+        prepass ? &depth_stage : stages,
+        &vertex_info,
+        &assembly,
+        nullptr,
+        &viewport_info,
+        &rasterizer,
+        &multisampling,
+        &depth_stencil,
+        &blending,
+        nullptr,
+        layout_,
+        render_pass_,
+        0,
+        nullptr,
+        -1
+    };
+
+    try {
+        return device_.createGraphicsPipeline(cache_, info).value;
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 050: Failed to create graphics pipeline. PipelineVariants::create(...)\n"
+            + std::string(err.what())
+        );
+    }
+}
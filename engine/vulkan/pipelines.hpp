@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "../types.hpp"
+
+namespace tdl {
+    /**
+     * @breif Selects one permutation of the fragment shader
+     *
+     * lit, model, video and compressed are passed to the shaders as specialization constants so the branches on them
+     * compile out, after_prepass only changes the depth test. compressed also selects the vertex input layout.
+    */
+    struct PipelineKey {
+        bool lit = true; // false for materials that ignore every light
+        LightingModels model = LightingModels::PER_LIGHT;
+        bool video = false; // texture holds I420 video frames instead of RGBA
+        bool after_prepass = false; // depth is already written by the pre-pass, only fragments with equal depth pass
+        bool compressed = false; // mesh vertices are CompressedVertex instead of Vertex
+
+        static constexpr uint32_t count = 64; // number of distinct ids
+
+        /**
+         * @breif Packs the key into a small integer, draws sorted by id are grouped by pipeline
+        */
+        [[nodiscard]] uint32_t id() const {
+            return (
+                static_cast<uint32_t>(lit) |
+                static_cast<uint32_t>(model) << 1 |
+                static_cast<uint32_t>(video) << 3 |
+                static_cast<uint32_t>(after_prepass) << 4 |
+                static_cast<uint32_t>(compressed) << 5
+            );
+        }
+    };
+
+    /**
+     * @breif Owns one graphics pipeline per shader permutation
+     *
+     * Pipelines are only created the first time a key is requested so a scene pays for the permutations it uses.
+     * Every pipeline shares the same layout, render pass and fixed function state. Also owns the depth only pipeline
+     * of the optional pre-pass.
+    */
+    class PipelineVariants {
+        public:
+            /**
+             * @breif Loads the shader modules, has to be called again after destroy() (eg. when the swapchain changes)
+             *
+             * @param device current GPU (logical)
+             * @param layout pipeline layout shared by all permutations
+             * @param render_pass render pass the pipelines are used in
+             * @param extent size of the viewport
+             * @param vert SPIR-V of the vertex shader
+             * @param frag SPIR-V of the fragment shader
+             * @param depth SPIR-V of the pre-pass vertex shader
+             * @param count_fragments makes every fragment shader invocation increment the debug counter
+             * @param color_attachments colour attachments of subpass 0, 1 for the forward path, GBuffer::count for the deferred one
+             * @param texture_count size of the texture array, TextureTable::size()
+            */
+            void init (
+                vk::Device device,
+                vk::PipelineLayout layout,
+                vk::RenderPass render_pass,
+                vk::Extent2D extent,
+                const std::vector<char>& vert,
+                const std::vector<char>& frag,
+                const std::vector<char>& depth,
+                bool count_fragments,
+                uint32_t color_attachments,
+                uint32_t texture_count
+            );
+
+            /**
+             * @breif Gets the pipeline of the given permutation, creating it if it does not exist yet
+             *
+             * @param key permutation to get
+             * @return vk::Pipeline pipeline with the permutation's specialization constants
+            */
+            vk::Pipeline get (
+                const PipelineKey& key
+            );
+
+            /**
+             * @breif Gets the depth only pipeline of the pre-pass, creating it if it does not exist yet
+             *
+             * Reads only the position stream of the meshes and has no fragment shader.
+             *
+             * @param compressed true for meshes with quantized positions (see Mesh::setCompressed())
+            */
+            vk::Pipeline depth (
+                bool compressed
+            );
+
+            /**
+             * @breif Number of pipelines that have been created
+            */
+            [[nodiscard]] uint32_t created() const;
+
+            /**
+             * @breif Destroys every pipeline and the shader modules
+            */
+            void destroy();
+
+        private:
+            vk::ShaderModule createModule (
+                const std::vector<char>& code
+            ) const;
+
+            /**
+             * @breif Creates the pipeline of a permutation, or the pre-pass pipeline if prepass is true (only
+             * key.compressed is used then)
+            */
+            vk::Pipeline create (
+                const PipelineKey& key,
+                bool prepass
+            ) const;
+
+            vk::Device device_;
+            vk::PipelineLayout layout_;
+            vk::RenderPass render_pass_;
+            vk::Extent2D extent_;
+
+            vk::ShaderModule vert_;
+            vk::ShaderModule frag_;
+            vk::ShaderModule depth_vert_;
+            bool count_fragments_ = false;
+            uint32_t color_attachments_ = 1;
+            uint32_t texture_count_ = 1;
+            vk::PipelineCache cache_; // lets the driver share work between the permutations
+
+            std::array<vk::Pipeline, PipelineKey::count> pipelines_ {};
+            std::array<vk::Pipeline, 2> depth_ {}; // indexed by compressed
+    };
+};
@@ -0,0 +1,676 @@
+#include "shadows.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "buffers.hpp"
+
+void tdl::ShadowAtlas::init(
+    const vk::Device device,
+    const vk::PhysicalDevice physical_device,
+    const vk::Queue graphics_queue,
+    const vk::CommandPool command_pool,
+    const std::array<vk::DescriptorSetLayout, 3>& set_layouts,
+    const std::vector<char>& vert,
+    const unsigned int max_f_frames
+) {
+    device_ = device;
+    physical_device_ = physical_device;
+    graphics_queue_ = graphics_queue;
+    command_pool_ = command_pool;
+
+    createImage();
+    createRenderPass();
+    createPipeline(set_layouts, vert);
+
+    try {
+        framebuffer_ = device_.createFramebuffer({
+            {},
+            render_pass_,
+            1,
+            &view_,
+            size,
+            size,
+            1
+        });
+
+        command_buffers_ = device_.allocateCommandBuffers({
+            command_pool_,
+            vk::CommandBufferLevel::ePrimary,
+            max_f_frames
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 071: Failed to create shadow atlas framebuffer. ShadowAtlas::init(...)\n"
+            + std::string(err.what())
+        );
+    }
+}
+
+bool tdl::ShadowAtlas::assign(
+    const std::vector<Light>& lights
+) {
+    bool changed = first_tile_.size() != lights.size();
+
+    first_tile_.resize(lights.size());
+    tiles_used_ = 0;
+
+    for (uint32_t i = 0; i < lights.size(); ++i) {
+        const Light& light = lights[i];
+
+        uint32_t needed = 0;
+        if (light.data.w == 1.0f && light.position.w > 0.0f) needed = 6; // point light, one tile per cube face
+        if (light.data.w == 2.0f) needed = 1; // spot light
+
+        uint32_t first = none;
+
+        if (needed > 0 && tiles_used_ + needed <= tile_count) {
+            first = tiles_used_;
+
+            for (uint32_t face = 0; face < needed; ++face) {
+                tile_light_[first + face] = i;
+                tile_face_[first + face] = face;
+            }
+
+            tiles_used_ += needed;
+        }
+
+        changed |= first_tile_[i] != first;
+        first_tile_[i] = first;
+    }
+
+    return changed;
+}
+
+bool tdl::ShadowAtlas::update(
+    const TransformSnapshot& snapshot,
+    const TransformSnapshot* const previous,
+    const float alpha,
+    const std::vector<const ObjectInterface*>& casters,
+    const unsigned long cframe,
+    const vk::DescriptorSet frame_set
+) {
+    tiles_rendered_ = 0;
+    casters_drawn_ = 0;
+
+    // collect where every changed caster was and is now, a tile is only out of date if one of them is in range
+    const bool casters_changed = caster_versions_.size() != casters.size();
+
+    if (casters_changed) {
+        caster_versions_.assign(casters.size(), 0);
+        caster_bounds_.assign(casters.size(), glm::vec4(0.0f));
+        caster_blended_.assign(casters.size(), 0);
+    }
+
+    // same test as Vlkn::regenUBOs(), the casters are drawn with the transform the frame blends
+    const bool blend = (
+        previous != nullptr &&
+        previous->sequence != 0 &&
+        previous->objects.size() == snapshot.objects.size() &&
+        alpha < 1.0f
+    );
+
+    moved_.clear();
+
+    for (size_t i = 0; i < casters.size(); ++i) {
+        const uint64_t version = snapshot.object_versions[i];
+        const bool moving = blend && previous->object_versions[i] != version;
+
+        // a caster that was blended last frame is drawn somewhere else now even if it has settled
+        if (caster_versions_[i] == version && !moving && !caster_blended_[i]) continue;
+
+        const glm::mat4 model = moving
+            ? TransformSnapshot::blend(previous->objects[i].model, snapshot.objects[i].model, alpha)
+            : snapshot.objects[i].model;
+        const glm::vec4 sphere = casters[i]->boundingSphere(model);
+
+        moved_.push_back(caster_bounds_[i]);
+        moved_.push_back(sphere);
+
+        caster_bounds_[i] = sphere;
+        caster_versions_[i] = version;
+        caster_blended_[i] = moving ? 1 : 0;
+    }
+
+    const auto overlaps = [](const glm::vec4& a, const glm::vec4& b) {
+        return glm::length(glm::vec3(a) - glm::vec3(b)) <= a.w + b.w;
+    };
+
+    std::array<uint32_t, tile_count> dirty {};
+    uint32_t dirty_count = 0;
+
+    for (uint32_t t = 0; t < tiles_used_; ++t) {
+        const uint32_t l = tile_light_[t];
+        const uint64_t version = snapshot.light_versions[l];
+
+        TileState& state = state_[t];
+        bool stale = casters_changed || state.light != l || state.face != tile_face_[t] || state.version != version;
+
+        if (!stale) {
+            const glm::vec4 range = reach(snapshot.lights[l]);
+            stale = std::ranges::any_of(moved_, [&](const glm::vec4& sphere) { return overlaps(range, sphere); });
+        }
+
+        if (!stale) continue;
+
+        state = {l, tile_face_[t], version};
+
+        tiles_[t].view_proj = viewProj(snapshot.lights[l], tile_face_[t]);
+        tiles_[t].rect = {
+            static_cast<float>(t % tiles_per_row) / tiles_per_row,
+            static_cast<float>(t / tiles_per_row) / tiles_per_row,
+            1.0f / tiles_per_row,
+            1.0f / tiles_per_row
+        };
+
+        dirty[dirty_count++] = t;
+    }
+
+    if (dirty_count == 0) return false;
+
+    const vk::CommandBuffer command_buffer = command_buffers_[cframe];
+    command_buffer.reset();
+    command_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+    const vk::ClearValue clear = vk::ClearDepthStencilValue(1.0f, 0);
+
+    command_buffer.beginRenderPass({
+        render_pass_,
+        framebuffer_,
+        {
+            {0, 0},
+            {size, size}
+        },
+        1,
+        &clear
+    }, vk::SubpassContents::eInline);
+
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout_, 0, 1, &frame_set, 0, nullptr);
+
+    int bound = -1; // vertex format of the bound pipeline
+    bool ubo_bound = false;
+
+    for (uint32_t d = 0; d < dirty_count; ++d) {
+        const uint32_t t = dirty[d];
+
+        const vk::Rect2D rect {
+            {
+                static_cast<int32_t>(t % tiles_per_row * tile_size),
+                static_cast<int32_t>(t / tiles_per_row * tile_size)
+            },
+            {tile_size, tile_size}
+        };
+
+        const vk::Viewport viewport {
+            static_cast<float>(rect.offset.x),
+            static_cast<float>(rect.offset.y),
+            static_cast<float>(tile_size),
+            static_cast<float>(tile_size),
+            0.0f, 1.0f
+        };
+
+        command_buffer.setViewport(0, 1, &viewport);
+        command_buffer.setScissor(0, 1, &rect);
+
+        // the render pass loads the whole atlas, only this tile is cleared
+        const vk::ClearAttachment clear_attachment {
+            vk::ImageAspectFlagBits::eDepth,
+            0,
+            clear
+        };
+        const vk::ClearRect clear_rect {rect, 0, 1};
+        command_buffer.clearAttachments(1, &clear_attachment, 1, &clear_rect);
+
+        command_buffer.pushConstants(
+            layout_,
+            vk::ShaderStageFlagBits::eVertex,
+            0,
+            sizeof(glm::mat4),
+            &tiles_[t].view_proj
+        );
+
+        const glm::vec4 range = reach(snapshot.lights[tile_light_[t]]);
+
+        for (size_t i = 0; i < casters.size(); ++i) {
+            if (!overlaps(range, caster_bounds_[i])) continue;
+
+            const int compressed = casters[i]->mesh_->compressed() ? 1 : 0;
+            if (compressed != bound) {
+                command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines_[compressed]);
+                bound = compressed;
+            }
+
+            // casters in the transform buffer read no UBO, but set 2 has to hold one
+            const uint32_t transform = casters[i]->transform_slot_;
+            if (transform == DrawConstants::static_transform || !ubo_bound) {
+                casters[i]->bindUBO(command_buffer, layout_, cframe);
+                ubo_bound = true;
+            }
+
+            command_buffer.pushConstants(
+                layout_,
+                vk::ShaderStageFlagBits::eVertex,
+                sizeof(glm::mat4),
+                sizeof(uint32_t),
+                &transform
+            );
+
+            // full mesh, a cached tile is not rendered again when the level or the visible meshlets of the object change
+            casters[i]->renderDepth(command_buffer, layout_, cframe, false);
+            ++casters_drawn_;
+        }
+
+        ++tiles_rendered_;
+    }
+
+    command_buffer.endRenderPass();
+    command_buffer.end();
+
+    return true;
+}
+
+void tdl::ShadowAtlas::destroy() {
+    if (!device_) return;
+
+    if (!command_buffers_.empty()) device_.freeCommandBuffers(command_pool_, command_buffers_);
+    command_buffers_.clear();
+
+    for (const auto& pipeline : pipelines_) device_.destroyPipeline(pipeline);
+    device_.destroyPipelineLayout(layout_);
+    device_.destroyFramebuffer(framebuffer_);
+    device_.destroyRenderPass(render_pass_);
+    device_.destroySampler(sampler_);
+    device_.destroyImageView(view_);
+    device_.destroyImage(image_);
+    device_.freeMemory(memory_);
+
+    device_ = nullptr;
+}
+
+glm::vec4 tdl::ShadowAtlas::reach(
+    const Light& light
+) {
+    const float range = light.data.w == 1.0f ? light.position.w : spot_range;
+    return {light.position.x, -light.position.y, light.position.z, range};
+}
+
+glm::mat4 tdl::ShadowAtlas::viewProj(
+    const Light& light,
+    const uint32_t face
+) {
+    const glm::vec4 range = reach(light);
+    const glm::vec3 eye = glm::vec3(range);
+
+    if (light.data.w == 1.0f) {
+        // cube faces in the order the fragment shader picks them: +x, -x, +y, -y, +z, -z
+        static const glm::vec3 directions[] = {
+            {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+        };
+        static const glm::vec3 ups[] = {
+            {0, 1, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, 1, 0}
+        };
+
+        const glm::mat4 proj = glm::perspectiveRH_ZO(glm::radians(90.0f), 1.0f, near_plane, range.w);
+        return proj * glm::lookAtRH(eye, eye + directions[face], ups[face]);
+    }
+
+    const glm::vec3 direction = glm::normalize(glm::vec3(light.direction.x, -light.direction.y, light.direction.z));
+    const glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+
+    const float fov = std::clamp(light.data.x, 1.0f, 170.0f);
+    const glm::mat4 proj = glm::perspectiveRH_ZO(glm::radians(fov), 1.0f, near_plane, range.w);
+
+    return proj * glm::lookAtRH(eye, eye + direction, up);
+}
+
+void tdl::ShadowAtlas::createImage() {
+    static constexpr auto format = vk::Format::eD32Sfloat;
+
+    const vk::ImageCreateInfo info {
+        {},
+        vk::ImageType::e2D,
+        format,
+        {size, size, 1},
+        1,
+        1,
+        vk::SampleCountFlagBits::e1,
+        vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
+        vk::SharingMode::eExclusive,
+        0, nullptr,
+        vk::ImageLayout::eUndefined
+    };
+
+    try {
+        image_ = device_.createImage(info);
+
+        const vk::MemoryRequirements reqs = device_.getImageMemoryRequirements(image_);
+
+        memory_ = device_.allocateMemory({
+            reqs.size,
+            MemoryBuffer::findMemoryType(
+                physical_device_,
+                reqs.memoryTypeBits,
+                vk::MemoryPropertyFlagBits::eDeviceLocal
+            )
+        });
+
+        device_.bindImageMemory(image_, memory_, 0);
+
+        view_ = device_.createImageView({
+            {},
+            image_,
+            vk::ImageViewType::e2D,
+            format,
+            {},
+            {
+                vk::ImageAspectFlagBits::eDepth,
+                0,
+                1,
+                0,
+                1
+            }
+        });
+
+        // compare sampler, the hardware filters 2x2 depth comparisons
+        sampler_ = device_.createSampler({
+            {},
+            vk::Filter::eLinear,
+            vk::Filter::eLinear,
+            vk::SamplerMipmapMode::eNearest,
+            vk::SamplerAddressMode::eClampToEdge,
+            vk::SamplerAddressMode::eClampToEdge,
+            vk::SamplerAddressMode::eClampToEdge,
+            0.0f,
+            VK_FALSE,
+            1.0f,
+            VK_TRUE,
+            vk::CompareOp::eLessOrEqual,
+            0.0f,
+            0.0f,
+            vk::BorderColor::eFloatOpaqueWhite,
+            VK_FALSE
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 072: Failed to create shadow atlas. ShadowAtlas::createImage(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    // the shadow pass always starts from the read only layout, the first frame renders every tile it reads
+    const vk::CommandBuffer command_buffer = CommandBuffer::begin(device_, command_pool_);
+
+    const vk::ImageMemoryBarrier barrier {
+        {},
+        vk::AccessFlagBits::eShaderRead,
+        vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        image_,
+        {
+            vk::ImageAspectFlagBits::eDepth,
+            0,
+            1,
+            0,
+            1
+        }
+    };
+
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eFragmentShader,
+        {},
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+    );
+
+    CommandBuffer::end(device_, command_buffer, command_pool_, graphics_queue_);
+}
+
+void tdl::ShadowAtlas::createRenderPass() {
+    // tiles that are not rendered this frame keep their contents
+    static constexpr vk::AttachmentDescription depth {
+        {},
+        vk::Format::eD32Sfloat,
+        vk::SampleCountFlagBits::e1,
+        vk::AttachmentLoadOp::eLoad,
+        vk::AttachmentStoreOp::eStore,
+        vk::AttachmentLoadOp::eDontCare,
+        vk::AttachmentStoreOp::eDontCare,
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        vk::ImageLayout::eShaderReadOnlyOptimal
+    };
+
+    static constexpr vk::AttachmentReference depth_ref {
+        0,
+        vk::ImageLayout::eDepthStencilAttachmentOptimal
+    };
+
+    static constexpr vk::SubpassDescription subpass {
+        {},
+        vk::PipelineBindPoint::eGraphics,
+        0, nullptr,
+        0, nullptr,
+        nullptr, &depth_ref
+    };
+
+    static constexpr vk::SubpassDependency dependencies[] {
+        { // previous frames have to finish sampling the atlas before it is written
+            VK_SUBPASS_EXTERNAL,
+            0,
+            vk::PipelineStageFlagBits::eFragmentShader,
+            vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+            {},
+            vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite
+        },
+        { // and the main pass samples it only once it is written
+            0,
+            VK_SUBPASS_EXTERNAL,
+            vk::PipelineStageFlagBits::eLateFragmentTests,
+            vk::PipelineStageFlagBits::eFragmentShader,
+            vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+            vk::AccessFlagBits::eShaderRead
+        }
+    };
+
+    try {
+        render_pass_ = device_.createRenderPass({
+            {},
+            1,
+            &depth,
+            1,
+            &subpass,
+            static_cast<uint32_t>(std::size(dependencies)),
+            dependencies
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 073: Failed to create shadow render pass. ShadowAtlas::createRenderPass(...)\n"
+            + std::string(err.what())
+        );
+    }
+}
+
+void tdl::ShadowAtlas::createPipeline(
+    const std::array<vk::DescriptorSetLayout, 3>& set_layouts,
+    const std::vector<char>& vert
+) {
+    // view_proj of the tile followed by DrawConstants::transform of the caster
+    static constexpr vk::PushConstantRange push_constant {
+        vk::ShaderStageFlagBits::eVertex,
+        0,
+        sizeof(glm::mat4) + sizeof(uint32_t)
+    };
+
+    vk::ShaderModule module;
+
+    try {
+        layout_ = device_.createPipelineLayout({
+            {},
+            static_cast<uint32_t>(set_layouts.size()),
+            set_layouts.data(),
+            1,
+            &push_constant
+        });
+
+        module = device_.createShaderModule({
+            {},
+            vert.size(),
+            reinterpret_cast<const uint32_t*>(vert.data())
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 074: Failed to create shadow pipeline layout. ShadowAtlas::createPipeline(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    // COMPRESSED in shadow.vert
+    static constexpr vk::SpecializationMapEntry entry {4, 0, sizeof(VkBool32)};
+
+    // same position stream as the depth pre-pass, full or quantized positions
+    static constexpr vk::VertexInputBindingDescription bindings[] = {
+        {0, sizeof(glm::vec3), vk::VertexInputRate::eVertex},
+        {0, sizeof(std::array<uint16_t, 4>), vk::VertexInputRate::eVertex}
+    };
+
+    static constexpr vk::VertexInputAttributeDescription attributes[] = {
+        {0, 0, vk::Format::eR32G32B32Sfloat, 0},
+        {0, 0, vk::Format::eR16G16B16A16Unorm, 0}
+    };
+
+    static constexpr vk::PipelineInputAssemblyStateCreateInfo assembly {
+        {},
+        vk::PrimitiveTopology::eTriangleList,
+        VK_FALSE
+    };
+
+    // every tile sets its own viewport
+    static constexpr vk::PipelineViewportStateCreateInfo viewport_info {
+        {},
+        1,
+        nullptr,
+        1,
+        nullptr
+    };
+
+    static constexpr vk::DynamicState dynamic_states[] = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+
+    const vk::PipelineDynamicStateCreateInfo dynamic_info {
+        {},
+        static_cast<uint32_t>(std::size(dynamic_states)),
+        dynamic_states
+    };
+
+    // slope scaled bias against shadow acne
+    static constexpr vk::PipelineRasterizationStateCreateInfo rasterizer {
+        {},
+        VK_FALSE,
+        VK_FALSE,
+        vk::PolygonMode::eFill,
+        vk::CullModeFlagBits::eNone,
+        vk::FrontFace::eClockwise,
+        VK_TRUE,
+        1.25f,
+        0.0f,
+        1.75f,
+        1.0f
+    };
+
+    static constexpr vk::PipelineMultisampleStateCreateInfo multisampling {
+        {},
+        vk::SampleCountFlagBits::e1,
+        VK_FALSE,
+        1.0f,
+        nullptr,
+        VK_FALSE,
+        VK_FALSE
+    };
+
+    static constexpr vk::PipelineDepthStencilStateCreateInfo depth_stencil {
+        {},
+        VK_TRUE,
+        VK_TRUE,
+        vk::CompareOp::eLess,
+        VK_FALSE,
+        VK_FALSE,
+        {},
+        {},
+        0.0f,
+        1.0f
+    };
+
+    static constexpr vk::PipelineColorBlendStateCreateInfo blending {
+        {},
+        VK_FALSE,
+        vk::LogicOp::eCopy,
+        0,
+        nullptr,
+        {0.0f, 0.0f, 0.0f, 0.0f}
+    };
+
+    for (uint32_t compressed = 0; compressed < pipelines_.size(); ++compressed) {
+        const VkBool32 constant = compressed ? VK_TRUE : VK_FALSE;
+
+        const vk::SpecializationInfo specialization {
+            1,
+            &entry,
+            sizeof(constant),
+            &constant
+        };
+
+        // depth only, no fragment shader
+        const vk::PipelineShaderStageCreateInfo stage {
+            {},
+            vk::ShaderStageFlagBits::eVertex,
+            module,
+            "main",
+            &specialization
+        };
+
+        const vk::PipelineVertexInputStateCreateInfo vertex_info {
+            {},
+            1,
+            &bindings[compressed],
+            1,
+            &attributes[compressed]
+        };
+
+        const vk::GraphicsPipelineCreateInfo info {
+            {},
+            1,
+            &stage,
+            &vertex_info,
+            &assembly,
+            nullptr,
+            &viewport_info,
+            &rasterizer,
+            &multisampling,
+            &depth_stencil,
+            &blending,
+            &dynamic_info,
+            layout_,
+            render_pass_,
+            0,
+            nullptr,
+            -1
+        };
+
+        try {
+            pipelines_[compressed] = device_.createGraphicsPipeline(nullptr, info).value;
+        } catch (const vk::SystemError& err) {
+            device_.destroyShaderModule(module);
+            throw std::runtime_error(
+                "ERR 075: Failed to create shadow pipeline. ShadowAtlas::createPipeline(...)\n"
+                + std::string(err.what())
+            );
+        }
+    }
+
+    device_.destroyShaderModule(module);
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include "../lighting.hpp"
+#include "../simulation.hpp"
+
+namespace tdl {
+    /**
+     * @breif Region of the shadow atlas as it is stored in the shadow storage buffer
+    */
+    struct alignas(16) ShadowTile {
+        glm::mat4 view_proj {1.0f}; // world space to the light's clip space
+        glm::vec4 rect {0.0f}; // uv offset (xy) and uv size (zw) of the tile inside the atlas
+    };
+
+    /**
+     * @breif Depth only shadow maps of every shadow casting light, packed into one atlas
+     *
+     * Point lights get six tiles (one per cube face), spot lights (DirectionalLight) one. Tiles are handed out in
+     * light order until the atlas is full, lights after that do not cast shadows. A tile keeps its contents between
+     * frames and is only rendered again when its light changed or a caster inside the light's range moved, a static
+     * scene renders no shadows at all.
+    */
+    class ShadowAtlas {
+        public:
+            static constexpr uint32_t size = 4096;
+            static constexpr uint32_t tile_size = 1024;
+            static constexpr uint32_t tiles_per_row = size / tile_size;
+            static constexpr uint32_t tile_count = tiles_per_row * tiles_per_row;
+
+            static constexpr float near_plane = 0.05f;
+            static constexpr float spot_range = 100.0f; // spot lights have no radius, shadows end at this distance
+
+            /**
+             * @breif Creates the atlas image, its render pass and the depth only pipeline
+             *
+             * @param device current GPU (logical)
+             * @param physical_device current GPU (physical)
+             * @param graphics_queue queue used to transition the atlas before its first use
+             * @param command_pool pool the per frame shadow command buffers are allocated from
+             * @param set_layouts descriptor set layouts 0 - 2 of the main pipeline, objects bind their UBO at set 2
+             * @param vert SPIR-V of the shadow vertex shader
+             * @param max_f_frames max number of pre rendered frames
+            */
+            void init (
+                vk::Device device,
+                vk::PhysicalDevice physical_device,
+                vk::Queue graphics_queue,
+                vk::CommandPool command_pool,
+                const std::array<vk::DescriptorSetLayout, 3>& set_layouts,
+                const std::vector<char>& vert,
+                unsigned int max_f_frames
+            );
+
+            /**
+             * @breif Hands out the atlas tiles to the lights
+             *
+             * @param lights lights in the order they are stored in the light buffer
+             * @return bool true if any light got a different tile than before
+            */
+            bool assign (
+                const std::vector<Light>& lights
+            );
+
+            /**
+             * @breif Index of the first tile of the light plus one, 0 if the light casts no shadow
+             *
+             * Stored in direction.w of the light for the fragment shader.
+            */
+            [[nodiscard]] float tileOf (
+                const uint32_t light
+            ) const { return light < first_tile_.size() ? static_cast<float>(first_tile_[light] + 1) : 0.0f; }
+
+            /**
+             * @breif Records the shadow passes of every tile that is out of date
+             *
+             * Casters are tested at the transform the frame draws them with. Casters blended between two ticks move
+             * every frame, so the tiles around them are drawn again every frame until they settle.
+             *
+             * @param snapshot snapshot of the frame, the first casters.size() objects are the casters
+             * @param previous snapshot the frame blends from, nullptr if it is not interpolated
+             * @param alpha how far between previous and snapshot the frame is (0 - 1)
+             * @param casters objects that cast shadows, same order as snapshot.objects
+             * @param cframe current frame, selects the object UBOs and the command buffer
+             * @param frame_set set 0 of the frame, holds the transform buffer of the casters that change often
+             * @return bool true if commandBuffer(cframe) has to be submitted before the frame
+            */
+            bool update (
+                const TransformSnapshot& snapshot,
+                const TransformSnapshot* previous,
+                float alpha,
+                const std::vector<const ObjectInterface*>& casters,
+                unsigned long cframe,
+                vk::DescriptorSet frame_set
+            );
+
+            [[nodiscard]] vk::CommandBuffer commandBuffer(const unsigned long cframe) const { return command_buffers_[cframe]; }
+            [[nodiscard]] const std::array<ShadowTile, tile_count>& tiles() const { return tiles_; }
+            [[nodiscard]] vk::ImageView view() const { return view_; }
+            [[nodiscard]] vk::Sampler sampler() const { return sampler_; }
+
+            [[nodiscard]] uint32_t tilesRendered() const { return tiles_rendered_; }
+            [[nodiscard]] uint32_t castersDrawn() const { return casters_drawn_; }
+
+            void destroy();
+
+        private:
+            static constexpr uint32_t none = UINT32_MAX;
+
+            /**
+             * @breif Light a tile was last rendered for
+            */
+            struct TileState {
+                uint32_t light = none;
+                uint32_t face = 0;
+                uint64_t version = 0;
+            };
+
+            /**
+             * @breif World space position and range of a light, the shader mirrors light positions on the y axis
+            */
+            static glm::vec4 reach (
+                const Light& light
+            );
+
+            /**
+             * @breif View projection matrix of one tile of the given light
+            */
+            static glm::mat4 viewProj (
+                const Light& light,
+                uint32_t face
+            );
+
+            void createImage();
+            void createRenderPass();
+            void createPipeline(const std::array<vk::DescriptorSetLayout, 3>& set_layouts, const std::vector<char>& vert);
+
+            vk::Device device_;
+            vk::PhysicalDevice physical_device_;
+            vk::Queue graphics_queue_;
+            vk::CommandPool command_pool_;
+
+            vk::Image image_;
+            vk::DeviceMemory memory_;
+            vk::ImageView view_;
+            vk::Sampler sampler_;
+            vk::RenderPass render_pass_;
+            vk::Framebuffer framebuffer_;
+            vk::PipelineLayout layout_;
+            std::array<vk::Pipeline, 2> pipelines_ {}; // indexed by Mesh::compressed()
+            std::vector<vk::CommandBuffer> command_buffers_;
+
+            std::vector<uint32_t> first_tile_; // first tile of every light, none if it has no shadow
+            std::array<uint32_t, tile_count> tile_light_ {}; // light every tile is assigned to
+            std::array<uint32_t, tile_count> tile_face_ {};
+            uint32_t tiles_used_ = 0;
+
+            std::array<TileState, tile_count> state_ {};
+            std::array<ShadowTile, tile_count> tiles_ {};
+
+            // casters as of the last update, used to find the ones that moved
+            std::vector<uint64_t> caster_versions_;
+            std::vector<glm::vec4> caster_bounds_;
+            std::vector<uint8_t> caster_blended_; // last bounds came from a blended transform, not the tick's
+            std::vector<glm::vec4> moved_; // old and new bounds of every caster that changed this frame
+
+            uint32_t tiles_rendered_ = 0;
+            uint32_t casters_drawn_ = 0;
+    };
+};
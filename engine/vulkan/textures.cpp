@@ -0,0 +1,116 @@
+#include "textures.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+void tdl::TextureTable::init(
+    const vk::Device device,
+    const vk::PhysicalDevice physical_device
+) {
+    device_ = device;
+
+    // the set limits count every set of the pipeline layout, the stage limits only the fragment shader
+    const vk::PhysicalDeviceLimits limits = physical_device.getProperties().limits;
+    const uint32_t samplers = std::min({
+        limits.maxPerStageDescriptorSamplers,
+        limits.maxPerStageDescriptorSampledImages,
+        limits.maxDescriptorSetSamplers,
+        limits.maxDescriptorSetSampledImages
+    });
+
+    const uint32_t resources = limits.maxPerStageResources;
+
+    size_ = std::clamp(
+        std::min(samplers - std::min(samplers, reserved_samplers), resources - std::min(resources, reserved_resources)),
+        1u,
+        max_textures
+    );
+    count_ = 0;
+
+    const vk::DescriptorSetLayoutBinding binding {
+        0,
+        vk::DescriptorType::eCombinedImageSampler,
+        size_,
+        vk::ShaderStageFlagBits::eFragment,
+        nullptr
+    };
+
+    const vk::DescriptorPoolSize pool_size {
+        vk::DescriptorType::eCombinedImageSampler,
+        size_
+    };
+
+    try {
+        layout_ = device_.createDescriptorSetLayout({
+            {},
+            1,
+            &binding
+        });
+
+        pool_ = device_.createDescriptorPool({
+            {},
+            1,
+            1,
+            &pool_size
+        });
+
+        set_ = device_.allocateDescriptorSets({
+            pool_,
+            1,
+            &layout_
+        })[0];
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 095: Failed to create texture table. TextureTable::init(...)\n"
+            + std::string(err.what())
+        );
+    }
+}
+
+uint32_t tdl::TextureTable::add(
+    const vk::ImageView view,
+    const vk::Sampler sampler
+) {
+    if (count_ >= size_) {
+        throw std::runtime_error(
+            "ERR 096: Texture table is full (" + std::to_string(size_) + " textures). TextureTable::add(...)"
+        );
+    }
+
+    // the first texture fills the whole array, later ones only overwrite their own slot
+    const uint32_t slots = count_ == 0 ? size_ : 1;
+    const std::vector<vk::DescriptorImageInfo> infos (
+        slots,
+        {sampler, view, vk::ImageLayout::eShaderReadOnlyOptimal}
+    );
+
+    const vk::WriteDescriptorSet write {
+        set_,
+        0,
+        count_,
+        slots,
+        vk::DescriptorType::eCombinedImageSampler,
+        infos.data(),
+        nullptr,
+        nullptr
+    };
+
+    device_.updateDescriptorSets(1, &write, 0, nullptr);
+
+    return count_++;
+}
+
+void tdl::TextureTable::destroy() {
+    if (!device_) return;
+
+    device_.destroyDescriptorPool(pool_);
+    device_.destroyDescriptorSetLayout(layout_);
+
+    pool_ = nullptr;
+    layout_ = nullptr;
+    set_ = nullptr;
+    size_ = 0;
+    count_ = 0;
+}
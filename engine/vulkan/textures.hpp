@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+namespace tdl {
+    /**
+     * @breif One descriptor set holding the textures of every object in a single array
+     *
+     * The set is bound once per frame and objects pick their texture through the slot stored in their material (see
+     * MaterialTable), so drawing an object binds no descriptor set for its texture. The index is the same for every
+     * fragment of a draw (dynamically uniform), which only needs shaderSampledImageArrayDynamicIndexing from Vulkan 1.0.
+     *
+     * Every slot of the array is written by the first add() so the shaders never read an unwritten descriptor, unused
+     * slots point at the first texture. Textures are never removed, the table lives as long as the device.
+    */
+    class TextureTable {
+        public:
+            static constexpr uint32_t max_textures = 4096;
+
+            // fragment shader samplers outside of the table (the shadow atlas), kept free of the sampler limits
+            static constexpr uint32_t reserved_samplers = 4;
+            // every other fragment shader resource (buffers, input attachments and outputs), kept free of maxPerStageResources
+            static constexpr uint32_t reserved_resources = 16;
+
+            /**
+             * @breif Creates the layout, pool and set of the table
+             *
+             * The size of the table is max_textures or the per stage sampler limits of the device if they are lower.
+             *
+             * @param device current GPU (logical)
+             * @param physical_device current GPU (physical)
+            */
+            void init (
+                vk::Device device,
+                vk::PhysicalDevice physical_device
+            );
+
+            /**
+             * @breif Writes a texture into the next free slot
+             *
+             * @param view view of the texture, has to stay in vk::ImageLayout::eShaderReadOnlyOptimal while it is drawn
+             * @param sampler sampler the texture is read with
+             * @return uint32_t slot of the texture, MaterialObject::texture_slot of the objects using it
+            */
+            uint32_t add (
+                vk::ImageView view,
+                vk::Sampler sampler
+            );
+
+            [[nodiscard]] vk::DescriptorSetLayout layout() const { return layout_; }
+            [[nodiscard]] vk::DescriptorSet set() const { return set_; }
+            [[nodiscard]] uint32_t size() const { return size_; } // TEXTURE_COUNT of the fragment shaders
+            [[nodiscard]] uint32_t count() const { return count_; } // slots in use
+
+            void destroy();
+
+        private:
+            vk::Device device_;
+
+            vk::DescriptorSetLayout layout_;
+            vk::DescriptorPool pool_;
+            vk::DescriptorSet set_;
+
+            uint32_t size_ = 0;
+            uint32_t count_ = 0;
+    };
+};
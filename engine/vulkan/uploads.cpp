@@ -0,0 +1,435 @@
+#include "uploads.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "buffers.hpp"
+
+void tdl::UploadQueue::init(
+    const vk::Device device,
+    const vk::Queue queue,
+    const uint32_t family,
+    const uint32_t graphics_family,
+    const unsigned int frames
+) {
+    device_ = device;
+    queue_ = queue;
+    family_ = family;
+    graphics_family_ = graphics_family;
+
+    frames_.resize(frames);
+
+    try {
+        command_pool_ = device_.createCommandPool({
+            vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+            family_
+        });
+
+        // one per frame in flight and the last one for the loads
+        const std::vector<vk::CommandBuffer> command_buffers = device_.allocateCommandBuffers({
+            command_pool_,
+            vk::CommandBufferLevel::ePrimary,
+            frames + 1
+        });
+
+        for (unsigned int i = 0; i < frames; ++i) {
+            frames_[i].command_buffer = command_buffers[i];
+            frames_[i].done = device_.createSemaphore({});
+        }
+
+        load_.command_buffer = command_buffers[frames];
+        load_.done = device_.createSemaphore({});
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 100: Failed to create upload command buffers. UploadQueue::init(...)\n"
+            + std::string(err.what())
+        );
+    }
+}
+
+void tdl::UploadQueue::copyToImage(
+    const size_t frame,
+    const vk::Buffer staging,
+    const vk::Image image,
+    const uint32_t width,
+    const uint32_t height,
+    const vk::DeviceSize bytes
+) {
+    Frame& slot = frames_[frame];
+
+    // the frame's fence was waited on, the last submission of this command buffer is done
+    if (slot.uploads == 0) {
+        slot.command_buffer.reset();
+        slot.command_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    }
+
+    if (copyImage(slot.command_buffer, staging, image, width, height)) slot.released.push_back(image);
+
+    ++slot.uploads;
+    slot.bytes += bytes;
+}
+
+void tdl::UploadQueue::loadBuffer(
+    MemoryBuffer* const staging,
+    const vk::Buffer buffer,
+    const vk::DeviceSize bytes
+) {
+    beginLoad();
+
+    load_.command_buffer.copyBuffer(staging->getBuffer(), buffer, vk::BufferCopy {0, 0, bytes});
+    load_.staging.push_back(staging);
+
+    if (dedicated()) {
+        const vk::BufferMemoryBarrier release {
+            vk::AccessFlagBits::eTransferWrite,
+            {},
+            family_,
+            graphics_family_,
+            buffer,
+            0,
+            VK_WHOLE_SIZE
+        };
+
+        load_.command_buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eBottomOfPipe,
+            {},
+            0, nullptr,
+            1, &release,
+            0, nullptr
+        );
+
+        load_.buffers.push_back(buffer);
+    }
+
+    ++load_.uploads;
+    load_.bytes += bytes;
+}
+
+void tdl::UploadQueue::loadImage(
+    const vk::Buffer staging,
+    const vk::Image image,
+    const uint32_t width,
+    const uint32_t height,
+    const vk::DeviceSize bytes
+) {
+    beginLoad();
+
+    if (copyImage(load_.command_buffer, staging, image, width, height)) load_.images.push_back(image);
+
+    ++load_.uploads;
+    load_.bytes += bytes;
+}
+
+void tdl::UploadQueue::flush(
+    const vk::Queue graphics_queue,
+    const vk::CommandPool graphics_pool
+) {
+    if (load_.uploads == 0) return;
+
+    // on the graphics family the copies are made visible to every later use in the same command buffer
+    if (!dedicated()) {
+        const vk::MemoryBarrier visible {
+            vk::AccessFlagBits::eTransferWrite,
+            vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead
+        };
+
+        load_.command_buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eVertexInput |
+            vk::PipelineStageFlagBits::eVertexShader |
+            vk::PipelineStageFlagBits::eComputeShader,
+            {},
+            visible,
+            nullptr,
+            nullptr
+        );
+    }
+
+    try {
+        load_.command_buffer.end();
+
+        const vk::SubmitInfo submit_info {
+            0,
+            nullptr,
+            nullptr,
+            1,
+            &load_.command_buffer,
+            dedicated() ? 1u : 0u,
+            &load_.done
+        };
+
+        queue_.submit(submit_info, nullptr);
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 107: Failed to submit loads. UploadQueue::flush(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    if (dedicated()) {
+        // the graphics family takes over what the transfer family released
+        std::vector<vk::BufferMemoryBarrier> buffers;
+        buffers.reserve(load_.buffers.size());
+
+        for (const vk::Buffer buffer : load_.buffers) {
+            buffers.push_back({
+                {},
+                vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead,
+                family_,
+                graphics_family_,
+                buffer,
+                0,
+                VK_WHOLE_SIZE
+            });
+        }
+
+        std::vector<vk::ImageMemoryBarrier> images;
+        images.reserve(load_.images.size());
+
+        for (const vk::Image image : load_.images) images.push_back(ownership(image, {}, vk::AccessFlagBits::eShaderRead));
+
+        const vk::CommandBuffer command_buffer = CommandBuffer::begin(device_, graphics_pool);
+
+        command_buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eAllCommands,
+            vk::PipelineStageFlagBits::eAllCommands,
+            {},
+            0, nullptr,
+            static_cast<uint32_t>(buffers.size()), buffers.data(),
+            static_cast<uint32_t>(images.size()), images.data()
+        );
+
+        static constexpr vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eAllCommands;
+
+        try {
+            command_buffer.end();
+
+            const vk::SubmitInfo submit_info {
+                1,
+                &load_.done,
+                &wait_stage,
+                1,
+                &command_buffer
+            };
+
+            graphics_queue.submit(submit_info, nullptr);
+        } catch (const vk::SystemError& err) {
+            throw std::runtime_error(
+                "ERR 108: Failed to acquire loaded resources. UploadQueue::flush(...)\n"
+                + std::string(err.what())
+            );
+        }
+
+        // waits for the copies as well, the acquire waited for them on the GPU
+        graphics_queue.waitIdle();
+        device_.freeCommandBuffers(graphics_pool, command_buffer);
+    } else {
+        queue_.waitIdle();
+    }
+
+    for (const MemoryBuffer* const staging : load_.staging) delete staging;
+
+    loaded_bytes_ += load_.bytes;
+
+    load_.buffers.clear();
+    load_.images.clear();
+    load_.staging.clear();
+    load_.uploads = 0;
+    load_.bytes = 0;
+}
+
+void tdl::UploadQueue::acquire(
+    const vk::CommandBuffer command_buffer,
+    const size_t frame
+) const {
+    const Frame& slot = frames_[frame];
+    if (slot.released.empty()) return;
+
+    std::vector<vk::ImageMemoryBarrier> barriers;
+    barriers.reserve(slot.released.size());
+
+    for (const vk::Image image : slot.released) {
+        barriers.push_back(ownership(image, {}, vk::AccessFlagBits::eShaderRead));
+    }
+
+    // the frame waits for the uploads at the fragment shader stage, the acquire has to come after that wait
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eFragmentShader,
+        vk::PipelineStageFlagBits::eFragmentShader,
+        {},
+        0, nullptr,
+        0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data()
+    );
+}
+
+vk::Semaphore tdl::UploadQueue::submit(
+    const size_t frame
+) {
+    Frame& slot = frames_[frame];
+
+    uploads_ = slot.uploads;
+    bytes_ = slot.bytes;
+
+    // the frame's command buffer was recorded, so the acquires of the released images are in it already
+    slot.released.clear();
+
+    if (slot.uploads == 0) return nullptr;
+
+    try {
+        slot.command_buffer.end();
+
+        const vk::SubmitInfo submit_info {
+            0,
+            nullptr,
+            nullptr,
+            1,
+            &slot.command_buffer,
+            1,
+            &slot.done
+        };
+
+        queue_.submit(submit_info, nullptr);
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 101: Failed to submit uploads. UploadQueue::submit(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    slot.uploads = 0;
+    slot.bytes = 0;
+
+    return slot.done;
+}
+
+bool tdl::UploadQueue::copyImage(
+    const vk::CommandBuffer command_buffer,
+    const vk::Buffer staging,
+    const vk::Image image,
+    const uint32_t width,
+    const uint32_t height
+) const {
+    static constexpr vk::ImageSubresourceRange range {
+        vk::ImageAspectFlagBits::eColor,
+        0,
+        1,
+        0,
+        1
+    };
+
+    // the old contents are discarded, so the image does not have to be acquired from the graphics family first
+    const vk::ImageMemoryBarrier to_transfer {
+        {},
+        vk::AccessFlagBits::eTransferWrite,
+        vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eTransferDstOptimal,
+        vk::QueueFamilyIgnored,
+        vk::QueueFamilyIgnored,
+        image,
+        range
+    };
+
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eTransfer,
+        {},
+        0, nullptr,
+        0, nullptr,
+        1, &to_transfer
+    );
+
+    const vk::BufferImageCopy region {
+        0,
+        0, 0,
+        {
+            vk::ImageAspectFlagBits::eColor,
+            0,
+            0,
+            1
+        },
+        {0, 0, 0},
+        {width, height, 1}
+    };
+
+    command_buffer.copyBufferToImage(staging, image, vk::ImageLayout::eTransferDstOptimal, 1, &region);
+
+    if (dedicated()) {
+        // release, the layout change happens once between this and the acquire on the graphics queue
+        const vk::ImageMemoryBarrier release = ownership(image, vk::AccessFlagBits::eTransferWrite, {});
+
+        command_buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eBottomOfPipe,
+            {},
+            0, nullptr,
+            0, nullptr,
+            1, &release
+        );
+
+        return true;
+    }
+
+    vk::ImageMemoryBarrier to_shader = ownership(image, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
+    to_shader.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+    to_shader.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eFragmentShader,
+        {},
+        0, nullptr,
+        0, nullptr,
+        1, &to_shader
+    );
+
+    return false;
+}
+
+void tdl::UploadQueue::beginLoad() {
+    if (load_.uploads > 0) return;
+
+    // flush() waited for the last batch, so the command buffer can be recorded again
+    load_.command_buffer.reset();
+    load_.command_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+}
+
+vk::ImageMemoryBarrier tdl::UploadQueue::ownership(
+    const vk::Image image,
+    const vk::AccessFlags src_access,
+    const vk::AccessFlags dst_access
+) const {
+    return {
+        src_access,
+        dst_access,
+        vk::ImageLayout::eTransferDstOptimal,
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        family_,
+        graphics_family_,
+        image,
+        {
+            vk::ImageAspectFlagBits::eColor,
+            0,
+            1,
+            0,
+            1
+        }
+    };
+}
+
+void tdl::UploadQueue::destroy() {
+    if (!device_) return;
+
+    for (const Frame& frame : frames_) device_.destroySemaphore(frame.done);
+    frames_.clear();
+
+    // loads that were never flushed
+    for (const MemoryBuffer* const staging : load_.staging) delete staging;
+    device_.destroySemaphore(load_.done);
+    load_ = {};
+
+    device_.destroyCommandPool(command_pool_);
+    command_pool_ = nullptr;
+    device_ = nullptr;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace tdl {
+    class MemoryBuffer;
+
+    /**
+     * @breif Uploads of the meshes and textures being loaded and streaming uploads of a frame (the video frames),
+     * recorded into command buffers of their own
+     *
+     * The command buffer is submitted to a transfer only queue when the device has one, so the copies run while the
+     * other frames in flight are rendered instead of stalling the graphics queue with waitIdle. The frame waits for
+     * them with a semaphore at the fragment shader stage.
+     *
+     * The images stay owned by the graphics queue family. Every copy overwrites the whole image, so the transfer queue
+     * starts from vk::ImageLayout::eUndefined without acquiring it and releases it to the graphics family afterwards,
+     * the frame acquires it with acquire(). Without a dedicated family the same command buffer goes to the graphics
+     * queue and no ownership transfer is recorded.
+     *
+     * An image written here may only be read by the frame that wrote it, Texture keeps one per frame in flight. The
+     * fence of that frame also covers the reuse of its upload command buffer, Vulkan 1.0 has no timeline semaphores.
+     *
+     * Loads (loadBuffer() and loadImage()) go into a separate command buffer that flush() submits as one batch. The
+     * buffers and images are released by the transfer family and acquired by a graphics command buffer that waits for
+     * the batch with a semaphore, so a scene costs a single wait instead of one per copy.
+    */
+    class UploadQueue {
+        public:
+            /**
+             * @breif Creates the command buffers and semaphores of every frame in flight
+             *
+             * @param device current GPU (logical)
+             * @param queue queue the uploads are submitted to, the graphics queue if there is no transfer only family
+             * @param family queue family of queue
+             * @param graphics_family queue family the uploaded images are used by
+             * @param frames frames in flight
+            */
+            void init (
+                vk::Device device,
+                vk::Queue queue,
+                uint32_t family,
+                uint32_t graphics_family,
+                unsigned int frames
+            );
+
+            /**
+             * @breif Records a copy of a whole staging buffer into a single mip, single layer colour image
+             *
+             * The image ends up in vk::ImageLayout::eShaderReadOnlyOptimal once the frame acquired it.
+             *
+             * @param frame frame in flight the image is read by
+             * @param staging host visible buffer holding the texels, written before the frame is submitted
+             * @param image image to overwrite
+             * @param width width of the image in texels
+             * @param height height of the image in texels
+             * @param bytes size of the copy, only counted
+            */
+            void copyToImage (
+                size_t frame,
+                vk::Buffer staging,
+                vk::Image image,
+                uint32_t width,
+                uint32_t height,
+                vk::DeviceSize bytes
+            );
+
+            /**
+             * @breif Records the copy of a staging buffer into a buffer of a mesh being loaded, submitted by flush()
+             *
+             * @param staging host visible buffer holding the data, the queue owns it and frees it after flush()
+             * @param buffer device local buffer to overwrite, read as vertices, indices or from a shader afterwards
+             * @param bytes size of the copy
+            */
+            void loadBuffer (
+                MemoryBuffer* staging,
+                vk::Buffer buffer,
+                vk::DeviceSize bytes
+            );
+
+            /**
+             * @breif Records the copy of a staging buffer into a texture being loaded, submitted by flush()
+             *
+             * The image is in vk::ImageLayout::eShaderReadOnlyOptimal once flush() returns.
+             *
+             * @param staging host visible buffer holding the texels, it has to live until flush() returns
+             * @param image single mip, single layer colour image to overwrite
+             * @param width width of the image in texels
+             * @param height height of the image in texels
+             * @param bytes size of the copy, only counted
+            */
+            void loadImage (
+                vk::Buffer staging,
+                vk::Image image,
+                uint32_t width,
+                uint32_t height,
+                vk::DeviceSize bytes
+            );
+
+            /**
+             * @breif Submits the recorded loads and waits for them, nothing if none were recorded
+             *
+             * @param graphics_queue queue the loaded buffers and images are used on
+             * @param graphics_pool pool of graphics_queue's family, the acquires are recorded with it
+            */
+            void flush (
+                vk::Queue graphics_queue,
+                vk::CommandPool graphics_pool
+            );
+
+            /**
+             * @breif Records the ownership acquire of the images uploaded for the frame, nothing without a dedicated queue
+             *
+             * @param command_buffer graphics command buffer of the frame, outside of a render pass
+             * @param frame frame in flight
+            */
+            void acquire (
+                vk::CommandBuffer command_buffer,
+                size_t frame
+            ) const;
+
+            /**
+             * @breif Submits the uploads recorded for the frame, after acquire() was recorded into its command buffer
+             *
+             * @param frame frame in flight
+             * @return vk::Semaphore semaphore the frame has to wait for at the fragment shader stage, null if nothing
+             * was recorded
+            */
+            vk::Semaphore submit (
+                size_t frame
+            );
+
+            [[nodiscard]] bool dedicated() const { return family_ != graphics_family_; }
+            [[nodiscard]] uint64_t uploads() const { return uploads_; } // copies of the last submitted frame
+            [[nodiscard]] uint64_t bytes() const { return bytes_; }
+            [[nodiscard]] uint64_t loadedBytes() const { return loaded_bytes_; } // by every flush()
+
+            void destroy();
+
+        private:
+            struct Frame {
+                vk::CommandBuffer command_buffer;
+                vk::Semaphore done;
+                std::vector<vk::Image> released; // images to acquire on the graphics queue
+                uint64_t uploads = 0;
+                uint64_t bytes = 0;
+            };
+
+            // uploads of the assets being loaded, submitted together by flush()
+            struct Load {
+                vk::CommandBuffer command_buffer;
+                vk::Semaphore done;
+                std::vector<vk::Buffer> buffers; // released to the graphics family
+                std::vector<vk::Image> images;
+                std::vector<MemoryBuffer*> staging; // freed once the copies are done
+                uint64_t uploads = 0;
+                uint64_t bytes = 0;
+            };
+
+            /**
+             * @breif Records the copy of a staging buffer into a whole image and its release to the graphics family
+             *
+             * @return bool the image was released and has to be acquired, false without a dedicated family
+            */
+            bool copyImage (
+                vk::CommandBuffer command_buffer,
+                vk::Buffer staging,
+                vk::Image image,
+                uint32_t width,
+                uint32_t height
+            ) const;
+
+            void beginLoad();
+
+            [[nodiscard]] vk::ImageMemoryBarrier ownership (
+                vk::Image image,
+                vk::AccessFlags src_access,
+                vk::AccessFlags dst_access
+            ) const;
+
+            vk::Device device_;
+            vk::Queue queue_;
+            uint32_t family_ = 0;
+            uint32_t graphics_family_ = 0;
+            vk::CommandPool command_pool_;
+
+            std::vector<Frame> frames_;
+            Load load_;
+
+            uint64_t uploads_ = 0;
+            uint64_t bytes_ = 0;
+            uint64_t loaded_bytes_ = 0;
+    };
+};
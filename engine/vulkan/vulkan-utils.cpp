@@ -1,7 +1,12 @@
 #include "vulkan-utils.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <set>
 
+#include "../simd.hpp"
+
 std::vector<const char*> tdl::Vlkn::getRequiredExtensions() {
     uint32_t glfwExtensionCount = 0;
     const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
@@ -64,8 +69,23 @@ vk::SurfaceFormatKHR tdl::Vlkn::chooseFormat(
 }
 
 vk::PresentModeKHR tdl::Vlkn::chooseMode(
-    const std::vector<vk::PresentModeKHR>& available_modes
+    const std::vector<vk::PresentModeKHR>& available_modes,
+    const PresentMode wanted
 ) {
+    if (wanted != PresentMode::AUTO) {
+        vk::PresentModeKHR mode = vk::PresentModeKHR::eFifo;
+
+        switch (wanted) {
+            case PresentMode::MAILBOX: mode = vk::PresentModeKHR::eMailbox; break;
+            case PresentMode::IMMEDIATE: mode = vk::PresentModeKHR::eImmediate; break;
+            case PresentMode::FIFO_RELAXED: mode = vk::PresentModeKHR::eFifoRelaxed; break;
+            default: break;
+        }
+
+        // FIFO is the only mode every device has to support
+        return std::ranges::find(available_modes, mode) != available_modes.end() ? mode : vk::PresentModeKHR::eFifo;
+    }
+
     auto best = vk::PresentModeKHR::eFifo;
 
     for (const auto& available_mode : available_modes) {
@@ -82,6 +102,14 @@ vk::PresentModeKHR tdl::Vlkn::chooseMode(
 }
 
 void tdl::Vlkn::init() {
+    // the G-buffer pass has no second phase to draw what the pyramid missed
+    occlusion_ = info_->occlusion_culling_ && info_->render_mode_ == RenderMode::FORWARD;
+
+    if (info_->frames_in_flight_ < 1) {
+        throw std::invalid_argument("ERR 106: At least one frame has to be in flight. Vlkn::init(...)");
+    }
+    max_f_frames_ = info_->frames_in_flight_;
+
     createInstance();
     createSurface();
     pickPhysicalDevice();
@@ -94,17 +122,21 @@ void tdl::Vlkn::init() {
     createGraphicsPipeline();
     createCommandPool();
     createZBuffer();
+    createHiZ();
     createFramebuffers();
     createUniformBuffers();
-    createDescriptorPool();
+    createDescriptorAllocator();
     createDescriptorSets();
     loadModels();
     startCommandBuffers();
     createSyncObjects();
+    createQueryPool();
 };
 
 void tdl::Vlkn::newFrame(
-    const UniformBufferObject& ubo
+    const TransformSnapshot& snapshot,
+    const TransformSnapshot* const previous,
+    const float alpha
 ) {
     if (
         device_.waitForFences(
@@ -113,6 +145,38 @@ void tdl::Vlkn::newFrame(
         ) != vk::Result::eSuccess
     ) throw std::runtime_error("ERR 30: Failed to wait for fences. Vlkn::newFrame(...)");
 
+    // this frame and every frame submitted before it are done, what they used can be destroyed
+    deletions_.collect(fence_values_[current_frame_]);
+
+    // the last frame that used this slot is done, its fragment count can be read and the counter restarted
+    if (count_fragments_) {
+        auto* const fragments = static_cast<uint32_t*>(counter_buffers_[current_frame_]->data());
+
+        stats_.fragments_shaded = *fragments;
+        stats_.overdraw = static_cast<double>(*fragments) / std::max(1u, extent_.width * extent_.height);
+        *fragments = 0;
+    }
+
+    if (timestamp_period_ > 0.0f && timestamps_written_[current_frame_]) {
+        std::array<uint64_t, 2> ticks {};
+
+        const vk::Result result = device_.getQueryPoolResults(
+            timestamps_,
+            static_cast<uint32_t>(current_frame_ * 2), 2,
+            sizeof(ticks), ticks.data(), sizeof(uint64_t),
+            vk::QueryResultFlagBits::e64
+        );
+
+        if (result == vk::Result::eSuccess) {
+            stats_.gpu_time = std::chrono::nanoseconds(
+                static_cast<int64_t>(static_cast<double>(ticks[1] - ticks[0]) * timestamp_period_)
+            );
+        }
+    }
+
+    // transient descriptor sets of the last frame that used this slot can be handed out again
+    descriptors_.beginFrame(current_frame_);
+
     uint32_t idx = 0;
     try {
         const vk::ResultValue result = device_.acquireNextImageKHR(
@@ -131,9 +195,10 @@ void tdl::Vlkn::newFrame(
         );
     }
 
-    regenUBOs(ubo);
+    regenUBOs(snapshot, previous, alpha);
+    recordCommandBuffer(snapshot, idx);
 
-    submitForDraw(command_buffers_[idx], idx);
+    submitForDraw(command_buffers_[current_frame_], idx);
 
     const vk::PresentInfoKHR present_info {
         1,
@@ -155,6 +220,20 @@ void tdl::Vlkn::newFrame(
         );
     }
 
+    // the first frame presented with a new key press in its snapshot
+    if (r_present != vk::Result::eErrorOutOfDateKHR && snapshot.input != measured_input_) {
+        measured_input_ = snapshot.input;
+
+        const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - snapshot.input
+        );
+        latency_total_ += latency;
+
+        ++stats_.inputs_measured;
+        stats_.input_latency = latency;
+        stats_.input_latency_average = latency_total_ / static_cast<int64_t>(stats_.inputs_measured);
+    }
+
     if (r_present == vk::Result::eSuboptimalKHR || resized_) {
         resized_ = false;
         recreateSwapchain();
@@ -168,13 +247,27 @@ void tdl::Vlkn::submitForDraw(
     const vk::CommandBuffer& buffer,
     const uint32_t idx
 ) {
-    vk::PipelineStageFlags waitStages = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    // the video frames are only sampled by the fragment shaders, everything before can run while they are copied
+    const vk::Semaphore uploaded = uploads_.submit(current_frame_);
+    stats_.streamed_uploads = uploads_.uploads();
+    stats_.streamed_bytes = uploads_.bytes();
+    stats_.loaded_bytes = uploads_.loadedBytes();
+
+    const vk::Semaphore wait_semaphores[] = { image_available_[current_frame_], uploaded };
+    static constexpr vk::PipelineStageFlags wait_stages[] = {
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eFragmentShader
+    };
+
+    // the shadow pass goes first, its render pass makes the frame wait for the atlas
+    const vk::CommandBuffer buffers[] = { shadows_.commandBuffer(current_frame_), buffer };
+
     const vk::SubmitInfo submit_info = {
-        1,
-        &image_available_[current_frame_],
-        &waitStages,
-        1,
-        &buffer,
+        uploaded ? 2u : 1u,
+        wait_semaphores,
+        wait_stages,
+        shadow_pass_ ? 2u : 1u,
+        shadow_pass_ ? buffers : &buffers[1],
         1,
         &render_finished_[current_frame_]
     };
@@ -188,6 +281,7 @@ void tdl::Vlkn::submitForDraw(
 
     try {
         graphics_queue_.submit(submit_info, fences_[current_frame_]);
+        fence_values_[current_frame_] = deletions_.submit();
     } catch (const vk::SystemError& err) {
         throw std::runtime_error(
             "ERR 034: Failed to submit command buffer for rendering. Vlkn::submitForDraw(...)\n"
@@ -202,12 +296,17 @@ void tdl::Vlkn::cleanupSwapchain() {
 
     device_.destroySwapchainKHR(swapchain_);
 
+    gbuffer_views_ = {};
+    gbuffer_.destroy();
+    hiz_.destroy();
+
     // for (const auto& group : command_buffers_)
     //     device_.freeCommandBuffers(command_pool_, group);
 
-    device_.destroyPipeline(graphics_pipeline_);
+    pipelines_.destroy();
     device_.destroyPipelineLayout(pipeline_layout_);
     device_.destroyRenderPass(render_pass_);
+    device_.destroyRenderPass(occlusion_pass_);
 
     device_.destroyImage(z_buffer_);
     device_.freeMemory(z_buffer_memory_);
@@ -215,20 +314,26 @@ void tdl::Vlkn::cleanupSwapchain() {
 }
 
 void tdl::Vlkn::cleanup() {
+    device_.waitIdle();
+    graph_.destroy();
+    deletions_.destroy();
+
     cleanupSwapchain();
 
+    shadows_.destroy();
+    culler_.destroy();
+    occluder_.destroy();
+    device_.destroyQueryPool(timestamps_);
+
+    if (!command_buffers_.empty()) device_.freeCommandBuffers(command_pool_, command_buffers_);
+
     device_.destroyCommandPool(command_pool_);
+    uploads_.destroy();
     device_.destroyDescriptorSetLayout(ubo_layout_);
     device_.destroyDescriptorSetLayout(object_layout_);
-    device_.destroyDescriptorSetLayout(model_layout_);
-    device_.destroyDescriptorPool(descriptor_pool_);
-
-    for (const auto& group : command_buffers_)
-        device_.freeCommandBuffers(command_pool_, group);
-
-        device_.destroyPipeline(graphics_pipeline_);
-        device_.destroyPipelineLayout(pipeline_layout_);
-        device_.destroyRenderPass(render_pass_);
+    descriptors_.destroy();
+    textures_.destroy();
+    materials_.destroy();
 
     for (size_t i = 0; i < max_f_frames_; ++i) {
         device_.destroyFence(fences_[i]);
@@ -236,6 +341,8 @@ void tdl::Vlkn::cleanup() {
         device_.destroySemaphore(image_available_[i]);
 
         delete uniform_buffers_[i];
+        delete counter_buffers_[i];
+        delete transform_buffers_[i];
     }
 
     instance_->destroySurfaceKHR(surface_);
@@ -253,16 +360,22 @@ void tdl::Vlkn::recreateSwapchain() {
     }
 
     device_.waitIdle();
+    deletions_.flush();
 
     cleanupSwapchain();
 
     createSwapchain();
     createImageViews();
     createZBuffer();
+    createHiZ();
     createRenderPass();
     createGraphicsPipeline();
     createFramebuffers();
     startCommandBuffers();
+
+    // the culling descriptor sets still point at the old pyramid
+    if (info_->meshlet_culling_) culler_.setPyramid(hiz_.view(), hiz_.sampler());
+    if (occlusion_) occluder_.setPyramid(hiz_.view(), hiz_.sampler());
 }
 
 void tdl::Vlkn::createInstance() {
@@ -317,15 +430,32 @@ void tdl::Vlkn::pickPhysicalDevice() {
 void tdl::Vlkn::createLogicalDevice() {
     const auto [graphics, present] = findQueueFamilies(physical_device_);
 
+    // streaming uploads go to a transfer only queue if there is one, the graphics queue otherwise
+    transfer_family_ = findTransferFamily(physical_device_).value_or(graphics.value());
+
     std::vector<vk::DeviceQueueCreateInfo> info_group;
-    const std::set<uint32_t> unique = { graphics.value(), present.value() };
+    const std::set<uint32_t> unique = { graphics.value(), present.value(), transfer_family_ };
 
     float priority = 1.0f;
     for (const uint32_t family : unique) {
         info_group.emplace_back( vk::DeviceQueueCreateFlags {}, family, 1, &priority);
     }
 
-    static constexpr vk::PhysicalDeviceFeatures features {};
+    // the fragment counter needs atomics in the fragment shader, counting is turned off if they are not supported
+    const vk::PhysicalDeviceFeatures supported = physical_device_.getFeatures();
+    vk::PhysicalDeviceFeatures features {};
+    count_fragments_ = info_->count_fragments_ && supported.fragmentStoresAndAtomics;
+    features.fragmentStoresAndAtomics = count_fragments_ ? VK_TRUE : VK_FALSE;
+
+    // the texture table is indexed with a push constant, there is no fallback without it
+    if (!supported.shaderSampledImageArrayDynamicIndexing) {
+        throw std::runtime_error(
+            "ERR 097: GPU can not index sampler arrays in shaders (shaderSampledImageArrayDynamicIndexing). "
+            "Vlkn::createLogicalDevice(...)"
+        );
+    }
+    features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+
     const vk::DeviceCreateInfo device_info {
         {},
         static_cast<uint32_t>(info_group.size()), info_group.data(),
@@ -345,6 +475,9 @@ void tdl::Vlkn::createLogicalDevice() {
 
     graphics_queue_ = device_.getQueue(graphics.value(), 0);
     present_queue_ = device_.getQueue(present.value(), 0);
+    deletions_.init(device_);
+    graph_.init(device_, physical_device_, deletions_);
+    transfer_queue_ = device_.getQueue(transfer_family_, 0);
 }
 
 void tdl::Vlkn::createSwapchain() {
@@ -354,10 +487,13 @@ void tdl::Vlkn::createSwapchain() {
         physical_device_.getSurfacePresentModesKHR(surface_)
     };
     const vk::SurfaceFormatKHR surfaceFormat = chooseFormat(sc_support.formats);
-    const vk::PresentModeKHR presentMode = chooseMode(sc_support.present_modes);
+    const vk::PresentModeKHR presentMode = chooseMode(sc_support.present_modes, info_->present_mode_);
     const vk::Extent2D extent = chooseExtent(sc_support.capabilities);
 
-    uint32_t imageCount = sc_support.capabilities.minImageCount + 1;
+    // fewer images queue fewer frames in front of the display, more let mailbox always find a free one
+    uint32_t imageCount = info_->swapchain_images_ > 0
+        ? std::max(info_->swapchain_images_, sc_support.capabilities.minImageCount)
+        : sc_support.capabilities.minImageCount + 1;
     if (
         sc_support.capabilities.maxImageCount > 0 &&
         imageCount > sc_support.capabilities.maxImageCount
@@ -435,6 +571,9 @@ void tdl::Vlkn::createImageViews() {
 }
 
 void tdl::Vlkn::createRenderPass() {
+    const bool deferred = info_->render_mode_ == RenderMode::DEFERRED;
+
+    // with occlusion culling the frame continues in occlusion_pass_, the depth is kept for the HiZ pyramid
     const vk::AttachmentDescription color {
         {},
         format_,
@@ -444,19 +583,19 @@ void tdl::Vlkn::createRenderPass() {
         vk::AttachmentLoadOp::eDontCare,
         vk::AttachmentStoreOp::eDontCare,
         vk::ImageLayout::eUndefined,
-        vk::ImageLayout::ePresentSrcKHR
+        occlusion_ ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::ePresentSrcKHR
     };
 
-    static constexpr vk::AttachmentDescription depth {
+    const vk::AttachmentDescription depth {
         {},
         vk::Format::eD32Sfloat,
         vk::SampleCountFlagBits::e1,
         vk::AttachmentLoadOp::eClear,
-        vk::AttachmentStoreOp::eDontCare,
+        occlusion_ ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare,
         vk::AttachmentLoadOp::eDontCare,
         vk::AttachmentStoreOp::eDontCare,
         vk::ImageLayout::eUndefined,
-        vk::ImageLayout::eDepthStencilAttachmentOptimal
+        occlusion_ ? vk::ImageLayout::eDepthStencilReadOnlyOptimal : vk::ImageLayout::eDepthStencilAttachmentOptimal
     };
 
     static constexpr vk::AttachmentReference depth_ref {
@@ -468,38 +607,175 @@ void tdl::Vlkn::createRenderPass() {
         vk::ImageLayout::eColorAttachmentOptimal
     };
 
-    static constexpr vk::SubpassDescription subpass {
-        {},
-        vk::PipelineBindPoint::eGraphics,
-        0, nullptr,
-        1, &color_ref,
-        nullptr, &depth_ref
+    std::vector<vk::AttachmentDescription> attachments = { color, depth };
+    std::vector<vk::SubpassDescription> subpasses;
+    std::vector<vk::SubpassDependency> dependencies = {
+        {
+            VK_SUBPASS_EXTERNAL,
+            0,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests,
+            {},
+            vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite
+        }
     };
 
-    const std::array<vk::AttachmentDescription, 2> attachments = { color, depth };
+    // G-buffer attachments follow the depth attachment, written by subpass 0 and read by subpass 1
+    std::array<vk::AttachmentReference, GBuffer::count> gbuffer_refs;
+    std::array<vk::AttachmentReference, GBuffer::count> input_refs;
+
+    if (deferred) {
+        for (uint32_t i = 0; i < GBuffer::count; ++i) {
+            // never stored, on tile based GPUs the G-buffer does not leave tile memory
+            attachments.emplace_back(
+                vk::AttachmentDescriptionFlags {},
+                GBuffer::formats[i],
+                vk::SampleCountFlagBits::e1,
+                vk::AttachmentLoadOp::eClear,
+                vk::AttachmentStoreOp::eDontCare,
+                vk::AttachmentLoadOp::eDontCare,
+                vk::AttachmentStoreOp::eDontCare,
+                vk::ImageLayout::eUndefined,
+                vk::ImageLayout::eShaderReadOnlyOptimal
+            );
+
+            gbuffer_refs[i] = { 2 + i, vk::ImageLayout::eColorAttachmentOptimal };
+            input_refs[i] = { 2 + i, vk::ImageLayout::eShaderReadOnlyOptimal };
+        }
+
+        subpasses.push_back({
+            {},
+            vk::PipelineBindPoint::eGraphics,
+            0, nullptr,
+            GBuffer::count, gbuffer_refs.data(),
+            nullptr, &depth_ref
+        });
+
+        subpasses.push_back({
+            {},
+            vk::PipelineBindPoint::eGraphics,
+            GBuffer::count, input_refs.data(),
+            1, &color_ref,
+            nullptr, nullptr
+        });
+
+        // by region, every pixel of the lighting pass only reads the G-buffer at the same pixel
+        dependencies.emplace_back(
+            0,
+            1,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::PipelineStageFlagBits::eFragmentShader,
+            vk::AccessFlagBits::eColorAttachmentWrite,
+            vk::AccessFlagBits::eInputAttachmentRead,
+            vk::DependencyFlagBits::eByRegion
+        );
+
+        // the swapchain image is first used by subpass 1, its layout transition has to wait for the acquire semaphore
+        dependencies.emplace_back(
+            VK_SUBPASS_EXTERNAL,
+            1,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::AccessFlags {},
+            vk::AccessFlagBits::eColorAttachmentWrite
+        );
+    } else {
+        subpasses.push_back({
+            {},
+            vk::PipelineBindPoint::eGraphics,
+            0, nullptr,
+            1, &color_ref,
+            nullptr, &depth_ref
+        });
+    }
+
+    // hiz.comp reads the depth of the first phase
+    if (occlusion_) {
+        dependencies.emplace_back(
+            0,
+            VK_SUBPASS_EXTERNAL,
+            vk::PipelineStageFlagBits::eLateFragmentTests,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+            vk::AccessFlagBits::eShaderRead
+        );
+    }
+
+    try {
+        render_pass_ = device_.createRenderPass({
+            {},
+            static_cast<uint32_t>(attachments.size()),
+            attachments.data(),
+            static_cast<uint32_t>(subpasses.size()),
+            subpasses.data(),
+            static_cast<uint32_t>(dependencies.size()),
+            dependencies.data()
+        });
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 042: Failed to create render pass. Vlkn::createRenderPass(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    if (!occlusion_) return;
+
+    // compatible with render_pass_, so it shares the framebuffers and the pipelines
+    const std::array<vk::AttachmentDescription, 2> second_attachments {{
+        {
+            {},
+            format_,
+            vk::SampleCountFlagBits::e1,
+            vk::AttachmentLoadOp::eLoad,
+            vk::AttachmentStoreOp::eStore,
+            vk::AttachmentLoadOp::eDontCare,
+            vk::AttachmentStoreOp::eDontCare,
+            vk::ImageLayout::eColorAttachmentOptimal,
+            vk::ImageLayout::ePresentSrcKHR
+        },
+        {
+            {},
+            vk::Format::eD32Sfloat,
+            vk::SampleCountFlagBits::e1,
+            vk::AttachmentLoadOp::eLoad,
+            vk::AttachmentStoreOp::eDontCare,
+            vk::AttachmentLoadOp::eDontCare,
+            vk::AttachmentStoreOp::eDontCare,
+            vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+            vk::ImageLayout::eDepthStencilAttachmentOptimal
+        }
+    }};
 
-    static constexpr vk::SubpassDependency dependency {
+    // waits for the first phase and for the pyramid reads before the depth is written again
+    const vk::SubpassDependency second_dependency {
         VK_SUBPASS_EXTERNAL,
         0,
-        vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests,
-        vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests,
-        {},
-        vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite
+        vk::PipelineStageFlagBits::eColorAttachmentOutput |
+        vk::PipelineStageFlagBits::eLateFragmentTests |
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput |
+        vk::PipelineStageFlagBits::eEarlyFragmentTests |
+        vk::PipelineStageFlagBits::eLateFragmentTests,
+        vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+        vk::AccessFlagBits::eColorAttachmentRead |
+        vk::AccessFlagBits::eColorAttachmentWrite |
+        vk::AccessFlagBits::eDepthStencilAttachmentRead |
+        vk::AccessFlagBits::eDepthStencilAttachmentWrite
     };
 
     try {
-        render_pass_ = device_.createRenderPass({
+        occlusion_pass_ = device_.createRenderPass({
             {},
-            attachments.size(),
-            attachments.data(),
+            static_cast<uint32_t>(second_attachments.size()),
+            second_attachments.data(),
             1,
-            &subpass,
+            subpasses.data(),
             1,
-            &dependency
+            &second_dependency
         });
     } catch (const vk::SystemError& err) {
         throw std::runtime_error(
-            "ERR 042: Failed to create render pass. Vlkn::createRenderPass(...)\n"
+            "ERR 094: Failed to create occlusion render pass. Vlkn::createRenderPass(...)\n"
             + std::string(err.what())
         );
     }
@@ -509,12 +785,21 @@ void tdl::Vlkn::createFramebuffers() {
     framebuffers_.resize(image_views_.size());
 
     for (size_t i = 0; i < image_views_.size(); ++i) {
-        const std::array<vk::ImageView, 2> attachments = { image_views_[i], z_buffer_view_ };
+        std::vector<vk::ImageView> attachments = { image_views_[i], z_buffer_view_ };
+        if (info_->render_mode_ == RenderMode::DEFERRED) {
+            // the graph creates the G-buffer with the first frame, recordCommandBuffer() creates the framebuffers then
+            if (!gbuffer_views_[0]) {
+                framebuffers_[i] = nullptr;
+                continue;
+            }
+
+            attachments.insert(attachments.end(), gbuffer_views_.begin(), gbuffer_views_.end());
+        }
 
         vk::FramebufferCreateInfo framebufferInfo {
             {},
             render_pass_,
-            attachments.size(),
+            static_cast<uint32_t>(attachments.size()),
             attachments.data(),
             extent_.width,
             extent_.height,
@@ -535,7 +820,7 @@ void tdl::Vlkn::createFramebuffers() {
 void tdl::Vlkn::createCommandPool() {
     const auto [graphics, _] = findQueueFamilies(physical_device_);
     const vk::CommandPoolCreateInfo pool_info = {
-        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer, // shadow passes are recorded again every time they change
         graphics.value()
     };
 
@@ -547,21 +832,26 @@ void tdl::Vlkn::createCommandPool() {
             + std::string(err.what())
         );
     }
+
+    // the uploads have their own pool, on the transfer family if the device has one
+    uploads_.init(device_, transfer_queue_, transfer_family_, graphics.value(), max_f_frames_);
 }
 
 void tdl::Vlkn::loadModels() {
     for (const auto& object : objects_) {
         object->setSampler(sampler_);
 
-        object->loadMesh(device_, graphics_queue_, command_pool_, physical_device_);
+        object->loadMesh(device_, graphics_queue_, command_pool_, physical_device_, uploads_);
 
         object->loadTexture(
             device_,
             graphics_queue_,
             command_pool_,
             physical_device_,
-            texture_layout_,
-            descriptor_pool_
+            textures_,
+            deletions_,
+            uploads_,
+            max_f_frames_
         );
 
         object->initUBOs(
@@ -572,21 +862,23 @@ void tdl::Vlkn::loadModels() {
             physical_device_
         );
 
-        object->createDescriptorSets(max_f_frames_, descriptor_pool_, device_, model_layout_, object_layout_);
+        object->createDescriptorSets(max_f_frames_, descriptors_, device_, object_layout_);
     }
 
     for (const auto& light : lights_) {
         light->light_model_->setSampler(sampler_);
 
-        light->light_model_->loadMesh(device_, graphics_queue_, command_pool_, physical_device_);
+        light->light_model_->loadMesh(device_, graphics_queue_, command_pool_, physical_device_, uploads_);
 
         light->light_model_->loadTexture(
             device_,
             graphics_queue_,
             command_pool_,
             physical_device_,
-            texture_layout_,
-            descriptor_pool_
+            textures_,
+            deletions_,
+            uploads_,
+            max_f_frames_
         );
 
         light->light_model_->initUBOs(
@@ -597,11 +889,14 @@ void tdl::Vlkn::loadModels() {
             physical_device_
         );
 
-        light->light_model_->createDescriptorSets(max_f_frames_, descriptor_pool_, device_, model_layout_, object_layout_);
+        light->light_model_->createDescriptorSets(max_f_frames_, descriptors_, device_, object_layout_);
     }
 
-    LightHelper::initUBOs(
-        light_ubos_,
+    // the meshes and textures were recorded into one batch, submitted on the transfer queue if there is one
+    uploads_.flush(graphics_queue_, command_pool_);
+
+    LightHelper::initBuffers(
+        light_buffers_,
         max_f_frames_,
         device_,
         graphics_queue_,
@@ -609,16 +904,62 @@ void tdl::Vlkn::loadModels() {
         physical_device_
     );
 
-    LightHelper::createDescriptorSets(light_descriptor_sets_, light_ubos_, max_f_frames_, descriptor_pool_, device_, lights_layout_);
+    shadows_.init(
+        device_,
+        physical_device_,
+        graphics_queue_,
+        command_pool_,
+        {ubo_layout_, textures_.layout(), object_layout_},
+        readFile(TDL_SHADER_DIR "shadow.spv"),
+        max_f_frames_
+    );
+
+    if (info_->meshlet_culling_) {
+        culler_.init(
+            device_,
+            physical_device_,
+            graphics_queue_,
+            command_pool_,
+            readFile(TDL_SHADER_DIR "cull.spv"),
+            max_f_frames_,
+            hiz_.view(),
+            hiz_.sampler()
+        );
+    }
+
+    if (occlusion_) {
+        occluder_.init(
+            device_,
+            physical_device_,
+            graphics_queue_,
+            command_pool_,
+            descriptors_,
+            readFile(TDL_SHADER_DIR "occlusion.spv"),
+            max_f_frames_,
+            hiz_.view(),
+            hiz_.sampler()
+        );
+    }
+
+    LightHelper::createDescriptorSets(
+        light_descriptor_sets_,
+        light_buffers_,
+        max_f_frames_,
+        descriptors_,
+        device_,
+        lights_layout_,
+        shadows_.view(),
+        shadows_.sampler()
+    );
 }
 
 void tdl::Vlkn::startCommandBuffers() {
-    command_buffers_.resize(framebuffers_.size());
+    if (!command_buffers_.empty()) return; // one per frame in flight, they survive swapchain changes
 
     const vk::CommandBufferAllocateInfo alloc_info = {
         command_pool_,
         vk::CommandBufferLevel::ePrimary,
-        static_cast<uint32_t>(command_buffers_.size())
+        static_cast<uint32_t>(max_f_frames_)
     };
 
     try {
@@ -629,61 +970,447 @@ void tdl::Vlkn::startCommandBuffers() {
             + std::string(err.what())
         );
     }
+}
 
-    for (size_t i = 0; i < command_buffers_.size(); ++i) {
-        static constexpr vk::CommandBufferBeginInfo begin_info {
-            vk::CommandBufferUsageFlagBits::eSimultaneousUse
-        };
+void tdl::Vlkn::recordCommandBuffer(
+    const TransformSnapshot& snapshot,
+    const uint32_t idx
+) {
+    const bool prepass = info_->depth_prepass_;
+
+    // pixels covered by a distance of 1 at a distance of 1 from the camera
+    const float lod_threshold = info_->lod_threshold_;
+    const float pixels_per_unit = snapshot.camera.proj[1][1] * 0.5f * static_cast<float>(extent_.height);
+
+    // the lens distortion moves vertices after the projection, the frustum and the pyramid would cull visible ones
+    const bool meshlet_culling = info_->meshlet_culling_;
+    const uint32_t cull_flags = snapshot.camera.data.y > 0.0f ? 0 :
+        CullFlags::frustum | (occlusion_ ? CullFlags::occlusion : 0);
+    const bool second_phase = (cull_flags & CullFlags::occlusion) != 0;
+
+    culler_.begin(current_frame_);
+    if (occlusion_) occluder_.begin(current_frame_, static_cast<uint32_t>(snapshot.objects.size()));
+
+    // snapshot entries are in the same order as the models, the lights' models come last
+    draws_.clear();
+    size_t object_idx = 0;
+
+    const auto addDraws = [&](const Model& model) {
+        for (const auto& object : model.objects_ | std::views::values) {
+            PipelineKey key = object->pipelineKey();
+            key.after_prepass = prepass;
+
+            // the transform written to the object's UBO, blended between the two ticks
+            const glm::mat4& world = frame_models_[object_idx];
+            const glm::vec4 centre = frame_view_ * world * glm::vec4(object->centre_, 1.0f);
+            draws_.push_back({key.id(), object->material_, -centre.z, object.get(), {}});
+            Draw& draw = draws_.back();
+
+            // the error is projected at the nearest point of the bounding sphere, inside it the full mesh is drawn
+            uint32_t lod = 0;
+            if (lod_threshold > 0.0f && object->mesh_->lodCount() > 1) {
+                const float scale = ObjectInterface::maxScale(world);
+                const float distance = glm::length(glm::vec3(centre)) - object->radius_ * scale;
+
+                if (distance > 0.0f) {
+                    lod = object->mesh_->selectLod(pixels_per_unit * scale / distance, lod_threshold, object->lod_);
+                }
+            }
+            object->lod_ = lod;
+
+            // only the full mesh is split into meshlets, coarse levels are small enough to draw whole
+            draw.culled = {};
+            if (meshlet_culling && lod == 0 && object->mesh_->cullable()) {
+                MeshletCuller::Constants constants;
+                constants.to_clip = frame_view_proj_[current_frame_] * world;
+                constants.pyramid = hiz_.size();
+                constants.meshlet_count = object->mesh_->meshletCount();
+                constants.flags = cull_flags | (info_->meshlet_cone_culling_ ? CullFlags::cones : 0);
+
+                const glm::vec4 camera = glm::inverse(frame_view_ * world) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+                constants.camera = glm::vec4(glm::vec3(camera) / camera.w, 1.0f);
+
+                draw.culled = culler_.add(object.get(), *object->mesh_, constants);
+            } else if (occlusion_) {
+                draw.culled = occluder_.add(
+                    static_cast<uint32_t>(object_idx),
+                    object->boundingSphere(world),
+                    object->mesh_->getLod(lod)
+                );
+            }
+            object->culled_ = draw.culled[0];
 
-        try {
-            command_buffers_[i].begin(begin_info);
-        } catch (const vk::SystemError& err) {
-            throw std::runtime_error(
-                "ERR 046: Failed to start command buffer. Vlkn::startCommandBuffers(...)\n"
-                + std::string(err.what())
+            ++object_idx;
+        }
+    };
+
+    for (const auto& model : objects_) addDraws(*model.ptr_);
+    for (const auto& light : lights_) addDraws(*light->light_model_.ptr_);
+
+    // front to back so the depth test rejects as many hidden fragments as possible
+    std::ranges::sort(draws_, {}, &Draw::depth);
+
+    const vk::CommandBuffer command_buffer = command_buffers_[current_frame_];
+
+    static constexpr vk::CommandBufferBeginInfo begin_info {
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+    };
+
+    try {
+        command_buffer.reset();
+        command_buffer.begin(begin_info);
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 046: Failed to start command buffer. Vlkn::recordCommandBuffer(...)\n"
+            + std::string(err.what())
+        );
+    }
+
+    const bool deferred = info_->render_mode_ == RenderMode::DEFERRED;
+
+    // the G-buffer is cleared to 0, a view depth of 0 marks the pixels nothing was drawn to
+    std::array<vk::ClearValue, 2 + GBuffer::count> clear_values {
+        vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}),
+        vk::ClearDepthStencilValue(1.0f, 0)
+    };
+
+    vk::RenderPassBeginInfo pass_info = {
+        render_pass_,
+        framebuffers_[idx],
+        {
+            {0, 0},
+            extent_
+        },
+        deferred ? static_cast<uint32_t>(clear_values.size()) : 2u,
+        clear_values.data()
+    };
+
+    if (timestamp_period_ > 0.0f) {
+        command_buffer.resetQueryPool(timestamps_, static_cast<uint32_t>(current_frame_ * 2), 2);
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestamps_, static_cast<uint32_t>(current_frame_ * 2));
+    }
+
+    OcclusionCuller::Constants occlusion;
+    occlusion.view_proj = frame_view_proj_[current_frame_];
+    occlusion.pyramid = hiz_.size();
+    occlusion.flags = cull_flags;
+
+    uploads_.acquire(command_buffer, current_frame_);
+
+    uint64_t descriptor_binds = 0;
+    uint64_t vertex_bytes = 0;
+    uint64_t index_bytes = 0;
+    uint64_t triangles = 0;
+    uint64_t full_triangles = 0; // triangles without the levels of detail
+    uint64_t lod_draws = 0;
+    double transformed = 0.0; // simulated vertex shader invocations of the main pass
+
+    DrawConstants pushed { UINT32_MAX, UINT32_MAX }; // DrawConstants last pushed, none yet
+    uint64_t material_changes = 0;
+    uint64_t dynamic_draws = 0;
+    bool ubo_bound = false;
+
+    // push constants stay set across pipeline switches and render passes, every pipeline has the same layout
+    const auto pushDraw = [&](const ObjectInterface& object) {
+        const DrawConstants constants { object.material_, object.transform_slot_ };
+        if (constants.material != pushed.material) ++material_changes;
+
+        if (constants.material != pushed.material || constants.transform != pushed.transform) {
+            command_buffer.pushConstants(
+                pipeline_layout_,
+                vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+                0,
+                sizeof(DrawConstants),
+                &constants
             );
+
+            pushed = constants;
         }
 
-        std::array<vk::ClearValue, 2> clear_values {
-            vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}),
-            vk::ClearDepthStencilValue(1.0f, 0)
-        };
+        // objects in the transform buffer read no UBO, the one bound last keeps set 2 valid for them
+        if (constants.transform == DrawConstants::static_transform || !ubo_bound) {
+            object.bindUBO(command_buffer, pipeline_layout_, current_frame_);
+            ubo_bound = true;
+            ++descriptor_binds;
+        }
 
-        const vk::RenderPassBeginInfo pass_info = {
-            render_pass_,
-            framebuffers_[i],
+        if (constants.transform != DrawConstants::static_transform) ++dynamic_draws;
+    };
+
+    uint32_t bound = PipelineKey::count; // no pipeline bound yet
+    uint64_t pipeline_binds = 0;
+    uint64_t mesh_binds = 0;
+
+    // the frame as passes, the graph records the barriers between them and drops the ones nothing reads from
+    graph_.reset();
+
+    const RenderGraph::Resource swapchain = graph_.importImage(
+        "swapchain",
+        images_[idx],
+        vk::ImageAspectFlagBits::eColor,
+        1,
+        vk::ImageLayout::eUndefined
+    );
+    const RenderGraph::Resource depth = graph_.importImage(
+        "depth",
+        z_buffer_,
+        vk::ImageAspectFlagBits::eDepth,
+        1,
+        vk::ImageLayout::eUndefined
+    );
+    const RenderGraph::Resource pyramid = graph_.importImage(
+        "hiz",
+        hiz_.image(),
+        vk::ImageAspectFlagBits::eColor,
+        hiz_.levels(),
+        vk::ImageLayout::eGeneral,
+        Usage::ComputeSample // the culling of the last frame may still read it
+    );
+    // indirect commands and index buffers written by the culling passes, the frame's own set of them
+    const RenderGraph::Resource culled = graph_.importBuffer("culled draws");
+
+    const RenderGraph::Pass cull = graph_.addPass("cull", [&](const vk::CommandBuffer buffer) {
+        culler_.record(buffer, 0);
+        if (occlusion_) occluder_.record(buffer, 0, occlusion);
+    });
+    graph_.write(cull, culled, Usage::ComputeWrite);
+    if (second_phase) graph_.read(cull, pyramid, Usage::ComputeSample, vk::ImageLayout::eGeneral);
+
+    vk::DescriptorSet inputs; // G-buffer of the frame, written once the graph created it
+    const RenderGraph::Pass scene = graph_.addPass("scene", [&](const vk::CommandBuffer buffer) {
+        buffer.beginRenderPass(pass_info, vk::SubpassContents::eInline);
+
+        // all pipelines share one layout so the sets stay bound across pipeline switches, objects only push their texture slot
+        const vk::DescriptorSet textures = textures_.set();
+        buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout_, 3, 1, &light_descriptor_sets_[current_frame_], 0, nullptr);
+        buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout_, 0, 1, &descriptor_sets_[current_frame_], 0, nullptr);
+        buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout_, 1, 1, &textures, 0, nullptr);
+        descriptor_binds += 3; // and the object UBO of every static draw
+
+        if (prepass) {
+            int bound_format = -1; // compressed or not, the pre-pass pipelines differ in their vertex input
+
+            for (const Draw& draw : draws_) {
+                const int compressed = draw.object->mesh_->compressed() ? 1 : 0;
+                if (compressed != bound_format) {
+                    buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines_.depth(compressed));
+                    bound_format = compressed;
+                }
+
+                pushDraw(*draw.object);
+                draw.object->renderDepth(buffer, pipeline_layout_, current_frame_, true);
+                vertex_bytes += draw.object->mesh_->positionBytes();
+                index_bytes += draw.object->mesh_->indexBytes(draw.object->lod_);
+            }
+        }
+
+        // group by pipeline, then material, then mesh so consecutive draws share as much state as they can, stable so
+        // every group stays front to back
+        std::ranges::stable_sort(draws_, [](const Draw& a, const Draw& b) {
+            if (a.key != b.key) return a.key < b.key;
+            if (a.material != b.material) return a.material < b.material;
+            return std::less<const Mesh*> {}(a.object->mesh_.get(), b.object->mesh_.get());
+        });
+
+        const Mesh* bound_mesh = nullptr; // the pre-pass left the position streams bound
+
+        for (const Draw& draw : draws_) {
+            if (draw.key != bound) {
+                PipelineKey key = draw.object->pipelineKey();
+                key.after_prepass = prepass;
+
+                buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines_.get(key));
+                bound = draw.key;
+                ++pipeline_binds;
+            }
+
+            pushDraw(*draw.object);
+
+            // culled draws bind the index buffer their culling pass wrote, the next draw of the mesh binds it again
+            const Mesh* const draw_mesh = draw.object->mesh_.get();
+            const bool draw_culled = static_cast<bool>(draw.culled[0].command);
+            const bool bind_mesh = draw_culled || draw_mesh != bound_mesh;
+
+            draw.object->render(buffer, pipeline_layout_, current_frame_, bind_mesh);
+            bound_mesh = draw_culled ? nullptr : draw_mesh;
+            if (bind_mesh) ++mesh_binds;
+
+            const Mesh& mesh = *draw.object->mesh_;
+            const uint32_t lod = draw.object->lod_;
+            vertex_bytes += mesh.vertexBytes();
+            index_bytes += mesh.indexBytes(lod);
+            triangles += mesh.triangles(lod);
+            full_triangles += mesh.triangles();
+            transformed += static_cast<double>(mesh.getLod(lod).acmr) * mesh.triangles(lod);
+            if (lod > 0) ++lod_draws;
+        }
+
+        // every pixel of the G-buffer is shaded once, no matter how many objects covered it
+        if (deferred) {
+            buffer.nextSubpass(vk::SubpassContents::eInline);
+            gbuffer_.draw(buffer, descriptor_sets_[current_frame_], inputs, light_descriptor_sets_[current_frame_]);
+        }
+
+        buffer.endRenderPass();
+    });
+    graph_.read(scene, culled, Usage::DrawIndirect);
+    // with occlusion culling the frame continues in occlusion_pass_, the depth is kept for the HiZ pyramid
+    graph_.attachment(
+        scene,
+        swapchain,
+        vk::ImageLayout::eUndefined,
+        occlusion_ ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::ePresentSrcKHR
+    );
+    graph_.attachment(
+        scene,
+        depth,
+        vk::ImageLayout::eUndefined,
+        occlusion_ ? vk::ImageLayout::eDepthStencilReadOnlyOptimal : vk::ImageLayout::eDepthStencilAttachmentOptimal
+    );
+
+    // the G-buffer only lives in the scene pass, the graph places it in memory other images of the frame can share
+    std::array<RenderGraph::Resource, GBuffer::count> gbuffer {};
+    if (deferred) {
+        for (uint32_t i = 0; i < GBuffer::count; ++i) {
+            gbuffer[i] = graph_.createImage("gbuffer " + std::to_string(i), {GBuffer::formats[i], extent_, GBuffer::usage});
+            graph_.attachment(scene, gbuffer[i], vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal);
+        }
+    }
+
+    // second phase, the pyramid holds what the first phase drew and everything it missed is drawn now
+    if (occlusion_) {
+        const RenderGraph::Pass build = graph_.addPass("hiz", [&](const vk::CommandBuffer buffer) {
+            hiz_.build(buffer);
+        });
+        graph_.read(build, depth, Usage::ComputeSample, vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+        graph_.write(build, pyramid, Usage::ComputeWrite);
+
+        const RenderGraph::Pass recull = graph_.addPass("cull phase 1", [&](const vk::CommandBuffer buffer) {
+            culler_.record(buffer, 1);
+            occluder_.record(buffer, 1, occlusion);
+        });
+        graph_.read(recull, pyramid, Usage::ComputeSample, vk::ImageLayout::eGeneral);
+        graph_.write(recull, culled, Usage::ComputeWrite);
+
+        const vk::RenderPassBeginInfo occlusion_info = {
+            occlusion_pass_,
+            framebuffers_[idx],
             {
                 {0, 0},
                 extent_
             },
-            clear_values.size(),
-            clear_values.data()
+            0,
+            nullptr
         };
 
-        command_buffers_[i].beginRenderPass(pass_info, vk::SubpassContents::eInline);
-        command_buffers_[i].bindPipeline(vk::PipelineBindPoint::eGraphics, graphics_pipeline_);
-        
-        command_buffers_[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout_, 4, 1, &light_descriptor_sets_[current_frame_], 0, nullptr);
-        command_buffers_[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout_, 0, 1, &descriptor_sets_[current_frame_], 0, nullptr);
+        // still needed without the second phase, it moves the image to the present layout
+        const RenderGraph::Pass redraw = graph_.addPass("scene phase 1", [&, occlusion_info](const vk::CommandBuffer buffer) {
+            buffer.beginRenderPass(occlusion_info, vk::SubpassContents::eInline);
 
-        for (const auto& object : objects_) {
-            object->render(command_buffers_[i], pipeline_layout_, current_frame_);
-        }
-        for (const auto& light : lights_) {
-            light->light_model_->render(command_buffers_[i], pipeline_layout_, current_frame_);
+            if (second_phase) {
+                bound = PipelineKey::count;
+
+                for (const Draw& draw : draws_) {
+                    if (draw.key != bound) {
+                        // the pre-pass never drew these objects, so they need the normal depth test
+                        PipelineKey key = draw.object->pipelineKey();
+                        key.after_prepass = false;
+
+                        buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines_.get(key));
+                        bound = draw.key;
+                        ++pipeline_binds;
+                    }
+
+                    pushDraw(*draw.object);
+
+                    draw.object->culled_ = draw.culled[1];
+                    draw.object->render(buffer, pipeline_layout_, current_frame_, true);
+                    ++mesh_binds;
+                }
+            }
+
+            buffer.endRenderPass();
+        });
+        // without the second phase nothing reads what the pyramid and phase 1 of the culling would write, both are culled
+        if (second_phase) graph_.read(redraw, culled, Usage::DrawIndirect);
+        graph_.attachment(redraw, swapchain, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR);
+        graph_.attachment(
+            redraw,
+            depth,
+            vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+            vk::ImageLayout::eDepthStencilAttachmentOptimal
+        );
+    }
+
+    graph_.output(swapchain);
+    graph_.compile();
+
+    if (deferred) {
+        std::array<vk::ImageView, GBuffer::count> views {};
+        for (uint32_t i = 0; i < GBuffer::count; ++i) views[i] = graph_.view(gbuffer[i]);
+
+        // the graph only creates new images when the extent changed, the frames in flight may still use the old ones
+        if (views != gbuffer_views_) {
+            for (const vk::Framebuffer framebuffer : framebuffers_) deletions_.push(framebuffer);
+
+            gbuffer_views_ = views;
+            createFramebuffers();
         }
 
-        command_buffers_[i].endRenderPass();
+        pass_info.framebuffer = framebuffers_[idx];
+        inputs = descriptors_.allocateTransient(gbuffer_.layout(), current_frame_);
+        gbuffer_.writeInputs(inputs, views);
+    }
 
-        try {
-            command_buffers_[i].end();
-        } catch (const vk::SystemError& err) {
-            throw std::runtime_error(
-            "ERR 047: Failed to end command buffer. Vlkn::startCommandBuffers(...)\n"
+    graph_.execute(command_buffer);
+
+    if (timestamp_period_ > 0.0f) {
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestamps_, static_cast<uint32_t>(current_frame_ * 2 + 1));
+        timestamps_written_[current_frame_] = true;
+    }
+
+    try {
+        command_buffer.end();
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error(
+            "ERR 047: Failed to end command buffer. Vlkn::recordCommandBuffer(...)\n"
             + std::string(err.what())
         );
-        }
     }
+
+    stats_.draws = draws_.size();
+    stats_.prepass_draws = prepass ? draws_.size() : 0;
+    stats_.pipelines = pipelines_.created();
+    stats_.pipeline_binds = pipeline_binds;
+    stats_.descriptor_binds = descriptor_binds;
+    stats_.material_changes = material_changes;
+    stats_.dynamic_draws = dynamic_draws;
+    stats_.mesh_binds = mesh_binds;
+    stats_.materials = materials_.count();
+    stats_.descriptor_sets = descriptors_.sets() + descriptors_.transientSets();
+    stats_.descriptor_pools = descriptors_.pools();
+    stats_.deletions_pending = deletions_.pending();
+    stats_.deletions_released = deletions_.released();
+    stats_.graph_passes = graph_.passes();
+    stats_.graph_passes_culled = graph_.culled();
+    stats_.graph_barriers = graph_.barriers();
+    stats_.transient_bytes = graph_.transientBytes();
+    stats_.transient_heap_bytes = graph_.heapBytes();
+    stats_.vertex_bytes = vertex_bytes;
+    stats_.index_bytes = index_bytes;
+    stats_.triangles = triangles;
+    stats_.lod_draws = lod_draws;
+    stats_.lod_triangles_saved = full_triangles - triangles;
+    stats_.meshlet_draws = culler_.objects();
+    stats_.meshlets_tested = culler_.meshlets();
+    stats_.meshlet_triangles_drawn = culler_.trianglesDrawn();
+    stats_.occlusion_tested = occluder_.tested();
+    stats_.occlusion_culled = occluder_.culled();
+    stats_.occlusion_redrawn = occluder_.redrawn();
+    stats_.occlusion_culled_fraction = occluder_.tested() > 0
+        ? static_cast<double>(occluder_.culled()) / static_cast<double>(occluder_.tested())
+        : 0.0;
+    stats_.acmr = triangles > 0 ? transformed / static_cast<double>(triangles) : 0.0;
 }
 
 void tdl::Vlkn::createSampler() {
@@ -727,6 +1454,7 @@ void tdl::Vlkn::createSyncObjects() {
     image_available_.resize(max_f_frames_);
     render_finished_.resize(max_f_frames_);
     fences_.resize(max_f_frames_);
+    fence_values_.assign(max_f_frames_, 0);
 
     try {
         for (size_t i = 0; i < max_f_frames_; ++i) {
@@ -743,116 +1471,21 @@ void tdl::Vlkn::createSyncObjects() {
 }
 
 void tdl::Vlkn::createGraphicsPipeline() {
-    const vk::UniqueShaderModule vert = createShaderModule(readFile("../shaders/vert.spv"));
-    const vk::UniqueShaderModule frag = createShaderModule(readFile("../shaders/frag.spv"));
+    const vk::DescriptorSetLayout layouts[] = { ubo_layout_, textures_.layout(), object_layout_, lights_layout_ };
 
-    const vk::PipelineShaderStageCreateInfo stages[] = {
-        {
-            {},
-            vk::ShaderStageFlagBits::eVertex,
-            vert.get(),
-            "main"
-        },
-        {
-            {},
-            vk::ShaderStageFlagBits::eFragment,
-            frag.get(),
-            "main"
-        }
+    // DrawConstants, pushed whenever the material changes between two draws
+    static constexpr vk::PushConstantRange push_constants {
+        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+        0,
+        sizeof(DrawConstants)
     };
 
-    const vk::VertexInputBindingDescription binding = Vertex::getBindingDescription();
-    const std::array<vk::VertexInputAttributeDescription, 3> attributes = Vertex::getAttributeDescriptions();
-
-    const vk::PipelineVertexInputStateCreateInfo vertex_info {
+    const vk::PipelineLayoutCreateInfo pipe_info { // NOLINT (not a constant expression)
         {},
+        std::size(layouts),
+        layouts,
         1,
-        &binding,
-        static_cast<uint32_t>(attributes.size()),
-        attributes.data()
-    };
-
-    static constexpr vk::PipelineInputAssemblyStateCreateInfo assembly {
-        {},
-        vk::PrimitiveTopology::eTriangleList,
-        VK_FALSE
-    };
-
-    const vk::Viewport viewport {
-        0.0f, 0.0f,
-        static_cast<float>(extent_.width),
-        static_cast<float>(extent_.height),
-        0.0f, 1.0f
-    };
-
-    const vk::Rect2D scissor = {
-        {0, 0},
-        extent_
-    };
-
-    vk::PipelineViewportStateCreateInfo viewport_info {
-        {},
-        1,
-        &viewport,
-        1,
-        &scissor
-    };
-
-    static constexpr vk::PipelineRasterizationStateCreateInfo rasterizer {
-        {},
-        VK_FALSE,
-        VK_FALSE,
-        vk::PolygonMode::eFill,
-        vk::CullModeFlagBits::eNone,
-        vk::FrontFace::eClockwise,
-        VK_FALSE,
-        0.0f,
-        0.0f,
-        0.0f,
-        1.0f
-    };
-
-    static constexpr vk::PipelineMultisampleStateCreateInfo multisampling {
-        {},
-        vk::SampleCountFlagBits::e1,
-        VK_FALSE,
-        1.0f,
-        nullptr,
-        VK_FALSE,
-        VK_FALSE
-    };
-
-    static constexpr vk::PipelineColorBlendAttachmentState blending_attach {
-        VK_FALSE,
-        vk::BlendFactor::eOne,
-        vk::BlendFactor::eZero,
-        vk::BlendOp::eAdd,
-        vk::BlendFactor::eOne,
-        vk::BlendFactor::eZero,
-        vk::BlendOp::eAdd,
-        vk::ColorComponentFlags(
-            vk::ColorComponentFlagBits::eR |
-            vk::ColorComponentFlagBits::eG |
-            vk::ColorComponentFlagBits::eB |
-            vk::ColorComponentFlagBits::eA
-        )
-    };
-
-    static constexpr vk::PipelineColorBlendStateCreateInfo blending {
-        {},
-        VK_FALSE,
-        vk::LogicOp::eCopy,
-        1,
-        &blending_attach,
-        {0.0f, 0.0f, 0.0f, 0.0f}
-    };
-
-    const vk::DescriptorSetLayout layouts[] = { ubo_layout_, texture_layout_, object_layout_, model_layout_, lights_layout_ };
-
-    const vk::PipelineLayoutCreateInfo pipe_info { // NOLINT (not a constant expression)
-        {},
-        std::size(layouts),
-        layouts
+        &push_constants
     };
 
     try {
@@ -864,94 +1497,157 @@ void tdl::Vlkn::createGraphicsPipeline() {
         );
     }
 
-    static constexpr vk::PipelineDepthStencilStateCreateInfo depth_stencil {
-        {},
-        VK_TRUE,
-        VK_TRUE,
-        vk::CompareOp::eLess,
-        VK_FALSE,
-        VK_FALSE,
-        {},
-        {},
-        0.0f,
-        1.0f
-    };
+    const bool deferred = info_->render_mode_ == RenderMode::DEFERRED;
 
-    const vk::GraphicsPipelineCreateInfo info {
-        {},
-        2,
-        stages,
-        &vertex_info,
-        &assembly,
-        nullptr,
-        &viewport_info,
-        &rasterizer,
-        &multisampling,
-        &depth_stencil,
-        &blending,
-        nullptr,
+    // the pipelines themselves are created once a draw asks for their permutation
+    pipelines_.init(
+        device_,
         pipeline_layout_,
         render_pass_,
-        0,
-        nullptr,
-        -1
-    };
+        extent_,
+        readFile(TDL_SHADER_DIR "vert.spv"),
+        readFile(deferred ? TDL_SHADER_DIR "gbuffer.spv" : TDL_SHADER_DIR "frag.spv"),
+        readFile(TDL_SHADER_DIR "depth.spv"),
+        count_fragments_,
+        deferred ? GBuffer::count : 1,
+        textures_.size()
+    );
+
+    if (deferred) {
+        gbuffer_.create(
+            device_,
+            extent_,
+            render_pass_,
+            ubo_layout_,
+            object_layout_,
+            lights_layout_,
+            readFile(TDL_SHADER_DIR "fullscreen.spv"),
+            readFile(TDL_SHADER_DIR "deferred.spv")
+        );
+    }
+}
+
+void tdl::Vlkn::createQueryPool() {
+    const auto [graphics, _] = findQueueFamilies(physical_device_);
+
+    const vk::PhysicalDeviceProperties properties = physical_device_.getProperties();
+    const auto families = physical_device_.getQueueFamilyProperties();
+
+    // frame times are only measured if the graphics queue can write timestamps
+    if (families[graphics.value()].timestampValidBits == 0) return;
 
     try {
-        graphics_pipeline_ = device_.createGraphicsPipeline(nullptr, info).value;
+        timestamps_ = device_.createQueryPool({
+            {},
+            vk::QueryType::eTimestamp,
+            static_cast<uint32_t>(max_f_frames_ * 2)
+        });
     } catch (const vk::SystemError& err) {
         throw std::runtime_error(
-            "ERR 050: Failed to create graphics pipeline. Vlkn::createGraphicsPipeline(...)\n"
+            "ERR 082: Failed to create timestamp query pool. Vlkn::createQueryPool(...)\n"
             + std::string(err.what())
         );
     }
+
+    timestamp_period_ = properties.limits.timestampPeriod;
+    timestamps_written_.assign(max_f_frames_, false);
 }
 
 void tdl::Vlkn::createDescriptorSetLayout() {
+    // the deferred lighting pass reads the camera in the fragment shader
     static constexpr vk::DescriptorSetLayoutBinding ubo_binding {
         0,
         vk::DescriptorType::eUniformBuffer,
         1,
-        vk::ShaderStageFlagBits::eVertex,
+        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
         nullptr
     };
 
-    static constexpr vk::DescriptorSetLayoutBinding object_binding {
-        1,
-        vk::DescriptorType::eUniformBuffer,
+    // fragment counter, only written when RendererInfo::count_fragments_ is set
+    static constexpr vk::DescriptorSetLayoutBinding counter_binding {
+        4,
+        vk::DescriptorType::eStorageBuffer,
         1,
-        vk::ShaderStageFlagBits::eVertex,
+        vk::ShaderStageFlagBits::eFragment,
         nullptr
     };
 
-    static constexpr vk::DescriptorSetLayoutBinding model_binding {
+    // MaterialTable, indexed with DrawConstants::material
+    static constexpr vk::DescriptorSetLayoutBinding material_binding {
         2,
-        vk::DescriptorType::eUniformBuffer,
+        vk::DescriptorType::eStorageBuffer,
         1,
-        vk::ShaderStageFlagBits::eVertex,
+        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
         nullptr
     };
 
-    static constexpr vk::DescriptorSetLayoutBinding texture_binding {
-        0,
-        vk::DescriptorType::eCombinedImageSampler,
+    // transforms of the objects that change often, indexed with DrawConstants::transform
+    static constexpr vk::DescriptorSetLayoutBinding transform_binding {
+        3,
+        vk::DescriptorType::eStorageBuffer,
         1,
-        vk::ShaderStageFlagBits::eFragment,
+        vk::ShaderStageFlagBits::eVertex,
         nullptr
     };
 
-    static constexpr vk::DescriptorSetLayoutBinding light_binding {
-        5,
+    static constexpr vk::DescriptorSetLayoutBinding ubo_bindings[] {
+        ubo_binding,
+        counter_binding,
+        material_binding,
+        transform_binding
+    };
+
+    static constexpr vk::DescriptorSetLayoutBinding object_binding {
+        1,
         vk::DescriptorType::eUniformBuffer,
         1,
-        vk::ShaderStageFlagBits::eFragment,
+        vk::ShaderStageFlagBits::eVertex,
         nullptr
     };
 
+    // lights, cluster grid, light indices, shadow atlas and shadow tiles
+    static constexpr vk::DescriptorSetLayoutBinding light_bindings[] {
+        {
+            5,
+            vk::DescriptorType::eStorageBuffer,
+            1,
+            vk::ShaderStageFlagBits::eFragment,
+            nullptr
+        },
+        {
+            6,
+            vk::DescriptorType::eStorageBuffer,
+            1,
+            vk::ShaderStageFlagBits::eFragment,
+            nullptr
+        },
+        {
+            7,
+            vk::DescriptorType::eStorageBuffer,
+            1,
+            vk::ShaderStageFlagBits::eFragment,
+            nullptr
+        },
+        {
+            8,
+            vk::DescriptorType::eCombinedImageSampler,
+            1,
+            vk::ShaderStageFlagBits::eFragment,
+            nullptr
+        },
+        {
+            9,
+            vk::DescriptorType::eStorageBuffer,
+            1,
+            vk::ShaderStageFlagBits::eFragment,
+            nullptr
+        }
+    };
+
     vk::DescriptorSetLayoutCreateInfo layout_info {
         {},
-        1,
-        &ubo_binding
+        static_cast<uint32_t>(std::size(ubo_bindings)),
+        ubo_bindings
     };
 
     if (
@@ -965,6 +1661,7 @@ void tdl::Vlkn::createDescriptorSetLayout() {
         "Vlkn::createDescriptorSetLayout(...)"
     );
 
+    layout_info.bindingCount = 1;
     layout_info.pBindings = &object_binding;
 
     if (
@@ -978,33 +1675,11 @@ void tdl::Vlkn::createDescriptorSetLayout() {
         "Vlkn::createDescriptorSetLayout(...)"
     );
 
-    layout_info.pBindings = &model_binding;
+    // one array for the textures of every object, sized by the limits of the GPU
+    textures_.init(device_, physical_device_);
 
-    if (
-        device_.createDescriptorSetLayout(
-            &layout_info,
-            nullptr,
-            &model_layout_
-        ) != vk::Result::eSuccess
-    ) throw std::runtime_error (
-        "ERR 059: failed to create descriptor layout for model_binding"
-        "Vlkn::createDescriptorSetLayout(...)"
-    );
-
-    layout_info.pBindings = &texture_binding;
-
-    if (
-        device_.createDescriptorSetLayout(
-            &layout_info,
-            nullptr,
-            &texture_layout_
-        ) != vk::Result::eSuccess
-    ) throw std::runtime_error (
-        "ERR 060: failed to create descriptor layout for texture_binding"
-        "Vlkn::createDescriptorSetLayout(...)"
-    );
-
-    layout_info.pBindings = &light_binding;
+    layout_info.bindingCount = static_cast<uint32_t>(std::size(light_bindings));
+    layout_info.pBindings = light_bindings;
 
     if (
         device_.createDescriptorSetLayout(
@@ -1030,7 +1705,7 @@ void tdl::Vlkn::createZBuffer() {
         1,
         vk::SampleCountFlagBits::e1,
         vk::ImageTiling::eOptimal,
-        vk::ImageUsageFlagBits::eDepthStencilAttachment,
+        vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled, // read by hiz.comp
         vk::SharingMode::eExclusive,
         0, nullptr,
         vk::ImageLayout::eUndefined
@@ -1092,11 +1767,37 @@ void tdl::Vlkn::createZBuffer() {
     }
 }
 
+void tdl::Vlkn::createHiZ() {
+    // cull.comp binds the pyramid even when it only culls against the frustum
+    if (!occlusion_ && !info_->meshlet_culling_) return;
+
+    hiz_.create(
+        device_,
+        physical_device_,
+        graphics_queue_,
+        command_pool_,
+        extent_,
+        z_buffer_view_,
+        readFile(TDL_SHADER_DIR "hiz.spv")
+    );
+}
 
 void tdl::Vlkn::createUniformBuffers() {
     static constexpr vk::DeviceSize buffer_size = sizeof(UniformBufferObject);
 
     uniform_buffers_.resize(max_f_frames_);
+    counter_buffers_.resize(max_f_frames_);
+    frame_view_proj_.assign(max_f_frames_, glm::mat4(0.0f)); // never a valid matrix, forces the first upload
+    cluster_extents_.assign(max_f_frames_, vk::Extent2D {0, 0});
+    light_frame_versions_.assign(max_f_frames_, {});
+    light_frame_slots_.assign(max_f_frames_, {});
+    transform_buffers_.assign(max_f_frames_, nullptr);
+    transform_capacity_.assign(max_f_frames_, 0);
+
+    // room for every object of the scene to change often, grown in regenUBOs() if more are added
+    uint32_t object_count = 1;
+    for (const auto& model : objects_) object_count += static_cast<uint32_t>(model->objects_.size());
+    for (const auto& light : lights_) object_count += static_cast<uint32_t>(light->light_model_->objects_.size());
 
     for (size_t i = 0; i < max_f_frames_; ++i) {
         uniform_buffers_[i] = new MemoryBuffer (
@@ -1108,65 +1809,33 @@ void tdl::Vlkn::createUniformBuffers() {
             command_pool_,
             physical_device_
         );
-    }
-}
 
-void tdl::Vlkn::createDescriptorPool() {
-    const vk::DescriptorPoolSize pool_sizes[] {
-        {
-            vk::DescriptorType::eUniformBuffer,
-            256
-        },
-        {
-            vk::DescriptorType::eCombinedImageSampler,
-            256
-        }
-    };
+        counter_buffers_[i] = new MemoryBuffer (
+            sizeof(uint32_t),
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            device_,
+            graphics_queue_,
+            command_pool_,
+            physical_device_
+        );
 
-    size_t descriptor_size = 2;
+        *static_cast<uint32_t*>(counter_buffers_[i]->map()) = 0;
 
-    for (const auto& model : objects_) {
-        descriptor_size += max_f_frames_ + model->objects_.size() * (1 + max_f_frames_);
-    }
-    for (const auto& light : lights_) {
-        descriptor_size += max_f_frames_ + light->light_model_->objects_.size() * (1 + max_f_frames_);
+        reserveTransforms(i, object_count);
     }
 
-    const vk::DescriptorPoolCreateInfo pool_info {
-        {vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet},
-        static_cast<uint32_t>(
-            max_f_frames_ + descriptor_size
-        ),
-        static_cast<uint32_t>(std::size(pool_sizes)),
-        pool_sizes
-    };
+    // shared by the frames in flight, materials are only ever appended
+    materials_.init(device_, physical_device_, graphics_queue_, command_pool_, deletions_);
+}
 
-    if (
-        device_.createDescriptorPool(
-            &pool_info,
-            nullptr,
-            &descriptor_pool_
-        ) != vk::Result::eSuccess
-        ) throw std::runtime_error("ERR 054: Failed to allocate descriptor pool. Vlkn::createDescriptorPool(...)");
+void tdl::Vlkn::createDescriptorAllocator() {
+    // object and light sets are taken from pools created as the scene grows, the textures are in the TextureTable
+    descriptors_.init(device_, max_f_frames_);
 }
 
 void tdl::Vlkn::createDescriptorSets() {
-    std::vector<vk::DescriptorSetLayout> layouts (max_f_frames_, ubo_layout_);
-
-    const vk::DescriptorSetAllocateInfo alloc_info {
-        descriptor_pool_,
-        static_cast<uint32_t>(max_f_frames_),
-        layouts.data()
-    };
-
-    descriptor_sets_.resize(max_f_frames_);
-
-    if (
-        device_.allocateDescriptorSets(
-            &alloc_info,
-            descriptor_sets_.data()
-        ) != vk::Result::eSuccess
-    ) throw std::runtime_error("ERR 055: Vlkn::createDescriptorSets(...)");
+    descriptor_sets_ = descriptors_.allocate(ubo_layout_, static_cast<uint32_t>(max_f_frames_));
 
     for (size_t i = 0; i < max_f_frames_; ++i) {
         vk::DescriptorBufferInfo buffer_info = {
@@ -1175,86 +1844,375 @@ void tdl::Vlkn::createDescriptorSets() {
             sizeof(UniformBufferObject)
         };
 
-        vk::WriteDescriptorSet descriptor_write = {
-            descriptor_sets_[i],
+        const vk::DescriptorBufferInfo counter_info = {
+            counter_buffers_[i]->getBuffer(),
             0,
+            sizeof(uint32_t)
+        };
+
+        const vk::DescriptorBufferInfo transform_info = {
+            transform_buffers_[i]->getBuffer(),
             0,
-            1,
-            vk::DescriptorType::eUniformBuffer,
-            nullptr,
-            &buffer_info,
-            nullptr
+            transform_capacity_[i] * sizeof(ObjectTransform)
+        };
+
+        const vk::WriteDescriptorSet descriptor_writes[] = {
+            {
+                descriptor_sets_[i],
+                0,
+                0,
+                1,
+                vk::DescriptorType::eUniformBuffer,
+                nullptr,
+                &buffer_info,
+                nullptr
+            },
+            {
+                descriptor_sets_[i],
+                4,
+                0,
+                1,
+                vk::DescriptorType::eStorageBuffer,
+                nullptr,
+                &counter_info,
+                nullptr
+            },
+            {
+                descriptor_sets_[i],
+                3,
+                0,
+                1,
+                vk::DescriptorType::eStorageBuffer,
+                nullptr,
+                &transform_info,
+                nullptr
+            }
         };
 
-        device_.updateDescriptorSets(1, &descriptor_write, 0, nullptr);
+        device_.updateDescriptorSets(static_cast<uint32_t>(std::size(descriptor_writes)), descriptor_writes, 0, nullptr);
     }
+
+    material_generations_.resize(max_f_frames_);
+    for (size_t i = 0; i < max_f_frames_; ++i) writeMaterialDescriptors(i);
 }
 
-void tdl::Vlkn::regenUBOs(const UniformBufferObject& ubo) const {
-    uniform_buffers_[current_frame_]->set(&ubo, sizeof(ubo));
+void tdl::Vlkn::writeMaterialDescriptors(
+    const size_t frame
+) {
+    const vk::DescriptorBufferInfo material_info = {
+        materials_.buffer(),
+        0,
+        materials_.bytes()
+    };
 
-    auto l = LightObject {
-        .num_lights =  static_cast<int>(lights_.size())
+    const vk::WriteDescriptorSet descriptor_write {
+        descriptor_sets_[frame],
+        2,
+        0,
+        1,
+        vk::DescriptorType::eStorageBuffer,
+        nullptr,
+        &material_info,
+        nullptr
     };
 
-    for (auto & light : l.lights) { light = {}; }
-    int idx = 0;
-    for (const auto& light : lights_) {
-        light->exportGPU();
-        l.lights[idx] = light->ubo_data_;
-        ++idx;
+    device_.updateDescriptorSets(1, &descriptor_write, 0, nullptr);
+
+    material_generations_[frame] = materials_.generation();
+}
+
+void tdl::Vlkn::reserveTransforms(
+    const size_t frame,
+    const uint32_t capacity
+) {
+    delete transform_buffers_[frame];
+
+    transform_buffers_[frame] = new MemoryBuffer (
+        capacity * sizeof(ObjectTransform),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        device_,
+        graphics_queue_,
+        command_pool_,
+        physical_device_
+    );
+
+    transform_buffers_[frame]->map();
+    transform_capacity_[frame] = capacity;
+
+    // the sets are written by createDescriptorSets() the first time
+    if (frame >= descriptor_sets_.size()) return;
+
+    const vk::DescriptorBufferInfo transform_info = {
+        transform_buffers_[frame]->getBuffer(),
+        0,
+        capacity * sizeof(ObjectTransform)
+    };
+
+    const vk::WriteDescriptorSet descriptor_write {
+        descriptor_sets_[frame],
+        3,
+        0,
+        1,
+        vk::DescriptorType::eStorageBuffer,
+        nullptr,
+        &transform_info,
+        nullptr
+    };
+
+    device_.updateDescriptorSets(1, &descriptor_write, 0, nullptr);
+}
+
+void tdl::Vlkn::regenUBOs(
+    const TransformSnapshot& snapshot,
+    const TransformSnapshot* const previous,
+    const float alpha
+) {
+    // only blend between two snapshots of the same scene
+    const bool blend = (
+        previous != nullptr &&
+        previous->sequence != 0 &&
+        previous->objects.size() == snapshot.objects.size() &&
+        alpha < 1.0f
+    );
+
+    UniformBufferObject ubo = snapshot.camera;
+    if (blend) {
+        ubo.camera = TransformSnapshot::blend(previous->camera.camera, snapshot.camera.camera, alpha);
+        ubo.rotation = TransformSnapshot::blend(previous->camera.rotation, snapshot.camera.rotation, alpha);
+    }
+
+    ubo.data.z = static_cast<float>(current_frame_); // picks the image of the video textures written for the frame
+    uniform_buffers_[current_frame_]->set(&ubo, sizeof(ubo));
+
+    // every object UBO holds projection * view * model, so they all have to be rewritten once the camera moves
+    frame_view_ = ubo.rotation * ubo.camera;
+    const glm::mat4 view_proj = ubo.proj * frame_view_;
+    const bool camera_moved = frame_view_proj_[current_frame_] != view_proj;
+    frame_view_proj_[current_frame_] = view_proj;
+
+    // objects that moved between the two ticks are drawn, culled and lit at their in-between transform
+    frame_models_.resize(snapshot.objects.size());
+    for (size_t i = 0; i < snapshot.objects.size(); ++i) {
+        const bool moving = blend && previous->object_versions[i] != snapshot.object_versions[i];
+        frame_models_[i] = moving ? TransformSnapshot::blend(previous->objects[i].model, snapshot.objects[i].model, alpha) :
+            snapshot.objects[i].model;
     }
 
-    light_ubos_[current_frame_]->set(&l, sizeof(LightObject));
+    // bounding spheres of the scene objects in view, the light models are unlit and never receive light
+    const Frustum frustum = Frustum::fromMatrix(view_proj);
+    receivers_.clear();
 
+    size_t receiver_idx = 0;
     for (const auto& model : objects_) {
-        model->imageTick();
+        for (const auto& object : model->objects_ | std::views::values) {
+            const glm::vec4 sphere = object->boundingSphere(frame_models_[receiver_idx++]);
+            if (frustum.intersects(sphere)) receivers_.push_back(sphere);
+        }
+    }
+
+    // only lights that can reach a visible object are packed into the light buffer, the BVH is refit to the lights that
+    // moved since the last frame
+    light_bvh_.update(snapshot.lights, snapshot.light_versions);
+    light_bvh_.query(frustum, receivers_, relevant_lights_);
+
+    const auto light_count = static_cast<uint32_t>(std::min<size_t>(relevant_lights_.size(), max_lights));
+    const LightBuffers& light_buffers = light_buffers_[current_frame_];
+
+    // the light buffer of every frame in flight keeps its contents, only slots that now hold a different light or a
+    // light that changed since this frame's buffer was last written are copied again
+    // lights store their shadow tile, a different assignment means every frame's light buffer has to be rewritten
+    if (shadows_.assign(snapshot.lights)) {
+        for (auto& versions : light_frame_versions_) versions.clear();
+    }
+
+    std::vector<uint64_t>& light_versions = light_frame_versions_[current_frame_];
+    std::vector<uint32_t>& light_slots = light_frame_slots_[current_frame_];
+
+    const bool light_count_changed = light_versions.size() != light_count;
+    light_versions.resize(light_count, 0);
+    light_slots.resize(light_count, UINT32_MAX);
+
+    packed_lights_.resize(light_count);
+
+    auto* const gpu_lights = static_cast<Light*>(light_buffers.lights->data());
+    uint64_t lights_uploaded = 0;
+
+    for (uint32_t slot = 0; slot < light_count; ++slot) {
+        const uint32_t i = relevant_lights_[slot];
+
+        packed_lights_[slot] = snapshot.lights[i];
+        packed_lights_[slot].direction.w = shadows_.tileOf(i);
+
+        if (light_slots[slot] == i && light_versions[slot] == snapshot.light_versions[i]) continue;
+
+        gpu_lights[slot] = packed_lights_[slot];
+        light_slots[slot] = i;
+        light_versions[slot] = snapshot.light_versions[i];
+        ++lights_uploaded;
+    }
+
+    // the clusters only depend on the camera, the screen size and the packed lights, a still scene keeps the ones
+    // already in the buffers. A resize that keeps the aspect ratio leaves view_proj as it was
+    const bool extent_changed = cluster_extents_[current_frame_] != extent_;
+    cluster_extents_[current_frame_] = extent_;
+
+    const bool rebuild_clusters = camera_moved || lights_uploaded > 0 || light_count_changed || extent_changed;
+
+    // assign lights to clusters while the object UBOs are written
+    const JobHandle cluster_job = jobs_->submit([&] {
+        if (!rebuild_clusters) return;
+
+        clusters_.build(
+            packed_lights_,
+            ubo.rotation * ubo.camera,
+            ubo.proj,
+            snapshot.near_plane,
+            snapshot.far_plane,
+            {static_cast<float>(extent_.width), static_cast<float>(extent_.height)},
+            *jobs_
+        );
+
+        auto* const grid = static_cast<std::byte*>(light_buffers.grid->data());
+        std::memcpy(grid, &clusters_.info(), sizeof(ClusterInfo));
+        std::memcpy(grid + sizeof(ClusterInfo), clusters_.grid().data(), sizeof(glm::uvec2) * LightClusters::count);
 
-        for (const auto& [_, obj] : model->objects_) {
-            if (obj->has_changed_) {
-                obj->ubos_[current_frame_]->set(&obj->ubo_data_, sizeof(obj->ubo_data_));
-                obj->has_changed_ = false;
+        const size_t index_count = std::min<size_t>(clusters_.indices().size(), LightClusters::max_indices);
+        std::memcpy(light_buffers.indices->data(), clusters_.indices().data(), sizeof(uint32_t) * index_count);
+    });
+
+    // snapshot entries are in the same order the models are stored in
+    std::vector<Model*> models;
+    models.reserve(objects_.size() + lights_.size());
+
+    for (const auto& model : objects_) models.push_back(model.ptr_.get());
+    for (const auto& light : lights_) models.push_back(light->light_model_.ptr_.get());
+
+    // first flattened object of every model, so models can be uploaded independently
+    std::vector<size_t> object_offsets (models.size());
+    size_t object_count = 0;
+
+    for (size_t i = 0; i < models.size(); ++i) {
+        object_offsets[i] = object_count;
+        object_count += models[i]->objects_.size();
+
+        // records the copies of the decoded video frames into the frame's uploads, not thread safe
+        models[i]->imageTick(uploads_, current_frame_);
+    }
+
+    // materials are only looked up in the table when they changed, a new entry is written into its buffer right away
+    size_t material_idx = 0;
+    for (const Model* model : models) {
+        for (const auto& obj : model->objects_ | std::views::values) {
+            const uint64_t version = snapshot.material_versions[material_idx];
+
+            if (obj->material_version_ != version) {
+                obj->material_ = materials_.add(snapshot.materials[material_idx]);
+                obj->material_version_ = version;
             }
-        }
 
-        if (model->has_changed_) {
-            model->ubos_[current_frame_]->set(&model->ubo_data_, sizeof(model->ubo_data_));
-            model->has_changed_ = false;
+            ++material_idx;
         }
     }
 
-    for (const auto& light : lights_) {
-        light->light_model_->imageTick();
+    // the table outgrew its buffer, growing waited for the GPU so every frame's set can be written
+    if (materials_.generation() != material_generations_[current_frame_]) writeMaterialDescriptors(current_frame_);
+
+    // objects that change often are packed at the start of the frame's transform buffer, there is room for all of them
+    if (object_count > transform_capacity_[current_frame_]) {
+        reserveTransforms(current_frame_, std::max(static_cast<uint32_t>(object_count), transform_capacity_[current_frame_] * 2));
+    }
+
+    auto* const transforms = static_cast<ObjectTransform*>(transform_buffers_[current_frame_]->data());
+
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> uploaded = 0;
+    std::atomic<uint32_t> dynamic = 0;
+
+    // every model only writes to its own buffers so they can be uploaded in parallel
+    jobs_->parallelFor(models.size(), 4, [&](const size_t begin, const size_t end) {
+        uint64_t count = 0;
+
+        for (size_t model_idx = begin; model_idx < end; ++model_idx) {
+            size_t object_idx = object_offsets[model_idx];
+
+            for (const auto& obj : models[model_idx]->objects_ | std::views::values) {
+                const uint64_t version = snapshot.object_versions[object_idx];
+                const ObjectObject& data = snapshot.objects[object_idx];
 
-        for (const auto& [_, obj] : light->light_model_->objects_) {
-            if (obj->has_changed_) {
-                obj->ubos_[current_frame_]->set(&obj->ubo_data_, sizeof(obj->ubo_data_));
-                obj->has_changed_ = false;
+                const bool moving = blend && previous->object_versions[object_idx] != version;
+
+                obj->change_history_ = static_cast<uint8_t>(obj->change_history_ << 1 | (moving || obj->seen_version_ != version ? 1 : 0));
+                obj->seen_version_ = version;
+
+                // the vertex shader applies the view and projection, so only the world matrix is copied
+                if (obj->changesOften()) {
+                    const uint32_t slot = dynamic.fetch_add(1, std::memory_order_relaxed);
+
+                    transforms[slot] = {frame_models_[object_idx], data.mesh};
+
+                    // the UBO is written again once the object settles
+                    obj->transform_slot_ = slot;
+                    obj->frame_versions_[current_frame_] = 0;
+
+                    ++object_idx;
+                    continue;
+                }
+
+                obj->transform_slot_ = DrawConstants::static_transform;
+
+                if (moving || camera_moved || obj->frame_versions_[current_frame_] != version) {
+                    // written straight into the persistently mapped UBO
+                    auto* const target = static_cast<ObjectObject*>(obj->ubos_[current_frame_]->data());
+
+                    // moved between the two ticks, the in-between transform is uploaded
+                    target->model = frame_models_[object_idx];
+                    simd::mul(view_proj, target->model, target->mvp);
+                    target->mesh = data.mesh;
+
+                    // exact transform has to be uploaded once it stops moving
+                    obj->frame_versions_[current_frame_] = moving ? 0 : version;
+                    ++count;
+                }
+
+                ++object_idx;
             }
         }
 
-        if (light->light_model_->has_changed_) {
-            light->light_model_->ubos_[current_frame_]->set(&light->light_model_->ubo_data_, sizeof(light->light_model_->ubo_data_));
-            light->light_model_->has_changed_ = false;
-        }
-    }
-}
+        uploaded.fetch_add(count, std::memory_order_relaxed);
+    });
 
-[[nodiscard]] vk::UniqueShaderModule tdl::Vlkn::createShaderModule(
-    const std::vector<char>& code
-) const {
-    try {
-        return device_.createShaderModuleUnique({
-            {},
-            code.size(),
-            reinterpret_cast<const uint32_t*>(code.data())
-        });
-    } catch (const vk::SystemError& err) {
-        throw std::runtime_error(
-            "ERR 056: Failed to create shader module. Vlkn::createShaderModule(...)\n"
-            + std::string(err.what())
-        );
+    // only the models of the scene cast shadows, the light models would hide their own light
+    std::vector<const ObjectInterface*> casters;
+    for (const auto& model : objects_) {
+        for (const auto& object : model->objects_ | std::views::values) casters.push_back(object.get());
     }
+
+    // shadow tiles are drawn with this frame's object UBOs and transforms, so only after they are written
+    shadow_pass_ = shadows_.update(snapshot, blend ? previous : nullptr, alpha, casters, current_frame_, descriptor_sets_[current_frame_]);
+    std::memcpy(light_buffers.shadows->data(), shadows_.tiles().data(), sizeof(ShadowTile) * ShadowAtlas::tile_count);
+
+    stats_.shadow_tiles_rendered = shadows_.tilesRendered();
+    stats_.shadow_casters_drawn = shadows_.castersDrawn();
+
+    stats_.objects_uploaded = uploaded.load();
+    stats_.upload_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    stats_.uploads_per_second = perSecond(stats_.objects_uploaded, stats_.upload_time);
+    stats_.dynamic_objects = dynamic.load();
+    stats_.transform_bytes = stats_.dynamic_objects * sizeof(ObjectTransform);
+
+    jobs_->wait(cluster_job); // buffers have to be complete before the frame is submitted
+
+    stats_.lights = snapshot.lights.size();
+    stats_.lights_packed = light_count;
+    stats_.light_bvh_nodes = light_bvh_.nodes();
+    stats_.lights_uploaded = lights_uploaded;
+    stats_.light_bytes_uploaded = lights_uploaded * sizeof(Light);
+    stats_.lights_clustered = clusters_.clusteredLights();
+    stats_.cluster_indices = clusters_.indices().size();
+    stats_.max_lights_per_cluster = clusters_.maxPerCluster();
+    stats_.cluster_overflow = clusters_.overflow();
+    stats_.cluster_time = rebuild_clusters ? clusters_.buildTime() : std::chrono::nanoseconds {0};
 }
 
 [[nodiscard]] vk::Extent2D tdl::Vlkn::chooseExtent(
@@ -1308,6 +2266,25 @@ void tdl::Vlkn::regenUBOs(const UniformBufferObject& ubo) const {
     return graphics.has_value() && present.has_value() && supported_extensions && swapChainAdequate;
 }
 
+std::optional<uint32_t> tdl::Vlkn::findTransferFamily(
+    const vk::PhysicalDevice& device
+) {
+    const std::vector<vk::QueueFamilyProperties> families = device.getQueueFamilyProperties();
+
+    // a family without graphics and compute is usually the copy engine of the GPU, it runs next to the graphics queue
+    for (uint32_t i = 0; i < families.size(); ++i) {
+        const vk::QueueFlags flags = families[i].queueFlags;
+
+        if (
+            families[i].queueCount > 0 &&
+            flags & vk::QueueFlagBits::eTransfer &&
+            !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))
+        ) return i;
+    }
+
+    return std::nullopt;
+}
+
 [[nodiscard]] tdl::GraphicsPresentInfo tdl::Vlkn::findQueueFamilies(
     const vk::PhysicalDevice& device
 ) const {
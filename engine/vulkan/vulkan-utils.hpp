@@ -23,8 +23,24 @@
 #include <string>
 
 #include "buffers.hpp"
+#include "deletion.hpp"
+#include "descriptors.hpp"
+#include "gbuffer.hpp"
+#include "graph.hpp"
+#include "materials.hpp"
+#include "meshlets.hpp"
+#include "occlusion.hpp"
+#include "pipelines.hpp"
+#include "shadows.hpp"
+#include "textures.hpp"
+#include "uploads.hpp"
 #include "../lighting.hpp"
+#include "../bvh.hpp"
+#include "../clusters.hpp"
+#include "../jobs.hpp"
 #include "../objects.hpp"
+#include "../simulation.hpp"
+#include "../stats.hpp"
 
 namespace tdl {
     inline std::vector DEVICE_EXTENSIONS {
@@ -43,15 +59,22 @@ namespace tdl {
     };
 
     /**
-     * @breif: Contains data needed for shader stages.
-     *
-     * Contains matracies for projection, camera, and rotation. Needed to render objects.
+     * @breif How the lights are applied to the objects
+    */
+    enum class RenderMode {
+        FORWARD, // every object is shaded with the lights of its clusters while it is drawn
+        DEFERRED // objects only write the G-buffer, every pixel is shaded once afterwards (see GBuffer)
+    };
+
+    /**
+     * @breif How finished frames are handed to the display, FIFO is used if the device does not support the mode
     */
-    struct UniformBufferObject {
-        glm::mat4 proj;
-        glm::mat4 camera;
-        glm::mat4 rotation;
-        glm::vec4 data = {1.0f, 0.0f, 0.0f, 0.0f};
+    enum class PresentMode {
+        AUTO, // mailbox, then immediate, then FIFO
+        MAILBOX, // no tearing, a newer frame replaces the one waiting, lowest latency without tearing
+        IMMEDIATE, // shown right away, may tear
+        FIFO, // every frame is shown once at vblank (vsync), highest throughput for captures that keep every frame
+        FIFO_RELAXED // FIFO, a late frame is shown right away and may tear
     };
 
     /**
@@ -67,14 +90,30 @@ namespace tdl {
 
             std::string title_ = "ThreeDL App"; // Default title
 
+            RenderMode render_mode_ = RenderMode::FORWARD;
+            bool depth_prepass_ = false; // lay down depth first so every pixel is only shaded once
+            bool count_fragments_ = false; // count fragment shader invocations, see FrameStats::fragments_shaded
+            float lod_threshold_ = 1.0f; // largest LOD error on screen in pixels, 0 always draws the full meshes
+            bool meshlet_culling_ = false; // cull the meshlets of large meshes on the GPU, see MeshletCuller
+            bool meshlet_cone_culling_ = false; // also cull meshlets facing away, only for closed meshes
+            bool occlusion_culling_ = false; // cull hidden objects and meshlets with a HiZ pyramid, forward only
+
+            // frames the CPU records ahead of the GPU, 1 has the lowest input latency and more keep the GPU busier
+            int frames_in_flight_ = 2;
+            PresentMode present_mode_ = PresentMode::AUTO;
+            // swapchain images, 0 for one more than the surface needs, clamped to what the surface supports
+            uint32_t swapchain_images_ = 0;
+
             GLFWwindow* window_ = nullptr;
     };
 
     class Vlkn {
         public:
-            explicit Vlkn (
-                RendererInfo* const renderer_info
+            Vlkn (
+                RendererInfo* const renderer_info,
+                JobSystem* const jobs
             ) : info_ { renderer_info },
+                jobs_ { jobs },
                 mem_vert_ { nullptr },
                 format_ { vk::Format::eUndefined }
             {}
@@ -91,29 +130,75 @@ namespace tdl {
                 lights_.push_back(light);
             }
 
+            /**
+             * @breif Uploads the given snapshot and draws a frame
+             *
+             * @param snapshot latest snapshot published by the simulation
+             * @param previous snapshot before it, nullptr if the frame should not be interpolated
+             * @param alpha how far between previous and snapshot this frame is (0 - 1)
+            */
             void newFrame (
-                const UniformBufferObject& ubo
+                const TransformSnapshot& snapshot,
+                const TransformSnapshot* previous,
+                float alpha
             );
 
+            /**
+             * @breif Counters of the last frame drawn by newFrame()
+            */
+            [[nodiscard]] const FrameStats& getStats() const { return stats_; }
+
             ~Vlkn() {
                 cleanup();
                 delete mem_vert_;
 
-                for (const auto& u : light_ubos_) delete u;
+                LightHelper::destroyBuffers(light_buffers_);
             }
 
             RendererInfo* const info_;
             bool resized_ = false;
 
         private:
+            JobSystem* const jobs_;
+
             MemoryBuffer* mem_vert_;
             std::vector<MemoryBuffer*> uniform_buffers_;
 
             std::vector<shared_model<Model>> objects_;
             std::vector<std::shared_ptr<LightInterface>> lights_;
 
-            std::vector<MemoryBuffer*> light_ubos_;
+            std::vector<LightBuffers> light_buffers_;
             std::vector<vk::DescriptorSet> light_descriptor_sets_;
+            LightClusters clusters_;
+
+            LightBVH light_bvh_;
+            std::vector<glm::mat4> frame_models_; // world matrices the frame draws, blended between the two ticks
+            std::vector<glm::vec4> receivers_; // bounding spheres of the visible objects of the frame
+            std::vector<uint32_t> relevant_lights_; // lights that can reach a receiver, in light buffer order
+            std::vector<Light> packed_lights_; // relevant_lights_ as they are stored in the light buffer
+
+            /**
+             * @breif One object drawn by the frame
+            */
+            struct Draw {
+                uint32_t key; // PipelineKey::id()
+                uint32_t material; // ObjectInterface::material_
+                float depth; // view space depth of the object's centre
+                ObjectInterface* object;
+                std::array<IndirectDraw, 2> culled; // ObjectInterface::culled_ of both occlusion phases
+            };
+
+            std::vector<Draw> draws_; // kept between frames to reuse the allocation
+            glm::mat4 frame_view_ {1.0f}; // view matrix of the frame being recorded
+
+            bool count_fragments_ = false; // enabled and supported by the device
+            std::vector<MemoryBuffer*> counter_buffers_; // fragment counter of each frame in flight
+            ShadowAtlas shadows_;
+            MeshletCuller culler_; // only initialised with RendererInfo::meshlet_culling_
+            bool occlusion_ = false; // RendererInfo::occlusion_culling_ in the forward render path
+            OcclusionCuller occluder_; // only initialised with occlusion_
+            HiZ hiz_; // created with the depth buffer when occlusion_ or the meshlet culling is on
+            bool shadow_pass_ = false; // shadow command buffer of the current frame has to be submitted
 
             vk::SurfaceKHR surface_;
             vk::SwapchainKHR swapchain_;
@@ -129,6 +214,10 @@ namespace tdl {
             vk::Queue graphics_queue_;
             vk::CommandPool command_pool_;
 
+            vk::Queue transfer_queue_; // the graphics queue if the device has no transfer only family
+            uint32_t transfer_family_ = 0;
+            UploadQueue uploads_; // copies of the video frames, submitted before every frame
+
             std::vector<vk::Image> images_;
             std::vector<vk::ImageView> image_views_;
             std::vector<vk::Framebuffer> framebuffers_;
@@ -136,6 +225,9 @@ namespace tdl {
             std::vector<vk::Semaphore> image_available_;
             std::vector<vk::Semaphore> render_finished_;
             std::vector<vk::Fence> fences_;
+            std::vector<uint64_t> fence_values_; // DeletionQueue::submit() of the frame each fence was last submitted with
+            DeletionQueue deletions_; // resources replaced while the frames in flight may still use them
+            RenderGraph graph_; // passes of the frame being recorded, rebuilt every frame
             std::vector<vk::DescriptorSet> descriptor_sets_;
 
             vk::Format format_;
@@ -146,19 +238,41 @@ namespace tdl {
             vk::ImageView z_buffer_view_;
 
             vk::RenderPass render_pass_;
-            vk::Pipeline graphics_pipeline_;
+            vk::RenderPass occlusion_pass_; // second phase of occlusion_, continues what render_pass_ drew
+            PipelineVariants pipelines_; // one pipeline per shader permutation
+            GBuffer gbuffer_; // only created for RenderMode::DEFERRED
+            std::array<vk::ImageView, GBuffer::count> gbuffer_views_ {}; // G-buffer images of graph_ the framebuffers use
+
+            vk::QueryPool timestamps_; // start and end of every frame in flight
+            float timestamp_period_ = 0.0f; // nanoseconds per tick, 0 if timestamps are not supported
+            std::vector<bool> timestamps_written_;
 
             vk::DescriptorSetLayout ubo_layout_;
             vk::DescriptorSetLayout object_layout_;
-            vk::DescriptorSetLayout model_layout_;
-            vk::DescriptorSetLayout texture_layout_;
+            TextureTable textures_; // every object texture, bound once per frame as set 1
+            MaterialTable materials_; // read through binding 2 of every frame's set 0
+            std::vector<uint64_t> material_generations_; // MaterialTable::generation() each frame's set 0 points at
+            // ObjectTransform of the objects that change often, one buffer per frame read through binding 3 of its set 0
+            std::vector<MemoryBuffer*> transform_buffers_;
+            std::vector<uint32_t> transform_capacity_; // entries of every frame's transform buffer
             vk::DescriptorSetLayout lights_layout_;
             vk::PipelineLayout pipeline_layout_;
 
-            vk::DescriptorPool descriptor_pool_;
+            DescriptorAllocator descriptors_; // every set of the objects, the lights and the frames
 
             size_t current_frame_ = 0;
-            int max_f_frames_ = 2;
+            int max_f_frames_ = 2; // RendererInfo::frames_in_flight_
+
+            // key press of the last snapshot whose input latency was measured, see FrameStats::input_latency
+            std::chrono::steady_clock::time_point measured_input_ {};
+            std::chrono::nanoseconds latency_total_ {0};
+
+            std::vector<glm::mat4> frame_view_proj_; // view projection matrix last used for each frame's object UBOs
+            std::vector<vk::Extent2D> cluster_extents_; // swapchain extent each frame's light clusters were built for
+            std::vector<std::vector<uint64_t>> light_frame_versions_; // light versions last written to each frame's light buffer
+            std::vector<std::vector<uint32_t>> light_frame_slots_; // light stored in every slot of each frame's light buffer
+
+            FrameStats stats_ {}; // only the render frame counters are filled in
 
             void submitForDraw (
                 const vk::CommandBuffer& buffer,
@@ -180,17 +294,55 @@ namespace tdl {
             void createCommandPool();
             void loadModels();
             void startCommandBuffers();
+
+            /**
+             * @breif Records the draws of the current frame into its command buffer
+             *
+             * Objects are sorted front to back by view depth, with the optional depth pre-pass first. The main pass is
+             * grouped by pipeline, keeping the front to back order inside every group.
+             *
+             * @param snapshot snapshot the frame is drawn from
+             * @param idx index of the swapchain image
+            */
+            void recordCommandBuffer (
+                const TransformSnapshot& snapshot,
+                uint32_t idx
+            );
             void createSyncObjects();
+            void createQueryPool();
             void createGraphicsPipeline();
             void createDescriptorSetLayout();
             void createZBuffer();
+            void createHiZ();
             void createUniformBuffers();
-            void createDescriptorPool();
+            void createDescriptorAllocator();
             void createDescriptorSets();
 
+            /**
+             * @breif Points a frame's set 0 at the current buffer of the MaterialTable
+             *
+             * The frame's fence has to be waited on, the other frames in flight keep reading the old buffer.
+            */
+            void writeMaterialDescriptors (
+                size_t frame
+            );
+
+
+            /**
+             * @breif Creates the transform buffer of a frame again with room for capacity objects
+             *
+             * Only called for the frame being recorded, its fence was waited on so the old buffer is no longer read.
+            */
+            void reserveTransforms (
+                size_t frame,
+                uint32_t capacity
+            );
+
             void regenUBOs (
-                const UniformBufferObject& ubo
-            ) const;
+                const TransformSnapshot& snapshot,
+                const TransformSnapshot* previous,
+                float alpha
+            );
 
             static std::vector<const char*> getRequiredExtensions();
 
@@ -207,13 +359,10 @@ namespace tdl {
             );
 
             static vk::PresentModeKHR chooseMode (
-                const std::vector<vk::PresentModeKHR>& available_modes
+                const std::vector<vk::PresentModeKHR>& available_modes,
+                PresentMode wanted
             );
 
-            [[nodiscard]] vk::UniqueShaderModule createShaderModule (
-                const std::vector<char>& code
-            ) const;
-
             [[nodiscard]] vk::Extent2D chooseExtent (
                 const vk::SurfaceCapabilitiesKHR& capabilities
             ) const;
@@ -229,5 +378,12 @@ namespace tdl {
             [[nodiscard]] GraphicsPresentInfo findQueueFamilies (
                 const vk::PhysicalDevice& device
             ) const;
+
+            /**
+             * @breif Queue family that supports transfers but no graphics or compute, if the device has one
+            */
+            [[nodiscard]] static std::optional<uint32_t> findTransferFamily (
+                const vk::PhysicalDevice& device
+            );
     };
 };
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 proj;
+    mat4 camera;
+    mat4 rotation;
+    vec4 data;
+} ubo;
+
+// G-buffer written by gbuffer.frag in the previous subpass, only the pixel being shaded can be read
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput gAlbedo;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput gNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput gMaterial;
+layout(input_attachment_index = 3, set = 1, binding = 3) uniform subpassInput gPosition;
+
+layout(location = 0) out vec4 outColor;
+
+#include "lighting.glsl"
+
+void main() {
+    vec4 position = subpassLoad(gPosition);
+    if (position.w == 0.0) { // background, same as the clear colour of the forward path
+        outColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    vec4 albedo = subpassLoad(gAlbedo);
+    vec4 normal = subpassLoad(gNormal);
+    vec4 material = subpassLoad(gMaterial);
+
+    int model = int(round(material.a * 4.0)) - 1;
+    if (model < 0) { // unlit
+        outColor = albedo;
+        return;
+    }
+
+    Surface surface = Surface(position.xyz, normal.xyz, material.rgb, normal.w, position.w, ubo.rotation * ubo.camera);
+    vec3 color = shadeClustered(surface, albedo.rgb, model, gl_FragCoord.xy);
+
+    outColor = vec4(pow(color, vec3(1.0 / 2.2)), albedo.a);
+}
@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// depth pre-pass, has to compute gl_Position exactly like shader.vert
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 proj;
+    mat4 camera;
+    mat4 rotation;
+    vec4 data;
+} ubo;
+
+#include "object.glsl"
+#include "material.glsl"
+
+layout(constant_id = 4) const bool COMPRESSED = false;
+
+layout(location = 0) in vec3 inPosition;
+
+invariant gl_Position;
+
+void main() {
+    MeshDecode mesh = objectMesh(draw.transform);
+    vec3 position = COMPRESSED ? mesh.position_min.xyz + inPosition * mesh.position_extent.xyz : inPosition;
+
+    gl_Position = draw.transform == STATIC_TRANSFORM
+        ? obo.mvp * vec4(position, 1.0)
+        : ubo.proj * (ubo.rotation * ubo.camera * (objectModel(draw.transform) * vec4(position, 1.0)));
+    float dist = sqrt(((ubo.data.x) * gl_Position.x * gl_Position.x) + ((ubo.data.x) * gl_Position.y * gl_Position.y) + (gl_Position.z));
+    if (ubo.data.y > 0) gl_Position.xy /= dist;
+}
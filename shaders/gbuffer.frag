@@ -0,0 +1,44 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// same inputs as shader.frag, the lights are applied later by deferred.frag
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 positionIn;
+layout(location = 3) in vec3 normalIn;
+layout(location = 4) in vec3 inAmbient;
+layout(location = 5) in vec3 inSpecular;
+layout(location = 6) in vec3 inSpecularExp;
+
+layout(location = 7) in mat4 inTranslation;
+layout(location = 11) flat in vec4 inOther;
+layout(location = 12) in float inViewDepth;
+
+// G-buffer, the formats are listed in GBuffer::formats
+layout(location = 0) out vec4 outAlbedo; // diffuse colour and alpha
+layout(location = 1) out vec4 outNormal; // world space normal, specular exponent
+layout(location = 2) out vec4 outMaterial; // specular colour, lighting model + 1 / 4 (0 if unlit)
+layout(location = 3) out vec4 outPosition; // world space position, view depth (0 where nothing was drawn)
+
+layout(early_fragment_tests) in;
+
+layout(constant_id = 0) const bool LIT = true;
+layout(constant_id = 1) const int LIGHTING_MODEL = 3;
+layout(constant_id = 2) const bool VIDEO = false;
+layout(constant_id = 3) const bool COUNT_FRAGMENTS = false;
+
+layout(std430, set = 0, binding = 4) buffer DebugCounters {
+    uint fragments;
+} counters;
+
+#include "texture.glsl"
+
+void main() {
+    if (COUNT_FRAGMENTS) atomicAdd(counters.fragments, 1u);
+
+    uint slot = textureSlot(VIDEO);
+    outAlbedo = VIDEO ? sampleI420(slot, fragTexCoord) : texture(textures[slot], fragTexCoord);
+    outNormal = vec4(normalize(normalIn), inSpecularExp.x);
+    outMaterial = vec4(inSpecular, LIT ? float(LIGHTING_MODEL + 1) / 4.0 : 0.0);
+    outPosition = vec4(positionIn, max(inViewDepth, 1e-6));
+}
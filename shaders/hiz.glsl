@@ -0,0 +1,72 @@
+// bounding sphere tests shared by the culling shaders (cull.comp and occlusion.comp), both declare a
+// sampler2D pyramid holding the Hi-Z pyramid built by hiz.comp before including this file
+
+// every bit set in the flags push constant of the culling shaders
+const uint CULL_FRUSTUM = 1u; // off when the lens distortion is on, it moves vertices after the projection
+const uint CULL_CONES = 2u;
+const uint CULL_OCCLUSION = 4u;
+
+// planes of the clip space volume in the space to_clip transforms from, depth goes from 0 to 1
+bool sphereInFrustum(mat4 to_clip, vec3 centre, float radius) {
+    vec4 row0 = vec4(to_clip[0][0], to_clip[1][0], to_clip[2][0], to_clip[3][0]);
+    vec4 row1 = vec4(to_clip[0][1], to_clip[1][1], to_clip[2][1], to_clip[3][1]);
+    vec4 row2 = vec4(to_clip[0][2], to_clip[1][2], to_clip[2][2], to_clip[3][2]);
+    vec4 row3 = vec4(to_clip[0][3], to_clip[1][3], to_clip[2][3], to_clip[3][3]);
+
+    vec4 planes[6] = vec4[6](row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2);
+
+    for (int i = 0; i < 6; ++i) {
+        if (dot(planes[i].xyz, centre) + planes[i].w < -radius * length(planes[i].xyz)) return false;
+    }
+
+    return true;
+}
+
+// true if the sphere is behind the depth the pyramid stores over its whole screen rectangle
+// pyramid_size: size of level 0 (xy) and number of levels (z)
+bool sphereOccluded(mat4 to_clip, vec3 centre, float radius, vec4 pyramid_size) {
+    vec2 lo = vec2(1.0);
+    vec2 hi = vec2(-1.0);
+    float nearest = 1.0;
+
+    // the corners of the bounding box, a sphere crossing the camera plane has no useful rectangle
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = centre + radius * vec3(
+            (i & 1) != 0 ? 1.0 : -1.0,
+            (i & 2) != 0 ? 1.0 : -1.0,
+            (i & 4) != 0 ? 1.0 : -1.0
+        );
+
+        vec4 clip = to_clip * vec4(corner, 1.0);
+        if (clip.w <= 0.0) return false;
+
+        vec3 ndc = clip.xyz / clip.w;
+        lo = min(lo, ndc.xy);
+        hi = max(hi, ndc.xy);
+        nearest = min(nearest, ndc.z);
+    }
+
+    if (nearest <= 0.0) return false;
+
+    ivec2 size = ivec2(pyramid_size.xy);
+    int levels = int(pyramid_size.z);
+
+    ivec2 a = clamp(ivec2(clamp(lo * 0.5 + 0.5, 0.0, 1.0) * vec2(size)), ivec2(0), size - 1);
+    ivec2 b = clamp(ivec2(clamp(hi * 0.5 + 0.5, 0.0, 1.0) * vec2(size)), ivec2(0), size - 1);
+
+    // the level where the rectangle spans at most 2x2 texels, 4 reads cover it
+    int level = 0;
+    while (level < levels - 1 && any(greaterThan((b >> level) - (a >> level), ivec2(1)))) ++level;
+
+    // the last texel of a level also covers the odd row or column of the level below it
+    ivec2 last = max(size >> level, ivec2(1)) - 1;
+    ivec2 ta = min(a >> level, last);
+    ivec2 tb = min(b >> level, last);
+
+    float furthest = max(
+        max(texelFetch(pyramid, ta, level).r, texelFetch(pyramid, ivec2(tb.x, ta.y), level).r),
+        max(texelFetch(pyramid, ivec2(ta.x, tb.y), level).r, texelFetch(pyramid, tb, level).r)
+    );
+
+    return nearest > furthest;
+}
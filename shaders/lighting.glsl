@@ -0,0 +1,221 @@
+// light data and shading shared by the forward (shader.frag) and deferred (deferred.frag) paths
+
+struct Light {
+    vec4 position;
+    vec4 direction;
+    vec4 color;
+    vec4 data;
+};
+
+// position.w is the influence radius of the light, 0 if it reaches every fragment
+layout(std430, set = 3, binding = 5) readonly buffer LightBuffer {
+    Light lights[];
+} light_buffer;
+
+// the view frustum is split into grid.x * grid.y screen tiles and grid.z exponential depth slices
+layout(std430, set = 3, binding = 6) readonly buffer ClusterGrid {
+    uvec4 grid; // tiles x, tiles y, depth slices, number of global lights
+    vec4 depth; // near, far, slices / log(far / near)
+    vec4 screen; // framebuffer size
+    uvec2 clusters[]; // offset into indices and light count of every cluster
+} cluster_grid;
+
+// global lights first, then the lights of every cluster
+layout(std430, set = 3, binding = 7) readonly buffer LightIndices {
+    uint indices[];
+} light_indices;
+
+struct ShadowTile {
+    mat4 view_proj; // world space to the light's clip space
+    vec4 rect; // uv offset and size of the tile inside the atlas
+};
+
+// depth of every shadow casting light, point lights use six consecutive tiles (+x, -x, +y, -y, +z, -z)
+layout(set = 3, binding = 8) uniform sampler2DShadow shadow_atlas;
+
+layout(std430, set = 3, binding = 9) readonly buffer ShadowTiles {
+    ShadowTile tiles[];
+} shadow_tiles;
+
+// everything the lights need to know about the shaded point
+struct Surface {
+    vec3 position; // world space
+    vec3 normal;
+    vec3 specular;
+    float specular_exp;
+    float view_depth; // distance along the view direction, picks the light cluster
+    mat4 view;
+};
+
+uint clusterIndex(vec2 frag_coord, float view_depth) {
+    uvec2 tile = min(
+        uvec2(frag_coord / cluster_grid.screen.xy * vec2(cluster_grid.grid.xy)),
+        cluster_grid.grid.xy - 1u
+    );
+
+    float slice = log(max(view_depth, cluster_grid.depth.x) / cluster_grid.depth.x) * cluster_grid.depth.z;
+    uint z = min(uint(max(slice, 0.0)), cluster_grid.grid.z - 1u);
+
+    return tile.x + tile.y * cluster_grid.grid.x + z * cluster_grid.grid.x * cluster_grid.grid.y;
+}
+
+vec3 calculateAmbient(vec4 color, float intensity) {
+    vec4 col = color * intensity;
+    return col.xyz;
+}
+
+vec3 calculatePointLight(
+        Surface surface,
+        vec3 position,
+        vec3 light_color,
+        vec3 diffuse_color,
+        float intensity,
+        float radius,
+        float type
+) {
+    position.y = -position.y;
+    vec4 pos = surface.view * vec4(position, 0.0);
+    vec4 dir = surface.view * vec4(surface.position, 0.0);
+
+    vec3 light_direction = (pos.xyz - dir.xyz);
+    float distance_to_light = pow(length(light_direction), 2.0);
+
+    // fade out towards the influence radius so lights do not pop when they leave a cluster
+    float fade = 1.0;
+    if (radius > 0.0) {
+        float ratio = distance_to_light / (radius * radius);
+        fade = pow(clamp(1.0 - ratio * ratio, 0.0, 1.0), 2.0);
+    }
+    intensity *= fade;
+
+    light_direction = normalize(light_direction);
+    vec3 normal = normalize(surface.normal);
+
+    float lambert_value = max(dot(light_direction, normal), 0);
+    float specular_value = 0.0;
+
+    if (type == 0.0) { // lambert shading
+        return diffuse_color * lambert_value * fade;
+    }
+
+    if (lambert_value == 0.0) {
+        return vec3(0.0);
+    }
+
+    vec3 look_direction = normalize(-dir.xyz);
+
+    if (type == 1.0) { // blinn-phong shading
+        vec3 halfway = normalize(light_direction + look_direction);
+        float angle = max(dot(halfway, normal), 0.0);
+        specular_value = pow(angle, surface.specular_exp);
+
+        return diffuse_color * lambert_value * light_color * intensity / distance_to_light +
+               surface.specular * specular_value * light_color * intensity / distance_to_light;
+    }
+
+    if (type == 2.0) { // phong shading
+        vec3 reflection = reflect(-light_direction, normal);
+        float angle = max(dot(reflection, look_direction), 0.0);
+        specular_value = pow(angle, surface.specular_exp / 4.0);
+
+        return diffuse_color * lambert_value * light_color * intensity / distance_to_light +
+               surface.specular * specular_value * light_color * intensity / distance_to_light;
+    }
+
+    return vec3(1, 0, 0);
+}
+
+// light positions and directions are mirrored on the y axis, same as in calculatePointLight
+vec3 lightPosition(vec4 position) {
+    return vec3(position.x, -position.y, position.z);
+}
+
+bool point_in_light(
+        vec3 point,
+        vec4 dir,
+        vec4 pos,
+        float fov
+) {
+    vec3 to_fragment = normalize(point - lightPosition(pos));
+    vec3 axis = normalize(vec3(dir.x, -dir.y, dir.z));
+
+    float angle = degrees(acos(clamp(dot(axis, to_fragment), -1.0, 1.0)));
+    return angle <= fov * 0.5;
+}
+
+// 1 if the point is lit by the light of the tile, 0 if it is in shadow
+float sampleShadow(uint index, vec3 point) {
+    ShadowTile tile = shadow_tiles.tiles[index];
+
+    vec4 clip = tile.view_proj * vec4(point, 1.0);
+    if (clip.w <= 0.0) return 1.0;
+
+    vec3 ndc = clip.xyz / clip.w;
+    if (any(greaterThan(abs(ndc.xy), vec2(1.0))) || ndc.z > 1.0) return 1.0; // outside of the shadow map
+
+    // stay half a texel inside the tile so filtering never reads a neighbouring tile
+    vec2 texel = 0.5 / vec2(textureSize(shadow_atlas, 0));
+    vec2 uv = clamp(tile.rect.xy + (ndc.xy * 0.5 + 0.5) * tile.rect.zw, tile.rect.xy + texel, tile.rect.xy + tile.rect.zw - texel);
+
+    return texture(shadow_atlas, vec3(uv, ndc.z));
+}
+
+float shadowFactor(Light light, vec3 point) {
+    if (light.direction.w <= 0.0) return 1.0; // casts no shadow
+
+    uint first = uint(light.direction.w) - 1u;
+    if (light.data.w != 1) return sampleShadow(first, point);
+
+    // point light, pick the cube face the point is on
+    vec3 d = point - lightPosition(light.position);
+    vec3 a = abs(d);
+
+    uint face;
+    if (a.x >= a.y && a.x >= a.z) face = d.x > 0.0 ? 0u : 1u;
+    else if (a.y >= a.z) face = d.y > 0.0 ? 2u : 3u;
+    else face = d.z > 0.0 ? 4u : 5u;
+
+    return sampleShadow(first + face, point);
+}
+
+// model 3 uses the lighting model of every light, 0 - 2 force lambert, blinn-phong or phong
+vec3 shadeLight(Light light, Surface surface, vec3 diffuse_color, int model) {
+    if (light.data.w == 0) { // ambient light
+        return diffuse_color * calculateAmbient(light.color, light.data.y);
+    }
+
+    if (light.data.w == 2 && !point_in_light(surface.position, light.direction, light.position, light.data.x)) {
+        return vec3(0.0);
+    }
+
+    float shadow = shadowFactor(light, surface.position);
+    if (shadow == 0.0) return vec3(0.0);
+
+    return shadow * calculatePointLight(
+        surface,
+        light.position.xyz,
+        light.color.xyz,
+        diffuse_color,
+        light.data.y,
+        light.position.w,
+        (model == 3) ? light.data.z : float(model)
+    );
+}
+
+// sum of the global lights and the lights of the cluster the fragment is in, linear colour
+vec3 shadeClustered(Surface surface, vec3 diffuse_color, int model, vec2 frag_coord) {
+    vec3 color = vec3(0.0);
+
+    // ambient and directional lights reach every fragment
+    for (uint i = 0; i < cluster_grid.grid.w; ++i) {
+        color += shadeLight(light_buffer.lights[light_indices.indices[i]], surface, diffuse_color, model);
+    }
+
+    // only the point lights that can reach this cluster
+    uvec2 cluster = cluster_grid.clusters[clusterIndex(frag_coord, surface.view_depth)];
+    for (uint i = 0; i < cluster.y; ++i) {
+        color += shadeLight(light_buffer.lights[light_indices.indices[cluster.x + i]], surface, diffuse_color, model);
+    }
+
+    return color;
+}
@@ -0,0 +1,21 @@
+// material table and per draw constants, shared by shader.vert, depth.vert and the fragment shaders (through texture.glsl)
+
+// MaterialObject, every distinct material of the scene is stored once
+struct Material {
+    vec4 ambient_color;
+    vec4 specular_color;
+    vec4 specular_exponent; // exponent (x), 1 if unlit (y)
+    vec4 other_data; // 1 for video textures (x)
+    uint texture_slot; // in the texture array of texture.glsl
+    uint padding[3];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Materials {
+    Material materials[];
+};
+
+// DrawConstants, the same for every vertex and fragment of a draw
+layout(push_constant) uniform Draw {
+    uint material;
+    uint transform; // in the Transforms buffer of object.glsl, STATIC_TRANSFORM for the object UBO
+} draw;
@@ -0,0 +1,36 @@
+// object matrices, shared by the vertex shaders (shader.vert, depth.vert and shadow.vert)
+
+// position = min + quantized * extent, only used by compressed meshes
+struct MeshDecode {
+    vec4 position_min;
+    vec4 position_extent;
+};
+
+// ObjectObject, only written while the object stays still. mvp is computed once per object on the CPU
+layout(set = 2, binding = 1) uniform ObjectObject {
+    mat4 mvp;
+    mat4 model;
+
+    MeshDecode mesh;
+} obo;
+
+// ObjectTransform, objects that change nearly every frame write here instead of to their UBO
+struct Transform {
+    mat4 model;
+    MeshDecode mesh;
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer Transforms {
+    Transform transforms[];
+};
+
+// DrawConstants::static_transform, the draw reads the object UBO
+const uint STATIC_TRANSFORM = 0xFFFFFFFFu;
+
+mat4 objectModel(uint transform) {
+    return transform == STATIC_TRANSFORM ? obo.model : transforms[transform].model;
+}
+
+MeshDecode objectMesh(uint transform) {
+    return transform == STATIC_TRANSFORM ? obo.mesh : transforms[transform].mesh;
+}
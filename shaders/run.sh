@@ -1,2 +0,0 @@
-glslc shaders/shader.vert -o shaders/vert.spv
-glslc shaders/shader.frag -o shaders/frag.spv
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -9,141 +10,41 @@ layout(location = 5) in vec3 inSpecular;
 layout(location = 6) in vec3 inSpecularExp;
 
 layout(location = 7) in mat4 inTranslation;
+layout(location = 11) flat in vec4 inOther;
+layout(location = 12) in float inViewDepth;
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler;
+// the counter below would otherwise force the depth test to run after the shader
+layout(early_fragment_tests) in;
 
-struct Light {
-    vec4 position;
-    vec4 direction;
-    vec4 color;
-    vec4 data;
-};
+// set per pipeline (see PipelineKey), branches on them are removed when the pipeline is compiled
+layout(constant_id = 0) const bool LIT = true;
+layout(constant_id = 1) const int LIGHTING_MODEL = 3; // 0 lambert, 1 blinn-phong, 2 phong, 3 model of each light
+layout(constant_id = 2) const bool VIDEO = false;
+layout(constant_id = 3) const bool COUNT_FRAGMENTS = false; // set for every pipeline by RendererInfo::count_fragments_
 
-layout(set = 4, binding = 5) uniform LightingUBO {
-    Light lights[16];
-    int num_lights;
-} ubo;
+// debug counters, read back by the renderer to measure overdraw
+layout(std430, set = 0, binding = 4) buffer DebugCounters {
+    uint fragments;
+} counters;
 
-vec3 calculateAmbient(vec4 color, float intensity) {
-    vec4 col = color * intensity;
-    return col.xyz;
-}
-
-vec3 calculatePointLight(
-        vec3 normal,
-        vec3 position,
-        vec3 light_color,
-        vec3 diffuse_color,
-        float intensity,
-        float type
-) {
-    position.y = -position.y;
-    vec4 pos = inTranslation * vec4(position, 0.0);
-    vec4 dir = inTranslation * vec4(positionIn, 0.0);
-
-    vec3 light_direction = (pos.xyz - dir.xyz);
-    float distance_to_light = pow(length(light_direction), 2.0);
-    light_direction = normalize(light_direction);
-    normal = normalize(normal);
-
-    float lambert_value = max(dot(light_direction, normal), 0);
-    float specular_value = 0.0;
-
-    if (type == 0.0) { // lambert shading
-        return inAmbient * 0.0 + diffuse_color * lambert_value;
-    }
-
-    if (lambert_value == 0.0) {
-        return inAmbient * 0.0 + diffuse_color * lambert_value * light_color * intensity / distance_to_light +
-                             inSpecular * specular_value * light_color * intensity / distance_to_light;
-    }
-
-    vec3 look_direction = normalize(-dir.xyz);
-
-    if (type == 1.0) { // blinn-phong shading
-        vec3 halfway = normalize(light_direction + look_direction);
-        float angle = max(dot(halfway, normal), 0.0);
-        specular_value = pow(angle, inSpecularExp.x);
-
-        return inAmbient * 0.0 + diffuse_color * lambert_value * light_color * intensity / distance_to_light +
-                              inSpecular * specular_value * light_color * intensity / distance_to_light;
-    }
-
-    if (type == 2.0) { // phong shading
-        vec3 reflection = reflect(-light_direction, normal);
-        float angle = max(dot(reflection, look_direction), 0.0);
-        specular_value = pow(angle, inSpecularExp.x/4.0);
-
-        return inAmbient * 0.0 + diffuse_color * lambert_value * light_color * intensity / distance_to_light +
-                             inSpecular * specular_value * light_color * intensity / distance_to_light;
-    }
-
-    return vec3(1, 0, 0);
-}
-
-bool point_in_light(
-        vec4 dir,
-        vec4 pos,
-        float fov
-) {
-    pos = pos - (inTranslation * vec4(positionIn, 0));
-    float d = dot(normalize(dir), normalize(-pos));
-    d = acos(d);
-    d = degrees(d);
-    return true;
-}
+#include "texture.glsl"
+#include "lighting.glsl"
 
 void main() {
-    vec4 diffuse_color = texture(texSampler, fragTexCoord);
-    outColor = vec4(0, 0, 0, 0);
-    outColor = diffuse_color;
-    return;
+    if (COUNT_FRAGMENTS) atomicAdd(counters.fragments, 1u);
+
+    uint slot = textureSlot(VIDEO);
+    vec4 diffuse_color = VIDEO ? sampleI420(slot, fragTexCoord) : texture(textures[slot], fragTexCoord);
 
-    if (inSpecularExp.y > 0) { // no light
+    if (!LIT) {
         outColor = diffuse_color;
         return;
     }
 
-    for (int i = 0; i < ubo.num_lights; ++i) {
-        if (ubo.lights[i].data.w == 0) { // ambient light
-             outColor += vec4(calculateAmbient(ubo.lights[i].color, ubo.lights[i].data.y), 0);
-             outColor /= 2;
-        } else if (ubo.lights[i].data.w == 1) { // point light
-            outColor += vec4(calculatePointLight(
-                normalIn,
-                (ubo.lights[i].position).xyz,
-                ubo.lights[i].color.xyz,
-                diffuse_color.xyz,
-                ubo.lights[i].data.y,
-                ubo.lights[i].data.z
-            ), 0);
-            outColor /= 2;
-        } else if (ubo.lights[i].data.w == 2) {
-            return;
-            bool inside_cone = point_in_light(
-                ubo.lights[i].direction,
-                ubo.lights[i].position,
-                ubo.lights[i].data.x
-            );
-
-            if (inside_cone) {
+    Surface surface = Surface(positionIn, normalIn, inSpecular, inSpecularExp.x, inViewDepth, inTranslation);
+    vec3 color = shadeClustered(surface, diffuse_color.xyz, LIGHTING_MODEL, gl_FragCoord.xy);
 
-                outColor += vec4(calculatePointLight(
-                     normalIn,
-                     (ubo.lights[i].position).xyz,
-                     ubo.lights[i].color.xyz,
-                     diffuse_color.xyz,
-                     ubo.lights[i].data.y,
-                     ubo.lights[i].data.z
-                 ), 0);
-                outColor /= 2;
-            }
-        } else {
-            outColor = vec4(normalIn, 0);
-        }
-    }
-
-    outColor = vec4(pow(outColor.xyz, vec3(1.0 / 2.2)), 0);
-}
\ No newline at end of file
+    outColor = vec4(pow(color, vec3(1.0 / 2.2)), diffuse_color.a);
+}
@@ -1,5 +1,6 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
 
 layout(binding = 0) uniform UniformBufferObject {
     mat4 proj;
@@ -8,24 +9,11 @@ layout(binding = 0) uniform UniformBufferObject {
     vec4 data;
 } ubo;
 
-struct Material {
-    vec4 ambient_color;
-    vec4 specular_color;
-    vec4 specular_exponent;
-    vec4 other_data;
-};
+#include "object.glsl"
+#include "material.glsl"
 
-layout(set = 2, binding = 1) uniform ObjectObject {
-    mat4 translation;
-    mat4 rotation;
-
-    Material mat;
-} obo;
-
-layout(set = 3, binding = 2) uniform ModelObject {
-    mat4 translation;
-    mat4 rotation;
-} mbo;
+// CompressedVertex instead of Vertex: 16 bit positions, octahedral normal (xy), half float uv
+layout(constant_id = 4) const bool COMPRESSED = false;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -40,20 +28,44 @@ layout(location = 5) out vec3 outSpecular;
 layout(location = 6) out vec3 outSpecularExp;
 
 layout(location = 7) out mat4 outTranslation;
+layout(location = 11) flat out vec4 outOther;
+layout(location = 12) out float outViewDepth;
+
+// the depth pre-pass (depth.vert) has to produce bit identical positions for the equal depth test
+invariant gl_Position;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
 
 void main() {
-    vec4 final_pos = mbo.translation * mbo.rotation * obo.translation * obo.rotation * vec4(inPosition, 1.0);
-    gl_Position =  ubo.proj * ubo.rotation * ubo.camera * final_pos;
+    // depth.vert decodes and transforms the position the same way
+    MeshDecode mesh = objectMesh(draw.transform);
+    mat4 model = objectModel(draw.transform);
+
+    vec3 position = COMPRESSED ? mesh.position_min.xyz + inPosition * mesh.position_extent.xyz : inPosition;
+    vec3 normal = COMPRESSED ? octDecode(inNormal.xy) : inNormal;
+
+    // objects in the transform buffer have no mvp, the view and projection are applied here
+    gl_Position = draw.transform == STATIC_TRANSFORM
+        ? obo.mvp * vec4(position, 1.0)
+        : ubo.proj * (ubo.rotation * ubo.camera * (model * vec4(position, 1.0)));
     float dist = sqrt(((ubo.data.x) * gl_Position.x * gl_Position.x) + ((ubo.data.x) * gl_Position.y * gl_Position.y) + (gl_Position.z));
     if (ubo.data.y > 0) gl_Position.xy /= dist;
 
     fragTexCoord = inTexCoord;
-    outPosition = final_pos.xyz;
-    outNormal = (mbo.rotation * vec4(inNormal, 0.0)).xyz;
+    outPosition = (model * vec4(position, 1.0)).xyz;
+    outNormal = mat3(model) * normal;
 
     outTranslation = ubo.rotation * ubo.camera;
+    outViewDepth = -(outTranslation * vec4(outPosition, 1.0)).z; // distance along the view direction, picks the light cluster
 
-    outAmbient = obo.mat.ambient_color.xyz;
-    outSpecular = obo.mat.specular_color.xyz;
-    outSpecularExp = obo.mat.specular_exponent.xyz;
+    Material material = materials[draw.material];
+    outAmbient = material.ambient_color.xyz;
+    outSpecular = material.specular_color.xyz;
+    outSpecularExp = material.specular_exponent.xyz;
+    outOther = material.other_data;
 }
\ No newline at end of file
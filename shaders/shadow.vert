@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// depth only pass of one shadow atlas tile, same object UBO and transform buffer as shader.vert
+#include "object.glsl"
+
+// quantized positions of a compressed mesh, set per pipeline by ShadowAtlas
+layout(constant_id = 4) const bool COMPRESSED = false;
+
+layout(push_constant) uniform ShadowTile {
+    mat4 view_proj; // world space to the light's clip space
+    uint transform; // DrawConstants::transform of the caster
+} tile;
+
+layout(location = 0) in vec3 inPosition;
+
+void main() {
+    MeshDecode mesh = objectMesh(tile.transform);
+    vec3 position = COMPRESSED ? mesh.position_min.xyz + inPosition * mesh.position_extent.xyz : inPosition;
+
+    gl_Position = tile.view_proj * objectModel(tile.transform) * vec4(position, 1.0);
+}
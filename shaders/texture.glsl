@@ -0,0 +1,52 @@
+// object textures, shared by the forward (shader.frag) and G-buffer (gbuffer.frag) fragment shaders
+
+#include "material.glsl"
+
+// size of the TextureTable, every texture of the scene is in the one array bound once per frame
+layout(constant_id = 5) const uint TEXTURE_COUNT = 1;
+layout(set = 1, binding = 0) uniform sampler2D textures[TEXTURE_COUNT];
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 proj;
+    mat4 camera;
+    mat4 rotation;
+    vec4 data; // z: frame in flight
+} ubo;
+
+// a video texture has one image per frame in flight in consecutive slots, the frame reads the one it uploaded
+uint textureSlot(bool video) {
+    uint slot = materials[draw.material].texture_slot;
+    return video ? slot + uint(ubo.data.z) : slot;
+}
+
+// video frames are stored as I420: a full size Y plane followed by quarter size U and V planes, all in one R8 image
+// slot has to be the same for the whole draw (Material::texture_slot), the array is indexed without nonuniformEXT
+vec4 sampleI420(uint slot, vec2 uv) {
+    ivec2 size = textureSize(textures[slot], 0);
+    int width = size.x;
+    int height = (size.y * 2) / 3;
+
+    ivec2 pixel = clamp(ivec2(uv * vec2(width, height)), ivec2(0), ivec2(width - 1, height - 1));
+
+    // chroma planes are half resolution and packed row after row into the remaining image rows
+    int chroma = (pixel.y / 2) * (width / 2) + (pixel.x / 2);
+    int u_index = width * height + chroma;
+    int v_index = u_index + (width * height) / 4;
+
+    float y = texelFetch(textures[slot], pixel, 0).r;
+    float u = texelFetch(textures[slot], ivec2(u_index % width, u_index / width), 0).r;
+    float v = texelFetch(textures[slot], ivec2(v_index % width, v_index / width), 0).r;
+
+    // BT.601 limited range to RGB
+    y = 1.164 * (y - 16.0 / 255.0);
+    u -= 0.5;
+    v -= 0.5;
+
+    vec3 rgb = clamp(vec3(
+        y + 1.596 * v,
+        y - 0.392 * u - 0.813 * v,
+        y + 2.017 * u
+    ), 0.0, 1.0);
+
+    return vec4(pow(rgb, vec3(2.2)), 1.0); // match the linear values sampled from sRGB images
+}